@@ -0,0 +1,16 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_ALLOCATIONCOUNTER_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_ALLOCATIONCOUNTER_H_
+
+#include <QtGlobal>
+
+/*
+	Process-wide allocation count for the benchmark.
+	With glibc, malloc itself is interposed so allocations made inside Qt are counted as well,
+	elsewhere only operator new is seen.
+*/
+class AllocationCounter {
+public:
+	static quint64 getAllocations();
+};
+
+#endif
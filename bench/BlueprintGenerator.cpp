@@ -0,0 +1,270 @@
+#include "BlueprintGenerator.h"
+
+#include <QFile>
+
+namespace {
+    // Deterministic entity ids, so generated files are identical between runs
+    quint64 nextEntityId(quint64& state) {
+        state += 0x9E3779B97F4A7C15ull;
+        quint64 z = state;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        z = z ^ (z >> 31);
+        return 0x7000000000000000ull | (z & 0x0FFFFFFFFFFFFFFFull);
+    }
+
+    void appendIndent(QByteArray& out, int depth) {
+        out.append(QByteArray(2 * depth, ' '));
+    }
+
+    void appendElement(QByteArray& out, int depth, char const* name, QByteArray const& text) {
+        appendIndent(out, depth);
+        out.append('<').append(name).append('>').append(text).append("</").append(name).append(">\n");
+    }
+
+    void appendVector(QByteArray& out, int depth, char const* name, int x, int y, int z) {
+        appendIndent(out, depth);
+        out.append('<').append(name).append(" x=\"").append(QByteArray::number(x)).append("\" y=\"").append(QByteArray::number(y)).append("\" z=\"").append(QByteArray::number(z)).append("\" />\n");
+    }
+
+    QByteArray customData(BlueprintGenerator::Parameters const& parameters, QByteArray const& nameTag) {
+        QByteArray result;
+        result.append("[Missile - Configuration]\n");
+        result.append("Missile name tag=").append(nameTag).append('\n');
+        result.append("Missile number=").append(QByteArray::number(parameters.number)).append('\n');
+        result.append("Fire individual missiles=true\n");
+        result.append("Spiral degrees=15\n");
+        result.append("Time to max spiral=3\n");
+        result.append("Disable gravity=false\n");
+        result.append("Detonation distance=0\n");
+
+        qsizetype line = 0;
+        while (result.size() < parameters.customDataSize) {
+            result.append("; Padding line ").append(QByteArray::number(line++)).append(" of the synthetic configuration\n");
+        }
+        result.append("[Missile - Done]");
+        return result;
+    }
+
+    void appendCubeGrid(QByteArray& out, BlueprintGenerator::Parameters const& parameters, QByteArray const& displayName, QByteArray const& nameTag, bool mainGrid, quint64& entityState) {
+        QByteArray const prefix = QByteArray("(").append(displayName).append(") ");
+
+        appendIndent(out, 4);
+        out.append("<CubeGrid>\n");
+        appendElement(out, 5, "SubtypeName", QByteArray());
+        appendElement(out, 5, "EntityId", QByteArray::number(nextEntityId(entityState)));
+        appendElement(out, 5, "PersistentFlags", "CastShadows InScene");
+        appendIndent(out, 5);
+        out.append("<PositionAndOrientation>\n");
+        appendVector(out, 6, "Position", 0, 0, (mainGrid) ? 0 : 5);
+        appendVector(out, 6, "Forward", 0, 0, -1);
+        appendVector(out, 6, "Up", 0, 1, 0);
+        appendIndent(out, 6);
+        out.append("<Orientation>\n");
+        appendElement(out, 7, "X", "0");
+        appendElement(out, 7, "Y", "0");
+        appendElement(out, 7, "Z", "0");
+        appendElement(out, 7, "W", "1");
+        appendIndent(out, 6);
+        out.append("</Orientation>\n");
+        appendIndent(out, 5);
+        out.append("</PositionAndOrientation>\n");
+        appendElement(out, 5, "GridSizeEnum", "Small");
+
+        appendIndent(out, 5);
+        out.append("<CubeBlocks>\n");
+        for (qsizetype i = 0; i < parameters.blocks; ++i) {
+            bool const programmableBlock = mainGrid && (i == 0);
+            bool const named = ((i % 2) == 0);
+
+            appendIndent(out, 6);
+            if (programmableBlock) {
+                out.append("<MyObjectBuilder_CubeBlock xsi:type=\"MyObjectBuilder_MyProgrammableBlock\">\n");
+                appendElement(out, 7, "SubtypeName", "SmallProgrammableBlock");
+            } else if (named) {
+                out.append("<MyObjectBuilder_CubeBlock xsi:type=\"MyObjectBuilder_Thrust\">\n");
+                appendElement(out, 7, "SubtypeName", "SmallBlockSmallThrust");
+            } else {
+                out.append("<MyObjectBuilder_CubeBlock xsi:type=\"MyObjectBuilder_CubeBlock\">\n");
+                appendElement(out, 7, "SubtypeName", "SmallBlockArmorBlock");
+            }
+            appendElement(out, 7, "EntityId", QByteArray::number(nextEntityId(entityState)));
+            appendVector(out, 7, "Min", static_cast<int>(i % 8), static_cast<int>((i / 8) % 8), static_cast<int>(i / 64));
+            appendIndent(out, 7);
+            out.append("<BlockOrientation Forward=\"Forward\" Up=\"Up\" />\n");
+            appendVector(out, 7, "ColorMaskHSV", 0, -1, 0);
+
+            for (int depth = 0; depth < parameters.nesting; ++depth) {
+                appendIndent(out, 7 + depth);
+                out.append("<ComponentContainer>\n");
+                appendElement(out, 8 + depth, "TypeId", "MyTimerComponent");
+            }
+            for (int depth = parameters.nesting - 1; depth >= 0; --depth) {
+                appendIndent(out, 7 + depth);
+                out.append("</ComponentContainer>\n");
+            }
+
+            if (named) {
+                QByteArray const blockName = (programmableBlock) ? QByteArray("Programmable Block") : QByteArray("Thruster ").append(QByteArray::number(i));
+                appendElement(out, 7, "CustomName", prefix + blockName);
+                appendElement(out, 7, "ShowOnHUD", "false");
+                appendElement(out, 7, "Enabled", "true");
+            }
+            if (programmableBlock) {
+                appendElement(out, 7, "CustomData", customData(parameters, nameTag));
+                appendElement(out, 7, "Program", "// Script omitted");
+            }
+            appendIndent(out, 6);
+            out.append("</MyObjectBuilder_CubeBlock>\n");
+        }
+        appendIndent(out, 5);
+        out.append("</CubeBlocks>\n");
+
+        appendElement(out, 5, "DisplayName", displayName);
+        appendElement(out, 5, "DestructibleBlocks", "true");
+
+        if (mainGrid) {
+            appendIndent(out, 5);
+            out.append("<BlockGroups>\n");
+            appendIndent(out, 6);
+            out.append("<MyObjectBuilder_BlockGroup>\n");
+            appendElement(out, 7, "Name", displayName);
+            appendIndent(out, 7);
+            out.append("<Blocks>\n");
+            for (qsizetype i = 0; i < parameters.blocks; i += 2) {
+                appendIndent(out, 8);
+                out.append("<Vector3I>\n");
+                appendElement(out, 9, "X", QByteArray::number(static_cast<int>(i % 8)));
+                appendElement(out, 9, "Y", QByteArray::number(static_cast<int>((i / 8) % 8)));
+                appendElement(out, 9, "Z", QByteArray::number(static_cast<int>(i / 64)));
+                appendIndent(out, 8);
+                out.append("</Vector3I>\n");
+            }
+            appendIndent(out, 7);
+            out.append("</Blocks>\n");
+            appendIndent(out, 6);
+            out.append("</MyObjectBuilder_BlockGroup>\n");
+            appendIndent(out, 5);
+            out.append("</BlockGroups>\n");
+        }
+        appendIndent(out, 4);
+        out.append("</CubeGrid>\n");
+    }
+}
+
+BlueprintGenerator::Parameters BlueprintGenerator::defaultParameters() {
+    Parameters result;
+    result.name = QStringLiteral("Synthetic Wasp MK_1");
+    result.number = 1;
+    result.blocks = 100;
+    result.nesting = 2;
+    result.customDataSize = 2048;
+    result.subgrids = 0;
+    return result;
+}
+
+QString BlueprintGenerator::displayNameOf(Parameters const& parameters) {
+    return QString("%1 %2").arg(parameters.name).arg(parameters.number);
+}
+
+QByteArray BlueprintGenerator::generate(Parameters const& parameters) {
+    QByteArray const displayName = displayNameOf(parameters).toUtf8();
+    QByteArray const nameTag = parameters.name.toUtf8();
+    quint64 entityState = static_cast<quint64>(parameters.blocks) * 31 + static_cast<quint64>(parameters.subgrids);
+
+    QByteArray out;
+    out.append("<?xml version=\"1.0\"?>\n");
+    out.append("<Definitions xmlns:xsd=\"http://www.w3.org/2001/XMLSchema\" xmlns:xsi=\"http://www.w3.org/2001/XMLSchema-instance\">\n");
+    appendIndent(out, 1);
+    out.append("<ShipBlueprints>\n");
+    appendIndent(out, 2);
+    out.append("<ShipBlueprint xsi:type=\"MyObjectBuilder_ShipBlueprintDefinition\">\n");
+    appendIndent(out, 3);
+    out.append("<Id Type=\"MyObjectBuilder_ShipBlueprintDefinition\" Subtype=\"").append(displayName).append("\" />\n");
+    appendElement(out, 3, "DisplayName", "Synthetic Engineer");
+    appendIndent(out, 3);
+    out.append("<CubeGrids>\n");
+    appendCubeGrid(out, parameters, displayName, nameTag, true, entityState);
+    for (qsizetype i = 0; i < parameters.subgrids; ++i) {
+        appendCubeGrid(out, parameters, displayName, nameTag, false, entityState);
+    }
+    appendIndent(out, 3);
+    out.append("</CubeGrids>\n");
+    appendElement(out, 3, "WorkshopId", "0");
+    appendElement(out, 3, "OwnerSteamId", "76561198000000000");
+    appendElement(out, 3, "Points", "0");
+    appendIndent(out, 2);
+    out.append("</ShipBlueprint>\n");
+    appendIndent(out, 1);
+    out.append("</ShipBlueprints>\n");
+    out.append("</Definitions>");
+    return out;
+}
+
+std::vector<BlueprintGenerator::Pathology> BlueprintGenerator::allPathologies() {
+    return { Pathology::DeepNesting, Pathology::GiantText, Pathology::ManyGroups, Pathology::ManyNames, Pathology::LongCustomData };
+}
+
+QString BlueprintGenerator::nameOf(Pathology pathology) {
+    switch (pathology) {
+        case Pathology::DeepNesting: return QStringLiteral("deep nesting");
+        case Pathology::GiantText: return QStringLiteral("giant text");
+        case Pathology::ManyGroups: return QStringLiteral("many groups");
+        case Pathology::ManyNames: return QStringLiteral("many names");
+        case Pathology::LongCustomData: return QStringLiteral("long custom data");
+    }
+    return QString();
+}
+
+QByteArray BlueprintGenerator::generatePathological(Pathology pathology, qsizetype size) {
+    Parameters parameters = defaultParameters();
+    parameters.blocks = 10;
+    if (pathology == Pathology::ManyNames) {
+        // Every second block is named
+        parameters.blocks = 2 * size;
+    } else if (pathology == Pathology::LongCustomData) {
+        parameters.customDataSize = size;
+    }
+    QByteArray out = generate(parameters);
+
+    // The rest is spliced into an otherwise valid blueprint, without indentation so the file stays linear in size
+    QByteArray payload;
+    QByteArray anchor;
+    if (pathology == Pathology::DeepNesting) {
+        anchor = "</MyObjectBuilder_CubeBlock>";
+        payload.reserve(13 * size);
+        for (qsizetype i = 0; i < size; ++i) {
+            payload.append("<Nest>");
+        }
+        for (qsizetype i = 0; i < size; ++i) {
+            payload.append("</Nest>");
+        }
+    } else if (pathology == Pathology::GiantText) {
+        anchor = "</MyObjectBuilder_CubeBlock>";
+        payload.append("<Notes>").append(QByteArray(size, 'x')).append("</Notes>");
+    } else if (pathology == Pathology::ManyGroups) {
+        anchor = "</BlockGroups>";
+        for (qsizetype i = 0; i < size; ++i) {
+            payload.append("<MyObjectBuilder_BlockGroup><Name>Extra ").append(QByteArray::number(i)).append("</Name><Blocks /></MyObjectBuilder_BlockGroup>");
+        }
+    }
+    if (!anchor.isEmpty()) {
+        out.insert(out.indexOf(anchor), payload);
+    }
+    return out;
+}
+
+QString BlueprintGenerator::writeFolder(QDir const& location, Parameters const& parameters) {
+    QString const displayName = displayNameOf(parameters);
+    QDir folder(location);
+    if (!folder.mkpath(displayName) || !folder.cd(displayName)) {
+        return QString();
+    }
+
+    QByteArray const data = generate(parameters);
+    QFile file(folder.absoluteFilePath(QStringLiteral("bp.sbc")));
+    if (!file.open(QFile::WriteOnly) || (file.write(data) != data.size())) {
+        return QString();
+    }
+    return folder.absolutePath();
+}
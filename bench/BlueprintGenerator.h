@@ -0,0 +1,53 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_BLUEPRINTGENERATOR_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_BLUEPRINTGENERATOR_H_
+
+#include <QByteArray>
+#include <QDir>
+#include <QString>
+
+#include <vector>
+
+/*
+	Writes synthetic WHAM-style bp.sbc files of a given shape, for benchmarking.
+	The result passes all checks of BlueprintData::fromXml: one block group, a programmable block
+	with the WHAM custom data and every named block carrying the group name prefix.
+	The pathological shapes are the exception, they are meant to run into the parse limits or the checks.
+*/
+class BlueprintGenerator {
+public:
+	struct Parameters {
+		// Missile type, the group name and name tag are derived from it
+		QString name;
+		int number;
+		// Blocks per grid, every second one is named and belongs to the group
+		qsizetype blocks;
+		// Depth of the component data nested into every block
+		int nesting;
+		// Approximate size of the WHAM custom data in bytes
+		qsizetype customDataSize;
+		// Additional grids attached to the main grid
+		qsizetype subgrids;
+	};
+
+	// Hostile documents whose one exaggerated feature grows linearly with the size
+	enum class Pathology {
+		DeepNesting,   // size elements nested into each other inside a block
+		GiantText,     // a text node of size bytes inside a block
+		ManyGroups,    // size additional block groups
+		ManyNames,     // size named blocks
+		LongCustomData // WHAM custom data of size bytes
+	};
+
+	static Parameters defaultParameters();
+	static std::vector<Pathology> allPathologies();
+	static QString nameOf(Pathology pathology);
+
+	static QByteArray generate(Parameters const& parameters);
+	static QByteArray generatePathological(Pathology pathology, qsizetype size);
+	// Creates <location>/<display name>/bp.sbc, returns the path of the blueprint folder or an empty string
+	static QString writeFolder(QDir const& location, Parameters const& parameters);
+
+	static QString displayNameOf(Parameters const& parameters);
+};
+
+#endif
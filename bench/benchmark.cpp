@@ -0,0 +1,400 @@
+#include <QBuffer>
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <sstream>
+#include <vector>
+
+#include "AllocationCounter.h"
+#include "BlueprintGenerator.h"
+
+#include "BlueprintData.h"
+#include "BlueprintScanner.h"
+#include "CopyPipeline.h"
+#include "CustomData.h"
+#include "Duplicator.h"
+#include "EntityIds.h"
+#include "Options.h"
+#include "PatchTemplate.h"
+#include "Stats.h"
+
+namespace {
+    struct Stage {
+        QString name;
+        // Bytes processed per iteration, for the throughput
+        qsizetype bytes;
+        std::function<bool()> body;
+    };
+
+    struct Result {
+        QString stage;
+        qsizetype iterations;
+        double seconds;
+        double bytesPerIteration;
+        double allocationsPerIteration;
+        qint64 peakResidentKiB;
+    };
+
+    // The library reports its findings on std::cout and rejected documents on std::cerr, which would drown the results
+    class QuietScope {
+    public:
+        QuietScope() : m_previous(std::cout.rdbuf(m_sink.rdbuf())), m_previousErrors(std::cerr.rdbuf(m_sink.rdbuf())) {
+            //
+        }
+        ~QuietScope() {
+            std::cout.rdbuf(m_previous);
+            std::cerr.rdbuf(m_previousErrors);
+        }
+    private:
+        std::ostringstream m_sink;
+        std::streambuf* const m_previous;
+        std::streambuf* const m_previousErrors;
+    };
+
+    // A plain run that never asks, reading blueprints within the given limits
+    Options makeOptions(ParseLimits const& parseLimits) {
+        Options result;
+        result.force = true;
+        result.parseLimits = parseLimits;
+        return result;
+    }
+
+    // Repeats the body until it ran for at least minimumMilliseconds, after one untimed warm-up run
+    std::optional<Result> measure(QString const& stage, qsizetype bytesPerIteration, qint64 minimumMilliseconds, std::function<bool()> const& body) {
+        QuietScope const quiet;
+        if (!body()) {
+            return std::nullopt;
+        }
+
+        quint64 const allocationsBefore = AllocationCounter::getAllocations();
+        qsizetype iterations = 0;
+        QElapsedTimer timer;
+        timer.start();
+        do {
+            if (!body()) {
+                return std::nullopt;
+            }
+            ++iterations;
+        } while (timer.elapsed() < minimumMilliseconds);
+        double const seconds = static_cast<double>(timer.nsecsElapsed()) / 1e9;
+        quint64 const allocations = AllocationCounter::getAllocations() - allocationsBefore;
+
+        return Result{ stage, iterations, seconds, static_cast<double>(bytesPerIteration), static_cast<double>(allocations) / static_cast<double>(iterations), Stats::getPeakResidentKiB() };
+    }
+
+    void printHeader(bool csv) {
+        if (csv) {
+            std::cout << "blocks,nesting,customData,subgrids,size,stage,iterations,msPerOp,mbPerSecond,opsPerSecond,allocationsPerOp,peakResidentKiB" << std::endl;
+        } else {
+            std::cout << std::left << std::setw(30) << "stage" << std::right << std::setw(12) << "ms/op" << std::setw(12) << "MB/s" << std::setw(12) << "ops/s" << std::setw(14) << "allocs/op" << std::setw(14) << "peak RSS MiB" << std::endl;
+        }
+    }
+
+    void printResult(BlueprintGenerator::Parameters const& parameters, qsizetype size, Result const& result, bool csv) {
+        double const msPerOp = 1000.0 * result.seconds / static_cast<double>(result.iterations);
+        double const opsPerSecond = static_cast<double>(result.iterations) / result.seconds;
+        double const mbPerSecond = opsPerSecond * result.bytesPerIteration / (1024.0 * 1024.0);
+        if (csv) {
+            std::cout << parameters.blocks << "," << parameters.nesting << "," << parameters.customDataSize << "," << parameters.subgrids << "," << size << "," << result.stage.toStdString() << "," << result.iterations << "," << msPerOp << "," << mbPerSecond << "," << opsPerSecond << "," << result.allocationsPerIteration << "," << result.peakResidentKiB << std::endl;
+        } else {
+            std::cout << std::left << std::setw(30) << result.stage.toStdString() << std::right << std::fixed << std::setprecision(3) << std::setw(12) << msPerOp << std::setprecision(1) << std::setw(12) << mbPerSecond << std::setw(12) << opsPerSecond << std::setw(14) << result.allocationsPerIteration << std::setw(14) << ((result.peakResidentKiB < 0) ? -1.0 : static_cast<double>(result.peakResidentKiB) / 1024.0) << std::defaultfloat << std::endl;
+        }
+    }
+
+    double msPerOp(Result const& result) {
+        return 1000.0 * result.seconds / static_cast<double>(result.iterations);
+    }
+
+    // Reads every pathological document at the given size and four times that, the time per byte may only grow by maximumGrowth
+    bool checkPathological(qsizetype size, qint64 minimumMilliseconds, double maximumGrowth, bool csv) {
+        Options const unlimited = makeOptions(ParseLimits::none());
+        Options const limited = makeOptions(ParseLimits::defaults());
+        if (csv) {
+            std::cout << "pathology,size,stage,msPerOp,largeSize,largeMsPerOp,growth" << std::endl;
+        }
+        bool linear = true;
+        for (auto const pathology : BlueprintGenerator::allPathologies()) {
+            QByteArray const small = BlueprintGenerator::generatePathological(pathology, size);
+            QByteArray const large = BlueprintGenerator::generatePathological(pathology, 4 * size);
+            if (!csv) {
+                std::cout << std::endl << BlueprintGenerator::nameOf(pathology).toStdString() << ": " << small.size() << " and " << large.size() << " bytes" << std::endl;
+                std::cout << std::left << std::setw(30) << "stage" << std::right << std::setw(12) << "ms/op" << std::setw(12) << "4x ms/op" << std::setw(12) << "growth" << std::endl;
+            }
+
+            // Nesting beyond the default limit has to be stopped by it
+            if ((pathology == BlueprintGenerator::Pathology::DeepNesting) && (size > limited.parseLimits.maxDepth)) {
+                bool const accepted = [&]() {
+                    QuietScope const quiet;
+                    return BlueprintData::fromXml(small, limited, std::cerr).has_value();
+                }();
+                if (accepted) {
+                    std::cerr << "The default limits did not stop the deep nesting!" << std::endl;
+                    linear = false;
+                }
+            }
+
+            // Rejecting the document is a valid outcome here, only the time it takes matters
+            std::vector<std::pair<QString, std::function<bool(QByteArray const&)>>> const stages = {
+                { QStringLiteral("BlueprintScanner::scan"), [&](QByteArray const& data) {
+                    ParseBudget budget(ParseLimits::none());
+                    std::ostringstream error;
+                    BlueprintScanner::scan(data, budget, error);
+                    return true;
+                } },
+                { QStringLiteral("fromXml"), [&](QByteArray const& data) {
+                    BlueprintData::fromXml(data, unlimited, std::cerr);
+                    return true;
+                } },
+                { QStringLiteral("fromXml (QXmlStreamReader)"), [&](QByteArray const& data) {
+                    QBuffer buffer;
+                    buffer.setData(data);
+                    return buffer.open(QIODevice::ReadOnly) && (BlueprintData::fromXml(buffer, unlimited, std::cerr), true);
+                } },
+                { QStringLiteral("fromXml (default limits)"), [&](QByteArray const& data) {
+                    BlueprintData::fromXml(data, limited, std::cerr);
+                    return true;
+                } },
+            };
+            for (auto const& stage : stages) {
+                auto const smallResult = measure(stage.first, small.size(), minimumMilliseconds, [&]() { return stage.second(small); });
+                auto const largeResult = measure(stage.first, large.size(), minimumMilliseconds, [&]() { return stage.second(large); });
+                if (!smallResult || !largeResult) {
+                    std::cerr << "Stage " << stage.first.toStdString() << " failed on " << BlueprintGenerator::nameOf(pathology).toStdString() << "!" << std::endl;
+                    return false;
+                }
+                double const growth = (msPerOp(*largeResult) / static_cast<double>(large.size())) / (msPerOp(*smallResult) / static_cast<double>(small.size()));
+                if (csv) {
+                    std::cout << BlueprintGenerator::nameOf(pathology).toStdString() << "," << small.size() << "," << stage.first.toStdString() << "," << msPerOp(*smallResult) << "," << large.size() << "," << msPerOp(*largeResult) << "," << growth << std::endl;
+                } else {
+                    std::cout << std::left << std::setw(30) << stage.first.toStdString() << std::right << std::fixed << std::setprecision(3) << std::setw(12) << msPerOp(*smallResult) << std::setw(12) << msPerOp(*largeResult) << std::setprecision(2) << std::setw(12) << growth << std::defaultfloat << std::endl;
+                }
+                if (growth > maximumGrowth) {
+                    std::cerr << "Stage " << stage.first.toStdString() << " is not linear on " << BlueprintGenerator::nameOf(pathology).toStdString() << ", the time per byte grew by " << growth << " at four times the size!" << std::endl;
+                    linear = false;
+                }
+            }
+        }
+        return linear;
+    }
+
+    std::vector<qsizetype> parseList(QString const& value, bool& ok) {
+        std::vector<qsizetype> result;
+        ok = true;
+        for (auto const& part : value.split(',')) {
+            bool partOk = false;
+            qsizetype const number = part.trimmed().toInt(&partOk);
+            if (!partOk || (number < 0)) {
+                ok = false;
+                return result;
+            }
+            result.push_back(number);
+        }
+        return result;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    QCoreApplication app(argc, argv);
+    QCoreApplication::setApplicationName("blueprintBenchmark");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Generates synthetic WHAM blueprints and measures the parse and rewrite stages of the duplicator.");
+    parser.addHelpOption();
+    parser.addOption(QCommandLineOption("blocks", "Comma-separated list of blocks per grid (default: 10,100,1000,10000)", "list", "10,100,1000,10000"));
+    parser.addOption(QCommandLineOption("nesting", "Comma-separated list of component nesting depths per block (default: 2)", "list", "2"));
+    parser.addOption(QCommandLineOption("customData", "Comma-separated list of WHAM custom data sizes in bytes (default: 2048)", "list", "2048"));
+    parser.addOption(QCommandLineOption("subgrids", "Comma-separated list of subgrid counts (default: 0)", "list", "0"));
+    parser.addOption(QCommandLineOption("minTime", "Minimum time per stage in milliseconds (default: 200)", "number", "200"));
+    parser.addOption(QCommandLineOption("csv", "Print the results as CSV, for comparing against a stored baseline"));
+    parser.addOption(QCommandLineOption("generate", "Only write one blueprint per size into the given folder", "path", ""));
+    parser.addOption(QCommandLineOption("pathological", "Instead of the sizes, read hostile documents of the given size and four times that and fail unless the time stays linear", "size", ""));
+    parser.addOption(QCommandLineOption("maxGrowth", "How much the time per byte of a pathological document may grow at four times the size (default: 2.0)", "factor", "2.0"));
+    parser.process(app);
+
+    bool okBlocks = false;
+    bool okNesting = false;
+    bool okCustomData = false;
+    bool okSubgrids = false;
+    bool okMinTime = false;
+    auto const blocksList = parseList(parser.value("blocks"), okBlocks);
+    auto const nestingList = parseList(parser.value("nesting"), okNesting);
+    auto const customDataList = parseList(parser.value("customData"), okCustomData);
+    auto const subgridsList = parseList(parser.value("subgrids"), okSubgrids);
+    qint64 const minTime = parser.value("minTime").toInt(&okMinTime);
+    if (!okBlocks || !okNesting || !okCustomData || !okSubgrids || !okMinTime) {
+        std::cerr << "Could not parse the size options, see --help." << std::endl;
+        return -1;
+    }
+    bool const csv = parser.isSet("csv");
+
+    if (parser.isSet("pathological")) {
+        bool okSize = false;
+        bool okGrowth = false;
+        qsizetype const size = parser.value("pathological").toInt(&okSize);
+        double const maxGrowth = parser.value("maxGrowth").toDouble(&okGrowth);
+        if (!okSize || (size < 1) || !okGrowth || (maxGrowth < 1.0)) {
+            std::cerr << "Could not parse --pathological or --maxGrowth, see --help." << std::endl;
+            return -1;
+        }
+        return checkPathological(size, minTime, maxGrowth, csv) ? 0 : -1;
+    }
+
+    std::vector<BlueprintGenerator::Parameters> sizes;
+    for (auto const blocks : blocksList) {
+        for (auto const nesting : nestingList) {
+            for (auto const customDataSize : customDataList) {
+                for (auto const subgrids : subgridsList) {
+                    BlueprintGenerator::Parameters parameters = BlueprintGenerator::defaultParameters();
+                    parameters.blocks = std::max<qsizetype>(blocks, 1);
+                    parameters.nesting = static_cast<int>(nesting);
+                    parameters.customDataSize = customDataSize;
+                    parameters.subgrids = subgrids;
+                    sizes.push_back(parameters);
+                }
+            }
+        }
+    }
+
+    if (parser.isSet("generate")) {
+        QDir const location(parser.value("generate"));
+        for (std::size_t i = 0; i < sizes.size(); ++i) {
+            // Distinct numbers keep the folders apart
+            sizes.at(i).number = static_cast<int>(i + 1);
+            QString const folder = BlueprintGenerator::writeFolder(location, sizes.at(i));
+            if (folder.isEmpty()) {
+                std::cerr << "Failed to write a blueprint into '" << location.absolutePath().toStdString() << "'!" << std::endl;
+                return -1;
+            }
+            std::cout << "Wrote " << folder.toStdString() << std::endl;
+        }
+        return 0;
+    }
+
+    Options const options = makeOptions(ParseLimits::defaults());
+    qsizetype const jobs = QThread::idealThreadCount();
+    QString overrideError;
+    std::vector<CustomData::Override> const overrides = { *CustomData::parseOverride(QStringLiteral("Launch delay={(i % 4) * 0.5}"), overrideError) };
+
+    if (csv) {
+        printHeader(true);
+    }
+    for (auto const& parameters : sizes) {
+        QByteArray const data = BlueprintGenerator::generate(parameters);
+        if (!csv) {
+            std::cout << std::endl << parameters.blocks << " blocks, nesting " << parameters.nesting << ", " << parameters.customDataSize << " bytes custom data, " << parameters.subgrids << " subgrids: " << data.size() << " bytes" << std::endl;
+            printHeader(false);
+        }
+
+        // Differential check, the fast scanner has to agree with QXmlStreamReader
+        auto const blueprintData = [&]() {
+            QuietScope const quiet;
+            return BlueprintData::fromScan(data, std::cerr);
+        }();
+        auto const referenceData = [&]() {
+            QuietScope const quiet;
+            QBuffer buffer;
+            buffer.setData(data);
+            buffer.open(QIODevice::ReadOnly);
+            return BlueprintData::fromXml(buffer, options, std::cerr);
+        }();
+        if (!blueprintData || !referenceData) {
+            std::cerr << "The generated blueprint was rejected by the " << ((blueprintData) ? "XML parser" : "fast scanner") << "!" << std::endl;
+            return -1;
+        } else if (*blueprintData != *referenceData) {
+            std::cerr << "The fast scanner and the XML parser read different data from the generated blueprint!" << std::endl;
+            return -1;
+        }
+        auto const patchTemplate = PatchTemplate::compile(data, *blueprintData, {}, std::cerr);
+        if (!patchTemplate) {
+            std::cerr << "The generated blueprint could not be compiled into a patch template!" << std::endl;
+            return -1;
+        }
+        auto const overrideTemplate = PatchTemplate::compile(data, *blueprintData, overrides, std::cerr);
+        if (!overrideTemplate) {
+            std::cerr << "The generated blueprint could not be compiled into a patch template with custom data overrides!" << std::endl;
+            return -1;
+        }
+        auto const entityIds = EntityIds::collect(data);
+        if (!entityIds) {
+            std::cerr << "The generated blueprint has no EntityIds!" << std::endl;
+            return -1;
+        }
+        PatchTemplate const entityIdTemplate = patchTemplate->withEntityIds(std::make_shared<EntityIds const>(*entityIds));
+
+        qsizetype newId = 1000;
+        // Kept across iterations like the buffers of the copy pipeline
+        QByteArray reused;
+        qsizetype const nameSize = blueprintData->getDisplayName().toUtf8().size();
+        std::vector<Stage> const stages = {
+            { QStringLiteral("cutDigitsFromEnd"), nameSize, [&]() {
+                return !BlueprintData::cutDigitsFromEnd(blueprintData->getDisplayName()).isEmpty();
+            } },
+            { QStringLiteral("BlueprintScanner::scan"), data.size(), [&]() {
+                return BlueprintScanner::scan(data, std::cerr).has_value();
+            } },
+            { QStringLiteral("fromXml"), data.size(), [&]() {
+                return BlueprintData::fromXml(data, options, std::cerr).has_value();
+            } },
+            { QStringLiteral("fromXml (QXmlStreamReader)"), data.size(), [&]() {
+                QBuffer buffer;
+                buffer.setData(data);
+                return buffer.open(QIODevice::ReadOnly) && BlueprintData::fromXml(buffer, options, std::cerr).has_value();
+            } },
+            { QStringLiteral("toXMLWithNewId"), data.size(), [&]() {
+                return !BlueprintData::toXMLWithNewId(data, *blueprintData, ++newId, options, std::cerr).isEmpty();
+            } },
+            { QStringLiteral("toXMLWithNewId (reused buffer)"), data.size(), [&]() {
+                return BlueprintData::toXMLWithNewId(data, *blueprintData, ++newId, options, reused, std::cerr);
+            } },
+            { QStringLiteral("toXMLWithNewId (stream)"), data.size(), [&]() {
+                QBuffer input;
+                input.setData(data);
+                QBuffer output;
+                return input.open(QIODevice::ReadOnly) && output.open(QIODevice::WriteOnly) && BlueprintData::toXMLWithNewId(input, output, *blueprintData, ++newId, options, std::cerr);
+            } },
+            { QStringLiteral("PatchTemplate::compile"), data.size(), [&]() {
+                return PatchTemplate::compile(data, *blueprintData, {}, std::cerr).has_value();
+            } },
+            { QStringLiteral("PatchTemplate::instantiate"), data.size(), [&]() {
+                return !patchTemplate->instantiate(++newId).isEmpty();
+            } },
+            { QStringLiteral("PatchTemplate::instantiate (reused buffer)"), data.size(), [&]() {
+                patchTemplate->instantiate(++newId, reused);
+                return !reused.isEmpty();
+            } },
+            { QStringLiteral("PatchTemplate::instantiate (customData)"), data.size(), [&]() {
+                return !overrideTemplate->instantiate(++newId).isEmpty();
+            } },
+            { QStringLiteral("PatchTemplate::instantiate (newEntityIds)"), data.size(), [&]() {
+                return !entityIdTemplate.instantiate(++newId).isEmpty();
+            } },
+            { QStringLiteral("Duplicator::load"), data.size(), [&]() {
+                Duplicator::Error error;
+                return Duplicator::load(Duplicator::ByteSpan{ data.constData(), data.size() }, Duplicator::ByteSpan{ nullptr, 0 }, error).has_value();
+            } },
+            { QStringLiteral("CopyPipeline (100 copies)"), 100 * data.size(), [&]() {
+                CopyPipeline const pipeline(jobs, 2 * jobs);
+                return pipeline.run(100, [&](qsizetype i, QByteArray& copy) { patchTemplate->instantiate(i, copy); }, [](qsizetype, QByteArray const& copy) { return !copy.isEmpty(); });
+            } },
+        };
+
+        for (auto const& stage : stages) {
+            auto const result = measure(stage.name, stage.bytes, minTime, stage.body);
+            if (!result) {
+                std::cerr << "Stage " << stage.name.toStdString() << " failed!" << std::endl;
+                return -1;
+            }
+            printResult(parameters, data.size(), *result, csv);
+        }
+    }
+
+    return 0;
+}
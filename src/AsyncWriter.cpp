@@ -0,0 +1,677 @@
+#include "AsyncWriter.h"
+
+#include "Sidecars.h"
+#include "Stats.h"
+
+#include <QDir>
+#include <QFile>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <ostream>
+#include <sstream>
+#include <thread>
+
+#ifdef BLUEPRINTDUPLICATOR_HAVE_LIBURING
+#include <liburing.h>
+
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class AsyncWriter::Backend {
+public:
+    virtual ~Backend() = default;
+
+    // Both append the copies completed in the meantime to results. submit moves from copy unless the backend has
+    // failed, the copy then has to go to another one.
+    virtual bool submit(Copy& copy, std::vector<Result>& results) = 0;
+    virtual void finish(std::vector<Result>& results) = 0;
+
+    // Once failed, a backend takes no more copies, all copies it had in flight were reported as failed
+    virtual bool hasFailed() const {
+        return false;
+    }
+    virtual char const* getName() const = 0;
+};
+
+namespace {
+    std::string failedToWrite(QString const& fileName, bool notWritable) {
+        return "Error: Failed to write file '" + fileName.toStdString() + ((notWritable) ? "', not writable!" : "'!");
+    }
+
+    std::string failedToWriteBinary(QString const& folder) {
+        return "Warning: Failed to write the binary blueprint cache of '" + QDir(folder).dirName().toStdString() + "'.";
+    }
+
+    std::string failedToCopySidecars(QString const& folder) {
+        return "Warning: Failed to copy some of the other files of the Blueprint to '" + QDir(folder).dirName().toStdString() + "'.";
+    }
+
+    // Keeps the warnings given before, one per line
+    void addWarning(AsyncWriter::Result& result, std::string warning) {
+        while (!warning.empty() && (warning.back() == '\n')) {
+            warning.pop_back();
+        }
+        if (!warning.empty() && (result.warning.find(warning) == std::string::npos)) {
+            result.warning = (result.warning.empty()) ? warning : (result.warning + "\n" + warning);
+        }
+    }
+
+    QStringList getReplacedFileNames(AsyncWriter::Copy const& copy) {
+        return (copy.sidecars == nullptr) ? QStringList({ QStringLiteral("thumb.png") }) : copy.sidecars->getReplacedFileNames();
+    }
+
+    // The same chain of blocking calls as the serial writer, run on the worker threads
+    AsyncWriter::Result writeBlocking(AsyncWriter::Copy const& copy) {
+        Stats::Span const span("write", copy.index);
+        AsyncWriter::Result result{ copy.index, false, 0, std::string(), std::string() };
+
+        QDir const copyDir(copy.folder);
+        if (!copyDir.exists()) {
+            QDir().mkdir(copy.folder);
+        }
+        QString const copyBpName = copyDir.absoluteFilePath(QStringLiteral("bp.sbc"));
+        if (copy.replace) {
+            QFile::remove(copyBpName);
+            QFile::remove(copyDir.absoluteFilePath(QStringLiteral("bp.sbcB5")));
+            for (auto const& name : getReplacedFileNames(copy)) {
+                QFile::remove(copyDir.absoluteFilePath(name));
+            }
+        }
+
+        QFile fileBlueprint(copyBpName);
+        if (!fileBlueprint.open(QFile::WriteOnly | QFile::Unbuffered)) {
+            result.error = failedToWrite(copyBpName, true);
+            return result;
+        }
+        if (fileBlueprint.write(copy.blueprint) != copy.blueprint.size()) {
+            result.error = failedToWrite(copyBpName, false);
+            return result;
+        }
+        fileBlueprint.close();
+        result.bytesWritten += copy.blueprint.size();
+
+        if (!copy.binary.isEmpty()) {
+            QFile fileBinary(copyDir.absoluteFilePath(QStringLiteral("bp.sbcB5")));
+            if (!fileBinary.open(QFile::WriteOnly) || (fileBinary.write(copy.binary) != copy.binary.size())) {
+                addWarning(result, failedToWriteBinary(copy.folder));
+                fileBinary.remove();
+            } else {
+                result.bytesWritten += copy.binary.size();
+            }
+        }
+
+        if (copy.sidecars != nullptr) {
+            std::ostringstream sidecarError;
+            qint64 const written = copy.sidecars->propagate(copyDir, sidecarError);
+            addWarning(result, sidecarError.str());
+            if (written < 0) {
+                addWarning(result, failedToCopySidecars(copy.folder));
+            } else {
+                result.bytesWritten += written;
+            }
+        }
+
+        result.success = true;
+        return result;
+    }
+
+    class ThreadBackend : public AsyncWriter::Backend {
+    public:
+        ThreadBackend(qsizetype inFlight, qsizetype threadCount) : m_inFlight(inFlight), m_pending(0), m_stopping(false) {
+            for (qsizetype i = 0; i < threadCount; ++i) {
+                m_threads.emplace_back([this]() { work(); });
+            }
+        }
+
+        ~ThreadBackend() override {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stopping = true;
+            }
+            m_workCondition.notify_all();
+            for (auto& thread : m_threads) {
+                thread.join();
+            }
+        }
+
+        bool submit(AsyncWriter::Copy& copy, std::vector<AsyncWriter::Result>& results) override {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            // Finished copies only stop counting as pending once they are collected
+            m_doneCondition.wait(lock, [&]() { return m_pending - static_cast<qsizetype>(m_done.size()) < m_inFlight; });
+            collect(results);
+            m_queue.push_back(std::move(copy));
+            ++m_pending;
+            lock.unlock();
+            m_workCondition.notify_one();
+            return true;
+        }
+
+        void finish(std::vector<AsyncWriter::Result>& results) override {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_doneCondition.wait(lock, [&]() { return m_pending == static_cast<qsizetype>(m_done.size()); });
+            collect(results);
+        }
+
+        char const* getName() const override {
+            return "threads";
+        }
+    private:
+        qsizetype const m_inFlight;
+        std::vector<std::thread> m_threads;
+        std::mutex m_mutex;
+        std::condition_variable m_workCondition;
+        std::condition_variable m_doneCondition;
+        std::deque<AsyncWriter::Copy> m_queue;
+        std::vector<AsyncWriter::Result> m_done;
+        qsizetype m_pending;
+        bool m_stopping;
+
+        // Called with the mutex held
+        void collect(std::vector<AsyncWriter::Result>& results) {
+            m_pending -= static_cast<qsizetype>(m_done.size());
+            for (auto& result : m_done) {
+                results.push_back(std::move(result));
+            }
+            m_done.clear();
+        }
+
+        void work() {
+            while (true) {
+                AsyncWriter::Copy copy;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_workCondition.wait(lock, [&]() { return m_stopping || !m_queue.empty(); });
+                    if (m_queue.empty()) {
+                        return;
+                    }
+                    copy = std::move(m_queue.front());
+                    m_queue.pop_front();
+                }
+
+                AsyncWriter::Result result = writeBlocking(copy);
+
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_done.push_back(std::move(result));
+                }
+                m_doneCondition.notify_all();
+            }
+        }
+    };
+
+#ifdef BLUEPRINTDUPLICATOR_HAVE_LIBURING
+    /*
+        Every copy in flight owns a slot and advances through its chain one completion at a time,
+        the operations of different copies and of independent files of one copy are in flight together.
+        The user data of every request is the slot number and which of its operations completed.
+    */
+    class UringBackend : public AsyncWriter::Backend {
+    public:
+        static std::unique_ptr<UringBackend> create(qsizetype inFlight) {
+            std::unique_ptr<UringBackend> backend(new UringBackend(inFlight));
+            // Most of the time, a slot has at most three requests in flight
+            unsigned entries = 1;
+            while (entries < static_cast<unsigned>(3 * inFlight)) {
+                entries *= 2;
+            }
+            if (io_uring_queue_init(entries, &backend->m_ring, 0) < 0) {
+                return nullptr;
+            }
+            backend->m_initialized = true;
+
+            // mkdirat and unlinkat need Linux 5.15, older kernels use the threads
+            io_uring_probe* const probe = io_uring_get_probe_ring(&backend->m_ring);
+            if (probe == nullptr) {
+                return nullptr;
+            }
+            bool supported = true;
+            for (int const opcode : { IORING_OP_MKDIRAT, IORING_OP_UNLINKAT, IORING_OP_OPENAT, IORING_OP_WRITE, IORING_OP_CLOSE }) {
+                supported = supported && io_uring_opcode_supported(probe, opcode);
+            }
+            io_uring_free_probe(probe);
+            if (!supported) {
+                return nullptr;
+            }
+            return backend;
+        }
+
+        ~UringBackend() override {
+            if (m_initialized) {
+                std::vector<AsyncWriter::Result> results;
+                finish(results);
+                io_uring_queue_exit(&m_ring);
+            }
+        }
+
+        bool submit(AsyncWriter::Copy& copy, std::vector<AsyncWriter::Result>& results) override {
+            while (!m_failed && m_free.empty()) {
+                reap(true, results);
+            }
+            if (m_failed) {
+                return false;
+            }
+            std::size_t const slotIndex = m_free.back();
+            m_free.pop_back();
+
+            Slot& slot = m_slots.at(slotIndex);
+            QDir const copyDir(copy.folder);
+            slot.folderPath = QFile::encodeName(copy.folder);
+            slot.files.clear();
+            slot.files.push_back(File(copyDir.absoluteFilePath(QStringLiteral("bp.sbc")), copy.blueprint));
+            slot.files.push_back(File(copyDir.absoluteFilePath(QStringLiteral("bp.sbcB5")), copy.binary));
+            // Sidecars already read into memory are written like the rest, the others are propagated on this thread
+            if (copy.sidecars != nullptr) {
+                for (auto const& sidecar : copy.sidecars->getFiles()) {
+                    if (sidecar.contents) {
+                        slot.files.push_back(File(copyDir.absoluteFilePath(sidecar.name), *sidecar.contents));
+                    }
+                }
+            }
+            slot.removePaths.clear();
+            if (copy.replace) {
+                slot.removePaths.push_back(slot.files.at(Blueprint).path);
+                slot.removePaths.push_back(slot.files.at(Binary).path);
+                for (auto const& name : getReplacedFileNames(copy)) {
+                    slot.removePaths.push_back(QFile::encodeName(copyDir.absoluteFilePath(name)));
+                }
+            }
+            slot.result = AsyncWriter::Result{ copy.index, false, 0, std::string(), std::string() };
+            slot.copy = std::move(copy);
+
+            // Like the serial writer, a folder that can not be created shows up as bp.sbc not being writable
+            slot.step = Step::Folder;
+            slot.outstanding = 1;
+            io_uring_prep_mkdirat(nextRequest(), AT_FDCWD, slot.folderPath.constData(), 0777);
+            tag(slotIndex, 0);
+
+            {
+                Stats::Span const span("submit", slot.copy.index);
+                io_uring_submit(&m_ring);
+            }
+            reap(false, results);
+            return true;
+        }
+
+        void finish(std::vector<AsyncWriter::Result>& results) override {
+            while (!m_failed && (m_free.size() < m_slots.size())) {
+                reap(true, results);
+            }
+        }
+
+        bool hasFailed() const override {
+            return m_failed;
+        }
+
+        char const* getName() const override {
+            return "io_uring";
+        }
+    private:
+        enum FileIndex { Blueprint = 0, Binary = 1, FirstSidecar = 2 };
+        enum class Step { Folder, Remove, Blueprint, Rest };
+        // Operation 0 is the folder, the next ones remove a file and from advanceFile on they advance a file
+        static unsigned const advanceFile = 0x8000;
+
+        struct File {
+            enum class State { Open, Write, Close, Done };
+
+            File(QString const& fileName, QByteArray const& data) : fileName(fileName), path(QFile::encodeName(fileName)), data(data), state(State::Done), failed(false), openFailed(false), kept(false), fd(-1), written(0) {
+                //
+            }
+
+            QString fileName;
+            QByteArray path;
+            QByteArray data;
+            State state;
+            bool failed;
+            bool openFailed;
+            // A sidecar that already existed, which is kept like QFile::copy does
+            bool kept;
+            int fd;
+            qint64 written;
+        };
+
+        struct Slot {
+            AsyncWriter::Copy copy;
+            QByteArray folderPath;
+            std::vector<File> files;
+            std::vector<QByteArray> removePaths;
+            Step step;
+            int outstanding;
+            AsyncWriter::Result result;
+        };
+
+        io_uring m_ring;
+        bool m_initialized;
+        bool m_failed;
+        std::vector<Slot> m_slots;
+        std::vector<std::size_t> m_free;
+        // Paths and data of the copies in flight when the ring failed, the kernel may not be done with them yet
+        std::vector<Slot> m_abandoned;
+        io_uring_sqe* m_request;
+
+        explicit UringBackend(qsizetype inFlight) : m_initialized(false), m_failed(false), m_slots(static_cast<std::size_t>(inFlight)), m_request(nullptr) {
+            for (std::size_t i = m_slots.size(); i > 0; --i) {
+                m_free.push_back(i - 1);
+            }
+        }
+
+        // Completions never get lost (all kernels with mkdirat keep overflowing ones), so a full ring only has to be flushed
+        io_uring_sqe* nextRequest() {
+            m_request = io_uring_get_sqe(&m_ring);
+            while (m_request == nullptr) {
+                io_uring_submit(&m_ring);
+                m_request = io_uring_get_sqe(&m_ring);
+            }
+            return m_request;
+        }
+
+        void tag(std::size_t slotIndex, unsigned operation) {
+            io_uring_sqe_set_data(m_request, reinterpret_cast<void*>(static_cast<std::uintptr_t>((slotIndex << 16) | operation)));
+        }
+
+        // Handles all available completions, waiting for at least one if wait is set
+        void reap(bool wait, std::vector<AsyncWriter::Result>& results) {
+            io_uring_cqe* completion = nullptr;
+            if (wait) {
+                Stats::Span const span("wait");
+                io_uring_submit(&m_ring);
+                int error = io_uring_wait_cqe(&m_ring, &completion);
+                while (error == -EINTR) {
+                    error = io_uring_wait_cqe(&m_ring, &completion);
+                }
+                if (error < 0) {
+                    fail(error, results);
+                    return;
+                }
+            } else if (io_uring_peek_cqe(&m_ring, &completion) != 0) {
+                return;
+            }
+
+            bool submitted = false;
+            while (completion != nullptr) {
+                std::uintptr_t const data = reinterpret_cast<std::uintptr_t>(io_uring_cqe_get_data(completion));
+                int const status = completion->res;
+                io_uring_cqe_seen(&m_ring, completion);
+                submitted = complete(static_cast<std::size_t>(data >> 16), static_cast<unsigned>(data & 0xFFFF), status, results) || submitted;
+
+                completion = nullptr;
+                if (io_uring_peek_cqe(&m_ring, &completion) != 0) {
+                    break;
+                }
+            }
+            if (submitted) {
+                io_uring_submit(&m_ring);
+            }
+        }
+
+        // Returns whether requests were queued
+        bool complete(std::size_t slotIndex, unsigned operation, int status, std::vector<AsyncWriter::Result>& results) {
+            Slot& slot = m_slots.at(slotIndex);
+            bool queued = false;
+            if (operation >= advanceFile) {
+                std::size_t const fileIndex = operation - advanceFile;
+                queued = advance(slotIndex, fileIndex, status);
+                if (slot.files.at(fileIndex).state != File::State::Done) {
+                    return queued;
+                }
+            }
+
+            if (--slot.outstanding > 0) {
+                return queued;
+            }
+
+            switch (slot.step) {
+                case Step::Folder:
+                    if (!slot.removePaths.empty()) {
+                        slot.step = Step::Remove;
+                        slot.outstanding = static_cast<int>(slot.removePaths.size());
+                        for (std::size_t i = 0; i < slot.removePaths.size(); ++i) {
+                            io_uring_prep_unlinkat(nextRequest(), AT_FDCWD, slot.removePaths.at(i).constData(), 0);
+                            tag(slotIndex, static_cast<unsigned>(1 + i));
+                        }
+                        return true;
+                    }
+                    [[fallthrough]];
+                case Step::Remove:
+                    slot.step = Step::Blueprint;
+                    slot.outstanding = 1;
+                    open(slotIndex, Blueprint, O_WRONLY | O_CREAT | O_TRUNC);
+                    return true;
+                case Step::Blueprint: {
+                    File const& file = slot.files.at(Blueprint);
+                    if (file.failed) {
+                        slot.result.error = failedToWrite(file.fileName, file.openFailed);
+                        release(slotIndex, results);
+                        return queued;
+                    }
+                    slot.result.bytesWritten += file.written;
+
+                    // Written after bp.sbc, so the game considers it up to date
+                    slot.step = Step::Rest;
+                    slot.outstanding = 0;
+                    if (!slot.files.at(Binary).data.isEmpty()) {
+                        ++slot.outstanding;
+                        open(slotIndex, Binary, O_WRONLY | O_CREAT | O_TRUNC);
+                    }
+                    for (std::size_t i = FirstSidecar; i < slot.files.size(); ++i) {
+                        ++slot.outstanding;
+                        open(slotIndex, i, O_WRONLY | O_CREAT | O_EXCL);
+                    }
+                    if (!propagateSidecars(slot)) {
+                        addWarning(slot.result, failedToCopySidecars(slot.copy.folder));
+                    }
+                    if (slot.outstanding > 0) {
+                        return true;
+                    }
+                    slot.result.success = true;
+                    release(slotIndex, results);
+                    return queued;
+                }
+                case Step::Rest: {
+                    File const& binary = slot.files.at(Binary);
+                    if (binary.failed) {
+                        addWarning(slot.result, failedToWriteBinary(slot.copy.folder));
+                        ::unlink(binary.path.constData());
+                    } else {
+                        slot.result.bytesWritten += binary.written;
+                    }
+                    bool sidecarsFailed = false;
+                    for (std::size_t i = FirstSidecar; i < slot.files.size(); ++i) {
+                        File const& file = slot.files.at(i);
+                        if (file.failed && !file.kept) {
+                            sidecarsFailed = true;
+                            ::unlink(file.path.constData());
+                        } else {
+                            slot.result.bytesWritten += file.written;
+                        }
+                    }
+                    if (sidecarsFailed) {
+                        addWarning(slot.result, failedToCopySidecars(slot.copy.folder));
+                    }
+                    slot.result.success = true;
+                    release(slotIndex, results);
+                    return queued;
+                }
+            }
+            return queued;
+        }
+
+        void open(std::size_t slotIndex, std::size_t fileIndex, int flags) {
+            File& file = m_slots.at(slotIndex).files.at(fileIndex);
+            file.state = File::State::Open;
+            io_uring_prep_openat(nextRequest(), AT_FDCWD, file.path.constData(), flags | O_CLOEXEC, 0666);
+            tag(slotIndex, advanceFile + static_cast<unsigned>(fileIndex));
+        }
+
+        // Sidecars that were not read into memory, a clone or link is a single call anyway
+        bool propagateSidecars(Slot& slot) {
+            if (slot.copy.sidecars == nullptr) {
+                return true;
+            }
+            Stats::Span const span("sidecars", slot.copy.index);
+            bool success = true;
+            QDir const copyDir(slot.copy.folder);
+            std::ostringstream sidecarError;
+            for (auto const& sidecar : slot.copy.sidecars->getFiles()) {
+                if (!sidecar.contents) {
+                    qint64 const written = slot.copy.sidecars->propagate(copyDir, sidecar, sidecarError);
+                    success = success && (written >= 0);
+                    slot.result.bytesWritten += std::max<qint64>(written, 0);
+                }
+            }
+            addWarning(slot.result, sidecarError.str());
+            return success;
+        }
+
+        // Moves one file through open, write (repeated for short writes) and close. Returns whether a request was queued.
+        bool advance(std::size_t slotIndex, std::size_t fileIndex, int status) {
+            File& file = m_slots.at(slotIndex).files.at(fileIndex);
+            switch (file.state) {
+                case File::State::Open:
+                    if (status < 0) {
+                        file.failed = true;
+                        file.openFailed = true;
+                        file.kept = (status == -EEXIST);
+                        file.state = File::State::Done;
+                        return false;
+                    }
+                    file.fd = status;
+                    break;
+                case File::State::Write:
+                    if (status <= 0) {
+                        file.failed = true;
+                    } else {
+                        file.written += status;
+                    }
+                    break;
+                case File::State::Close:
+                    // On network file systems, errors may only show up when closing
+                    file.failed = file.failed || (status < 0);
+                    file.fd = -1;
+                    file.state = File::State::Done;
+                    return false;
+                case File::State::Done:
+                    return false;
+            }
+
+            if (!file.failed && (file.written < file.data.size())) {
+                file.state = File::State::Write;
+                unsigned const chunk = static_cast<unsigned>(std::min<qint64>(file.data.size() - file.written, 1 << 30));
+                io_uring_prep_write(nextRequest(), file.fd, file.data.constData() + file.written, chunk, static_cast<__u64>(file.written));
+            } else {
+                file.state = File::State::Close;
+                io_uring_prep_close(nextRequest(), file.fd);
+            }
+            tag(slotIndex, advanceFile + static_cast<unsigned>(fileIndex));
+            return true;
+        }
+
+        // The ring can not be used any more: it is torn down and every copy in flight fails
+        void fail(int error, std::vector<AsyncWriter::Result>& results) {
+            io_uring_queue_exit(&m_ring);
+            m_initialized = false;
+            m_failed = true;
+
+            std::vector<bool> isFree(m_slots.size(), false);
+            for (std::size_t const slotIndex : m_free) {
+                isFree.at(slotIndex) = true;
+            }
+            for (std::size_t slotIndex = 0; slotIndex < m_slots.size(); ++slotIndex) {
+                if (isFree.at(slotIndex)) {
+                    continue;
+                }
+                Slot& slot = m_slots.at(slotIndex);
+                for (auto const& file : slot.files) {
+                    if (file.fd >= 0) {
+                        ::close(file.fd);
+                    }
+                }
+                slot.result.success = false;
+                slot.result.error = "Error: Waiting for the io_uring failed with code " + std::to_string(-error) + ", the copy '" + QDir(slot.copy.folder).dirName().toStdString() + "' may be incomplete.";
+
+                Slot abandoned;
+                abandoned.folderPath = std::move(slot.folderPath);
+                abandoned.files = std::move(slot.files);
+                abandoned.removePaths = std::move(slot.removePaths);
+                m_abandoned.push_back(std::move(abandoned));
+                release(slotIndex, results);
+            }
+        }
+
+        void release(std::size_t slotIndex, std::vector<AsyncWriter::Result>& results) {
+            Slot& slot = m_slots.at(slotIndex);
+            results.push_back(std::move(slot.result));
+            slot.files.clear();
+            slot.removePaths.clear();
+            slot.copy = AsyncWriter::Copy();
+            m_free.push_back(slotIndex);
+        }
+    };
+#endif
+}
+
+AsyncWriter::AsyncWriter(qsizetype inFlight, Completion const& completion, std::ostream& error) : m_inFlight((inFlight < 1) ? 1 : inFlight), m_completion(completion), m_error(error) {
+#ifdef BLUEPRINTDUPLICATOR_HAVE_LIBURING
+    m_backend = UringBackend::create(m_inFlight);
+    if (!m_backend) {
+        m_error << "Warning: io_uring is not available, writing with threads instead." << std::endl;
+    }
+#endif
+    if (!m_backend) {
+        useThreads();
+    }
+}
+
+AsyncWriter::~AsyncWriter() {
+    finish();
+}
+
+void AsyncWriter::submit(Copy copy) {
+    std::vector<Result> results;
+    if (!m_backend->submit(copy, results)) {
+        m_error << "Warning: io_uring stopped working, writing the remaining copies with threads instead." << std::endl;
+        useThreads();
+        m_backend->submit(copy, results);
+    }
+    deliver(results);
+}
+
+void AsyncWriter::finish() {
+    std::vector<Result> results;
+    m_backend->finish(results);
+    if (m_backend->hasFailed()) {
+        m_error << "Warning: io_uring stopped working, writing with threads from now on." << std::endl;
+        useThreads();
+    }
+    deliver(results);
+}
+
+char const* AsyncWriter::getBackendName() const {
+    return m_backend->getName();
+}
+
+void AsyncWriter::useThreads() {
+    // The threads spend most of their time waiting for the file system, so use more than there are cores
+    qsizetype const threadCount = std::min<qsizetype>(m_inFlight, 16);
+    m_backend = std::make_unique<ThreadBackend>(m_inFlight, threadCount);
+}
+
+void AsyncWriter::deliver(std::vector<Result>& results) const {
+    for (auto const& result : results) {
+        if (!result.error.empty()) {
+            m_error << result.error << std::endl;
+        }
+        if (!result.warning.empty()) {
+            m_error << result.warning << std::endl;
+        }
+        Stats::addBytesWritten(result.bytesWritten);
+        m_completion(result.index, result.success);
+    }
+    results.clear();
+}
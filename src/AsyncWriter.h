@@ -0,0 +1,70 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_ASYNCWRITER_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_ASYNCWRITER_H_
+
+#include <QByteArray>
+#include <QString>
+
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <vector>
+
+class Sidecars;
+
+/*
+	Writes finished copies to disk with many of them in flight at once, used by --async.
+	Every copy is the same short chain of operations as in the blocking writer: create the folder,
+	remove the files of an earlier copy, write bp.sbc, then bp.sbcB5 and the sidecars. On Linux with liburing
+	the operations of all copies in flight are batched into one io_uring, elsewhere, or if the kernel
+	refuses, a pool of threads runs the chains with blocking calls. If the io_uring fails while copies are in
+	flight, those copies are reported as failed and the remaining ones are written by the threads.
+	Errors and warnings are written to the stream given on construction and completions are reported on the thread
+	calling submit() and finish(), never concurrently.
+*/
+class AsyncWriter {
+public:
+	struct Copy {
+		qsizetype index;
+		// Absolute path of the copy folder
+		QString folder;
+		QByteArray blueprint;
+		// No bp.sbcB5 is written if empty
+		QByteArray binary;
+		// Propagated after bp.sbc, may be null
+		Sidecars const* sidecars;
+		// Remove bp.sbc, bp.sbcB5, thumb.png and the sidecars of an earlier copy first
+		bool replace;
+	};
+	using Completion = std::function<void(qsizetype index, bool success)>;
+
+	AsyncWriter(qsizetype inFlight, Completion const& completion, std::ostream& error);
+	~AsyncWriter();
+
+	// Blocks while inFlight copies are pending
+	void submit(Copy copy);
+	// Waits for all pending copies
+	void finish();
+
+	char const* getBackendName() const;
+
+	// Outcome of one copy, as produced by a backend
+	struct Result {
+		qsizetype index;
+		bool success;
+		qint64 bytesWritten;
+		std::string error;
+		std::string warning;
+	};
+	class Backend;
+private:
+	qsizetype const m_inFlight;
+	std::unique_ptr<Backend> m_backend;
+	Completion const m_completion;
+	std::ostream& m_error;
+
+	void useThreads();
+	void deliver(std::vector<Result>& results) const;
+};
+
+#endif
@@ -0,0 +1,372 @@
+#include "BinaryBlueprint.h"
+
+#include <QFileInfo>
+
+#include <cstring>
+#include <ostream>
+#include <set>
+#include <vector>
+
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+    bool readVarint(char const*& pos, char const* end, quint64& value) {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (pos >= end) {
+                return false;
+            }
+            quint64 const byte = static_cast<unsigned char>(*pos++);
+            value |= (byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void writeVarint(QByteArray& out, quint64 value) {
+        while (value >= 0x80) {
+            out.append(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.append(static_cast<char>(value));
+    }
+
+    bool startsWith(char const* data, qsizetype size, QByteArray const& prefix) {
+        return (size >= prefix.size()) && (std::memcmp(data, prefix.constData(), static_cast<std::size_t>(prefix.size())) == 0);
+    }
+
+    bool equals(char const* data, qsizetype size, QByteArray const& value) {
+        return (size == value.size()) && startsWith(data, size, value);
+    }
+}
+
+bool BinaryBlueprint::isFresh(QDir const& blueprintFolder) {
+    QFileInfo const binaryInfo(blueprintFolder.absoluteFilePath(QStringLiteral("bp.sbcB5")));
+    QFileInfo const xmlInfo(blueprintFolder.absoluteFilePath(QStringLiteral("bp.sbc")));
+    return binaryInfo.exists() && xmlInfo.exists() && (binaryInfo.lastModified() >= xmlInfo.lastModified());
+}
+
+bool BinaryBlueprint::isMessage(char const* data, qsizetype size, int depth) {
+    if ((size <= 0) || (depth >= maximumDepth)) {
+        return false;
+    }
+    char const* pos = data;
+    return walk(pos, data + size, depth, 0, nullptr, nullptr, nullptr);
+}
+
+bool BinaryBlueprint::walk(char const*& pos, char const* end, int depth, quint32 endGroup, Rule const* rule, Visitor const* visitor, QByteArray* out) {
+    bool const descend = (rule != nullptr) || (visitor != nullptr) || (out != nullptr);
+    while (pos < end) {
+        char const* const tagBegin = pos;
+        quint64 tag = 0;
+        if (!readVarint(pos, end, tag)) {
+            return false;
+        }
+        quint64 const number = tag >> 3;
+        if ((number == 0) || (number > 0x1FFFFFFF)) {
+            return false;
+        }
+
+        switch (tag & 0x7) {
+            case 0: {
+                quint64 value = 0;
+                if (!readVarint(pos, end, value)) {
+                    return false;
+                }
+                break;
+            }
+            case 1:
+                if ((end - pos) < 8) {
+                    return false;
+                }
+                pos += 8;
+                break;
+            case 5:
+                if ((end - pos) < 4) {
+                    return false;
+                }
+                pos += 4;
+                break;
+            case 3: {
+                if (out != nullptr) {
+                    out->append(tagBegin, pos - tagBegin);
+                }
+                if ((depth + 1 >= maximumDepth) || !walk(pos, end, depth + 1, static_cast<quint32>(number), rule, visitor, out)) {
+                    return false;
+                }
+                continue;
+            }
+            case 4:
+                if (out != nullptr) {
+                    out->append(tagBegin, pos - tagBegin);
+                }
+                return (endGroup != 0) && (number == endGroup);
+            case 2: {
+                quint64 length = 0;
+                if (!readVarint(pos, end, length) || (length > static_cast<quint64>(end - pos))) {
+                    return false;
+                }
+                char const* const payload = pos;
+                qsizetype const payloadSize = static_cast<qsizetype>(length);
+                pos += payloadSize;
+                if (!descend) {
+                    break;
+                }
+
+                // Strings and nested messages share the same wire type, a string is whatever does not parse as a message
+                bool const nestedMessage = isMessage(payload, payloadSize, depth + 1);
+                if (visitor != nullptr) {
+                    (*visitor)(payload, payloadSize, nestedMessage);
+                }
+                std::optional<QByteArray> const replacement = (rule != nullptr) ? (*rule)(payload, payloadSize, nestedMessage) : std::nullopt;
+                if (replacement && (out != nullptr)) {
+                    // Re-emit the tag, the length has changed
+                    writeVarint(*out, tag);
+                    writeVarint(*out, static_cast<quint64>(replacement->size()));
+                    out->append(*replacement);
+                    continue;
+                }
+
+                if (nestedMessage) {
+                    char const* nested = payload;
+                    if (out != nullptr) {
+                        QByteArray nestedOut;
+                        nestedOut.reserve(payloadSize);
+                        if (!walk(nested, payload + payloadSize, depth + 1, 0, rule, visitor, &nestedOut)) {
+                            return false;
+                        }
+                        writeVarint(*out, tag);
+                        writeVarint(*out, static_cast<quint64>(nestedOut.size()));
+                        out->append(nestedOut);
+                        continue;
+                    } else if (!walk(nested, payload + payloadSize, depth + 1, 0, rule, visitor, nullptr)) {
+                        return false;
+                    }
+                }
+                break;
+            }
+            default:
+                return false;
+        }
+
+        if (out != nullptr) {
+            out->append(tagBegin, pos - tagBegin);
+        }
+    }
+    return (endGroup == 0);
+}
+
+std::optional<QByteArray> BinaryBlueprint::decode(QByteArray const& data, bool& compressed, std::ostream& error) {
+    compressed = (data.size() >= 2) && (static_cast<unsigned char>(data.at(0)) == 0x1F) && (static_cast<unsigned char>(data.at(1)) == 0x8B);
+    if (!compressed) {
+        return data;
+    }
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK) {
+        return std::nullopt;
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+
+    QByteArray result;
+    int status = Z_OK;
+    while (status != Z_STREAM_END) {
+        qsizetype const offset = result.size();
+        result.resize(offset + 256 * 1024);
+        stream.next_out = reinterpret_cast<Bytef*>(result.data() + offset);
+        stream.avail_out = 256 * 1024;
+        status = inflate(&stream, Z_NO_FLUSH);
+        result.resize(offset + (256 * 1024 - static_cast<qsizetype>(stream.avail_out)));
+        if ((status != Z_OK) && (status != Z_STREAM_END)) {
+            inflateEnd(&stream);
+            return std::nullopt;
+        }
+    }
+    inflateEnd(&stream);
+    return result;
+#else
+    error << "Warning: bp.sbcB5 is compressed, but this build has no zlib support." << std::endl;
+    return std::nullopt;
+#endif
+}
+
+std::optional<QByteArray> BinaryBlueprint::encode(QByteArray const& data, bool compress) {
+    if (!compress) {
+        return data;
+    }
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return std::nullopt;
+    }
+    QByteArray result;
+    result.resize(static_cast<qsizetype>(deflateBound(&stream, static_cast<uLong>(data.size()))) + 32);
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(result.data());
+    stream.avail_out = static_cast<uInt>(result.size());
+    int const status = deflate(&stream, Z_FINISH);
+    result.resize(static_cast<qsizetype>(stream.total_out));
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END) {
+        return std::nullopt;
+    }
+    return result;
+#else
+    return std::nullopt;
+#endif
+}
+
+std::optional<BlueprintData> BinaryBlueprint::extract(QByteArray const& data, QString const& gridName, std::ostream& error) {
+    bool compressed = false;
+    auto const decoded = decode(data, compressed, error);
+    if (!decoded) {
+        error << "Failed to decode bp.sbcB5!" << std::endl;
+        return std::nullopt;
+    }
+
+    QByteArray const gridNameUtf8 = gridName.toUtf8();
+    QByteArray const missileNumberKey("\nMissile number=");
+
+    bool haveGridName = false;
+    std::set<QByteArray> customData;
+    std::set<QByteArray> strings;
+    std::vector<QByteArray> prefixed;
+    Visitor const visitor = [&](char const* payload, qsizetype size, bool nestedMessage) {
+        QByteArray const view = QByteArray::fromRawData(payload, size);
+        if (equals(payload, size, gridNameUtf8)) {
+            haveGridName = true;
+        } else if (!nestedMessage && view.contains(missileNumberKey)) {
+            customData.insert(QByteArray(payload, size));
+        } else if ((size > 3) && (payload[0] == '(') && (view.indexOf(") ") > 1)) {
+            // Some names parse as a message as well, withNewId renames them all the same
+            prefixed.push_back(QByteArray(payload, size));
+        } else if (nestedMessage) {
+            return;
+        }
+        if (size < 256) {
+            strings.insert(QByteArray(payload, size));
+        }
+    };
+
+    char const* pos = decoded->constData();
+    if (!walk(pos, decoded->constData() + decoded->size(), 0, 0, nullptr, &visitor, nullptr)) {
+        error << "bp.sbcB5 is not a valid protobuf message!" << std::endl;
+        return std::nullopt;
+    }
+
+    if (!haveGridName || (customData.size() != 1) || prefixed.empty()) {
+        error << "bp.sbcB5 does not contain the expected grid name, WHAM custom data and item names!" << std::endl;
+        return std::nullopt;
+    }
+
+    // The group name is the one item prefix that also appears as a string of its own
+    std::set<QByteArray> groups;
+    for (auto const& name : prefixed) {
+        QByteArray const group = name.mid(1, name.indexOf(") ") - 1);
+        if (strings.count(group) > 0) {
+            groups.insert(group);
+        }
+    }
+    if (groups.size() != 1) {
+        error << "bp.sbcB5 does not contain exactly one block group!" << std::endl;
+        return std::nullopt;
+    }
+    QByteArray const group = *groups.begin();
+    QByteArray const itemPrefix = "(" + group + ") ";
+
+    BlueprintData::ItemNames itemNames;
+    for (auto const& name : prefixed) {
+        if (name.startsWith(itemPrefix)) {
+            itemNames.add(QString::fromUtf8(name));
+        }
+    }
+
+    return BlueprintData::fromFields(gridName, gridName, QString::fromUtf8(group), QString::fromUtf8(*customData.begin()), itemNames, error);
+}
+
+QByteArray BinaryBlueprint::withNewId(QByteArray const& data, BlueprintData const& blueprintData, qsizetype newId, std::vector<CustomData::Override> const& overrides, std::ostream& error) {
+    bool compressed = false;
+    auto const decoded = decode(data, compressed, error);
+    if (!decoded) {
+        return QByteArray();
+    }
+
+    QByteArray const number = QByteArray::number(newId);
+    QByteArray const oldGridName = blueprintData.getGridName().toUtf8();
+    QByteArray const newGridName = BlueprintData::cutDigitsFromEnd(blueprintData.getGridName()).toUtf8() + number;
+    QByteArray const oldDisplayName = blueprintData.getDisplayName().toUtf8();
+    QByteArray const newDisplayName = BlueprintData::cutDigitsFromEnd(blueprintData.getDisplayName()).toUtf8() + number;
+    QByteArray const oldGroupName = blueprintData.getGroupName().toUtf8();
+    QByteArray const newGroupName = BlueprintData::cutDigitsFromEnd(blueprintData.getGroupName()).toUtf8() + number;
+    QByteArray const oldItemPrefix = "(" + oldGroupName + ")";
+    QByteArray const newItemPrefix = "(" + newGroupName + ")";
+    QByteArray const oldMissileNumber = "\nMissile number=" + QByteArray::number(blueprintData.getId()) + "\n";
+    QByteArray const newMissileNumber = "\nMissile number=" + number + "\n";
+
+    // Without a renumbered custom data the copy would keep the missile number of the source, and every name that was
+    // not renamed would keep the old number as well
+    qsizetype customDataCount = 0;
+    qsizetype itemCount = 0;
+    std::set<QByteArray> renamed;
+    Rule const rule = [&](char const* payload, qsizetype size, bool nestedMessage) -> std::optional<QByteArray> {
+        if (equals(payload, size, oldGridName)) {
+            renamed.insert(oldGridName);
+            return newGridName;
+        } else if (equals(payload, size, oldDisplayName)) {
+            renamed.insert(oldDisplayName);
+            return newDisplayName;
+        } else if (equals(payload, size, oldGroupName)) {
+            renamed.insert(oldGroupName);
+            return newGroupName;
+        } else if (startsWith(payload, size, oldItemPrefix)) {
+            // Even if the name happens to parse as a message, the count below tells whether that guess was right
+            ++itemCount;
+            return newItemPrefix + QByteArray(payload + oldItemPrefix.size(), size - oldItemPrefix.size());
+        } else if (nestedMessage) {
+            return std::nullopt;
+        }
+        QByteArray const view = QByteArray::fromRawData(payload, size);
+        if (view.contains(oldMissileNumber) && !overrides.empty()) {
+            // Strings are stored as they are, without XML entities
+            ++customDataCount;
+            return CustomData(QByteArray(payload, size), false).instantiate(newId, overrides);
+        } else if (view.contains(oldMissileNumber)) {
+            ++customDataCount;
+            QByteArray result(payload, size);
+            result.replace(oldMissileNumber, newMissileNumber);
+            return result;
+        }
+        return std::nullopt;
+    };
+
+    QByteArray result;
+    result.reserve(decoded->size() + 1024);
+    char const* pos = decoded->constData();
+    if (!walk(pos, decoded->constData() + decoded->size(), 0, 0, &rule, nullptr, &result)) {
+        error << "bp.sbcB5 is not a valid protobuf message!" << std::endl;
+        return QByteArray();
+    } else if (customDataCount == 0) {
+        error << "bp.sbcB5 has no WHAM custom data with 'Missile number=" << blueprintData.getId() << "' on a line of its own, the copy is written without it." << std::endl;
+        return QByteArray();
+    } else if (itemCount != blueprintData.getItemCount()) {
+        error << "bp.sbcB5 has " << itemCount << " block names starting with '" << oldItemPrefix.toStdString() << "', bp.sbc has " << blueprintData.getItemCount() << ", the copy is written without it." << std::endl;
+        return QByteArray();
+    } else if ((renamed.count(oldGridName) == 0) || (renamed.count(oldDisplayName) == 0) || (renamed.count(oldGroupName) == 0)) {
+        error << "bp.sbcB5 lacks the grid name, display name or group name of bp.sbc, the copy is written without it." << std::endl;
+        return QByteArray();
+    }
+
+    auto const encoded = encode(result, compressed);
+    if (!encoded) {
+        return QByteArray();
+    }
+    return *encoded;
+}
@@ -0,0 +1,46 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_BINARYBLUEPRINT_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_BINARYBLUEPRINT_H_
+
+#include <QByteArray>
+#include <QDir>
+#include <QString>
+
+#include <functional>
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+#include "BlueprintData.h"
+#include "CustomData.h"
+
+/*
+	Support for the protobuf-serialized bp.sbcB5 cache the game writes next to bp.sbc.
+	The game's schema is not available, so the file is handled on the wire-format level: every
+	length-delimited field is either one of the known blueprint strings or a nested message.
+	Files may be gzip-compressed, which requires building with zlib.
+*/
+class BinaryBlueprint {
+public:
+	// Whether the folder has a bp.sbcB5 that is at least as new as its bp.sbc
+	static bool isFresh(QDir const& blueprintFolder);
+
+	// Extracts the same data as BlueprintData::fromXml, given the grid name (which equals the folder name)
+	static std::optional<BlueprintData> extract(QByteArray const& data, QString const& gridName, std::ostream& error);
+
+	// Renumbers all blueprint strings and applies the --customData overrides, returns an empty array if the file
+	// could not be processed
+	static QByteArray withNewId(QByteArray const& data, BlueprintData const& blueprintData, qsizetype newId, std::vector<CustomData::Override> const& overrides, std::ostream& error);
+private:
+	using Rule = std::function<std::optional<QByteArray>(char const* data, qsizetype size, bool nestedMessage)>;
+	using Visitor = std::function<void(char const* data, qsizetype size, bool nestedMessage)>;
+
+	static bool walk(char const*& pos, char const* end, int depth, quint32 endGroup, Rule const* rule, Visitor const* visitor, QByteArray* out);
+	static bool isMessage(char const* data, qsizetype size, int depth);
+
+	static std::optional<QByteArray> decode(QByteArray const& data, bool& compressed, std::ostream& error);
+	static std::optional<QByteArray> encode(QByteArray const& data, bool compress);
+
+	static constexpr int maximumDepth = 64;
+};
+
+#endif
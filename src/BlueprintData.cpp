@@ -4,15 +4,175 @@
 #include <QXmlStreamReader>
 #include <QXmlStreamWriter>
 
-#include <iostream>
-#include <stack>
+#include <algorithm>
+#include <array>
+#include <sstream>
+#include <unordered_map>
 
+#include "BlueprintScanner.h"
+#include "CustomData.h"
 #include "Options.h"
+#include "Stats.h"
+#include "XmlFixupDevice.h"
+#include "ZipArchive.h"
 
 QRegularExpression const BlueprintData::expressionCustomDataMissileNumber = QRegularExpression(R"(\nMissile number=(\d+)\n)", QRegularExpression::MultilineOption);
 QRegularExpression const BlueprintData::expressionCustomDataMissileNameTag = QRegularExpression(R"(\nMissile name tag=([^\n]+)\n)", QRegularExpression::MultilineOption);
 
-BlueprintData::BlueprintData(QString const& gridName, QString const& displayName, QString const& groupName, QString const& nameTag, QStringList const& itemNames, int id) : m_gridName(gridName), m_displayName(displayName), m_groupName(groupName), m_nameTag(nameTag), m_itemNames(itemNames), m_id(id) {
+namespace {
+    // Bytes the reader took from its file so far. Readers of a QByteArray and sequential devices, which have no
+    // position, are checked against their whole size before reading instead.
+    qint64 bytesRead(QXmlStreamReader const& reader) {
+        QIODevice const* const device = reader.device();
+        return ((device != nullptr) && !device->isSequential()) ? device->pos() : 0;
+    }
+
+    // The only element names the parsers look at, all others are Other
+    enum class Tag : quint8 { Other, ShipBlueprint, Id, CubeGrid, DisplayName, BlockGroup, Name, CubeBlock, CustomName };
+
+    // Compares against the few interesting names without allocating, for QStringRef (Qt 5) and QStringView (Qt 6) alike
+    template<typename Name>
+    Tag internTag(Name const& name) {
+        static std::array<std::pair<QLatin1String, Tag>, 8> const tags = { {
+            { QLatin1String("ShipBlueprint"), Tag::ShipBlueprint },
+            { QLatin1String("Id"), Tag::Id },
+            { QLatin1String("CubeGrid"), Tag::CubeGrid },
+            { QLatin1String("DisplayName"), Tag::DisplayName },
+            { QLatin1String("MyObjectBuilder_BlockGroup"), Tag::BlockGroup },
+            { QLatin1String("Name"), Tag::Name },
+            { QLatin1String("MyObjectBuilder_CubeBlock"), Tag::CubeBlock },
+            { QLatin1String("CustomName"), Tag::CustomName },
+        } };
+        for (auto const& tag : tags) {
+            if (name == tag.first) {
+                return tag.second;
+            }
+        }
+        return Tag::Other;
+    }
+
+    // The tags of the open elements. Only the innermost one is ever looked at and the interesting elements are all
+    // close to the root, so the path is a fixed array and elements nested deeper than it holds count as Other.
+    class TagPath {
+    public:
+        TagPath() : m_tags(), m_depth(0) {
+            //
+        }
+
+        void push(Tag tag) {
+            if (m_depth < static_cast<qsizetype>(m_tags.size())) {
+                m_tags[static_cast<std::size_t>(m_depth)] = tag;
+            }
+            ++m_depth;
+        }
+
+        void pop() {
+            --m_depth;
+        }
+
+        Tag top() const {
+            if ((m_depth < 1) || (m_depth > static_cast<qsizetype>(m_tags.size()))) {
+                return Tag::Other;
+            }
+            return m_tags[static_cast<std::size_t>(m_depth - 1)];
+        }
+
+        bool isEmpty() const {
+            return m_depth == 0;
+        }
+
+        qsizetype getDepth() const {
+            return m_depth;
+        }
+    private:
+        std::array<Tag, 64> m_tags;
+        qsizetype m_depth;
+    };
+
+    // Element and namespace names of the rewritten documents. Every name is turned into a QString once, later copies
+    // share that one instead of allocating their own for every element.
+    class NameTable {
+    public:
+        template<typename Name>
+        QString intern(Name const& name) {
+            auto const hash = static_cast<std::size_t>(qHash(name));
+            auto const range = m_index.equal_range(hash);
+            for (auto it = range.first; it != range.second; ++it) {
+                if (m_names.at(it->second) == name) {
+                    return m_names.at(it->second);
+                }
+            }
+            if (m_names.size() >= maximumNames) {
+                return name.toString();
+            }
+            m_index.emplace(hash, m_names.size());
+            m_names.push_back(name.toString());
+            return m_names.back();
+        }
+    private:
+        // Documents with more distinct names than this are not worth remembering them for
+        static std::size_t const maximumNames = 4096;
+
+        std::vector<QString> m_names;
+        std::unordered_multimap<std::size_t, std::size_t> m_index;
+    };
+
+    // Reused by every copy written on a thread
+    struct RewriteScratch {
+        NameTable names;
+        QString text;
+
+        // A single huge text, like an oversized custom data, would otherwise stay allocated on the thread for good
+        void trimText() {
+            if (text.capacity() > maximumText) {
+                text = QString();
+            }
+        }
+    private:
+        // Characters, far above the names and texts of a regular blueprint
+        static qsizetype const maximumText = 64 * 1024;
+    };
+}
+
+BlueprintData::ItemNames::ItemNames() : m_count(0), m_first(), m_shared(0), m_least() {
+	//
+}
+
+void BlueprintData::ItemNames::add(QString const& itemName) {
+    if (m_count == 0) {
+        m_first = itemName;
+        m_shared = itemName.size();
+    } else {
+        qsizetype const limit = std::min(m_shared, itemName.size());
+        qsizetype shared = 0;
+        while ((shared < limit) && (m_first.at(shared) == itemName.at(shared))) {
+            ++shared;
+        }
+        if (shared < m_shared) {
+            m_shared = shared;
+            m_least = itemName;
+        }
+    }
+    ++m_count;
+}
+
+qsizetype BlueprintData::ItemNames::getCount() const {
+    return m_count;
+}
+
+std::optional<BlueprintData::Problem> BlueprintData::ItemNames::check(QString const& prefix) const {
+    // Every name shares m_shared characters with the first one, so if that covers the prefix all of them have it
+    if (m_count == 0) {
+        return std::nullopt;
+    } else if (!m_first.startsWith(prefix)) {
+        return checkItemName(m_first, prefix);
+    } else if (m_shared < prefix.size()) {
+        return checkItemName(m_least, prefix);
+    }
+    return std::nullopt;
+}
+
+BlueprintData::BlueprintData(QString const& gridName, QString const& displayName, QString const& groupName, QString const& nameTag, qsizetype itemCount, int id) : m_gridName(gridName), m_displayName(displayName), m_groupName(groupName), m_nameTag(nameTag), m_itemCount(itemCount), m_id(id) {
 	//
 }
 
@@ -32,18 +192,134 @@ QString const& BlueprintData::getNameTag() const {
     return m_nameTag;
 }
 
-QStringList const& BlueprintData::getItemNames() const {
-	return m_itemNames;
+qsizetype BlueprintData::getItemCount() const {
+	return m_itemCount;
 }
 
 int BlueprintData::getId() const {
     return m_id;
 }
 
-std::optional<BlueprintData> BlueprintData::fromXml(QByteArray const& data, Options const& options) {
-    QXmlStreamReader reader(data);
+bool BlueprintData::operator==(BlueprintData const& other) const {
+    return (m_gridName == other.m_gridName) && (m_displayName == other.m_displayName) && (m_groupName == other.m_groupName) && (m_nameTag == other.m_nameTag) && (m_itemCount == other.m_itemCount) && (m_id == other.m_id);
+}
 
-    std::stack<QString> stack;
+bool BlueprintData::operator!=(BlueprintData const& other) const {
+    return !(*this == other);
+}
+
+std::optional<BlueprintData> BlueprintData::fromXml(QByteArray const& data, Options const& options, std::ostream& error) {
+    // A blueprint over the limits is rejected outright, the XML parser would only run into them again
+    ParseBudget budget(options.parseLimits);
+    std::ostringstream scanError;
+    auto const fields = BlueprintScanner::scan(data, budget, scanError);
+    if (!fields && budget.isExceeded()) {
+        error << "Error: " << budget.getError().toStdString() << std::endl;
+        return std::nullopt;
+    } else if (!fields) {
+        error << scanError.str();
+        error << "Warning: The fast scanner could not handle this blueprint, falling back to the XML parser." << std::endl;
+        QXmlStreamReader reader(data);
+        return fromXml(reader, options, budget, error);
+    }
+
+    auto result = fromScan(data, *fields, error);
+    if (options.verifyParse) {
+        QXmlStreamReader reader(data);
+        ParseBudget referenceBudget(options.parseLimits);
+        auto const reference = fromXml(reader, options, referenceBudget, error);
+        if (result.has_value() != reference.has_value()) {
+            error << "Error: The fast scanner " << ((result) ? "accepted" : "rejected") << " a blueprint that the XML parser " << ((reference) ? "accepted" : "rejected") << "!" << std::endl;
+            return std::nullopt;
+        } else if (result && (*result != *reference)) {
+            error << "Error: The fast scanner and the XML parser read different data from this blueprint!" << std::endl;
+            return std::nullopt;
+        }
+        error << "Info: The fast scanner and the XML parser agree on this blueprint." << std::endl;
+    }
+    return result;
+}
+
+std::optional<BlueprintData> BlueprintData::fromScan(QByteArray const& data, std::ostream& error) {
+    auto const fields = BlueprintScanner::scan(data, error);
+    if (!fields) {
+        return std::nullopt;
+    }
+    return fromScan(data, *fields, error);
+}
+
+std::optional<BlueprintData> BlueprintData::fromScan(QByteArray const& data, std::vector<BlueprintScanner::Field> const& fields, std::ostream& error) {
+    bool haveIdSubType = false;
+    QString idSubType;
+
+    bool haveDisplayName = false;
+    QString displayName;
+
+    bool haveGroupName = false;
+    QString groupName;
+
+    bool haveCustomData = false;
+    QString customData;
+
+    ItemNames itemNames;
+
+    // Same rules as the QXmlStreamReader path: the last id and display name win, group and custom data must be unique
+    for (auto const& field : fields) {
+        auto const text = BlueprintScanner::decode(data, field, error);
+        if (!text) {
+            return std::nullopt;
+        }
+
+        switch (field.type) {
+            case BlueprintScanner::FieldType::IdSubtype:
+                haveIdSubType = true;
+                idSubType = *text;
+                break;
+            case BlueprintScanner::FieldType::GridDisplayName:
+                haveDisplayName = true;
+                displayName = *text;
+                break;
+            case BlueprintScanner::FieldType::GroupName:
+                if (haveGroupName) {
+                    error << "Error: More than one block group defined!" << std::endl;
+                    return std::nullopt;
+                }
+                haveGroupName = true;
+                groupName = *text;
+                break;
+            case BlueprintScanner::FieldType::BlockCustomName:
+                itemNames.add(*text);
+                break;
+            case BlueprintScanner::FieldType::CustomData:
+                if (haveCustomData) {
+                    error << "Error: More than one custom data for WHAM defined!" << std::endl;
+                    return std::nullopt;
+                }
+                haveCustomData = true;
+                customData = *text;
+                break;
+        }
+    }
+
+    if (!isComplete(haveIdSubType, haveDisplayName, haveGroupName, itemNames.getCount(), haveCustomData, error)) {
+        return std::nullopt;
+    }
+    return fromFields(idSubType, displayName, groupName, customData, itemNames, error);
+}
+
+std::optional<BlueprintData> BlueprintData::fromXml(QIODevice& device, Options const& options, std::ostream& error) {
+    // An archive entry reports the size from its central directory and never reads beyond it
+    ParseBudget budget(options.parseLimits);
+    if (!budget.checkBytes(device.size())) {
+        error << "Error: " << budget.getError().toStdString() << std::endl;
+        return std::nullopt;
+    }
+    QXmlStreamReader reader(&device);
+    return fromXml(reader, options, budget, error);
+}
+
+std::optional<BlueprintData> BlueprintData::fromXml(QXmlStreamReader& reader, Options const& options, ParseBudget& budget, std::ostream& error) {
+    TagPath path;
 
     bool haveIdSubType = false;
     QString idSubType;
@@ -57,75 +333,97 @@ std::optional<BlueprintData> BlueprintData::fromXml(QByteArray const& data, Opti
     bool haveCustomData = false;
     QString customData;
 
-    QStringList itemNames;
+    // Block names are gathered in one reused buffer and only checked, not kept
+    ItemNames itemNames;
+    QString itemName;
+    bool inItemName = false;
 
     while (!reader.atEnd()) {
         auto const token = reader.readNext();
         if (token == QXmlStreamReader::Invalid) {
             continue;
+        } else if (!budget.checkBytes(bytesRead(reader)) || !budget.checkTime(reader.characterOffset())) {
+            error << "Error: " << budget.getError().toStdString() << std::endl;
+            return std::nullopt;
         }
 
         // std::cout << "Found token: " << reader.tokenString().toStdString() << std::endl;
         switch (reader.tokenType()) {
             case QXmlStreamReader::StartElement: {
-                QString const name = reader.name().toString();
-                
-                QString const top = (stack.empty() ? QString() : stack.top());
-                stack.push(name);
+                if (inItemName) {
+                    error << "Error while parsing XML: Expected character data in the name of a block." << std::endl;
+                    return std::nullopt;
+                }
+                Tag const tag = internTag(reader.name());
+                Tag const top = path.top();
+                path.push(tag);
+                if (!budget.checkDepth(path.getDepth(), reader.characterOffset())) {
+                    error << "Error: " << budget.getError().toStdString() << std::endl;
+                    return std::nullopt;
+                }
 
-                // std::cout << "Found start element: " << name.toStdString() << " (depth: " << stack.size() << ")" << std::endl;
-                if ((!stack.empty()) && (top == QStringLiteral("ShipBlueprint")) && (name == QStringLiteral("Id"))) {
+                if ((top == Tag::ShipBlueprint) && (tag == Tag::Id)) {
                     haveIdSubType = true;
                     auto const attrs = reader.attributes();
                     if (!attrs.hasAttribute("", "Subtype")) {
-                        std::cerr << "Attr Subtype not defined?" << std::endl;
+                        error << "Attr Subtype not defined?" << std::endl;
                         return std::nullopt;
                     }
 
                     idSubType = attrs.value("", "Subtype").toString();
-                } else if ((!stack.empty()) && (top == QStringLiteral("CubeGrid")) && (name == QStringLiteral("DisplayName"))) {
+                } else if ((top == Tag::CubeGrid) && (tag == Tag::DisplayName)) {
                     haveDisplayName = true;
                     displayName = reader.readElementText();
 
                     // this operation consumed the EndElement
-                    stack.pop();
-                } else if ((!stack.empty()) && (top == QStringLiteral("MyObjectBuilder_BlockGroup")) && (name == QStringLiteral("Name"))) {
+                    path.pop();
+                } else if ((top == Tag::BlockGroup) && (tag == Tag::Name)) {
                     if (haveGroupName) {
-                        std::cerr << "Error: More than one block group defined!" << std::endl;
+                        error << "Error: More than one block group defined!" << std::endl;
                         return std::nullopt;
                     }
                     haveGroupName = true;
                     groupName = reader.readElementText();
 
                     // this operation consumed the EndElement
-                    stack.pop();
-                } else if ((!stack.empty()) && (top == QStringLiteral("MyObjectBuilder_CubeBlock")) && (name == QStringLiteral("CustomName"))) {
-                    itemNames.push_back(reader.readElementText());
-
-                    // this operation consumed the EndElement
-                    stack.pop();
+                    path.pop();
+                } else if ((top == Tag::CubeBlock) && (tag == Tag::CustomName)) {
+                    // The text follows as Characters and the name is complete at the EndElement
+                    itemName.resize(0);
+                    inItemName = true;
                 }
                 break;
             }
             case QXmlStreamReader::EndElement: {
-                QString const name = reader.name().toString();
-                
-                // std::cout << "Found end element: " << name.toStdString() << " (depth: " << stack.size() << ")" << std::endl;
-                if (stack.empty()) { std::cerr << "Invalid state, EndElement, but stack is empty!" << std::endl; return std::nullopt; }
-                stack.pop();
+                if (path.isEmpty()) { error << "Invalid state, EndElement, but stack is empty!" << std::endl; return std::nullopt; }
+                path.pop();
+                if (inItemName) {
+                    if (!budget.checkBlocks(itemNames.getCount() + 1, reader.characterOffset())) {
+                        error << "Error: " << budget.getError().toStdString() << std::endl;
+                        return std::nullopt;
+                    }
+                    itemNames.add(itemName);
+                    inItemName = false;
+                }
                 break;
             }
             case QXmlStreamReader::StartDocument:
-                if (!stack.empty()) { std::cerr << "Invalid state, StartDocument but not looking for it!" << std::endl; return std::nullopt; }
+                if (!path.isEmpty()) { error << "Invalid state, StartDocument but not looking for it!" << std::endl; return std::nullopt; }
                 break;
             case QXmlStreamReader::EndDocument:
-                if (!stack.empty()) { std::cerr << "Invalid state, EndDocument but not looking for it!" << std::endl; return std::nullopt; }
+                if (!path.isEmpty()) { error << "Invalid state, EndDocument but not looking for it!" << std::endl; return std::nullopt; }
                 break;
             case QXmlStreamReader::Characters: {
                 auto const characters = reader.text();
-                if (characters.contains(QStringLiteral("Missile number="))) {
+                if (inItemName) {
+                    itemName.append(characters);
+                } else if (characters.contains(QStringLiteral("Missile number="))) {
                     if (haveCustomData) {
-                        std::cerr << "Error: More than one custom data for WHAM defined!" << std::endl;
+                        error << "Error: More than one custom data for WHAM defined!" << std::endl;
+                        return std::nullopt;
+                    }
+                    if (!budget.checkCustomData(characters.size(), reader.characterOffset())) {
+                        error << "Error: " << budget.getError().toStdString() << std::endl;
                         return std::nullopt;
                     }
                     haveCustomData = true;
@@ -133,93 +431,193 @@ std::optional<BlueprintData> BlueprintData::fromXml(QByteArray const& data, Opti
                 }
                 break;
             }
+            case QXmlStreamReader::Comment:
+                // Skipped by the scanner as well, even if it mentions the missile number
+                break;
             default:
-                std::cout << "Found an unhandled token: " << reader.tokenString().toStdString() << std::endl;
+                error << "Found an unhandled token: " << reader.tokenString().toStdString() << std::endl;
                 return std::nullopt;
         }
     }
     if (reader.hasError()) {
-        std::cerr << "Error while parsing XML: " << reader.errorString().toStdString() << std::endl;
+        error << "Error while parsing XML: " << reader.errorString().toStdString() << std::endl;
         return std::nullopt;
     }
 
-    if (!haveIdSubType) {
-        std::cerr << "Failed to find all relevant data, missing <Id Subtype=\"X\">!" << std::endl;
+    if (!isComplete(haveIdSubType, haveDisplayName, haveGroupName, itemNames.getCount(), haveCustomData, error)) {
         return std::nullopt;
+    }
+
+    return fromFields(idSubType, displayName, groupName, customData, itemNames, error);
+}
+
+bool BlueprintData::isComplete(bool haveIdSubType, bool haveDisplayName, bool haveGroupName, qsizetype itemCount, bool haveCustomData, std::ostream& error) {
+    auto const problem = checkComplete(haveIdSubType, haveDisplayName, haveGroupName, itemCount, haveCustomData);
+    if (problem) {
+        error << problem->message.toStdString() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::optional<BlueprintData::Problem> BlueprintData::checkComplete(bool haveIdSubType, bool haveDisplayName, bool haveGroupName, qsizetype itemCount, bool haveCustomData) {
+    if (!haveIdSubType) {
+        return Problem{ QStringLiteral("complete"), QStringLiteral("Failed to find all relevant data, missing <Id Subtype=\"X\">!") };
     } else if (!haveDisplayName) {
-        std::cerr << "Failed to find all relevant data, missing DisplayName in CubeGrid!" << std::endl;
-        return std::nullopt;
+        return Problem{ QStringLiteral("complete"), QStringLiteral("Failed to find all relevant data, missing DisplayName in CubeGrid!") };
     } else if (!haveGroupName) {
-        std::cerr << "Failed to find all relevant data, missing block group over items!" << std::endl;
-        return std::nullopt;
-    } else if (itemNames.size() == 0) {
-        std::cerr << "Failed to find all relevant data, found no items!" << std::endl;
-        return std::nullopt;
+        return Problem{ QStringLiteral("complete"), QStringLiteral("Failed to find all relevant data, missing block group over items!") };
+    } else if (itemCount == 0) {
+        return Problem{ QStringLiteral("complete"), QStringLiteral("Failed to find all relevant data, found no items!") };
     } else if (!haveCustomData) {
-        std::cerr << "Failed to find all relevant data, missing the WHAM custom data!" << std::endl;
-        return std::nullopt;
+        return Problem{ QStringLiteral("complete"), QStringLiteral("Failed to find all relevant data, missing the WHAM custom data!") };
     }
+    return std::nullopt;
+}
 
-    QString const prefix = QString("(%1) ").arg(groupName);
-    for (int i = 0; i < itemNames.size(); ++i) {
-        if (!itemNames.at(i).startsWith(prefix)) {
-            std::cerr << "Item '" << itemNames.at(i).toStdString() << "' is missing the prefix '" << prefix.toStdString() << "' based on the group name, this blueprint is broken." << std::endl;
-            return std::nullopt;
-        }
+std::optional<BlueprintData::Problem> BlueprintData::checkItemName(QString const& itemName, QString const& prefix) {
+    if (!itemName.startsWith(prefix)) {
+        return Problem{ QStringLiteral("prefix"), QStringLiteral("Item '%1' is missing the prefix '%2' based on the group name, this blueprint is broken.").arg(itemName, prefix) };
     }
+    return std::nullopt;
+}
 
+std::optional<BlueprintData::Problem> BlueprintData::checkNumbers(QString const& idSubType, QString const& displayName, QString const& groupName, QString const& customData, int& id, QString& nameTag) {
     QRegularExpression expr(R"( (\d+)$)");
     auto matchGridName = expr.match(idSubType);
     if (!matchGridName.isValid() || !matchGridName.hasMatch()) {
-        std::cerr << "Failed to match number at the end of Grid Name '" << idSubType.toStdString() << "'!" << std::endl;
-        return std::nullopt;
+        return Problem{ QStringLiteral("number"), QStringLiteral("Failed to match number at the end of Grid Name '%1'!").arg(idSubType) };
     }
     int const numberGridName = matchGridName.captured(1).toInt();
 
     auto matchDisplayName = expr.match(displayName);
     if (!matchDisplayName.isValid() || !matchDisplayName.hasMatch()) {
-        std::cerr << "Failed to match number at the end of Display Name '" << displayName.toStdString() << "'!" << std::endl;
-        return std::nullopt;
+        return Problem{ QStringLiteral("number"), QStringLiteral("Failed to match number at the end of Display Name '%1'!").arg(displayName) };
     }
     int const numberDisplayName = matchDisplayName.captured(1).toInt();
 
     auto matchGroupName = expr.match(groupName);
     if (!matchGroupName.isValid() || !matchGroupName.hasMatch()) {
-        std::cerr << "Failed to match number at the end of Group Name '" << groupName.toStdString() << "'!" << std::endl;
-        return std::nullopt;
+        return Problem{ QStringLiteral("number"), QStringLiteral("Failed to match number at the end of Group Name '%1'!").arg(groupName) };
     }
     int const numberGroupName = matchGroupName.captured(1).toInt();
 
     auto matchCustomDataMissileNumber = expressionCustomDataMissileNumber.match(customData);
     if (!matchCustomDataMissileNumber.isValid() || !matchCustomDataMissileNumber.hasMatch()) {
-        std::cerr << "Failed to match the missile number in the WHAM custom data!" << std::endl;
-        std::cerr << "Custom Data: " << customData.toStdString() << std::endl;
-        return std::nullopt;
+        return Problem{ QStringLiteral("customData"), QStringLiteral("Failed to match the missile number in the WHAM custom data!\nCustom Data: %1").arg(customData) };
     }
     int const numberMissileCustomData = matchCustomDataMissileNumber.captured(1).toInt();
 
     auto matchCustomDataMissileNameTag = expressionCustomDataMissileNameTag.match(customData);
     if (!matchCustomDataMissileNameTag.isValid() || !matchCustomDataMissileNameTag.hasMatch()) {
-        std::cerr << "Failed to match the missile name tag in the WHAM custom data!" << std::endl;
-        std::cerr << "Custom Data: " << customData.toStdString() << std::endl;
-        return std::nullopt;
+        return Problem{ QStringLiteral("customData"), QStringLiteral("Failed to match the missile name tag in the WHAM custom data!\nCustom Data: %1").arg(customData) };
     }
-    QString const nameTag = matchCustomDataMissileNameTag.captured(1);
+    QString const customDataNameTag = matchCustomDataMissileNameTag.captured(1);
 
     QString const reducedGroupName = cutDigitsFromEnd(groupName).trimmed();
-    if (nameTag != reducedGroupName) {
-        std::cerr << "The missile name tag in the WHAM custom data and the actual group name do not match: '" << nameTag.toStdString() << "' vs. '" << reducedGroupName.toStdString() << "'" << std::endl;
-        return std::nullopt;
+    if (customDataNameTag != reducedGroupName) {
+        return Problem{ QStringLiteral("nameTag"), QStringLiteral("The missile name tag in the WHAM custom data and the actual group name do not match: '%1' vs. '%2'").arg(customDataNameTag, reducedGroupName) };
     }
 
     if ((numberGridName != numberDisplayName) || (numberDisplayName != numberGroupName) || (numberGridName != numberMissileCustomData)) {
-        std::cerr << "Numbering on Grid Name, Display Name, Group Name and WHAM custom data does NOT match: " << numberGridName << " vs. " << numberDisplayName << " vs. " << numberGroupName << " vs. " << numberMissileCustomData << "!" << std::endl;
+        return Problem{ QStringLiteral("numbering"), QStringLiteral("Numbering on Grid Name, Display Name, Group Name and WHAM custom data does NOT match: %1 vs. %2 vs. %3 vs. %4!").arg(numberGridName).arg(numberDisplayName).arg(numberGroupName).arg(numberMissileCustomData) };
+    }
+
+    id = numberGroupName;
+    nameTag = customDataNameTag;
+    return std::nullopt;
+}
+
+std::optional<BlueprintData> BlueprintData::fromFields(QString const& idSubType, QString const& displayName, QString const& groupName, QString const& customData, ItemNames const& itemNames, std::ostream& error) {
+    auto const prefixProblem = itemNames.check(QString("(%1) ").arg(groupName));
+    if (prefixProblem) {
+        error << prefixProblem->message.toStdString() << std::endl;
         return std::nullopt;
     }
 
-    std::cout << "Info: Found GridName='" << idSubType.toStdString() << "', DisplayName='" << displayName.toStdString() << "', GroupName='" << groupName.toStdString() << "' and " << itemNames.size() << " items, which all have the group name prefix." << std::endl;
+    int id = 0;
+    QString nameTag;
+    auto const problem = checkNumbers(idSubType, displayName, groupName, customData, id, nameTag);
+    if (problem) {
+        error << problem->message.toStdString() << std::endl;
+        return std::nullopt;
+    }
+    return BlueprintData(idSubType, displayName, groupName, nameTag, itemNames.getCount(), id);
+}
+
+std::optional<BlueprintData> BlueprintData::lint(QByteArray const& data, std::vector<BlueprintScanner::Field> const& fields, Problem& problem) {
+    // Same rules as fromScan: the last id and display name win, group and custom data must be unique
+    BlueprintScanner::Field const* idSubTypeField = nullptr;
+    BlueprintScanner::Field const* displayNameField = nullptr;
+    BlueprintScanner::Field const* groupNameField = nullptr;
+    BlueprintScanner::Field const* customDataField = nullptr;
+    std::vector<BlueprintScanner::Field const*> itemNameFields;
+    for (auto const& field : fields) {
+        switch (field.type) {
+            case BlueprintScanner::FieldType::IdSubtype:
+                idSubTypeField = &field;
+                break;
+            case BlueprintScanner::FieldType::GridDisplayName:
+                displayNameField = &field;
+                break;
+            case BlueprintScanner::FieldType::GroupName:
+                if (groupNameField != nullptr) {
+                    problem = Problem{ QStringLiteral("structure"), QStringLiteral("Error: More than one block group defined!") };
+                    return std::nullopt;
+                }
+                groupNameField = &field;
+                break;
+            case BlueprintScanner::FieldType::BlockCustomName:
+                itemNameFields.push_back(&field);
+                break;
+            case BlueprintScanner::FieldType::CustomData:
+                if (customDataField != nullptr) {
+                    problem = Problem{ QStringLiteral("structure"), QStringLiteral("Error: More than one custom data for WHAM defined!") };
+                    return std::nullopt;
+                }
+                customDataField = &field;
+                break;
+        }
+    }
 
-    return BlueprintData(idSubType, displayName, groupName, nameTag, itemNames, numberGroupName);
+    auto const complete = checkComplete(idSubTypeField != nullptr, displayNameField != nullptr, groupNameField != nullptr, static_cast<qsizetype>(itemNameFields.size()), customDataField != nullptr);
+    if (complete) {
+        problem = *complete;
+        return std::nullopt;
+    }
+    // The scanner reports what it could not decode, that becomes the message instead of being printed
+    std::ostringstream decodeError;
+    auto const idSubType = BlueprintScanner::decode(data, *idSubTypeField, decodeError);
+    auto const displayName = BlueprintScanner::decode(data, *displayNameField, decodeError);
+    auto const groupName = BlueprintScanner::decode(data, *groupNameField, decodeError);
+    auto const customData = BlueprintScanner::decode(data, *customDataField, decodeError);
+    if (!idSubType || !displayName || !groupName || !customData) {
+        problem = Problem{ QStringLiteral("decode"), QStringLiteral("Could not decode the names or the WHAM custom data: %1").arg(QString::fromStdString(decodeError.str()).trimmed()) };
+        return std::nullopt;
+    }
+
+    int id = 0;
+    QString nameTag;
+    auto const numbers = checkNumbers(*idSubType, *displayName, *groupName, *customData, id, nameTag);
+    if (numbers) {
+        problem = *numbers;
+        return std::nullopt;
+    }
+
+    QString const prefix = QString("(%1) ").arg(*groupName);
+    for (auto const field : itemNameFields) {
+        auto const itemName = BlueprintScanner::decode(data, *field, decodeError);
+        if (!itemName) {
+            problem = Problem{ QStringLiteral("decode"), QStringLiteral("Could not decode the name of a block at byte %1: %2").arg(field->begin).arg(QString::fromStdString(decodeError.str()).trimmed()) };
+            return std::nullopt;
+        }
+        auto const prefixProblem = checkItemName(*itemName, prefix);
+        if (prefixProblem) {
+            problem = *prefixProblem;
+            return std::nullopt;
+        }
+    }
+    return BlueprintData(*idSubType, *displayName, *groupName, nameTag, static_cast<qsizetype>(itemNameFields.size()), id);
 }
 
 QString BlueprintData::cutDigitsFromEnd(QString s) {
@@ -234,7 +632,64 @@ QString BlueprintData::cutDigitsFromEnd(QString s) {
     return s;
 }
 
-QByteArray BlueprintData::toXMLWithNewId(QByteArray const& data, BlueprintData const& blueprintData, qsizetype newId, Options const& options) {
+QByteArray BlueprintData::toXMLWithNewId(QByteArray const& data, BlueprintData const& blueprintData, qsizetype newId, Options const& options, std::ostream& error) {
+    QByteArray result;
+    toXMLWithNewId(data, blueprintData, newId, options, result, error);
+    return result;
+}
+
+bool BlueprintData::toXMLWithNewId(QByteArray const& data, BlueprintData const& blueprintData, qsizetype newId, Options const& options, QByteArray& result, std::ostream& error) {
+    ParseBudget budget(options.parseLimits);
+    if (!budget.checkBytes(data.size())) {
+        error << "Error: " << budget.getError().toStdString() << std::endl;
+        result.resize(0);
+        return false;
+    }
+    QXmlStreamReader reader(data);
+    // Sized for the copy up front, so the writer does not grow it step by step, and kept from copy to copy
+    result.resize(0);
+    result.reserve(data.size() + data.size() / 8);
+    QXmlStreamWriter writer(&result);
+    {
+        Stats::Span const span("rewrite");
+        if (!toXMLWithNewId(reader, writer, blueprintData, newId, options, budget, error)) {
+            result.resize(0);
+            return false;
+        }
+    }
+
+    Stats::Span const span("postprocess");
+    // Both fixes only touch ASCII, so they are applied to the UTF-8 bytes without a round trip through QString
+    // Quick-and-Dirty fix for Qt removing the space from '" />' to '"/>'
+    result.replace("/>", " />");
+
+    // Quick-and-Dirty fix for Qt replacing all " by &quot;
+    result.replace("&quot;", "\"");
+
+    return true;
+}
+
+bool BlueprintData::toXMLWithNewId(QIODevice& input, QIODevice& output, BlueprintData const& blueprintData, qsizetype newId, Options const& options, std::ostream& error) {
+    // Applies the same fixes as above, but incrementally while writing
+    // The source is read again for every copy, with --stream straight from the file
+    ParseBudget budget(options.parseLimits);
+    if (!budget.checkBytes(input.size())) {
+        error << "Error: " << budget.getError().toStdString() << std::endl;
+        return false;
+    }
+    XmlFixupDevice fixup(output);
+    if (!fixup.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+
+    QXmlStreamReader reader(&input);
+    QXmlStreamWriter writer(&fixup);
+    bool const result = toXMLWithNewId(reader, writer, blueprintData, newId, options, budget, error);
+    fixup.close();
+    return result && fixup.isHealthy();
+}
+
+bool BlueprintData::toXMLWithNewId(QXmlStreamReader& reader, QXmlStreamWriter& writer, BlueprintData const& blueprintData, qsizetype newId, Options const& options, ParseBudget& budget, std::ostream& error) {
     // Replacement Data:
     QString const idSubType = cutDigitsFromEnd(blueprintData.getGridName()).append(QString::number(newId));
     QString const displayName = cutDigitsFromEnd(blueprintData.getDisplayName()).append(QString::number(newId));
@@ -242,40 +697,49 @@ QByteArray BlueprintData::toXMLWithNewId(QByteArray const& data, BlueprintData c
     QString const oldItemPrefix = QString("(%1)").arg(blueprintData.getGroupName());
     QString const newItemPrefix = QString("(%1)").arg(groupName);
 
-    QXmlStreamReader reader(data);
-    QByteArray result;
-    QXmlStreamWriter writer(&result);
     writer.setAutoFormatting(true);
     writer.setAutoFormattingIndent(2);
 
-    std::stack<QString> stack;
+    // Element names and text go through memory kept per thread, so a copy does not allocate for every element
+    thread_local RewriteScratch scratch;
+    TagPath path;
+    bool inItemName = false;
     while (!reader.atEnd()) {
         auto const token = reader.readNext();
+        if (!budget.checkBytes(bytesRead(reader)) || !budget.checkTime(reader.characterOffset())) {
+            error << "Error: " << budget.getError().toStdString() << std::endl;
+            return false;
+        }
         switch (token) {
             case QXmlStreamReader::StartElement: {
-                QString const name = reader.name().toString();
-                QString const namespaceUri = reader.namespaceUri().toString();
-
-                QString const top = (stack.empty() ? QString() : stack.top());
-                stack.push(name);
+                if (inItemName) {
+                    error << "Error while parsing XML: Expected character data in the name of a block." << std::endl;
+                    return false;
+                }
+                Tag const tag = internTag(reader.name());
+                Tag const top = path.top();
+                path.push(tag);
+                if (!budget.checkDepth(path.getDepth(), reader.characterOffset())) {
+                    error << "Error: " << budget.getError().toStdString() << std::endl;
+                    return false;
+                }
 
-                writer.writeStartElement(namespaceUri, name);
+                writer.writeStartElement(scratch.names.intern(reader.namespaceUri()), scratch.names.intern(reader.name()));
                 auto const namespaces = reader.namespaceDeclarations();
                 for (qsizetype i = 0; i < namespaces.size(); ++i) {
                     writer.writeNamespace(namespaces.at(i).namespaceUri().toString(), namespaces.at(i).prefix().toString());
                 }
 
-                // std::cout << "Found start element: " << name.toStdString() << " (depth: " << stack.size() << ")" << std::endl;
-                if ((!stack.empty()) && (top == QStringLiteral("ShipBlueprint")) && (name == QStringLiteral("Id"))) {
+                if ((top == Tag::ShipBlueprint) && (tag == Tag::Id)) {
                     auto const attrs = reader.attributes();
                     if (!attrs.hasAttribute("", "Subtype")) {
-                        std::cerr << "Attr Subtype not defined?" << std::endl;
-                        return QByteArray();
+                        error << "Attr Subtype not defined?" << std::endl;
+                        return false;
                     }
 
                     writer.writeAttribute(QStringLiteral("Type"), attrs.value("", QStringLiteral("Type")).toString());
                     writer.writeAttribute(QStringLiteral("Subtype"), idSubType);
-                } else if ((!stack.empty()) && (top == QStringLiteral("CubeGrid")) && (name == QStringLiteral("DisplayName"))) {
+                } else if ((top == Tag::CubeGrid) && (tag == Tag::DisplayName)) {
                     writer.writeCharacters(displayName);
                     
                     // consume the characters to stop them from appearing next
@@ -283,8 +747,8 @@ QByteArray BlueprintData::toXMLWithNewId(QByteArray const& data, BlueprintData c
 
                     // this operation consumed the EndElement
                     writer.writeEndElement();
-                    stack.pop();
-                } else if ((!stack.empty()) && (top == QStringLiteral("MyObjectBuilder_BlockGroup")) && (name == QStringLiteral("Name"))) {
+                    path.pop();
+                } else if ((top == Tag::BlockGroup) && (tag == Tag::Name)) {
                     //writer.writeStartElement(QStringLiteral("Name"));
                     writer.writeCharacters(groupName);
 
@@ -293,85 +757,93 @@ QByteArray BlueprintData::toXMLWithNewId(QByteArray const& data, BlueprintData c
                     
                     // this operation consumed the EndElement
                     writer.writeEndElement();
-                    stack.pop();
-                } else if ((!stack.empty()) && (top == QStringLiteral("MyObjectBuilder_CubeBlock")) && (name == QStringLiteral("CustomName"))) {
-                    QString oldItemName = reader.readElementText();
-                    QString const newItemName = oldItemName.replace(oldItemPrefix, newItemPrefix);
-
-                    //writer.writeStartElement(QStringLiteral("CustomName"));
-                    writer.writeCharacters(newItemName);
-                    writer.writeEndElement();
-
-                    // this operation consumed the EndElement
-                    stack.pop();
+                    path.pop();
+                } else if ((top == Tag::CubeBlock) && (tag == Tag::CustomName)) {
+                    // The text follows as Characters, the renamed block is written at the EndElement
+                    scratch.text.resize(0);
+                    inItemName = true;
                 } else {
                     writer.writeAttributes(reader.attributes());
                 }
                 break;
             }
             case QXmlStreamReader::EndElement: {
-                QString const name = reader.name().toString();
-
-                // std::cout << "Found end element: " << name.toStdString() << " (depth: " << stack.size() << ")" << std::endl;
-                if (stack.empty()) { std::cerr << "Invalid state, EndElement, but stack is empty!" << std::endl; return QByteArray(); }
-                stack.pop();
+                if (path.isEmpty()) { error << "Invalid state, EndElement, but stack is empty!" << std::endl; return false; }
+                path.pop();
+                if (inItemName) {
+                    // Like the patch template, only the leading prefix is renamed
+                    if (scratch.text.startsWith(oldItemPrefix)) {
+                        scratch.text.replace(0, oldItemPrefix.size(), newItemPrefix);
+                    }
+                    writer.writeCharacters(scratch.text);
+                    scratch.trimText();
+                    inItemName = false;
+                }
                 writer.writeEndElement();
                 break;
             }
             case QXmlStreamReader::StartDocument:
-                if (!stack.empty()) { std::cerr << "Invalid state, StartDocument but not looking for it!" << std::endl; return QByteArray(); }
+                if (!path.isEmpty()) { error << "Invalid state, StartDocument but not looking for it!" << std::endl; return false; }
                 writer.writeStartDocument();
                 break;
             case QXmlStreamReader::EndDocument:
-                if (!stack.empty()) { std::cerr << "Invalid state, EndDocument but not looking for it!" << std::endl; return QByteArray(); }
+                if (!path.isEmpty()) { error << "Invalid state, EndDocument but not looking for it!" << std::endl; return false; }
                 writer.writeEndDocument();
                 break;
             case QXmlStreamReader::Characters: {
-                auto characters = reader.text().toString();
-                if (characters.contains(QStringLiteral("Missile number="))) {
-                    auto matchCustomDataMissileNumber = expressionCustomDataMissileNumber.match(characters);
-                    if (!matchCustomDataMissileNumber.isValid() || !matchCustomDataMissileNumber.hasMatch()) {
-                        std::cerr << "Failed to match the missile number in the WHAM custom data!" << std::endl;
-                        std::cerr << "Custom Data: " << characters.toStdString() << std::endl;
-                        return QByteArray();
+                auto const characters = reader.text();
+                if (inItemName) {
+                    scratch.text.append(characters);
+                    break;
+                } else if (characters.contains(QStringLiteral("Missile number="))) {
+                    // The reader already decoded the entities, the writer escapes the result again
+                    CustomData const customData(characters.toString().toUtf8(), false);
+                    if (customData.find(QByteArray("Missile number")) == nullptr) {
+                        error << "Failed to locate the missile number in the WHAM custom data!" << std::endl;
+                        error << "Custom Data: " << characters.toString().toStdString() << std::endl;
+                        return false;
                     }
-                    int const numberMissileCustomData = matchCustomDataMissileNumber.captured(1).toInt();
-
-                    characters = characters.replace(expressionCustomDataMissileNumber, QString("Missile number=%1").arg(newId));
+                    writer.writeCharacters(QString::fromUtf8(customData.instantiate(newId, options.customDataOverrides)));
+                    break;
                 }
-                writer.writeCharacters(characters);
+                scratch.text.resize(0);
+                scratch.text.append(characters);
+                writer.writeCharacters(scratch.text);
+                scratch.trimText();
                 break;
             }
+            case QXmlStreamReader::Comment:
+                writer.writeComment(reader.text().toString());
+                break;
             default:
-                std::cout << "Found an unhandled token: " << reader.tokenString().toStdString() << std::endl;
-                return QByteArray();
+                error << "Found an unhandled token: " << reader.tokenString().toStdString() << std::endl;
+                return false;
         }
     }
     if (reader.hasError()) {
-        std::cerr << "Error while parsing XML: " << reader.errorString().toStdString() << std::endl;
-        return QByteArray();
+        error << "Error while parsing XML: " << reader.errorString().toStdString() << std::endl;
+        return false;
     }
 
-    QString fix = QString::fromUtf8(result);
-    
-    // Quick-and-Dirty fix for Qt removing the space from '" />' to '"/>'
-    fix.replace(QStringLiteral("/>"), QStringLiteral(" />"));
-    
-    // Quick-and-Dirty fix for Qt replacing all " by &quot;
-    fix.replace(QStringLiteral("&quot;"), QStringLiteral("\""));
-
-    result = fix.toUtf8();
-
-    return result;
+    return true;
 }
 
 bool BlueprintData::isValidBlueprintLocation(QDir dir) {
     // pick a folder and check if it contains bp.spc
     auto const list = dir.entryList(QDir::Filter::Dirs | QDir::Filter::NoDotAndDotDot);
-    if (list.size() < 1) {
-        return false;
-    } else if (!dir.cd(list.at(0))) {
-        return false;
+    QDir blueprintDir(dir);
+    if ((list.size() >= 1) && blueprintDir.cd(list.at(0)) && QFile::exists(blueprintDir.absoluteFilePath(QStringLiteral("bp.sbc")))) {
+        return true;
+    }
+
+    // or pick an archive, as Workshop blueprints come in, and check that instead
+    for (auto const& name : dir.entryList(QDir::Filter::Files)) {
+        if (ZipArchive::isArchive(dir.absoluteFilePath(name))) {
+            // A damaged archive only means this is not a blueprint location, there is nothing to report
+            std::ostringstream archiveError;
+            auto const archive = ZipArchive::open(dir.absoluteFilePath(name), archiveError);
+            return archive && (archive->find(QStringLiteral("bp.sbc")) != nullptr);
+        }
     }
-    return QFile::exists(dir.absoluteFilePath(QStringLiteral("bp.sbc")));
+    return false;
 }
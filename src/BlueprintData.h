@@ -7,34 +7,93 @@
 #include <QString>
 #include <QStringList>
 
+#include <iosfwd>
 #include <optional>
+#include <vector>
+
+#include "BlueprintScanner.h"
+#include "ParseLimits.h"
 
 class Options;
+class QIODevice;
+class QXmlStreamReader;
+class QXmlStreamWriter;
 
 class BlueprintData {
 public:
-	BlueprintData(QString const& gridName, QString const& displayName, QString const& groupName, QString const& nameTag, QStringList const& itemNames, int id);
+	// The first failed consistency check of a blueprint, check is a short identifier like "prefix" or "numbering"
+	struct Problem {
+		QString check;
+		QString message;
+	};
+
+	// The names of the blocks in the group, reduced to what the prefix check needs while they stream by: their count,
+	// the first one and the one sharing the shortest start with it. The group name may only come after the blocks.
+	class ItemNames {
+	public:
+		ItemNames();
+
+		void add(QString const& itemName);
+		qsizetype getCount() const;
+		// A name without the prefix if there is one, not necessarily the first such name in the document
+		std::optional<Problem> check(QString const& prefix) const;
+	private:
+		qsizetype m_count;
+		QString m_first;
+		// Length of the start all names share with the first one, and a name sharing only that much
+		qsizetype m_shared;
+		QString m_least;
+	};
+
+	BlueprintData(QString const& gridName, QString const& displayName, QString const& groupName, QString const& nameTag, qsizetype itemCount, int id);
 
 	QString const& getGridName() const;
 	QString const& getDisplayName() const;
 	QString const& getGroupName() const;
 	QString const& getNameTag() const;
-	QStringList const& getItemNames() const;
+	qsizetype getItemCount() const;
 	int getId() const;
 
-	static std::optional<BlueprintData> fromXml(QByteArray const& data, Options const& options);
+	// Uses the fast scanner, QXmlStreamReader remains the fallback for documents the scanner can not handle. Both stop
+	// with an error as soon as the document exceeds options.parseLimits. Like everywhere in the library, errors and
+	// warnings go to error, nothing is printed.
+	static std::optional<BlueprintData> fromXml(QByteArray const& data, Options const& options, std::ostream& error);
+	static std::optional<BlueprintData> fromXml(QIODevice& device, Options const& options, std::ostream& error);
+	// Only the fast scanner, without a fallback
+	static std::optional<BlueprintData> fromScan(QByteArray const& data, std::ostream& error);
+	// Runs the consistency checks on the raw values, regardless of where they were read from
+	static std::optional<BlueprintData> fromFields(QString const& idSubType, QString const& displayName, QString const& groupName, QString const& customData, ItemNames const& itemNames, std::ostream& error);
+	// The same checks as fromScan without printing anything, safe to run on many threads at once. The block names are
+	// only decoded once everything else passed and the checks stop at the first problem, which is stored in problem.
+	static std::optional<BlueprintData> lint(QByteArray const& data, std::vector<BlueprintScanner::Field> const& fields, Problem& problem);
 
-	static QByteArray toXMLWithNewId(QByteArray const& data, BlueprintData const& blueprintData, qsizetype newId, Options const& options);
+	static QByteArray toXMLWithNewId(QByteArray const& data, BlueprintData const& blueprintData, qsizetype newId, Options const& options, std::ostream& error);
+	// Same into result, whose memory is reused as long as nobody else holds on to it. Leaves result empty on failure.
+	static bool toXMLWithNewId(QByteArray const& data, BlueprintData const& blueprintData, qsizetype newId, Options const& options, QByteArray& result, std::ostream& error);
+	// Streams the copy from input to output without materializing either document
+	static bool toXMLWithNewId(QIODevice& input, QIODevice& output, BlueprintData const& blueprintData, qsizetype newId, Options const& options, std::ostream& error);
 	static QString cutDigitsFromEnd(QString s);
 	static bool isValidBlueprintLocation(QDir dir);
+
+	bool operator==(BlueprintData const& other) const;
+	bool operator!=(BlueprintData const& other) const;
 private:
 	QString const m_gridName;
 	QString const m_displayName;
 	QString const m_groupName;
 	QString const m_nameTag;
-	QStringList const m_itemNames;
+	qsizetype const m_itemCount;
 	int const m_id;
 
+	static std::optional<BlueprintData> fromXml(QXmlStreamReader& reader, Options const& options, ParseBudget& budget, std::ostream& error);
+	static std::optional<BlueprintData> fromScan(QByteArray const& data, std::vector<BlueprintScanner::Field> const& fields, std::ostream& error);
+	static bool isComplete(bool haveIdSubType, bool haveDisplayName, bool haveGroupName, qsizetype itemCount, bool haveCustomData, std::ostream& error);
+	static std::optional<Problem> checkComplete(bool haveIdSubType, bool haveDisplayName, bool haveGroupName, qsizetype itemCount, bool haveCustomData);
+	static std::optional<Problem> checkItemName(QString const& itemName, QString const& prefix);
+	// Numbers and name tag, id and nameTag are only set if all of them match
+	static std::optional<Problem> checkNumbers(QString const& idSubType, QString const& displayName, QString const& groupName, QString const& customData, int& id, QString& nameTag);
+	static bool toXMLWithNewId(QXmlStreamReader& reader, QXmlStreamWriter& writer, BlueprintData const& blueprintData, qsizetype newId, Options const& options, ParseBudget& budget, std::ostream& error);
+
 	static QRegularExpression const expressionCustomDataMissileNumber;
 	static QRegularExpression const expressionCustomDataMissileNameTag;
 };
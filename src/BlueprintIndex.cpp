@@ -0,0 +1,219 @@
+#include "BlueprintIndex.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <map>
+#include <optional>
+#include <ostream>
+
+#include "BlueprintData.h"
+#include "Options.h"
+#include "ZipArchive.h"
+
+QString const BlueprintIndex::fileName = QStringLiteral(".blueprintDuplicatorIndex.json");
+
+namespace {
+    int const indexVersion = 1;
+
+    std::optional<QByteArray> readFile(QString const& path) {
+        QFile file(path);
+        if (!file.open(QFile::ReadOnly)) {
+            return std::nullopt;
+        }
+        return file.readAll();
+    }
+
+    // The bp.sbc of a workshop archive
+    std::optional<QByteArray> readArchived(QString const& path, std::ostream& error) {
+        auto const archive = ZipArchive::open(path, error);
+        auto const entry = (archive) ? archive->find(QStringLiteral("bp.sbc")) : nullptr;
+        if (entry == nullptr) {
+            if (archive) {
+                error << "Error: The archive '" << path.toStdString() << "' does not contain a bp.sbc!" << std::endl;
+            }
+            return std::nullopt;
+        }
+        return archive->read(*entry, error);
+    }
+}
+
+BlueprintIndex::BlueprintIndex(QString const& blueprintLocation) : m_blueprintLocation(blueprintLocation) {
+	//
+}
+
+std::vector<BlueprintIndex::Entry> const& BlueprintIndex::getEntries() const {
+    return m_entries;
+}
+
+QByteArray BlueprintIndex::hashContents(QByteArray const& data) {
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+bool BlueprintIndex::load(std::ostream& error) {
+    m_entries.clear();
+
+    QFile file(QDir(m_blueprintLocation).absoluteFilePath(fileName));
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    QJsonDocument const document = QJsonDocument::fromJson(file.readAll());
+    if (!document.isObject() || (document.object().value(QStringLiteral("version")).toInt() != indexVersion)) {
+        error << "Warning: Ignoring the blueprint index, it is damaged or from another version." << std::endl;
+        return false;
+    }
+
+    QJsonArray const entries = document.object().value(QStringLiteral("entries")).toArray();
+    m_entries.reserve(static_cast<std::size_t>(entries.size()));
+    for (auto const& value : entries) {
+        QJsonObject const object = value.toObject();
+        Entry entry;
+        entry.name = object.value(QStringLiteral("name")).toString();
+        entry.modified = static_cast<qint64>(object.value(QStringLiteral("modified")).toDouble());
+        entry.size = static_cast<qint64>(object.value(QStringLiteral("size")).toDouble());
+        entry.hash = object.value(QStringLiteral("hash")).toString().toLatin1();
+        entry.valid = object.value(QStringLiteral("valid")).toBool();
+        entry.gridName = object.value(QStringLiteral("gridName")).toString();
+        entry.displayName = object.value(QStringLiteral("displayName")).toString();
+        entry.groupName = object.value(QStringLiteral("groupName")).toString();
+        entry.nameTag = object.value(QStringLiteral("nameTag")).toString();
+        entry.missileNumber = object.value(QStringLiteral("missileNumber")).toInt();
+        entry.blockCount = object.value(QStringLiteral("blockCount")).toInt();
+        m_entries.push_back(entry);
+    }
+    return true;
+}
+
+bool BlueprintIndex::save(std::ostream& error) const {
+    QJsonArray entries;
+    for (auto const& entry : m_entries) {
+        QJsonObject object;
+        object.insert(QStringLiteral("name"), entry.name);
+        object.insert(QStringLiteral("modified"), static_cast<double>(entry.modified));
+        object.insert(QStringLiteral("size"), static_cast<double>(entry.size));
+        object.insert(QStringLiteral("hash"), QString::fromLatin1(entry.hash));
+        object.insert(QStringLiteral("valid"), entry.valid);
+        object.insert(QStringLiteral("gridName"), entry.gridName);
+        object.insert(QStringLiteral("displayName"), entry.displayName);
+        object.insert(QStringLiteral("groupName"), entry.groupName);
+        object.insert(QStringLiteral("nameTag"), entry.nameTag);
+        object.insert(QStringLiteral("missileNumber"), entry.missileNumber);
+        object.insert(QStringLiteral("blockCount"), static_cast<int>(entry.blockCount));
+        entries.append(object);
+    }
+    QJsonObject root;
+    root.insert(QStringLiteral("version"), indexVersion);
+    root.insert(QStringLiteral("entries"), entries);
+
+    // Written atomically, other users of a shared library never see a half-written index
+    QSaveFile file(QDir(m_blueprintLocation).absoluteFilePath(fileName));
+    if (!file.open(QFile::WriteOnly)) {
+        error << "Warning: Could not write the blueprint index." << std::endl;
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+qsizetype BlueprintIndex::update(Options const& options, std::ostream& error) {
+    std::map<QString, Entry> previous;
+    for (auto& entry : m_entries) {
+        previous.emplace(entry.name, std::move(entry));
+    }
+    m_entries.clear();
+
+    QDir dir(m_blueprintLocation);
+    dir.setFilter(QDir::Dirs | QDir::NoDotAndDotDot);
+    // Folders first and archives after them, in the order the blueprint list has them
+    QStringList names = dir.entryList();
+    for (auto const& name : dir.entryList(QDir::Files)) {
+        if (ZipArchive::isArchive(dir.absoluteFilePath(name))) {
+            names.append(name);
+        }
+    }
+    m_entries.reserve(static_cast<std::size_t>(names.size()));
+
+    qsizetype parsed = 0;
+    for (auto const& name : names) {
+        // An archive is keyed by its own mtime and size, its bp.sbc is only unpacked if either changed
+        bool const isArchive = ZipArchive::isArchive(dir.absoluteFilePath(name));
+        QFileInfo const info((isArchive) ? dir.absoluteFilePath(name) : QDir(dir.absoluteFilePath(name)).absoluteFilePath(QStringLiteral("bp.sbc")));
+
+        Entry entry;
+        entry.name = name;
+        entry.modified = 0;
+        entry.size = 0;
+        entry.valid = false;
+        entry.missileNumber = -1;
+        entry.blockCount = 0;
+        if (!info.exists()) {
+            m_entries.push_back(entry);
+            continue;
+        }
+        entry.modified = info.lastModified().toMSecsSinceEpoch();
+        entry.size = info.size();
+
+        auto const it = previous.find(name);
+        if ((it != previous.end()) && (it->second.modified == entry.modified) && (it->second.size == entry.size)) {
+            m_entries.push_back(it->second);
+            continue;
+        }
+
+        auto const data = (isArchive) ? readArchived(info.absoluteFilePath(), error) : readFile(info.absoluteFilePath());
+        if (!data) {
+            m_entries.push_back(entry);
+            continue;
+        }
+        entry.hash = hashContents(*data);
+
+        // Touched, but not changed
+        if ((it != previous.end()) && (it->second.hash == entry.hash)) {
+            Entry unchanged = it->second;
+            unchanged.modified = entry.modified;
+            unchanged.size = entry.size;
+            m_entries.push_back(unchanged);
+            continue;
+        }
+
+        ++parsed;
+        auto const blueprintData = BlueprintData::fromXml(*data, options, error);
+        if (blueprintData) {
+            entry.valid = true;
+            entry.gridName = blueprintData->getGridName();
+            entry.displayName = blueprintData->getDisplayName();
+            entry.groupName = blueprintData->getGroupName();
+            entry.nameTag = blueprintData->getNameTag();
+            entry.missileNumber = blueprintData->getId();
+            entry.blockCount = blueprintData->getItemCount();
+        }
+        m_entries.push_back(entry);
+    }
+
+    return parsed;
+}
+
+BlueprintIndex::Entry const* BlueprintIndex::find(QString const& name) const {
+    auto const it = std::find_if(m_entries.cbegin(), m_entries.cend(), [&](Entry const& entry) { return entry.name == name; });
+    return (it == m_entries.cend()) ? nullptr : &(*it);
+}
+
+std::vector<BlueprintIndex::Entry const*> BlueprintIndex::family(QString const& stem) const {
+    QString const reducedStem = BlueprintData::cutDigitsFromEnd(stem).trimmed();
+
+    std::vector<Entry const*> result;
+    for (auto const& entry : m_entries) {
+        if (entry.valid && (BlueprintData::cutDigitsFromEnd(entry.displayName).trimmed() == reducedStem)) {
+            result.push_back(&entry);
+        }
+    }
+    std::sort(result.begin(), result.end(), [](Entry const* a, Entry const* b) { return a->missileNumber < b->missileNumber; });
+    return result;
+}
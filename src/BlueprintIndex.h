@@ -0,0 +1,59 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_BLUEPRINTINDEX_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_BLUEPRINTINDEX_H_
+
+#include <QByteArray>
+#include <QString>
+
+#include <iosfwd>
+#include <vector>
+
+class Options;
+
+/*
+	On-disk index of all blueprints in a blueprint folder.
+	Entries are keyed by folder name and invalidated by the mtime, size and content hash of their bp.sbc,
+	so updating the index only parses blueprints that actually changed. Archives are keyed by their file name and
+	invalidated by the mtime and size of the archive, the hash is still that of the bp.sbc inside.
+*/
+class BlueprintIndex {
+public:
+	struct Entry {
+		// Folder name, or file name with suffix for an archive
+		QString name;
+		qint64 modified;
+		qint64 size;
+		QByteArray hash;
+
+		bool valid;
+		QString gridName;
+		QString displayName;
+		QString groupName;
+		QString nameTag;
+		int missileNumber;
+		qsizetype blockCount;
+	};
+
+	explicit BlueprintIndex(QString const& blueprintLocation);
+
+	// A damaged index or one that could not be written is reported to error as a warning
+	bool load(std::ostream& error);
+	bool save(std::ostream& error) const;
+
+	// Brings the index up to date with the folder, returns the number of blueprints that had to be parsed. Why a
+	// blueprint is not valid goes to error.
+	qsizetype update(Options const& options, std::ostream& error);
+
+	std::vector<Entry> const& getEntries() const;
+	Entry const* find(QString const& name) const;
+	// All valid entries whose display name has the given stem, i.e. the same missile type
+	std::vector<Entry const*> family(QString const& stem) const;
+
+	static QByteArray hashContents(QByteArray const& data);
+
+	static QString const fileName;
+private:
+	QString const m_blueprintLocation;
+	std::vector<Entry> m_entries;
+};
+
+#endif
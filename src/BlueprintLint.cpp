@@ -0,0 +1,197 @@
+#include "BlueprintLint.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QXmlStreamReader>
+
+#include <algorithm>
+#include <atomic>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+#include "BlueprintData.h"
+#include "BlueprintScanner.h"
+#include "Options.h"
+#include "Stats.h"
+#include "ZipArchive.h"
+
+BlueprintLint::BlueprintLint(QString const& blueprintLocation, ParseLimits const& limits) : m_blueprintLocation(blueprintLocation), m_limits(limits), m_elapsed(0) {
+	//
+}
+
+std::vector<BlueprintLint::Result> const& BlueprintLint::getResults() const {
+    return m_results;
+}
+
+qsizetype BlueprintLint::getProblemCount() const {
+    qsizetype result = 0;
+    for (auto const& entry : m_results) {
+        if (!entry.valid) {
+            ++result;
+        }
+    }
+    return result;
+}
+
+void BlueprintLint::run(QStringList const& names, qsizetype jobs) {
+    QElapsedTimer timer;
+    timer.start();
+
+    // Every thread claims the next unchecked blueprint, results go to their fixed slot
+    m_results.assign(static_cast<std::size_t>(names.size()), Result());
+    std::atomic<qsizetype> next(0);
+    auto const worker = [&]() {
+        for (qsizetype i = next++; i < names.size(); i = next++) {
+            Stats::Span const span("lint");
+            m_results.at(static_cast<std::size_t>(i)) = check(names.at(i));
+        }
+    };
+
+    qsizetype const threadCount = std::max<qsizetype>(1, std::min<qsizetype>(jobs, names.size()));
+    std::vector<std::thread> threads;
+    threads.reserve(static_cast<std::size_t>(threadCount - 1));
+    for (qsizetype i = 1; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    m_elapsed = timer.elapsed();
+}
+
+BlueprintLint::Result BlueprintLint::check(QString const& name) const {
+    Result result{ name, false, QString(), QString(), QString(), -1, 0 };
+
+    // Oversized blueprints are turned down before they are read
+    ParseBudget budget(m_limits);
+    auto const tooLarge = [&](qint64 size) {
+        if (budget.checkBytes(size)) {
+            return false;
+        }
+        result.check = QStringLiteral("limits");
+        result.problem = budget.getError();
+        return true;
+    };
+
+    QDir const location(m_blueprintLocation);
+    QByteArray data;
+    if (ZipArchive::isArchive(location.absoluteFilePath(name))) {
+        // Runs on the lint threads, so the reason goes into the result instead of std::cerr
+        std::ostringstream archiveError;
+        auto const archive = ZipArchive::open(location.absoluteFilePath(name), archiveError);
+        auto const entry = (archive) ? archive->find(QStringLiteral("bp.sbc")) : nullptr;
+        if ((entry != nullptr) && tooLarge(entry->size)) {
+            return result;
+        }
+        auto contents = (entry != nullptr) ? archive->read(*entry, archiveError) : std::nullopt;
+        if (!contents) {
+            result.check = QStringLiteral("read");
+            result.problem = QStringLiteral("Could not read bp.sbc from the archive. %1").arg(QString::fromStdString(archiveError.str())).trimmed();
+            return result;
+        }
+        data = std::move(*contents);
+    } else {
+        QFile file(QDir(location.absoluteFilePath(name)).absoluteFilePath(QStringLiteral("bp.sbc")));
+        if (!file.open(QFile::ReadOnly)) {
+            result.check = QStringLiteral("read");
+            result.problem = QStringLiteral("Could not open bp.sbc for reading.");
+            return result;
+        } else if (tooLarge(file.size())) {
+            return result;
+        }
+        data = file.readAll();
+    }
+    Stats::addBytesRead(data.size());
+
+    std::ostringstream scanError;
+    auto const fields = BlueprintScanner::scan(data, budget, scanError);
+    if (!fields && budget.isExceeded()) {
+        result.check = QStringLiteral("limits");
+        result.problem = budget.getError();
+        return result;
+    } else if (!fields) {
+        // Like everywhere else, what the scanner can not handle is read by the XML parser, which also checks that the
+        // document is well-formed
+        Options options;
+        options.parseLimits = m_limits;
+        std::ostringstream xmlError;
+        auto const blueprintData = BlueprintData::fromXml(data, options, xmlError);
+        if (!blueprintData) {
+            result.check = QStringLiteral("xml");
+            result.problem = QStringLiteral("Neither the fast scanner nor the XML parser could read this blueprint. %1").arg(QString::fromStdString(xmlError.str())).trimmed();
+            return result;
+        }
+        return valid(result, *blueprintData);
+    }
+    BlueprintData::Problem problem;
+    auto const blueprintData = BlueprintData::lint(data, *fields, problem);
+    if (!blueprintData) {
+        result.check = problem.check;
+        result.problem = problem.message;
+        return result;
+    }
+
+    // The scanner does not check everything a well-formed document needs, the game's parser would
+    QXmlStreamReader reader(data);
+    while (!reader.atEnd()) {
+        reader.readNext();
+    }
+    if (reader.hasError()) {
+        result.check = QStringLiteral("xml");
+        result.problem = QStringLiteral("The blueprint is not well-formed XML, line %1: %2").arg(reader.lineNumber()).arg(reader.errorString());
+        return result;
+    }
+    return valid(result, *blueprintData);
+}
+
+BlueprintLint::Result BlueprintLint::valid(Result result, BlueprintData const& blueprintData) {
+
+    result.valid = true;
+    result.displayName = blueprintData.getDisplayName();
+    result.missileNumber = blueprintData.getId();
+    result.blockCount = blueprintData.getItemCount();
+    return result;
+}
+
+QString BlueprintLint::toText() const {
+    qsizetype const problemCount = getProblemCount();
+    std::ostringstream out;
+    out << "Lint: Checked " << m_results.size() << " blueprint" << ((m_results.size() == 1) ? "" : "s") << " in " << m_elapsed << " ms, " << problemCount << " with problems." << std::endl;
+    for (auto const& entry : m_results) {
+        if (!entry.valid) {
+            out << "  " << entry.name.toStdString() << ": [" << entry.check.toStdString() << "] " << entry.problem.toStdString() << std::endl;
+        }
+    }
+    return QString::fromStdString(out.str());
+}
+
+QByteArray BlueprintLint::toJson() const {
+    QJsonArray blueprints;
+    for (auto const& entry : m_results) {
+        QJsonObject object;
+        object.insert(QStringLiteral("name"), entry.name);
+        object.insert(QStringLiteral("valid"), entry.valid);
+        if (entry.valid) {
+            object.insert(QStringLiteral("displayName"), entry.displayName);
+            object.insert(QStringLiteral("missileNumber"), entry.missileNumber);
+            object.insert(QStringLiteral("blockCount"), static_cast<double>(entry.blockCount));
+        } else {
+            object.insert(QStringLiteral("check"), entry.check);
+            object.insert(QStringLiteral("problem"), entry.problem);
+        }
+        blueprints.append(object);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("checked"), static_cast<double>(m_results.size()));
+    root.insert(QStringLiteral("problems"), static_cast<double>(getProblemCount()));
+    root.insert(QStringLiteral("wallMs"), static_cast<double>(m_elapsed));
+    root.insert(QStringLiteral("blueprints"), blueprints);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,57 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_BLUEPRINTLINT_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_BLUEPRINTLINT_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <vector>
+
+#include "ParseLimits.h"
+
+class BlueprintData;
+
+/*
+	Runs the consistency checks of BlueprintData on every blueprint of a folder, used by --lint.
+	Blueprints are read, scanned and checked on a pool of threads, each stops at its first problem and nothing is
+	printed meanwhile. The results are in the order of the names, so reports are reproducible. A blueprint over the
+	parse limits fails the check "limits" without being read any further. What the fast scanner can not handle is
+	read by the XML parser instead, and a blueprint is only valid once it is known to be well-formed XML, otherwise
+	it fails the check "xml".
+*/
+class BlueprintLint {
+public:
+	struct Result {
+		QString name;
+		bool valid;
+		// Identifier of the failed check and its message, empty if valid
+		QString check;
+		QString problem;
+		// Only set if valid
+		QString displayName;
+		int missileNumber;
+		qsizetype blockCount;
+	};
+
+	BlueprintLint(QString const& blueprintLocation, ParseLimits const& limits);
+
+	// Checks the blueprint folders or archives with the given names
+	void run(QStringList const& names, qsizetype jobs);
+
+	std::vector<Result> const& getResults() const;
+	qsizetype getProblemCount() const;
+
+	// Only the blueprints with a problem are listed in the text, all of them in JSON
+	QString toText() const;
+	QByteArray toJson() const;
+private:
+	QString const m_blueprintLocation;
+	ParseLimits const m_limits;
+	std::vector<Result> m_results;
+	qint64 m_elapsed;
+
+	Result check(QString const& name) const;
+	static Result valid(Result result, BlueprintData const& blueprintData);
+};
+
+#endif
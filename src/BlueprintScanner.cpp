@@ -0,0 +1,427 @@
+#include "BlueprintScanner.h"
+
+#include <cstring>
+#include <optional>
+#include <ostream>
+#include <string>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <immintrin.h>
+#define BLUEPRINTSCANNER_HAVE_SSE2
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+// Compiled for AVX2 regardless of the target flags, only called if the CPU has it
+#define BLUEPRINTSCANNER_HAVE_AVX2_DISPATCH
+#elif defined(__AVX2__)
+#define BLUEPRINTSCANNER_HAVE_AVX2
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace {
+    std::size_t findScalar(char const* data, std::size_t size, char c) {
+        void const* const hit = std::memchr(data, c, size);
+        return (hit == nullptr) ? size : static_cast<std::size_t>(static_cast<char const*>(hit) - data);
+    }
+
+#ifdef BLUEPRINTSCANNER_HAVE_SSE2
+    inline unsigned countTrailingZeros(unsigned mask) {
+#ifdef _MSC_VER
+        unsigned long index = 0;
+        _BitScanForward(&index, mask);
+        return static_cast<unsigned>(index);
+#else
+        return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+    }
+
+    std::size_t findSse2(char const* data, std::size_t size, char c) {
+        __m128i const needle = _mm_set1_epi8(c);
+        std::size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+            unsigned const mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+            if (mask != 0) {
+                return i + countTrailingZeros(mask);
+            }
+        }
+        return i + findScalar(data + i, size - i, c);
+    }
+#endif
+
+#if defined(BLUEPRINTSCANNER_HAVE_AVX2_DISPATCH) || defined(BLUEPRINTSCANNER_HAVE_AVX2)
+#ifdef BLUEPRINTSCANNER_HAVE_AVX2_DISPATCH
+    __attribute__((target("avx2")))
+#endif
+    std::size_t findAvx2(char const* data, std::size_t size, char c) {
+        __m256i const needle = _mm256_set1_epi8(c);
+        std::size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i const chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + i));
+            unsigned const mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+            if (mask != 0) {
+                return i + countTrailingZeros(mask);
+            }
+        }
+        return i + findSse2(data + i, size - i, c);
+    }
+#endif
+
+    using FindFunction = std::size_t(*)(char const* data, std::size_t size, char c);
+
+    FindFunction selectFind() {
+#if defined(BLUEPRINTSCANNER_HAVE_AVX2_DISPATCH)
+        __builtin_cpu_init();
+        return (__builtin_cpu_supports("avx2")) ? &findAvx2 : &findSse2;
+#elif defined(BLUEPRINTSCANNER_HAVE_AVX2)
+        return &findAvx2;
+#elif defined(BLUEPRINTSCANNER_HAVE_SSE2)
+        return &findSse2;
+#else
+        return &findScalar;
+#endif
+    }
+
+    FindFunction const findFunction = selectFind();
+
+    bool isXmlSpace(char c) {
+        return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n');
+    }
+
+    bool isNameChar(char c) {
+        return !isXmlSpace(c) && (c != '/') && (c != '>') && (c != '=');
+    }
+
+    // The character an entity or character reference stands for, given without '&' and ';'. Nothing for what
+    // QXmlStreamReader rejects, as there is no DTD to define more entities.
+    std::optional<char32_t> resolveEntity(std::string_view entity) {
+        if (entity == "lt") {
+            return U'<';
+        } else if (entity == "gt") {
+            return U'>';
+        } else if (entity == "amp") {
+            return U'&';
+        } else if (entity == "quot") {
+            return U'"';
+        } else if (entity == "apos") {
+            return U'\'';
+        } else if ((entity.size() < 2) || (entity[0] != '#')) {
+            return std::nullopt;
+        }
+
+        bool const hex = (entity[1] == 'x');
+        std::string_view const digits = entity.substr((hex) ? 2 : 1);
+        if (digits.empty() || (digits.size() > 8)) {
+            return std::nullopt;
+        }
+        char32_t codePoint = 0;
+        for (char const d : digits) {
+            if ((d >= '0') && (d <= '9')) {
+                codePoint = codePoint * ((hex) ? 16 : 10) + static_cast<char32_t>(d - '0');
+            } else if (hex && (d >= 'a') && (d <= 'f')) {
+                codePoint = codePoint * 16 + static_cast<char32_t>(d - 'a' + 10);
+            } else if (hex && (d >= 'A') && (d <= 'F')) {
+                codePoint = codePoint * 16 + static_cast<char32_t>(d - 'A' + 10);
+            } else {
+                return std::nullopt;
+            }
+        }
+        if ((codePoint == 0) || (codePoint > 0x10FFFF) || ((codePoint >= 0xD800) && (codePoint <= 0xDFFF))) {
+            return std::nullopt;
+        }
+        return codePoint;
+    }
+
+    // Position of the first entity in [begin, end) that does not resolve, or npos
+    std::size_t findBadEntity(std::string_view doc, std::size_t begin, std::size_t end) {
+        std::size_t pos = begin;
+        while (pos < end) {
+            std::size_t const amp = pos + findFunction(doc.data() + pos, end - pos, '&');
+            if (amp >= end) {
+                break;
+            }
+            std::size_t const semicolon = doc.find(';', amp + 1);
+            if ((semicolon >= end) || !resolveEntity(doc.substr(amp + 1, semicolon - amp - 1))) {
+                return amp;
+            }
+            pos = semicolon + 1;
+        }
+        return std::string_view::npos;
+    }
+}
+
+std::string_view BlueprintScanner::localName(std::string_view name) {
+    auto const colon = name.find(':');
+    if (colon == std::string_view::npos) {
+        return name;
+    }
+    return name.substr(colon + 1);
+}
+
+std::size_t BlueprintScanner::find(std::string_view doc, std::size_t pos, char c) {
+    if (pos >= doc.size()) {
+        return std::string_view::npos;
+    }
+    std::size_t const offset = findFunction(doc.data() + pos, doc.size() - pos, c);
+    return (offset == doc.size() - pos) ? std::string_view::npos : (pos + offset);
+}
+
+std::optional<std::vector<BlueprintScanner::Field>> BlueprintScanner::scan(QByteArray const& data, std::ostream& error) {
+    ParseBudget budget(ParseLimits::defaults());
+    return scan(data, budget, error);
+}
+
+std::optional<std::vector<BlueprintScanner::Field>> BlueprintScanner::scan(QByteArray const& data, ParseBudget& budget, std::ostream& error) {
+    std::string_view const doc(data.constData(), static_cast<std::size_t>(data.size()));
+    constexpr auto npos = std::string_view::npos;
+    if (!budget.checkBytes(data.size())) {
+        error << "Scanner: " << budget.getError().toStdString() << std::endl;
+        return std::nullopt;
+    }
+
+    std::vector<std::string_view> stack;
+    std::vector<Field> fields;
+    qsizetype blockCount = 0;
+
+    // The element whose text we are currently collecting, if any
+    bool capturing = false;
+    FieldType captureType = FieldType::GridDisplayName;
+    std::size_t captureBegin = 0;
+    std::size_t captureDepth = 0;
+
+    // Like QXmlStreamReader, the document has exactly one root element and no text outside of it
+    bool haveRoot = false;
+
+    // A byte order mark is not text
+    std::size_t pos = (doc.compare(0, 3, "\xEF\xBB\xBF") == 0) ? 3 : 0;
+    while (pos < doc.size()) {
+        std::size_t const lt = find(doc, pos, '<');
+        std::size_t const textEnd = (lt == npos) ? doc.size() : lt;
+        if (textEnd > pos) {
+            std::size_t const badEntity = findBadEntity(doc, pos, textEnd);
+            if (badEntity != npos) { error << "Scanner: Undefined entity at byte " << badEntity << "!" << std::endl; return std::nullopt; }
+            if (stack.empty()) {
+                for (std::size_t j = pos; j < textEnd; ++j) {
+                    if (!isXmlSpace(doc[j])) { error << "Scanner: Text outside of the root element at byte " << j << "!" << std::endl; return std::nullopt; }
+                }
+            }
+        }
+        if ((textEnd > pos) && !capturing) {
+            if (doc.substr(pos, textEnd - pos).find("Missile number=") != npos) {
+                if (!budget.checkCustomData(static_cast<qsizetype>(textEnd - pos), static_cast<qint64>(pos))) {
+                    error << "Scanner: " << budget.getError().toStdString() << std::endl;
+                    return std::nullopt;
+                }
+                fields.push_back({ FieldType::CustomData, static_cast<qsizetype>(pos), static_cast<qsizetype>(textEnd) });
+            }
+        }
+        if (lt == npos) {
+            break;
+        } else if (!budget.checkTime(static_cast<qint64>(lt))) {
+            error << "Scanner: " << budget.getError().toStdString() << std::endl;
+            return std::nullopt;
+        }
+
+        if (doc.compare(lt, 4, "<!--") == 0) {
+            std::size_t const end = doc.find("-->", lt + 4);
+            if ((end == npos) || capturing) { error << "Scanner: Unterminated or misplaced comment at byte " << lt << "!" << std::endl; return std::nullopt; }
+            pos = end + 3;
+            continue;
+        } else if (doc.compare(lt, 9, "<![CDATA[") == 0) {
+            std::size_t const end = doc.find("]]>", lt + 9);
+            if ((end == npos) || capturing) { error << "Scanner: Unterminated or misplaced CDATA section at byte " << lt << "!" << std::endl; return std::nullopt; }
+            if (doc.substr(lt + 9, end - lt - 9).find("Missile number=") != npos) { error << "Scanner: WHAM custom data inside a CDATA section is not supported!" << std::endl; return std::nullopt; }
+            pos = end + 3;
+            continue;
+        } else if (doc.compare(lt, 2, "<?") == 0) {
+            std::size_t const end = doc.find("?>", lt + 2);
+            if (end == npos) { error << "Scanner: Unterminated processing instruction at byte " << lt << "!" << std::endl; return std::nullopt; }
+            pos = end + 2;
+            continue;
+        } else if (doc.compare(lt, 2, "<!") == 0) {
+            std::size_t const end = find(doc, lt + 2, '>');
+            if ((end == npos) || (doc.substr(lt, end - lt).find('[') != npos)) { error << "Scanner: Unsupported declaration at byte " << lt << "!" << std::endl; return std::nullopt; }
+            pos = end + 1;
+            continue;
+        } else if (doc.compare(lt, 2, "</") == 0) {
+            std::size_t const end = find(doc, lt + 2, '>');
+            if (end == npos) { error << "Scanner: Unterminated end tag at byte " << lt << "!" << std::endl; return std::nullopt; }
+            std::size_t nameEnd = lt + 2;
+            while ((nameEnd < end) && isNameChar(doc[nameEnd])) {
+                ++nameEnd;
+            }
+            std::string_view const name = doc.substr(lt + 2, nameEnd - lt - 2);
+            if (stack.empty() || (stack.back() != name)) { error << "Scanner: Mismatched end tag at byte " << lt << "!" << std::endl; return std::nullopt; }
+
+            if (capturing && (stack.size() == captureDepth)) {
+                if ((captureType == FieldType::BlockCustomName) && !budget.checkBlocks(++blockCount, static_cast<qint64>(captureBegin))) {
+                    error << "Scanner: " << budget.getError().toStdString() << std::endl;
+                    return std::nullopt;
+                }
+                fields.push_back({ captureType, static_cast<qsizetype>(captureBegin), static_cast<qsizetype>(lt) });
+                capturing = false;
+            }
+            stack.pop_back();
+            pos = end + 1;
+            continue;
+        }
+
+        // Start tag
+        if (capturing) { error << "Scanner: Unexpected child element in a text field at byte " << lt << "!" << std::endl; return std::nullopt; }
+
+        std::size_t i = lt + 1;
+        while ((i < doc.size()) && isNameChar(doc[i])) {
+            ++i;
+        }
+        std::string_view const name = doc.substr(lt + 1, i - lt - 1);
+        if (name.empty()) { error << "Scanner: Empty element name at byte " << lt << "!" << std::endl; return std::nullopt; }
+        if (stack.empty() && haveRoot) { error << "Scanner: Second root element at byte " << lt << "!" << std::endl; return std::nullopt; }
+        haveRoot = true;
+
+        std::string_view const local = localName(name);
+        std::string_view const parent = stack.empty() ? std::string_view() : localName(stack.back());
+        bool const isBlueprintId = (parent == "ShipBlueprint") && (local == "Id");
+
+        bool selfClosing = false;
+        while (true) {
+            while ((i < doc.size()) && isXmlSpace(doc[i])) {
+                ++i;
+            }
+            if (i >= doc.size()) { error << "Scanner: Unterminated start tag at byte " << lt << "!" << std::endl; return std::nullopt; }
+            if (doc[i] == '>') {
+                ++i;
+                break;
+            } else if (doc.compare(i, 2, "/>") == 0) {
+                selfClosing = true;
+                i += 2;
+                break;
+            }
+
+            std::size_t const attrBegin = i;
+            while ((i < doc.size()) && isNameChar(doc[i])) {
+                ++i;
+            }
+            std::string_view const attrName = doc.substr(attrBegin, i - attrBegin);
+            while ((i < doc.size()) && isXmlSpace(doc[i])) {
+                ++i;
+            }
+            if (attrName.empty() || (i >= doc.size()) || (doc[i] != '=')) { error << "Scanner: Malformed attribute at byte " << attrBegin << "!" << std::endl; return std::nullopt; }
+            ++i;
+            while ((i < doc.size()) && isXmlSpace(doc[i])) {
+                ++i;
+            }
+            if ((i >= doc.size()) || ((doc[i] != '"') && (doc[i] != '\''))) { error << "Scanner: Unquoted attribute value at byte " << i << "!" << std::endl; return std::nullopt; }
+            std::size_t const valueEnd = find(doc, i + 1, doc[i]);
+            if (valueEnd == npos) { error << "Scanner: Unterminated attribute value at byte " << i << "!" << std::endl; return std::nullopt; }
+            if (doc.substr(i + 1, valueEnd - i - 1).find('<') != npos) { error << "Scanner: '<' in the attribute value at byte " << i << "!" << std::endl; return std::nullopt; }
+            std::size_t const badEntity = findBadEntity(doc, i + 1, valueEnd);
+            if (badEntity != npos) { error << "Scanner: Undefined entity at byte " << badEntity << "!" << std::endl; return std::nullopt; }
+
+            if (isBlueprintId && (localName(attrName) == "Subtype")) {
+                fields.push_back({ FieldType::IdSubtype, static_cast<qsizetype>(i + 1), static_cast<qsizetype>(valueEnd) });
+            }
+            i = valueEnd + 1;
+        }
+
+        bool isTextField = true;
+        FieldType textType = FieldType::GridDisplayName;
+        if ((parent == "CubeGrid") && (local == "DisplayName")) {
+            textType = FieldType::GridDisplayName;
+        } else if ((parent == "MyObjectBuilder_BlockGroup") && (local == "Name")) {
+            textType = FieldType::GroupName;
+        } else if ((parent == "MyObjectBuilder_CubeBlock") && (local == "CustomName")) {
+            textType = FieldType::BlockCustomName;
+        } else {
+            isTextField = false;
+        }
+
+        if (!selfClosing) {
+            stack.push_back(name);
+            if (!budget.checkDepth(static_cast<qsizetype>(stack.size()), static_cast<qint64>(lt))) {
+                error << "Scanner: " << budget.getError().toStdString() << std::endl;
+                return std::nullopt;
+            }
+            if (isTextField) {
+                capturing = true;
+                captureType = textType;
+                captureBegin = i;
+                captureDepth = stack.size();
+            }
+        } else if (isTextField) {
+            error << "Scanner: Empty text field at byte " << lt << "!" << std::endl;
+            return std::nullopt;
+        }
+        pos = i;
+    }
+
+    if (!stack.empty()) {
+        error << "Scanner: Document ended with " << stack.size() << " open element(s)!" << std::endl;
+        return std::nullopt;
+    } else if (!haveRoot) {
+        error << "Scanner: Document has no root element!" << std::endl;
+        return std::nullopt;
+    }
+
+    return fields;
+}
+
+std::optional<QString> BlueprintScanner::decode(QByteArray const& data, Field const& field, std::ostream& error) {
+    std::string_view const raw(data.constData() + field.begin, static_cast<std::size_t>(field.end - field.begin));
+    constexpr auto npos = std::string_view::npos;
+    bool const attribute = (field.type == FieldType::IdSubtype);
+
+    // The common case, nothing to decode
+    if (raw.find_first_of((attribute) ? "&\r\n\t" : "&\r") == npos) {
+        return QString::fromUtf8(raw.data(), static_cast<qsizetype>(raw.size()));
+    }
+
+    std::string result;
+    result.reserve(raw.size());
+    for (std::size_t i = 0; i < raw.size(); ++i) {
+        char const c = raw[i];
+        if (c == '\r') {
+            // Line ends are normalized to \n, attribute values then turn literal whitespace into spaces
+            if ((i + 1 < raw.size()) && (raw[i + 1] == '\n')) {
+                ++i;
+            }
+            result.push_back((attribute) ? ' ' : '\n');
+        } else if (attribute && ((c == '\n') || (c == '\t'))) {
+            result.push_back(' ');
+        } else if (c == '&') {
+            std::size_t const semicolon = raw.find(';', i + 1);
+            if (semicolon == npos) { error << "Scanner: Unterminated entity reference at byte " << (field.begin + i) << "!" << std::endl; return std::nullopt; }
+            std::string_view const entity = raw.substr(i + 1, semicolon - i - 1);
+            auto const resolved = resolveEntity(entity);
+            if (!resolved && (entity.substr(0, 1) == "#")) {
+                error << "Scanner: Invalid character reference at byte " << (field.begin + i) << "!" << std::endl;
+                return std::nullopt;
+            } else if (!resolved) {
+                error << "Scanner: Unknown entity '&" << entity << ";' at byte " << (field.begin + i) << "!" << std::endl;
+                return std::nullopt;
+            }
+
+            char32_t const codePoint = *resolved;
+            if (codePoint < 0x80) {
+                result.push_back(static_cast<char>(codePoint));
+            } else if (codePoint < 0x800) {
+                result.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+                result.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            } else if (codePoint < 0x10000) {
+                result.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+                result.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                result.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            } else {
+                result.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+                result.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+                result.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+                result.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+            }
+            i = semicolon;
+        } else {
+            result.push_back(c);
+        }
+    }
+    return QString::fromUtf8(result.data(), static_cast<qsizetype>(result.size()));
+}
@@ -0,0 +1,52 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_BLUEPRINTSCANNER_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_BLUEPRINTSCANNER_H_
+
+#include <QByteArray>
+#include <QString>
+
+#include <iosfwd>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include "ParseLimits.h"
+
+/*
+	A minimal, byte-oriented walker over a bp.sbc document, the parser every blueprint is read with first.
+	It reports the raw byte ranges of the handful of locations the duplicator has to rewrite. Like QXmlStreamReader,
+	it rejects unbalanced tags, anything but one root element and undefined entities in any text or attribute value,
+	but it is not a validating parser: names, duplicate attributes and the encoding are not checked. Documents it can
+	not handle (CDATA or comments in a field, DTDs with an internal subset) are left to QXmlStreamReader,
+	--verifyParse runs both on every blueprint.
+	The scan jumps from one '<' to the next using SSE2 or AVX2 where the CPU supports it.
+*/
+class BlueprintScanner {
+public:
+	enum class FieldType {
+		IdSubtype,       // Value of the Subtype attribute on ShipBlueprint/Id
+		GridDisplayName, // Text of CubeGrid/DisplayName
+		GroupName,       // Text of MyObjectBuilder_BlockGroup/Name
+		BlockCustomName, // Text of MyObjectBuilder_CubeBlock/CustomName
+		CustomData       // Any text node containing the WHAM "Missile number=" key
+	};
+
+	struct Field {
+		FieldType type;
+		qsizetype begin;
+		qsizetype end;
+	};
+
+	// Within ParseLimits::defaults(), reports why the document could not be scanned to error
+	static std::optional<std::vector<Field>> scan(QByteArray const& data, std::ostream& error);
+	// Stops as soon as the budget is exceeded, budget.isExceeded() then tells this apart from a document the scanner
+	// can not handle
+	static std::optional<std::vector<Field>> scan(QByteArray const& data, ParseBudget& budget, std::ostream& error);
+	// Decodes a raw field the way QXmlStreamReader reports it: entities, character references and line ends
+	static std::optional<QString> decode(QByteArray const& data, Field const& field, std::ostream& error);
+private:
+	static std::string_view localName(std::string_view name);
+	// Position of the first c at or after pos, or npos
+	static std::size_t find(std::string_view doc, std::size_t pos, char c);
+};
+
+#endif
@@ -0,0 +1,192 @@
+#include "CopyManifest.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+
+#include <ostream>
+
+QString const CopyManifest::fileName = QStringLiteral(".blueprintDuplicatorCopies.json");
+
+namespace {
+    int const manifestVersion = 2;
+
+    void addFile(QCryptographicHash& hash, QString const& fileName) {
+        QFile file(fileName);
+        if (file.open(QFile::ReadOnly)) {
+            hash.addData(&file);
+        } else {
+            // A missing file has to hash differently from an empty one
+            hash.addData(QByteArray("<missing>"));
+        }
+    }
+}
+
+CopyManifest::CopyManifest(QString const& blueprintLocation, bool archive) : m_blueprintLocation(blueprintLocation), m_archive(archive) {
+	//
+}
+
+bool CopyManifest::load(std::ostream& error) {
+    m_entries.clear();
+
+    QFile file(QDir(m_blueprintLocation).absoluteFilePath(fileName));
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+    QJsonDocument const document = QJsonDocument::fromJson(file.readAll());
+    if (!document.isObject() || (document.object().value(QStringLiteral("version")).toInt() != manifestVersion)) {
+        error << "Warning: Ignoring the copy manifest, it is damaged or from another version. All copies will be written." << std::endl;
+        return false;
+    }
+
+    QJsonArray const entries = document.object().value(QStringLiteral("copies")).toArray();
+    for (auto const& value : entries) {
+        QJsonObject const object = value.toObject();
+        Entry entry;
+        entry.sourceHash = object.value(QStringLiteral("sourceHash")).toString().toLatin1();
+        entry.newId = static_cast<qsizetype>(object.value(QStringLiteral("id")).toDouble());
+        entry.copyHash = object.value(QStringLiteral("copyHash")).toString().toLatin1();
+        for (auto const& fileValue : object.value(QStringLiteral("files")).toArray()) {
+            QJsonObject const fileObject = fileValue.toObject();
+            entry.files.push_back({ fileObject.value(QStringLiteral("name")).toString(), static_cast<qint64>(fileObject.value(QStringLiteral("modified")).toDouble()), static_cast<qint64>(fileObject.value(QStringLiteral("size")).toDouble()) });
+        }
+        m_entries[object.value(QStringLiteral("name")).toString()] = entry;
+    }
+    return true;
+}
+
+bool CopyManifest::save(std::ostream& error) const {
+    QJsonArray entries;
+    for (auto const& entry : m_entries) {
+        QJsonObject object;
+        object.insert(QStringLiteral("name"), entry.first);
+        object.insert(QStringLiteral("sourceHash"), QString::fromLatin1(entry.second.sourceHash));
+        object.insert(QStringLiteral("id"), static_cast<double>(entry.second.newId));
+        object.insert(QStringLiteral("copyHash"), QString::fromLatin1(entry.second.copyHash));
+        QJsonArray files;
+        for (auto const& file : entry.second.files) {
+            QJsonObject fileObject;
+            fileObject.insert(QStringLiteral("name"), file.name);
+            fileObject.insert(QStringLiteral("modified"), static_cast<double>(file.modified));
+            fileObject.insert(QStringLiteral("size"), static_cast<double>(file.size));
+            files.append(fileObject);
+        }
+        object.insert(QStringLiteral("files"), files);
+        entries.append(object);
+    }
+    QJsonObject root;
+    root.insert(QStringLiteral("version"), manifestVersion);
+    root.insert(QStringLiteral("copies"), entries);
+
+    QSaveFile file(QDir(m_blueprintLocation).absoluteFilePath(fileName));
+    if (!file.open(QFile::WriteOnly)) {
+        error << "Warning: Could not write the copy manifest." << std::endl;
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+std::vector<CopyManifest::File> CopyManifest::stampFiles(QString const& copyName) const {
+    std::vector<File> result;
+    if (m_archive) {
+        QFileInfo const info(QDir(m_blueprintLocation).absoluteFilePath(QString(copyName).append(QStringLiteral(".sbb"))));
+        if (info.isFile()) {
+            result.push_back({ info.fileName(), info.lastModified().toMSecsSinceEpoch(), info.size() });
+        }
+        return result;
+    }
+
+    // A file added or removed since, e.g. a deleted bp.sbcB5, changes the list just like a changed one
+    QDir const copyDir(QDir(m_blueprintLocation).absoluteFilePath(copyName));
+    for (auto const& info : copyDir.entryInfoList(QDir::Files | QDir::Hidden, QDir::Name)) {
+        result.push_back({ info.fileName(), info.lastModified().toMSecsSinceEpoch(), info.size() });
+    }
+    return result;
+}
+
+bool CopyManifest::isIntact(QString const& copyName, Entry const& entry) const {
+    std::vector<File> const files = stampFiles(copyName);
+    if (files.empty() || (files.size() != entry.files.size())) {
+        return false;
+    }
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        File const& file = files.at(i);
+        File const& recorded = entry.files.at(i);
+        if ((file.name != recorded.name) || (file.modified != recorded.modified) || (file.size != recorded.size)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CopyManifest::isUpToDate(QString const& copyName, QByteArray const& sourceHash, qsizetype newId) const {
+    auto const it = m_entries.find(copyName);
+    return (it != m_entries.cend()) && (it->second.sourceHash == sourceHash) && (it->second.newId == newId) && isIntact(copyName, it->second);
+}
+
+bool CopyManifest::hasContents(QString const& copyName, QByteArray const& copyHash) const {
+    auto const it = m_entries.find(copyName);
+    return !copyHash.isEmpty() && (it != m_entries.cend()) && (it->second.copyHash == copyHash) && isIntact(copyName, it->second);
+}
+
+void CopyManifest::record(QString const& copyName, QByteArray const& sourceHash, qsizetype newId, QByteArray const& copyHash) {
+    Entry entry;
+    entry.sourceHash = sourceHash;
+    entry.newId = newId;
+    entry.copyHash = copyHash;
+    entry.files = stampFiles(copyName);
+    m_entries[copyName] = entry;
+}
+
+QByteArray CopyManifest::hashSource(QDir const& blueprintFolder, QStringList const& sidecarNames, bool includeBinary, QByteArray const& mode) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(mode);
+    addFile(hash, blueprintFolder.absoluteFilePath(QStringLiteral("bp.sbc")));
+    hash.addData(hashSidecars(blueprintFolder, sidecarNames));
+    if (includeBinary) {
+        addFile(hash, blueprintFolder.absoluteFilePath(QStringLiteral("bp.sbcB5")));
+    }
+    return hash.result().toHex();
+}
+
+QByteArray CopyManifest::hashSidecars(QDir const& blueprintFolder, QStringList const& sidecarNames) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (auto const& name : sidecarNames) {
+        hash.addData(name.toUtf8());
+        addFile(hash, blueprintFolder.absoluteFilePath(name));
+    }
+    return hash.result().toHex();
+}
+
+QByteArray CopyManifest::hashArchive(QString const& archivePath, QByteArray const& mode) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(mode);
+    addFile(hash, archivePath);
+    return hash.result().toHex();
+}
+
+QByteArray CopyManifest::hashCopy(QByteArray const& copyData, QByteArray const& binaryCopy, QByteArray const& sidecarHash) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(copyData);
+    hash.addData(QByteArray::number(binaryCopy.size()));
+    hash.addData(binaryCopy);
+    hash.addData(sidecarHash);
+    return hash.result().toHex();
+}
+
+QByteArray CopyManifest::hashCopy(std::vector<PatchTemplate::Slice> const& slices, QByteArray const& binaryCopy, QByteArray const& sidecarHash) {
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    for (auto const& slice : slices) {
+        hash.addData(QByteArray::fromRawData(slice.data, slice.size));
+    }
+    hash.addData(QByteArray::number(binaryCopy.size()));
+    hash.addData(binaryCopy);
+    hash.addData(sidecarHash);
+    return hash.result().toHex();
+}
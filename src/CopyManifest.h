@@ -0,0 +1,68 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_COPYMANIFEST_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_COPYMANIFEST_H_
+
+#include <QByteArray>
+#include <QDir>
+#include <QString>
+#include <QStringList>
+
+#include <iosfwd>
+#include <map>
+#include <vector>
+
+#include "PatchTemplate.h"
+
+/*
+	Record of the copies written by earlier runs, used by --incremental.
+	For every copy it stores the hash of the source it was generated from, its id and the hash of its contents,
+	together with the size and mtime of every file in its folder (bp.sbc, bp.sbcB5 and the sidecars), so copies
+	changed by anyone else are never skipped. With --archive, the copy is the single file <copy>.sbb instead.
+*/
+class CopyManifest {
+public:
+	struct File {
+		QString name;
+		qint64 modified;
+		qint64 size;
+	};
+
+	struct Entry {
+		QByteArray sourceHash;
+		qsizetype newId;
+		QByteArray copyHash;
+		// Sorted by name
+		std::vector<File> files;
+	};
+
+	CopyManifest(QString const& blueprintLocation, bool archive);
+
+	// A damaged manifest or one that could not be written is reported to error as a warning
+	bool load(std::ostream& error);
+	bool save(std::ostream& error) const;
+
+	// Whether the copy on disk was generated from this source with this id and is untouched since
+	bool isUpToDate(QString const& copyName, QByteArray const& sourceHash, qsizetype newId) const;
+	// Whether the copy on disk already has exactly these contents
+	bool hasContents(QString const& copyName, QByteArray const& copyHash) const;
+	void record(QString const& copyName, QByteArray const& sourceHash, qsizetype newId, QByteArray const& copyHash);
+
+	// Covers bp.sbc, the sidecars and optionally bp.sbcB5 of the source, plus the way copies are generated
+	static QByteArray hashSource(QDir const& blueprintFolder, QStringList const& sidecarNames, bool includeBinary, QByteArray const& mode);
+	static QByteArray hashSidecars(QDir const& blueprintFolder, QStringList const& sidecarNames);
+	// For blueprints read from an archive, which holds bp.sbc, bp.sbcB5 and the sidecars together
+	static QByteArray hashArchive(QString const& archivePath, QByteArray const& mode);
+	static QByteArray hashCopy(QByteArray const& copyData, QByteArray const& binaryCopy, QByteArray const& sidecarHash);
+	static QByteArray hashCopy(std::vector<PatchTemplate::Slice> const& slices, QByteArray const& binaryCopy, QByteArray const& sidecarHash);
+
+	static QString const fileName;
+private:
+	QString const m_blueprintLocation;
+	bool const m_archive;
+	std::map<QString, Entry> m_entries;
+
+	bool isIntact(QString const& copyName, Entry const& entry) const;
+	// The files of the copy as they are on disk now
+	std::vector<File> stampFiles(QString const& copyName) const;
+};
+
+#endif
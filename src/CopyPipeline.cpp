@@ -0,0 +1,110 @@
+#include "CopyPipeline.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+CopyPipeline::CopyPipeline(qsizetype jobs, qsizetype queueCapacity) : m_jobs((jobs < 1) ? 1 : jobs), m_queueCapacity((queueCapacity < 1) ? 1 : queueCapacity) {
+	//
+}
+
+qsizetype CopyPipeline::getJobs() const {
+    return m_jobs;
+}
+
+bool CopyPipeline::run(qsizetype count, Generator const& generator, Writer const& writer) const {
+    return run(count, Filler([&](qsizetype index, QByteArray& data) {
+        data = generator(index);
+    }), writer);
+}
+
+bool CopyPipeline::run(qsizetype count, Filler const& filler, Writer const& writer) const {
+    if (m_jobs == 1) {
+        QByteArray data;
+        for (qsizetype i = 0; i < count; ++i) {
+            filler(i, data);
+            if (!writer(i, data)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    std::mutex mutex;
+    std::condition_variable producerCondition;
+    std::condition_variable writerCondition;
+    qsizetype nextToClaim = 0;
+    qsizetype nextToWrite = 0;
+    bool aborted = false;
+    std::map<qsizetype, QByteArray> ready;
+    // Buffers the writer is done with, never more than the copies in flight
+    std::vector<QByteArray> spare;
+
+    auto const worker = [&]() {
+        while (true) {
+            qsizetype index = 0;
+            QByteArray data;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                producerCondition.wait(lock, [&]() { return aborted || (nextToClaim >= count) || (nextToClaim < nextToWrite + m_queueCapacity); });
+                if (aborted || (nextToClaim >= count)) {
+                    return;
+                }
+                index = nextToClaim++;
+                if (!spare.empty()) {
+                    data = std::move(spare.back());
+                    spare.pop_back();
+                }
+            }
+
+            filler(index, data);
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.emplace(index, std::move(data));
+            }
+            writerCondition.notify_one();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    qsizetype const threadCount = (m_jobs < count) ? m_jobs : count;
+    threads.reserve(static_cast<std::size_t>(threadCount));
+    for (qsizetype i = 0; i < threadCount; ++i) {
+        threads.emplace_back(worker);
+    }
+
+    bool success = true;
+    for (qsizetype i = 0; i < count; ++i) {
+        QByteArray data;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            writerCondition.wait(lock, [&]() { return ready.count(i) > 0; });
+            auto const it = ready.find(i);
+            data = std::move(it->second);
+            ready.erase(it);
+            nextToWrite = i + 1;
+        }
+        producerCondition.notify_all();
+
+        if (!writer(i, data)) {
+            success = false;
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        spare.push_back(std::move(data));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        aborted = true;
+    }
+    producerCondition.notify_all();
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    return success;
+}
@@ -0,0 +1,33 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_COPYPIPELINE_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_COPYPIPELINE_H_
+
+#include <QByteArray>
+
+#include <functional>
+
+/*
+	Generates copies on a pool of worker threads and hands the finished buffers to a single writer stage.
+	The writer runs on the calling thread and sees the copies strictly in index order, so prompts and
+	file operations behave exactly like the serial loop. Workers never run more than queueCapacity
+	copies ahead of the writer, which keeps memory flat regardless of the number of copies. A Filler writes
+	into a buffer the writer stage handed back, so the copies reuse a few buffers instead of allocating.
+*/
+class CopyPipeline {
+public:
+	using Generator = std::function<QByteArray(qsizetype index)>;
+	using Filler = std::function<void(qsizetype index, QByteArray& data)>;
+	using Writer = std::function<bool(qsizetype index, QByteArray const& data)>;
+
+	CopyPipeline(qsizetype jobs, qsizetype queueCapacity);
+
+	// Produces the copies [0, count). Returns false as soon as the writer rejects a copy.
+	bool run(qsizetype count, Generator const& generator, Writer const& writer) const;
+	bool run(qsizetype count, Filler const& filler, Writer const& writer) const;
+
+	qsizetype getJobs() const;
+private:
+	qsizetype const m_jobs;
+	qsizetype const m_queueCapacity;
+};
+
+#endif
@@ -0,0 +1,105 @@
+#include "CopyPlan.h"
+
+#include <QDir>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <sstream>
+
+#include "Stats.h"
+
+namespace {
+    // Overwrites named in the summary before asking, the dry run lists all of them
+    qsizetype const maximumListed = 10;
+}
+
+CopyPlan::CopyPlan(QString const& blueprintLocation, bool archive) : m_blueprintLocation(blueprintLocation), m_archive(archive), m_listed(false) {
+	//
+}
+
+void CopyPlan::add(QString const& name, qsizetype newId, bool upToDate) {
+    if (upToDate) {
+        m_entries.push_back({ name, newId, Action::Skip });
+        return;
+    }
+
+    // The listing is only taken once a copy is added, so a plan of nothing but skipped copies does not list anything
+    if (!m_listed) {
+        Stats::Span const span("plan");
+        QDir const dir(m_blueprintLocation);
+        for (auto const& entry : dir.entryList(((m_archive) ? QDir::Files : QDir::Dirs) | QDir::NoDotAndDotDot)) {
+            m_existing.insert(entry);
+        }
+        m_listed = true;
+    }
+
+    bool exists = false;
+    if (m_archive) {
+        exists = (m_existing.count(QString(name).append(QStringLiteral(".sbb"))) > 0);
+    } else if (m_existing.count(name) > 0) {
+        // An existing folder without bp.sbc is just filled in
+        exists = QFile::exists(QDir(m_blueprintLocation).absoluteFilePath(QString(name).append(QStringLiteral("/bp.sbc"))));
+    }
+    m_entries.push_back({ name, newId, (exists) ? Action::Overwrite : Action::Create });
+}
+
+std::vector<CopyPlan::Entry> const& CopyPlan::getEntries() const {
+    return m_entries;
+}
+
+qsizetype CopyPlan::count(Action action) const {
+    qsizetype result = 0;
+    for (auto const& entry : m_entries) {
+        if (entry.action == action) {
+            ++result;
+        }
+    }
+    return result;
+}
+
+QString CopyPlan::toString(Action action) {
+    switch (action) {
+        case Action::Create: return QStringLiteral("create");
+        case Action::Overwrite: return QStringLiteral("overwrite");
+        case Action::Skip: return QStringLiteral("skip");
+    }
+    return QString();
+}
+
+QString CopyPlan::toText(bool allCopies) const {
+    qsizetype const overwriteCount = count(Action::Overwrite);
+    std::ostringstream out;
+    out << "Plan: " << m_entries.size() << " cop" << ((m_entries.size() == 1) ? "y" : "ies") << ", " << count(Action::Create) << " to create, " << overwriteCount << " to overwrite, " << count(Action::Skip) << " unchanged and skipped." << std::endl;
+    qsizetype listed = 0;
+    for (auto const& entry : m_entries) {
+        if (allCopies || ((entry.action == Action::Overwrite) && (listed < maximumListed))) {
+            out << "  " << toString(entry.action).toStdString() << ": " << entry.name.toStdString() << std::endl;
+            ++listed;
+        }
+    }
+    if (!allCopies && (overwriteCount > listed)) {
+        out << "  ... and " << (overwriteCount - listed) << " more to overwrite" << std::endl;
+    }
+    return QString::fromStdString(out.str());
+}
+
+QByteArray CopyPlan::toJson() const {
+    QJsonArray copies;
+    for (auto const& entry : m_entries) {
+        QJsonObject object;
+        object.insert(QStringLiteral("name"), entry.name);
+        object.insert(QStringLiteral("missileNumber"), static_cast<double>(entry.newId));
+        object.insert(QStringLiteral("action"), toString(entry.action));
+        copies.append(object);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("blueprintFolder"), m_blueprintLocation);
+    root.insert(QStringLiteral("create"), static_cast<double>(count(Action::Create)));
+    root.insert(QStringLiteral("overwrite"), static_cast<double>(count(Action::Overwrite)));
+    root.insert(QStringLiteral("skip"), static_cast<double>(count(Action::Skip)));
+    root.insert(QStringLiteral("copies"), copies);
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,51 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_COPYPLAN_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_COPYPLAN_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+#include <set>
+#include <vector>
+
+/*
+	What a run is going to do with each of its copies, decided before the first one is written.
+	The blueprint folder is listed once when the plan is created, only targets that show up in that listing are looked
+	at any further. Replacing existing copies is then confirmed once for the whole plan (or exported with --dryRun),
+	so the copies are written without ever stopping for a question.
+*/
+class CopyPlan {
+public:
+	enum class Action { Create, Overwrite, Skip };
+
+	struct Entry {
+		QString name;
+		qsizetype newId;
+		Action action;
+	};
+
+	// Archive selects whether copies are folders or <name>.sbb archives
+	CopyPlan(QString const& blueprintLocation, bool archive);
+
+	// Adds the next copy, upToDate ones are skipped as --incremental found them unchanged
+	void add(QString const& name, qsizetype newId, bool upToDate);
+
+	std::vector<Entry> const& getEntries() const;
+	qsizetype count(Action action) const;
+
+	// A one line summary followed by every copy with its action, or only by the first few copies that will be replaced
+	QString toText(bool allCopies) const;
+	// Every copy with its action
+	QByteArray toJson() const;
+
+	static QString toString(Action action);
+private:
+	QString const m_blueprintLocation;
+	bool const m_archive;
+	// Names in the blueprint folder, listed when the first copy that is not skipped is added
+	bool m_listed;
+	std::set<QString> m_existing;
+	std::vector<Entry> m_entries;
+};
+
+#endif
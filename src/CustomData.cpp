@@ -0,0 +1,339 @@
+#include "CustomData.h"
+
+#include <QLocale>
+
+#include <cmath>
+
+namespace {
+    // Deeper formulas are rejected, so evaluating one never needs more than a fixed stack
+    int const maximumFormulaDepth = 32;
+
+    QByteArray const missileNumberKey("Missile number");
+    QByteArray const missileNameTagKey("Missile name tag");
+
+    bool isSpace(char c) {
+        return (c == ' ') || (c == '\t') || (c == '\r');
+    }
+
+    void skipSpaces(QByteArray const& text, qsizetype& pos) {
+        while ((pos < text.size()) && isSpace(text.at(pos))) {
+            ++pos;
+        }
+    }
+
+    QByteArray formatNumber(double value) {
+        // Whole numbers without a fraction or exponent, WHAM reads both as numbers
+        if ((std::floor(value) == value) && (std::fabs(value) < 1e15)) {
+            return QByteArray::number(static_cast<qint64>(value));
+        }
+        return QByteArray::number(value, 'g', QLocale::FloatingPointShortest);
+    }
+}
+
+std::optional<CustomData::Template> CustomData::Template::parse(QByteArray const& text, QString& error) {
+    Template result;
+    qsizetype pos = 0;
+    while (pos < text.size()) {
+        qsizetype const open = text.indexOf('{', pos);
+        qsizetype const close = text.indexOf('}', pos);
+        if ((close >= 0) && ((open < 0) || (close < open))) {
+            error = QStringLiteral("'}' without '{' in '%1'.").arg(QString::fromUtf8(text));
+            return std::nullopt;
+        } else if (open < 0) {
+            result.m_parts.push_back({ text.mid(pos), {} });
+            break;
+        } else if (open > pos) {
+            result.m_parts.push_back({ text.mid(pos, open - pos), {} });
+        }
+
+        Part formula;
+        qsizetype formulaPos = open + 1;
+        if (!parseSum(text, formulaPos, formula.formula, 0) || (formula.formula.size() > static_cast<std::size_t>(4 * maximumFormulaDepth)) || (formulaPos >= text.size()) || (text.at(formulaPos) != '}')) {
+            error = QStringLiteral("Invalid formula at character %1 of '%2'.").arg(formulaPos + 1).arg(QString::fromUtf8(text));
+            return std::nullopt;
+        }
+        result.m_parts.push_back(std::move(formula));
+        pos = formulaPos + 1;
+    }
+    return result;
+}
+
+bool CustomData::Template::parseSum(QByteArray const& text, qsizetype& pos, std::vector<Token>& out, int depth) {
+    if (!parseProduct(text, pos, out, depth)) {
+        return false;
+    }
+    while (true) {
+        skipSpaces(text, pos);
+        if ((pos >= text.size()) || ((text.at(pos) != '+') && (text.at(pos) != '-'))) {
+            return true;
+        }
+        Operation const operation = (text.at(pos++) == '+') ? Operation::Add : Operation::Subtract;
+        if (!parseProduct(text, pos, out, depth)) {
+            return false;
+        }
+        out.push_back({ operation, 0.0 });
+    }
+}
+
+bool CustomData::Template::parseProduct(QByteArray const& text, qsizetype& pos, std::vector<Token>& out, int depth) {
+    if (!parseFactor(text, pos, out, depth)) {
+        return false;
+    }
+    while (true) {
+        skipSpaces(text, pos);
+        if ((pos >= text.size()) || ((text.at(pos) != '*') && (text.at(pos) != '/') && (text.at(pos) != '%'))) {
+            return true;
+        }
+        char const c = text.at(pos++);
+        Operation const operation = (c == '*') ? Operation::Multiply : ((c == '/') ? Operation::Divide : Operation::Modulo);
+        if (!parseFactor(text, pos, out, depth)) {
+            return false;
+        }
+        out.push_back({ operation, 0.0 });
+    }
+}
+
+bool CustomData::Template::parseFactor(QByteArray const& text, qsizetype& pos, std::vector<Token>& out, int depth) {
+    skipSpaces(text, pos);
+    if ((pos >= text.size()) || (depth > maximumFormulaDepth) || (out.size() > static_cast<std::size_t>(4 * maximumFormulaDepth))) {
+        return false;
+    }
+
+    char const c = text.at(pos);
+    if (c == '-') {
+        ++pos;
+        if (!parseFactor(text, pos, out, depth + 1)) {
+            return false;
+        }
+        out.push_back({ Operation::Negate, 0.0 });
+        return true;
+    } else if (c == 'i') {
+        ++pos;
+        out.push_back({ Operation::Index, 0.0 });
+        return true;
+    } else if (c == '(') {
+        ++pos;
+        std::vector<Token> inner;
+        if (!parseSum(text, pos, inner, depth + 1)) {
+            return false;
+        }
+        skipSpaces(text, pos);
+        if ((pos >= text.size()) || (text.at(pos) != ')')) {
+            return false;
+        }
+        ++pos;
+        out.insert(out.end(), inner.begin(), inner.end());
+        return true;
+    }
+
+    qsizetype const begin = pos;
+    while ((pos < text.size()) && ((('0' <= text.at(pos)) && (text.at(pos) <= '9')) || (text.at(pos) == '.'))) {
+        ++pos;
+    }
+    bool ok = false;
+    double const value = text.mid(begin, pos - begin).toDouble(&ok);
+    if (!ok) {
+        return false;
+    }
+    out.push_back({ Operation::Number, value });
+    return true;
+}
+
+double CustomData::Template::run(std::vector<Token> const& formula, qsizetype index) {
+    // Postfix order, so every operation finds its operands on the stack
+    double stack[4 * maximumFormulaDepth + 2];
+    int top = 0;
+    for (auto const& token : formula) {
+        switch (token.operation) {
+            case Operation::Number: stack[top++] = token.value; break;
+            case Operation::Index: stack[top++] = static_cast<double>(index); break;
+            case Operation::Negate: stack[top - 1] = -stack[top - 1]; break;
+            default: {
+                double const b = stack[--top];
+                double& a = stack[top - 1];
+                switch (token.operation) {
+                    case Operation::Add: a = a + b; break;
+                    case Operation::Subtract: a = a - b; break;
+                    case Operation::Multiply: a = a * b; break;
+                    case Operation::Divide: a = (b == 0.0) ? 0.0 : (a / b); break;
+                    case Operation::Modulo: a = (b == 0.0) ? 0.0 : std::fmod(a, b); break;
+                    default: break;
+                }
+                break;
+            }
+        }
+    }
+    return (top == 1) ? stack[0] : 0.0;
+}
+
+QByteArray CustomData::Template::evaluate(qsizetype index) const {
+    QByteArray result;
+    for (auto const& part : m_parts) {
+        if (part.formula.empty()) {
+            result.append(part.literal);
+        } else {
+            result.append(formatNumber(run(part.formula, index)));
+        }
+    }
+    return result;
+}
+
+CustomData::CustomData(QByteArray const& text, bool escaped) : m_text(text), m_escaped(escaped), m_insertAt(text.size()), m_insertNeedsLineBreak(false), m_lineBreak("\n") {
+    qsizetype section = 0;
+    qsizetype lineBegin = 0;
+    while (lineBegin < m_text.size()) {
+        qsizetype lineBreak = m_text.indexOf('\n', lineBegin);
+        qsizetype const lineEnd = (lineBreak < 0) ? m_text.size() : (lineBreak + 1);
+        if (lineBreak < 0) {
+            lineBreak = m_text.size();
+        }
+
+        qsizetype pos = lineBegin;
+        skipSpaces(m_text, pos);
+        qsizetype const equals = m_text.indexOf('=', pos);
+        if ((pos < lineBreak) && (m_text.at(pos) == '[')) {
+            ++section;
+        } else if ((pos < lineBreak) && (m_text.at(pos) != ';') && (m_text.at(pos) != '#') && (equals >= 0) && (equals < lineBreak)) {
+            qsizetype keyEnd = equals;
+            while ((keyEnd > pos) && isSpace(m_text.at(keyEnd - 1))) {
+                --keyEnd;
+            }
+            qsizetype valueBegin = equals + 1;
+            skipSpaces(m_text, valueBegin);
+            qsizetype valueEnd = lineBreak;
+            while ((valueEnd > valueBegin) && isSpace(m_text.at(valueEnd - 1))) {
+                --valueEnd;
+            }
+            if (keyEnd > pos) {
+                m_entries.push_back({ m_text.mid(pos, keyEnd - pos), valueBegin, valueEnd, lineEnd, section });
+            }
+        }
+        lineBegin = lineEnd;
+    }
+
+    // New keys go after the last key of the section holding the missile number
+    Entry const* const missileNumber = find(missileNumberKey);
+    if (missileNumber != nullptr) {
+        for (auto const& entry : m_entries) {
+            if (entry.section == missileNumber->section) {
+                m_insertAt = entry.lineEnd;
+            }
+        }
+    }
+    m_insertNeedsLineBreak = (m_insertAt > 0) && (m_text.at(m_insertAt - 1) != '\n');
+    if ((m_insertAt > 1) && !m_insertNeedsLineBreak && (m_text.at(m_insertAt - 2) == '\r')) {
+        m_lineBreak = "\r\n";
+    }
+}
+
+std::optional<CustomData::Override> CustomData::parseOverride(QString const& text, QString& error) {
+    qsizetype const equals = text.indexOf(QChar('='));
+    if (equals <= 0) {
+        error = QStringLiteral("Expected 'key=value', not '%1'.").arg(text);
+        return std::nullopt;
+    }
+    QByteArray const keyText = text.left(equals).trimmed().toUtf8();
+    if ((keyText == missileNumberKey) || (keyText == missileNameTagKey)) {
+        error = QStringLiteral("The key '%1' is set by the duplicator itself.").arg(QString::fromUtf8(keyText));
+        return std::nullopt;
+    }
+    auto key = Template::parse(keyText, error);
+    auto value = (key) ? Template::parse(text.mid(equals + 1).trimmed().toUtf8(), error) : std::nullopt;
+    if (!key || !value) {
+        return std::nullopt;
+    }
+    return Override{ text, std::move(*key), std::move(*value) };
+}
+
+std::vector<CustomData::Entry> const& CustomData::getEntries() const {
+    return m_entries;
+}
+
+CustomData::Entry const* CustomData::find(QByteArray const& key) const {
+    for (auto const& entry : m_entries) {
+        if (entry.key == key) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+QByteArray CustomData::getValue(Entry const& entry) const {
+    return m_text.mid(entry.valueBegin, entry.valueEnd - entry.valueBegin);
+}
+
+QByteArray CustomData::escape(QByteArray const& value) const {
+    if (!m_escaped) {
+        return value;
+    }
+    QByteArray result(value);
+    result.replace("&", "&amp;").replace("<", "&lt;").replace(">", "&gt;");
+    return result;
+}
+
+QByteArray CustomData::instantiate(qsizetype newId, std::vector<Override> const& overrides) const {
+    // The missile number comes last, so it always wins
+    std::vector<QByteArray> keys;
+    std::vector<QByteArray> values;
+    keys.reserve(overrides.size() + 1);
+    values.reserve(overrides.size() + 1);
+    for (auto const& entry : overrides) {
+        keys.push_back(escape(entry.key.evaluate(newId)));
+        values.push_back(escape(entry.value.evaluate(newId)));
+    }
+    keys.push_back(missileNumberKey);
+    values.push_back(QByteArray::number(newId));
+
+    std::vector<bool> used(keys.size(), false);
+    QByteArray result;
+    result.reserve(m_text.size() + 64);
+    qsizetype cursor = 0;
+    auto const insertUnused = [&]() {
+        result.append(m_text.constData() + cursor, m_insertAt - cursor);
+        cursor = m_insertAt;
+        for (std::size_t k = 0; k < keys.size(); ++k) {
+            if (used.at(k) || keys.at(k).isEmpty()) {
+                continue;
+            }
+            if (m_insertNeedsLineBreak) {
+                result.append(m_lineBreak);
+            }
+            result.append(keys.at(k)).append('=').append(values.at(k));
+            if (!m_insertNeedsLineBreak) {
+                result.append(m_lineBreak);
+            }
+            used.at(k) = true;
+        }
+    };
+
+    // Keys set in a later section have to be known before the new ones are added to the missile section
+    std::vector<qsizetype> replacements(m_entries.size(), -1);
+    for (std::size_t e = 0; e < m_entries.size(); ++e) {
+        for (std::size_t k = keys.size(); k-- > 0;) {
+            if (m_entries.at(e).key == keys.at(k)) {
+                replacements.at(e) = static_cast<qsizetype>(k);
+                used.at(k) = true;
+                break;
+            }
+        }
+    }
+
+    bool inserted = false;
+    for (std::size_t e = 0; e < m_entries.size(); ++e) {
+        auto const& entry = m_entries.at(e);
+        if (!inserted && (entry.valueBegin >= m_insertAt)) {
+            insertUnused();
+            inserted = true;
+        }
+        if (replacements.at(e) >= 0) {
+            result.append(m_text.constData() + cursor, entry.valueBegin - cursor);
+            result.append(values.at(static_cast<std::size_t>(replacements.at(e))));
+            cursor = entry.valueEnd;
+        }
+    }
+    if (!inserted) {
+        insertUnused();
+    }
+    result.append(m_text.constData() + cursor, m_text.size() - cursor);
+    return result;
+}
@@ -0,0 +1,89 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_CUSTOMDATA_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_CUSTOMDATA_H_
+
+#include <QByteArray>
+#include <QString>
+
+#include <optional>
+#include <vector>
+
+/*
+	The WHAM custom data as an ordered list of "key=value" lines with their byte ranges, parsed once per source.
+	Section headers like "[Missile - Configuration]", comments and everything else are kept as they are.
+	A copy is produced by one pass over the lines, replacing the values of the missile number and of the keys
+	given with --customData, so no regular expression runs per copy. The text is either raw from bp.sbc, with
+	XML entities, or already decoded; the new values are escaped to match.
+*/
+class CustomData {
+public:
+	// Text with {formula} parts, evaluated for every copy with i as the number of the copy. Formulas use decimal
+	// numbers, i, + - * / %, unary minus and parentheses, a division by zero gives 0.
+	class Template {
+	public:
+		static std::optional<Template> parse(QByteArray const& text, QString& error);
+
+		QByteArray evaluate(qsizetype index) const;
+	private:
+		enum class Operation { Number, Index, Add, Subtract, Multiply, Divide, Modulo, Negate };
+
+		struct Token {
+			Operation operation;
+			double value;
+		};
+
+		// Either a literal or a formula in postfix order
+		struct Part {
+			QByteArray literal;
+			std::vector<Token> formula;
+		};
+
+		std::vector<Part> m_parts;
+
+		static bool parseSum(QByteArray const& text, qsizetype& pos, std::vector<Token>& out, int depth);
+		static bool parseProduct(QByteArray const& text, qsizetype& pos, std::vector<Token>& out, int depth);
+		static bool parseFactor(QByteArray const& text, qsizetype& pos, std::vector<Token>& out, int depth);
+		static double run(std::vector<Token> const& formula, qsizetype index);
+	};
+
+	struct Override {
+		// As given on the command line, identifies the overrides for --incremental
+		QString text;
+		Template key;
+		Template value;
+	};
+
+	struct Entry {
+		// The key without surrounding spaces
+		QByteArray key;
+		qsizetype valueBegin;
+		qsizetype valueEnd;
+		// End of the line, after its line break if there is one
+		qsizetype lineEnd;
+		qsizetype section;
+	};
+
+	CustomData(QByteArray const& text, bool escaped);
+
+	// "key=value", the missile number and name tag can not be overridden
+	static std::optional<Override> parseOverride(QString const& text, QString& error);
+
+	std::vector<Entry> const& getEntries() const;
+	Entry const* find(QByteArray const& key) const;
+	QByteArray getValue(Entry const& entry) const;
+
+	// The text with the missile number set to newId and the overrides applied. Keys that do not exist yet are
+	// added as new lines after the last key of the section holding the missile number.
+	QByteArray instantiate(qsizetype newId, std::vector<Override> const& overrides) const;
+private:
+	QByteArray const m_text;
+	bool const m_escaped;
+	std::vector<Entry> m_entries;
+	qsizetype m_insertAt;
+	bool m_insertNeedsLineBreak;
+	// "\r\n" if the line in front of the new keys uses it
+	QByteArray m_lineBreak;
+
+	QByteArray escape(QByteArray const& value) const;
+};
+
+#endif
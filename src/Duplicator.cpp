@@ -0,0 +1,97 @@
+#include "Duplicator.h"
+
+#include <limits>
+#include <sstream>
+
+#include "BinaryBlueprint.h"
+#include "BlueprintScanner.h"
+
+Duplicator::Duplicator(QByteArray const& binary, BlueprintData const& blueprintData, PatchTemplate const& patchTemplate) : m_binary(binary), m_blueprintData(blueprintData), m_patchTemplate(patchTemplate) {
+	//
+}
+
+BlueprintData const& Duplicator::getBlueprintData() const {
+    return m_blueprintData;
+}
+
+QString Duplicator::getCopyName(qsizetype newId) const {
+    return BlueprintData::cutDigitsFromEnd(m_blueprintData.getDisplayName()).append(QString::number(newId));
+}
+
+std::optional<std::vector<BlueprintScanner::Field>> Duplicator::scan(QByteArray const& data, ParseLimits const& limits, Error& error) {
+    ParseBudget budget(limits);
+    std::ostringstream scanError;
+    auto result = BlueprintScanner::scan(data, budget, scanError);
+    if (!result && budget.isExceeded()) {
+        error = Error{ ErrorCode::LimitExceeded, QStringLiteral("limits"), budget.getError() };
+    } else if (!result) {
+        error = Error{ ErrorCode::Unsupported, QStringLiteral("scan"), QStringLiteral("The fast scanner could not handle this blueprint. %1").arg(QString::fromStdString(scanError.str())).trimmed() };
+    }
+    return result;
+}
+
+std::optional<BlueprintData> Duplicator::check(QByteArray const& data, std::vector<BlueprintScanner::Field> const& fields, Error& error) {
+    BlueprintData::Problem problem;
+    auto result = BlueprintData::lint(data, fields, problem);
+    if (!result) {
+        error = Error{ ErrorCode::Inconsistent, problem.check, problem.message };
+    }
+    return result;
+}
+
+std::optional<BlueprintData> Duplicator::check(ByteSpan blueprint, Error& error) {
+    return check(blueprint, ParseLimits::defaults(), error);
+}
+
+std::optional<BlueprintData> Duplicator::check(ByteSpan blueprint, ParseLimits const& limits, Error& error) {
+    // Read in place, the caller keeps the bytes alive for the duration of the call
+    QByteArray const data = QByteArray::fromRawData(blueprint.data, blueprint.size);
+    auto const fields = scan(data, limits, error);
+    if (!fields) {
+        return std::nullopt;
+    }
+    return check(data, *fields, error);
+}
+
+std::optional<Duplicator> Duplicator::load(ByteSpan blueprint, ByteSpan binary, Error& error) {
+    return load(blueprint, binary, ParseLimits::defaults(), error);
+}
+
+std::optional<Duplicator> Duplicator::load(ByteSpan blueprint, ByteSpan binary, ParseLimits const& limits, Error& error) {
+    // The template keeps referring to the source, so unlike check this takes a copy
+    QByteArray const data(blueprint.data, blueprint.size);
+    auto const fields = scan(data, limits, error);
+    if (!fields) {
+        return std::nullopt;
+    }
+    auto const blueprintData = check(data, *fields, error);
+    if (!blueprintData) {
+        return std::nullopt;
+    }
+
+    std::ostringstream compileError;
+    auto const patchTemplate = PatchTemplate::compile(data, *fields, *blueprintData, {}, compileError);
+    if (!patchTemplate) {
+        error = Error{ ErrorCode::NoTemplate, QString(), QString::fromStdString(compileError.str()).trimmed() };
+        return std::nullopt;
+    }
+    return Duplicator(QByteArray(binary.data, binary.size), *blueprintData, *patchTemplate);
+}
+
+std::optional<Duplicator::Copy> Duplicator::generate(qsizetype newId, Error& error) const {
+    if ((newId < 0) || (newId > std::numeric_limits<int>::max())) {
+        error = Error{ ErrorCode::InvalidId, QString(), QStringLiteral("The missile number %1 is out of range.").arg(newId) };
+        return std::nullopt;
+    }
+
+    Copy result{ getCopyName(newId), m_patchTemplate.instantiate(newId), QByteArray() };
+    if (!m_binary.isEmpty()) {
+        std::ostringstream binaryError;
+        result.binary = BinaryBlueprint::withNewId(m_binary, m_blueprintData, newId, {}, binaryError);
+        if (result.binary.isEmpty()) {
+            error = Error{ ErrorCode::BinaryFailed, QString(), QStringLiteral("Could not renumber bp.sbcB5. %1").arg(QString::fromStdString(binaryError.str())).trimmed() };
+            return std::nullopt;
+        }
+    }
+    return result;
+}
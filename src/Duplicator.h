@@ -0,0 +1,80 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_DUPLICATOR_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_DUPLICATOR_H_
+
+#include <QByteArray>
+#include <QString>
+
+#include <optional>
+
+#include "BlueprintData.h"
+#include "ParseLimits.h"
+#include "PatchTemplate.h"
+
+/*
+	The duplicator as a library: blueprints go in as bytes, copies come out as bytes, and every failure is returned
+	as an error code with a message instead of being printed. Nothing here touches the file system or the console,
+	so embedders and tools can drive it in-process. Only blueprints the fast scanner handles are supported. For the
+	XML parser fallback, streaming, salvos, --customData and --newEntityIds, the command line client uses the
+	lower-level classes, which report to the error stream they are given.
+*/
+class Duplicator {
+public:
+	enum class ErrorCode {
+		// The fast scanner could not handle the document
+		Unsupported,
+		// The document exceeded the parse limits, Error::message names the limit
+		LimitExceeded,
+		// A consistency check failed, Error::check names it
+		Inconsistent,
+		// The numbered locations could not be compiled into a patch template
+		NoTemplate,
+		// bp.sbcB5 was given but could not be renumbered
+		BinaryFailed,
+		InvalidId
+	};
+
+	struct Error {
+		ErrorCode code;
+		// Identifier of the failed check like BlueprintData::Problem, "scan" for Unsupported, "limits" for
+		// LimitExceeded and empty otherwise
+		QString check;
+		QString message;
+	};
+
+	// Bytes owned by the caller, only read during the call
+	struct ByteSpan {
+		char const* data;
+		qsizetype size;
+	};
+
+	struct Copy {
+		// Display name of the copy, which is also the name of its folder
+		QString name;
+		QByteArray blueprint;
+		// Empty if no bp.sbcB5 was loaded
+		QByteArray binary;
+	};
+
+	// Checks and compiles bp.sbc and, if binary is not empty, keeps bp.sbcB5 to renumber it with every copy. Within
+	// ParseLimits::defaults() unless limits are given.
+	static std::optional<Duplicator> load(ByteSpan blueprint, ByteSpan binary, Error& error);
+	static std::optional<Duplicator> load(ByteSpan blueprint, ByteSpan binary, ParseLimits const& limits, Error& error);
+	// Only the consistency checks, without compiling anything
+	static std::optional<BlueprintData> check(ByteSpan blueprint, Error& error);
+	static std::optional<BlueprintData> check(ByteSpan blueprint, ParseLimits const& limits, Error& error);
+
+	BlueprintData const& getBlueprintData() const;
+	QString getCopyName(qsizetype newId) const;
+	// Safe to call from many threads at once
+	std::optional<Copy> generate(qsizetype newId, Error& error) const;
+private:
+	QByteArray const m_binary;
+	BlueprintData const m_blueprintData;
+	PatchTemplate const m_patchTemplate;
+
+	Duplicator(QByteArray const& binary, BlueprintData const& blueprintData, PatchTemplate const& patchTemplate);
+	static std::optional<std::vector<BlueprintScanner::Field>> scan(QByteArray const& data, ParseLimits const& limits, Error& error);
+	static std::optional<BlueprintData> check(QByteArray const& data, std::vector<BlueprintScanner::Field> const& fields, Error& error);
+};
+
+#endif
@@ -0,0 +1,122 @@
+#include "EntityIds.h"
+
+#include <algorithm>
+
+namespace {
+    // The game stores ids as signed 64 bit numbers, all new ones are positive
+    quint64 const idMask = 0x7FFFFFFFFFFFFFFFull;
+    // The input of the mix is (round << 58) | (copy << 20) | index
+    int const indexBits = 20;
+    int const copyBits = 38;
+
+    // Parses a plain decimal number without sign or spaces, as written by the game
+    bool parseId(char const* data, qsizetype size, quint64& value) {
+        if ((size < 1) || (size > 19)) {
+            return false;
+        }
+        value = 0;
+        for (qsizetype i = 0; i < size; ++i) {
+            char const c = data[i];
+            if ((c < '0') || (c > '9')) {
+                return false;
+            }
+            value = 10 * value + static_cast<quint64>(c - '0');
+        }
+        return true;
+    }
+}
+
+EntityIds::EntityIds(quint64 seed, qsizetype count, std::vector<Location> const& locations, std::unordered_set<quint64> const& reserved) : m_seed(seed), m_count(count), m_locations(locations), m_reserved(reserved) {
+	//
+}
+
+template<typename Visit>
+void EntityIds::forEachEntityId(QByteArray const& data, Visit const& visit) {
+    QByteArray const open("<EntityId>");
+    char const* const text = data.constData();
+    for (qsizetype pos = data.indexOf(open); pos >= 0; pos = data.indexOf(open, pos)) {
+        pos += open.size();
+        qsizetype const end = data.indexOf('<', pos);
+        quint64 value = 0;
+        if ((end >= 0) && parseId(text + pos, end - pos, value)) {
+            visit(value);
+        }
+    }
+}
+
+std::optional<EntityIds> EntityIds::collect(QByteArray const& source) {
+    // Ids are numbered in the order they first appear, which also derives the seed from the source
+    std::unordered_map<quint64, qsizetype> indices;
+    quint64 seed = 0;
+    forEachEntityId(source, [&](quint64 value) {
+        if ((value != 0) && indices.emplace(value, static_cast<qsizetype>(indices.size())).second) {
+            seed = mix(seed ^ value);
+        }
+    });
+    if (indices.empty() || (indices.size() >= (std::size_t(1) << indexBits))) {
+        return std::nullopt;
+    }
+
+    // Every element consisting of nothing but one of the ids refers to it
+    std::vector<Location> locations;
+    char const* const text = source.constData();
+    for (qsizetype pos = source.indexOf('>'); pos >= 0; pos = source.indexOf('>', pos + 1)) {
+        qsizetype const begin = pos + 1;
+        qsizetype end = begin;
+        while ((end < source.size()) && ('0' <= text[end]) && (text[end] <= '9')) {
+            ++end;
+        }
+        quint64 value = 0;
+        if ((end < source.size()) && (text[end] == '<') && parseId(text + begin, end - begin, value)) {
+            auto const it = indices.find(value);
+            if (it != indices.end()) {
+                locations.push_back({ begin, end, it->second });
+            }
+        }
+        pos = std::max(pos, end - 1);
+    }
+
+    std::unordered_set<quint64> reserved;
+    reserved.reserve(2 * indices.size() + 1);
+    reserved.insert(0);
+    for (auto const& entry : indices) {
+        reserved.insert(entry.first);
+    }
+    return EntityIds(seed & idMask, static_cast<qsizetype>(indices.size()), locations, reserved);
+}
+
+void EntityIds::reserve(QByteArray const& data) {
+    forEachEntityId(data, [&](quint64 value) {
+        m_reserved.insert(value);
+    });
+}
+
+qsizetype EntityIds::getCount() const {
+    return m_count;
+}
+
+std::vector<EntityIds::Location> const& EntityIds::getLocations() const {
+    return m_locations;
+}
+
+quint64 EntityIds::mix(quint64 x) {
+    // Every step is a bijection on 63 bit numbers: xor with a right shift and multiplication by an odd constant
+    x &= idMask;
+    x ^= x >> 31;
+    x = (x * 0x7FB5D329728EA185ull) & idMask;
+    x ^= x >> 27;
+    x = (x * 0x81DADEF4BC2DD44Dull) & idMask;
+    x ^= x >> 33;
+    return x;
+}
+
+quint64 EntityIds::generate(qsizetype newId, qsizetype index) const {
+    quint64 const base = ((static_cast<quint64>(newId) & ((quint64(1) << copyBits) - 1)) << indexBits) | static_cast<quint64>(index);
+    // A reserved id is practically never hit, the next round then uses inputs no other copy or index can have
+    for (quint64 round = 0;; ++round) {
+        quint64 const id = mix((((round << (indexBits + copyBits)) | base) ^ m_seed) & idMask);
+        if (m_reserved.count(id) == 0) {
+            return id;
+        }
+    }
+}
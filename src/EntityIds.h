@@ -0,0 +1,53 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_ENTITYIDS_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_ENTITYIDS_H_
+
+#include <QByteArray>
+
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+/*
+	Fresh EntityIds for every copy, used by --newEntityIds.
+	The ids of the source are numbered once, along with every element in it whose text is one of them, so references
+	like the top part of a rotor or the blocks on a toolbar are remapped together with the blocks themselves.
+	The new id of source id k in copy n is a bijective 63 bit mix of (n, k), so no two of them are ever the same
+	without remembering any of them. Only ids of the source and the library, kept in a set, have to be avoided.
+*/
+class EntityIds {
+public:
+	// An element text in the source holding the id with the given index
+	struct Location {
+		qsizetype begin;
+		qsizetype end;
+		qsizetype index;
+	};
+
+	// Nothing if the source has no EntityId at all
+	static std::optional<EntityIds> collect(QByteArray const& source);
+
+	// Keeps the EntityIds found in data from being generated, e.g. those of other blueprints in the library
+	void reserve(QByteArray const& data);
+
+	qsizetype getCount() const;
+	// In document order, the ranges do not overlap
+	std::vector<Location> const& getLocations() const;
+
+	// The new id of the source id with the given index in copy newId, safe to call on many threads at once
+	quint64 generate(qsizetype newId, qsizetype index) const;
+private:
+	quint64 const m_seed;
+	qsizetype const m_count;
+	std::vector<Location> const m_locations;
+	std::unordered_set<quint64> m_reserved;
+
+	EntityIds(quint64 seed, qsizetype count, std::vector<Location> const& locations, std::unordered_set<quint64> const& reserved);
+
+	// Calls visit for every <EntityId> in data
+	template<typename Visit>
+	static void forEachEntityId(QByteArray const& data, Visit const& visit);
+	static quint64 mix(quint64 x);
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_LRUCACHE_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_LRUCACHE_H_
+
+#include <cstddef>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+
+/*
+	A fixed number of values, the least recently used one is dropped when another is inserted into a full cache.
+	Values are handed out as shared pointers, so a value dropped while a thread still uses it stays alive until
+	that thread is done. All functions are safe to call from many threads at once.
+*/
+template<typename Key, typename Value>
+class LruCache {
+public:
+	explicit LruCache(std::size_t capacity) : m_capacity((capacity < 1) ? 1 : capacity) {
+		//
+	}
+
+	// Returns nullptr if there is no value for key, otherwise it becomes the most recently used one
+	std::shared_ptr<Value const> find(Key const& key) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto const it = m_index.find(key);
+		if (it == m_index.end()) {
+			return nullptr;
+		}
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return it->second->second;
+	}
+
+	// Replaces any value for key
+	void insert(Key const& key, std::shared_ptr<Value const> value) {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto const it = m_index.find(key);
+		if (it != m_index.end()) {
+			m_entries.erase(it->second);
+			m_index.erase(it);
+		}
+		m_entries.emplace_front(key, std::move(value));
+		m_index.emplace(key, m_entries.begin());
+		while (m_entries.size() > m_capacity) {
+			m_index.erase(m_entries.back().first);
+			m_entries.pop_back();
+		}
+	}
+
+	std::size_t size() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+private:
+	using Entry = std::pair<Key, std::shared_ptr<Value const>>;
+
+	std::size_t const m_capacity;
+	mutable std::mutex m_mutex;
+	std::list<Entry> m_entries;
+	std::map<Key, typename std::list<Entry>::iterator> m_index;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "Manifest.h"
+
+#include <QFile>
+#include <QStringList>
+
+#include <ostream>
+
+std::optional<std::vector<Manifest::Job>> Manifest::fromFile(QString const& fileName, std::ostream& error) {
+    QFile file(fileName);
+    if (!file.open(QFile::ReadOnly | QFile::Text)) {
+        error << "Error: Could not open the manifest '" << fileName.toStdString() << "' for reading!" << std::endl;
+        return std::nullopt;
+    }
+    return fromText(QString::fromUtf8(file.readAll()), error);
+}
+
+std::optional<std::vector<Manifest::Job>> Manifest::fromText(QString const& text, std::ostream& error) {
+    std::vector<Job> result;
+
+    QStringList const lines = text.split('\n');
+    for (qsizetype i = 0; i < lines.size(); ++i) {
+        QString const line = lines.at(i).trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        QStringList const parts = line.split(';');
+        if (parts.size() != 3) {
+            error << "Error: Line " << (i + 1) << " of the manifest should read 'blueprint;firstIndex;numCopies', but is '" << line.toStdString() << "'." << std::endl;
+            return std::nullopt;
+        }
+
+        bool okFirstIndex = false;
+        bool okNumCopies = false;
+        Job job;
+        job.blueprintName = parts.at(0).trimmed();
+        job.firstIndex = parts.at(1).trimmed().toInt(&okFirstIndex);
+        job.numCopies = parts.at(2).trimmed().toInt(&okNumCopies);
+        job.line = i + 1;
+        if (job.blueprintName.isEmpty() || !okFirstIndex || !okNumCopies || (job.firstIndex < 1) || (job.numCopies < 1)) {
+            error << "Error: Line " << (i + 1) << " of the manifest could not be parsed: '" << line.toStdString() << "'." << std::endl;
+            return std::nullopt;
+        }
+        result.push_back(job);
+    }
+
+    if (result.empty()) {
+        error << "Error: The manifest does not contain any jobs." << std::endl;
+        return std::nullopt;
+    }
+    return result;
+}
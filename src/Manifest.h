@@ -0,0 +1,29 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_MANIFEST_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_MANIFEST_H_
+
+#include <QString>
+
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+/*
+	A list of duplication jobs, one 'blueprint;firstIndex;numCopies' per line.
+	Empty lines and lines starting with '#' are ignored.
+*/
+class Manifest {
+public:
+	struct Job {
+		QString blueprintName;
+		qsizetype firstIndex;
+		qsizetype numCopies;
+		// Line in the manifest, for error messages
+		qsizetype line;
+	};
+
+	// Why the manifest can not be used goes to error
+	static std::optional<std::vector<Job>> fromFile(QString const& fileName, std::ostream& error);
+	static std::optional<std::vector<Job>> fromText(QString const& text, std::ostream& error);
+};
+
+#endif
@@ -2,20 +2,34 @@
 
 #include "BlueprintData.h"
 
-#include <iostream>
+#include <QThread>
 
-qsizetype parseInt(QString const& name, QCommandLineParser& parser) {
+#include <ostream>
+
+std::optional<qsizetype> parseInt(QString const& name, QCommandLineParser& parser, std::ostream& error) {
     QString const s = parser.value(name);
     bool ok = false;
     qsizetype const result = s.toInt(&ok);
     if ((!ok) || (result < 0)) {
-        std::cerr << "Option '" << name.toStdString() << "' could not be parsed: '" << s.toStdString() << "'" << std::endl;
-        QCoreApplication::exit(-1);
+        error << "Option '" << name.toStdString() << "' could not be parsed: '" << s.toStdString() << "'" << std::endl;
+        return std::nullopt;
     }
     return result;
 }
 
-Options Options::parseOptions(QCoreApplication const& app) {
+// The limits on bytes and milliseconds do not fit into an int
+std::optional<qint64> parseLongLong(QString const& name, QCommandLineParser& parser, std::ostream& error) {
+    QString const s = parser.value(name);
+    bool ok = false;
+    qint64 const result = s.toLongLong(&ok);
+    if ((!ok) || (result < 0)) {
+        error << "Option '" << name.toStdString() << "' could not be parsed: '" << s.toStdString() << "'" << std::endl;
+        return std::nullopt;
+    }
+    return result;
+}
+
+std::optional<Options> Options::parseOptions(QCoreApplication const& app, std::ostream& error) {
     QCommandLineParser parser;
     parser.setApplicationDescription("A utility for duplicating missiles made with the WHAM (Whip's Homing Advanced Missile) script.");
     parser.addHelpOption();
@@ -25,31 +39,245 @@ Options Options::parseOptions(QCoreApplication const& app) {
     parser.addOption(QCommandLineOption("firstIndex", "First index that the copies will take", "number", ""));
     parser.addOption(QCommandLineOption("numCopies", "How many copies will be created", "number", ""));
     parser.addOption(QCommandLineOption("force", "Yes to all overwrite questions"));
+    parser.addOption(QCommandLineOption("jobs", "Number of threads generating copies, 0 for one per core (default: 1)", "number", ""));
+    parser.addOption(QCommandLineOption("mmap", "Memory-map the source blueprint and write copies directly from the mapping"));
+    parser.addOption(QCommandLineOption("stream", "Stream the source and every copy through the XML parser with constant memory, for very large blueprints"));
+    parser.addOption(QCommandLineOption("binaryCache", "Read the blueprint data from an up-to-date bp.sbcB5 and regenerate it for every copy instead of deleting it"));
+    parser.addOption(QCommandLineOption("index", "Keep an index of the blueprint folder, so only changed blueprints are parsed for listing"));
+    parser.addOption(QCommandLineOption("list", "List the blueprints in the folder using the index and exit"));
+    parser.addOption(QCommandLineOption("family", "Only list blueprints of the given missile type, e.g. 'Urmel Wasp MK_1'", "name", ""));
+    parser.addOption(QCommandLineOption("manifest", "Run all jobs from a file with one 'blueprint;firstIndex;numCopies' per line", "file", ""));
+    parser.addOption(QCommandLineOption("stats", "Print per-phase timings, throughput, copy latencies and peak memory at the end, as 'text' or 'json'", "format", ""));
+    parser.addOption(QCommandLineOption("trace", "Write a Chrome trace event file with a span for every phase and copy", "file", ""));
+    parser.addOption(QCommandLineOption("verifyParse", "Parse every blueprint with both the fast scanner and the XML parser and fail if they disagree"));
+    parser.addOption(QCommandLineOption("incremental", "Only write copies whose source or contents changed since the last run"));
+    parser.addOption(QCommandLineOption("async", "Write copies asynchronously with many of them in flight at once, using io_uring where available"));
+    parser.addOption(QCommandLineOption("sidecars", "How thumb.png and the other files next to bp.sbc are propagated: 'auto', 'reflink', 'hardlink', 'copyRange' or 'copy' (default: auto)", "strategy", ""));
+    parser.addOption(QCommandLineOption("archive", "Write every copy as a zip archive <name>.sbb, like Workshop blueprints, instead of a folder"));
+    parser.addOption(QCommandLineOption("lint", "Check every Blueprint in the folder on all cores instead of duplicating one, reporting as 'text' or 'json'", "format", ""));
+    parser.addOption(QCommandLineOption("watch", "After creating the copies, keep running and regenerate them whenever the Blueprint is saved again"));
+    parser.addOption(QCommandLineOption("salvo", "Write all copies as one Blueprint, each copy moved by the offset pattern 'x,y,z' (one row) or 'x,y,z:columns:x,y,z' (rows), in meters", "pattern", ""));
+    parser.addOption(QCommandLineOption("customData", "Set a key of the WHAM custom data in every copy, as 'key=value' where {formulas} of i, the copy's number, are evaluated per copy, e.g. 'Launch delay={(i % 4) * 0.5}'; may be repeated", "entry", ""));
+    parser.addOption(QCommandLineOption("dryRun", "Only plan the copies and print which would be created, overwritten or skipped as 'text' or 'json', without writing anything", "format", ""));
+    parser.addOption(QCommandLineOption("newEntityIds", "Give the blocks and grids of every copy their own EntityIds, so copies pasted into the same world do not collide"));
+    parser.addOption(QCommandLineOption("maxDepth", "Reject blueprints whose elements are nested deeper than this (default: 256)", "number", ""));
+    parser.addOption(QCommandLineOption("maxBytes", "Reject blueprints larger than this many bytes (default: 1073741824)", "number", ""));
+    parser.addOption(QCommandLineOption("maxBlocks", "Reject blueprints with more named blocks than this (default: 1000000)", "number", ""));
+    parser.addOption(QCommandLineOption("maxCustomData", "Reject blueprints whose WHAM custom data is longer than this (default: 1048576)", "number", ""));
+    parser.addOption(QCommandLineOption("timeBudget", "Stop reading a blueprint after this many milliseconds, 0 for no budget (default: 60000)", "number", ""));
+    parser.addOption(QCommandLineOption("serve", "Keep running and answer duplication requests, one JSON object per line, from stdin ('-') or a local socket with the given name", "address", ""));
 
     parser.process(app);
 
     bool ok = false;
 
     // Check Argument validity
-    bool const haveBlueprintLocation = parser.isSet("blueprintFolder");
-    QString const userBlueprintLocation = parser.value("blueprintFolder");
-    if (haveBlueprintLocation) {
-        if (!BlueprintData::isValidBlueprintLocation(QDir(userBlueprintLocation))) {
-            std::cerr << "Your specified Blueprint location '" << userBlueprintLocation.toStdString() << "' is invalid!" << std::endl;
-            QCoreApplication::exit(-1);
+    Options result;
+    result.haveBlueprintLocation = parser.isSet("blueprintFolder");
+    result.userBlueprintLocation = parser.value("blueprintFolder");
+    if (result.haveBlueprintLocation) {
+        if (!BlueprintData::isValidBlueprintLocation(QDir(result.userBlueprintLocation))) {
+            error << "Your specified Blueprint location '" << result.userBlueprintLocation.toStdString() << "' is invalid!" << std::endl;
+            return std::nullopt;
         }
     }
 
-    bool const haveBlueprintName = parser.isSet("blueprint");
-    QString const userBlueprintName = parser.value("blueprint");
+    result.haveBlueprintName = parser.isSet("blueprint");
+    result.userBlueprintName = parser.value("blueprint");
+
+    result.haveFirstIndex = parser.isSet("firstIndex");
+    std::optional<qsizetype> const userFirstIndex = (result.haveFirstIndex) ? parseInt("firstIndex", parser, error) : -1;
+    if (!userFirstIndex) {
+        return std::nullopt;
+    }
+    result.userFirstIndex = *userFirstIndex;
+
+    result.haveNumCopies = parser.isSet("numCopies");
+    std::optional<qsizetype> const userNumCopies = (result.haveNumCopies) ? parseInt("numCopies", parser, error) : -1;
+    if (!userNumCopies) {
+        return std::nullopt;
+    }
+    result.userNumCopies = *userNumCopies;
+
+    result.force = parser.isSet("force");
+
+    std::optional<qsizetype> const userJobs = (parser.isSet("jobs")) ? parseInt("jobs", parser, error) : 1;
+    if (!userJobs) {
+        return std::nullopt;
+    }
+    result.jobs = *userJobs;
+    if (result.jobs == 0) {
+        result.jobs = QThread::idealThreadCount();
+    }
+
+    result.mmap = parser.isSet("mmap");
+    result.stream = parser.isSet("stream");
+    result.binaryCache = parser.isSet("binaryCache");
+
+    result.index = parser.isSet("index");
+    result.list = parser.isSet("list");
+
+    result.haveFamily = parser.isSet("family");
+    result.userFamily = parser.value("family");
+
+    result.haveManifest = parser.isSet("manifest");
+    result.userManifest = parser.value("manifest");
+    if (result.haveManifest && (result.haveBlueprintName || result.haveFirstIndex || result.haveNumCopies)) {
+        error << "The option 'manifest' can not be combined with 'blueprint', 'firstIndex' or 'numCopies'." << std::endl;
+        return std::nullopt;
+    } else if (result.haveManifest && (result.stream || result.mmap)) {
+        // The jobs of a manifest are read whole and share one pipeline
+        error << "The option 'manifest' can not be combined with 'stream' or 'mmap'." << std::endl;
+        return std::nullopt;
+    }
+
+    result.haveStats = parser.isSet("stats");
+    result.statsAsJson = (parser.value("stats") == QStringLiteral("json"));
+    if (result.haveStats && !result.statsAsJson && (parser.value("stats") != QStringLiteral("text"))) {
+        error << "Option 'stats' could not be parsed: '" << parser.value("stats").toStdString() << "', expected 'text' or 'json'." << std::endl;
+        return std::nullopt;
+    }
+
+    result.haveTrace = parser.isSet("trace");
+    result.userTrace = parser.value("trace");
+
+    result.verifyParse = parser.isSet("verifyParse");
+    result.incremental = parser.isSet("incremental");
+    result.async = parser.isSet("async");
+
+    std::optional<Sidecars::Strategy> const sidecarStrategy = (parser.isSet("sidecars")) ? Sidecars::parseStrategy(parser.value("sidecars")) : Sidecars::Strategy::Auto;
+    if (!sidecarStrategy) {
+        error << "Option 'sidecars' could not be parsed: '" << parser.value("sidecars").toStdString() << "', expected 'auto', 'reflink', 'hardlink', 'copyRange' or 'copy'." << std::endl;
+        return std::nullopt;
+    }
+    result.sidecarStrategy = *sidecarStrategy;
+
+    result.watch = parser.isSet("watch");
+    if (result.watch && (result.haveManifest || result.list)) {
+        error << "The option 'watch' can not be combined with 'manifest' or 'list'." << std::endl;
+        return std::nullopt;
+    } else if (result.watch && (result.stream || result.mmap)) {
+        // Every save is loaded into memory again, the game may replace bp.sbc under a stream or a mapping
+        error << "The option 'watch' can not be combined with 'stream' or 'mmap'." << std::endl;
+        return std::nullopt;
+    } else if (result.watch && !result.force) {
+        error << "The option 'watch' requires 'force', the copies are replaced on every save without asking." << std::endl;
+        return std::nullopt;
+    }
 
-    bool const haveFirstIndex = parser.isSet("firstIndex");
-    qsizetype const userFirstIndex = (haveFirstIndex) ? parseInt("firstIndex", parser) : -1;
+    result.haveLint = parser.isSet("lint");
+    result.lintAsJson = (parser.value("lint") == QStringLiteral("json"));
+    if (result.haveLint && !result.lintAsJson && (parser.value("lint") != QStringLiteral("text"))) {
+        error << "Option 'lint' could not be parsed: '" << parser.value("lint").toStdString() << "', expected 'text' or 'json'." << std::endl;
+        return std::nullopt;
+    } else if (result.haveLint && (result.haveManifest || result.list || result.watch)) {
+        error << "The option 'lint' can not be combined with 'manifest', 'list' or 'watch'." << std::endl;
+        return std::nullopt;
+    } else if (result.haveLint && !parser.isSet("jobs")) {
+        // Linting is meant for whole libraries, so it uses all cores unless told otherwise
+        result.jobs = QThread::idealThreadCount();
+    }
 
-    bool const haveNumCopies = parser.isSet("numCopies");
-    qsizetype const userNumCopies = (haveNumCopies) ? parseInt("numCopies", parser) : -1;
+    result.archive = parser.isSet("archive");
+    if (result.archive && (result.stream || result.async)) {
+        error << "The option 'archive' can not be combined with 'stream' or 'async'." << std::endl;
+        return std::nullopt;
+    }
 
-    bool const force = parser.isSet("force");
+    // Unless written asynchronously or as archives, copies are written from the mapping one after the other
+    if (result.mmap && !result.async && !result.archive && parser.isSet("jobs") && (result.jobs > 1)) {
+        error << "The option 'mmap' can not be combined with 'jobs', the copies are written from the mapping one at a time. Add 'async' to write them concurrently." << std::endl;
+        return std::nullopt;
+    }
+    // Every streamed copy reads the source file again, one after the other
+    if (result.stream && parser.isSet("jobs") && (result.jobs > 1)) {
+        error << "The option 'stream' can not be combined with 'jobs', the copies are streamed from the source one at a time." << std::endl;
+        return std::nullopt;
+    }
+
+    result.haveServe = parser.isSet("serve");
+    result.userServe = parser.value("serve");
+    if (result.haveServe && (result.haveManifest || result.list || result.watch || result.haveLint || result.haveBlueprintName || result.haveFirstIndex || result.haveNumCopies)) {
+        error << "The option 'serve' can not be combined with 'manifest', 'list', 'watch', 'lint', 'blueprint', 'firstIndex' or 'numCopies'." << std::endl;
+        return std::nullopt;
+    } else if (result.haveServe && (result.stream || result.mmap || result.async || result.incremental || result.verifyParse)) {
+        error << "The option 'serve' can not be combined with 'stream', 'mmap', 'async', 'incremental' or 'verifyParse'." << std::endl;
+        return std::nullopt;
+    } else if (result.haveServe && (!result.force || !result.haveBlueprintLocation)) {
+        error << "The option 'serve' requires 'force' and 'blueprintFolder', nothing is asked while serving." << std::endl;
+        return std::nullopt;
+    } else if (result.haveServe && !parser.isSet("jobs")) {
+        // Requests are answered concurrently, one per core unless told otherwise
+        result.jobs = QThread::idealThreadCount();
+    }
 
-    return Options(haveBlueprintLocation, userBlueprintLocation, haveBlueprintName, userBlueprintName, haveFirstIndex, userFirstIndex, haveNumCopies, userNumCopies, force);
+    result.haveSalvo = parser.isSet("salvo");
+    std::optional<Salvo::Pattern> const salvoPattern = (result.haveSalvo) ? Salvo::parsePattern(parser.value("salvo")) : result.salvoPattern;
+    if (!salvoPattern) {
+        error << "Option 'salvo' could not be parsed: '" << parser.value("salvo").toStdString() << "', expected 'x,y,z' or 'x,y,z:columns:x,y,z'." << std::endl;
+        return std::nullopt;
+    } else if (result.haveSalvo && (result.haveManifest || result.list || result.watch || result.haveLint || result.haveServe)) {
+        error << "The option 'salvo' can not be combined with 'manifest', 'list', 'watch', 'lint' or 'serve'." << std::endl;
+        return std::nullopt;
+    } else if (result.haveSalvo && (result.stream || result.mmap || result.async || result.incremental || result.archive)) {
+        error << "The option 'salvo' can not be combined with 'stream', 'mmap', 'async', 'incremental' or 'archive'." << std::endl;
+        return std::nullopt;
+    }
+    result.salvoPattern = *salvoPattern;
+
+    for (auto const& text : parser.values("customData")) {
+        QString overrideError;
+        auto const entry = CustomData::parseOverride(text, overrideError);
+        if (!entry) {
+            error << "Option 'customData' could not be parsed: " << overrideError.toStdString() << std::endl;
+            return std::nullopt;
+        }
+        result.customDataOverrides.push_back(*entry);
+    }
+    if (!result.customDataOverrides.empty() && (result.list || result.haveLint)) {
+        error << "The option 'customData' can not be combined with 'list' or 'lint'." << std::endl;
+        return std::nullopt;
+    }
+
+    result.haveDryRun = parser.isSet("dryRun");
+    result.dryRunAsJson = (parser.value("dryRun") == QStringLiteral("json"));
+    if (result.haveDryRun && !result.dryRunAsJson && (parser.value("dryRun") != QStringLiteral("text"))) {
+        error << "Option 'dryRun' could not be parsed: '" << parser.value("dryRun").toStdString() << "', expected 'text' or 'json'." << std::endl;
+        return std::nullopt;
+    } else if (result.haveDryRun && (result.list || result.watch || result.haveLint || result.haveServe)) {
+        error << "The option 'dryRun' can not be combined with 'list', 'watch', 'lint' or 'serve'." << std::endl;
+        return std::nullopt;
+    }
+
+    result.newEntityIds = parser.isSet("newEntityIds");
+    if (result.newEntityIds && (result.stream || result.binaryCache)) {
+        // Streamed copies have no patch template to locate the ids with, and bp.sbcB5 would keep the old ones
+        error << "The option 'newEntityIds' can not be combined with 'stream' or 'binaryCache'." << std::endl;
+        return std::nullopt;
+    }
+
+    // Zero would reject every blueprint, except for the time budget where it turns the budget off
+    ParseLimits const defaultLimits = ParseLimits::defaults();
+    auto const parseLimit = [&](QString const& name, qint64 defaultValue, bool allowZero) -> std::optional<qint64> {
+        if (!parser.isSet(name)) {
+            return defaultValue;
+        }
+        std::optional<qint64> const value = parseLongLong(name, parser, error);
+        if (value && (*value == 0) && !allowZero) {
+            error << "Option '" << name.toStdString() << "' has to be at least 1." << std::endl;
+            return std::nullopt;
+        }
+        return value;
+    };
+    auto const maxDepth = parseLimit("maxDepth", defaultLimits.maxDepth, false);
+    auto const maxBytes = parseLimit("maxBytes", defaultLimits.maxBytes, false);
+    auto const maxBlocks = parseLimit("maxBlocks", defaultLimits.maxBlocks, false);
+    auto const maxCustomData = parseLimit("maxCustomData", defaultLimits.maxCustomData, false);
+    auto const timeBudget = parseLimit("timeBudget", defaultLimits.timeBudget, true);
+    if (!maxDepth || !maxBytes || !maxBlocks || !maxCustomData || !timeBudget) {
+        return std::nullopt;
+    }
+    result.parseLimits = ParseLimits(*maxDepth, *maxBytes, *maxBlocks, *maxCustomData, *timeBudget);
+
+    return result;
 }
@@ -5,37 +5,89 @@
 #include <QCoreApplication>
 #include <QString>
 
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+#include "CustomData.h"
+#include "ParseLimits.h"
+#include "Salvo.h"
+#include "Sidecars.h"
+
+/*
+	Everything given on the command line. A default-constructed Options is a plain, non-interactive run without any of
+	the optional modes, so embedders and the benchmark only set the fields they need.
+*/
 class Options {
 public:
-	Options(
-		bool haveBlueprintLocation,	QString const& userBlueprintLocation,
-		bool haveBlueprintName, QString const& userBlueprintName,
-		bool haveFirstIndex, qsizetype userFirstIndex,
-		bool haveNumCopies, qsizetype userNumCopies,
-		bool force
-	) :
-		haveBlueprintLocation(haveBlueprintLocation), userBlueprintLocation(userBlueprintLocation),
-		haveBlueprintName(haveBlueprintName), userBlueprintName(userBlueprintName),
-		haveFirstIndex(haveFirstIndex), userFirstIndex(userFirstIndex),
-		haveNumCopies(haveNumCopies), userNumCopies(userNumCopies),
-		force(force) {
-	}
-
-	bool const haveBlueprintLocation;
-	QString const userBlueprintLocation;
-
-	bool const haveBlueprintName;
-	QString const userBlueprintName;
-
-	bool const haveFirstIndex;
-	qsizetype const userFirstIndex;
-
-	bool const haveNumCopies;
-	qsizetype const userNumCopies;
-
-	bool const force;
-
-	static Options parseOptions(QCoreApplication const& app);
+	bool haveBlueprintLocation = false;
+	QString userBlueprintLocation;
+
+	bool haveBlueprintName = false;
+	QString userBlueprintName;
+
+	bool haveFirstIndex = false;
+	qsizetype userFirstIndex = -1;
+
+	bool haveNumCopies = false;
+	qsizetype userNumCopies = -1;
+
+	bool force = false;
+
+	qsizetype jobs = 1;
+
+	bool mmap = false;
+	bool stream = false;
+
+	bool binaryCache = false;
+
+	bool index = false;
+	bool list = false;
+
+	bool haveFamily = false;
+	QString userFamily;
+
+	bool haveManifest = false;
+	QString userManifest;
+
+	bool haveStats = false;
+	bool statsAsJson = false;
+
+	bool haveTrace = false;
+	QString userTrace;
+
+	bool verifyParse = false;
+
+	bool incremental = false;
+
+	bool async = false;
+
+	Sidecars::Strategy sidecarStrategy = Sidecars::Strategy::Auto;
+
+	bool watch = false;
+
+	bool archive = false;
+
+	bool haveLint = false;
+	bool lintAsJson = false;
+
+	bool haveServe = false;
+	QString userServe;
+
+	bool haveSalvo = false;
+	Salvo::Pattern salvoPattern{ { 0.0, 0.0, 0.0 }, 0, { 0.0, 0.0, 0.0 } };
+
+	std::vector<CustomData::Override> customDataOverrides;
+
+	bool haveDryRun = false;
+	bool dryRunAsJson = false;
+
+	bool newEntityIds = false;
+
+	ParseLimits parseLimits = ParseLimits::defaults();
+
+	// Nothing if the options are invalid, the reason was written to error then
+	static std::optional<Options> parseOptions(QCoreApplication const& app, std::ostream& error);
 };
 
 #endif
@@ -0,0 +1,78 @@
+#include "ParseLimits.h"
+
+#include <limits>
+
+namespace {
+    // Calls to checkTime between two looks at the clock
+    qsizetype const ticksPerCheck = 1024;
+}
+
+ParseLimits::ParseLimits(qsizetype maxDepth, qint64 maxBytes, qsizetype maxBlocks, qsizetype maxCustomData, qint64 timeBudget) : maxDepth(maxDepth), maxBytes(maxBytes), maxBlocks(maxBlocks), maxCustomData(maxCustomData), timeBudget(timeBudget) {
+	//
+}
+
+ParseLimits ParseLimits::defaults() {
+    // The game nests a few dozen levels deep and writes custom data of a few KiB
+    return ParseLimits(256, qint64(1024) * 1024 * 1024, 1000000, 1024 * 1024, 60000);
+}
+
+ParseLimits ParseLimits::none() {
+    return ParseLimits(std::numeric_limits<qsizetype>::max(), std::numeric_limits<qint64>::max(), std::numeric_limits<qsizetype>::max(), std::numeric_limits<qsizetype>::max(), 0);
+}
+
+ParseBudget::ParseBudget(ParseLimits const& limits) : m_limits(limits), m_timer(), m_ticks(0), m_error() {
+    m_timer.start();
+}
+
+bool ParseBudget::fail(QString const& error) {
+    if (m_error.isEmpty()) {
+        m_error = error;
+    }
+    return false;
+}
+
+bool ParseBudget::checkBytes(qint64 bytes) {
+    if (bytes > m_limits.maxBytes) {
+        return fail(QStringLiteral("The blueprint is larger than the limit of %1 bytes (see --maxBytes).").arg(m_limits.maxBytes));
+    }
+    return m_error.isEmpty();
+}
+
+bool ParseBudget::checkDepth(qsizetype depth, qint64 position) {
+    if (depth > m_limits.maxDepth) {
+        return fail(QStringLiteral("Elements are nested deeper than the limit of %1 at offset %2 (see --maxDepth).").arg(m_limits.maxDepth).arg(position));
+    }
+    return m_error.isEmpty();
+}
+
+bool ParseBudget::checkBlocks(qsizetype count, qint64 position) {
+    if (count > m_limits.maxBlocks) {
+        return fail(QStringLiteral("More named blocks than the limit of %1 at offset %2 (see --maxBlocks).").arg(m_limits.maxBlocks).arg(position));
+    }
+    return m_error.isEmpty();
+}
+
+bool ParseBudget::checkCustomData(qsizetype length, qint64 position) {
+    if (length > m_limits.maxCustomData) {
+        return fail(QStringLiteral("The WHAM custom data at offset %1 is longer than the limit of %2 (see --maxCustomData).").arg(position).arg(m_limits.maxCustomData));
+    }
+    return m_error.isEmpty();
+}
+
+bool ParseBudget::checkTime(qint64 position) {
+    if ((m_limits.timeBudget > 0) && (++m_ticks >= ticksPerCheck)) {
+        m_ticks = 0;
+        if (m_timer.elapsed() > m_limits.timeBudget) {
+            return fail(QStringLiteral("Reading the blueprint took longer than the budget of %1 ms, stopped at offset %2 (see --timeBudget).").arg(m_limits.timeBudget).arg(position));
+        }
+    }
+    return m_error.isEmpty();
+}
+
+bool ParseBudget::isExceeded() const {
+    return !m_error.isEmpty();
+}
+
+QString const& ParseBudget::getError() const {
+    return m_error;
+}
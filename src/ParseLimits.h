@@ -0,0 +1,58 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_PARSELIMITS_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_PARSELIMITS_H_
+
+#include <QElapsedTimer>
+#include <QString>
+
+/*
+	Bounds on how much a single blueprint may make the parsers do, so a damaged or hostile bp.sbc in a shared folder
+	can neither hang a batch run nor make it balloon in memory. The defaults are far above anything the game writes.
+	A ParseBudget enforces them while one document is read, it stops at the first exceeded limit and keeps the reason.
+*/
+class ParseLimits {
+public:
+	ParseLimits(qsizetype maxDepth, qint64 maxBytes, qsizetype maxBlocks, qsizetype maxCustomData, qint64 timeBudget);
+
+	static ParseLimits defaults();
+	// For documents that already passed the limits of the caller
+	static ParseLimits none();
+
+	// Element nesting
+	qsizetype maxDepth;
+	// Size of the whole document
+	qint64 maxBytes;
+	// Named blocks, i.e. CustomName entries
+	qsizetype maxBlocks;
+	// Length of the WHAM custom data
+	qsizetype maxCustomData;
+	// Milliseconds to read one document, 0 for no budget
+	qint64 timeBudget;
+};
+
+// Enforces the limits while one document is read
+class ParseBudget {
+public:
+	// The clock starts right away
+	explicit ParseBudget(ParseLimits const& limits);
+
+	// Each of these returns false once a limit is exceeded, positions are byte or character offsets for the error
+	bool checkBytes(qint64 bytes);
+	bool checkDepth(qsizetype depth, qint64 position);
+	bool checkBlocks(qsizetype count, qint64 position);
+	bool checkCustomData(qsizetype length, qint64 position);
+	// Only looks at the clock every so many calls, so it can be called for every element
+	bool checkTime(qint64 position);
+
+	bool isExceeded() const;
+	// Why reading was stopped, empty if it was not
+	QString const& getError() const;
+private:
+	ParseLimits const m_limits;
+	QElapsedTimer m_timer;
+	qsizetype m_ticks;
+	QString m_error;
+
+	bool fail(QString const& error);
+};
+
+#endif
@@ -0,0 +1,274 @@
+#include "PatchTemplate.h"
+
+#include <cstring>
+#include <ostream>
+
+#include "BlueprintData.h"
+#include "BlueprintScanner.h"
+
+PatchTemplate::PatchTemplate(QByteArray const& source, std::vector<Patch> const& patches) : m_source(source), m_patches(patches), m_customData(), m_overrides(), m_entityIds() {
+	//
+}
+
+PatchTemplate::PatchTemplate(QByteArray const& source, std::vector<Patch> const& patches, std::shared_ptr<CustomData const> const& customData, std::vector<CustomData::Override> const& overrides, std::shared_ptr<EntityIds const> const& entityIds) : m_source(source), m_patches(patches), m_customData(customData), m_overrides(overrides), m_entityIds(entityIds) {
+	//
+}
+
+qsizetype PatchTemplate::getPatchCount() const {
+    return static_cast<qsizetype>(m_patches.size());
+}
+
+QByteArray const& PatchTemplate::getSource() const {
+    return m_source;
+}
+
+std::vector<PatchTemplate::Patch> const& PatchTemplate::getPatches() const {
+    return m_patches;
+}
+
+QByteArray PatchTemplate::instantiateCustomData(qsizetype newId) const {
+    return (m_customData) ? m_customData->instantiate(newId, m_overrides) : QByteArray();
+}
+
+QByteArray PatchTemplate::instantiateEntityId(qsizetype newId, qsizetype index) const {
+    return QByteArray::number(m_entityIds->generate(newId, index));
+}
+
+PatchTemplate PatchTemplate::withEntityIds(std::shared_ptr<EntityIds const> const& entityIds) const {
+    // Ids inside a range that is already patched, like the custom data, are left to that patch
+    std::vector<Patch> patches;
+    patches.reserve(m_patches.size() + entityIds->getLocations().size());
+    auto it = m_patches.begin();
+    for (auto const& location : entityIds->getLocations()) {
+        while ((it != m_patches.end()) && (it->end <= location.begin)) {
+            patches.push_back(*it++);
+        }
+        if ((it == m_patches.end()) || (location.end <= it->begin)) {
+            patches.push_back({ location.begin, location.end, QByteArray(), false, location.index });
+        }
+    }
+    patches.insert(patches.end(), it, m_patches.end());
+    return PatchTemplate(m_source, patches, m_customData, m_overrides, entityIds);
+}
+
+QByteArray PatchTemplate::instantiate(qsizetype newId) const {
+    QByteArray result;
+    instantiate(newId, result);
+    return result;
+}
+
+void PatchTemplate::instantiate(qsizetype newId, QByteArray& result) const {
+    QByteArray const number = QByteArray::number(newId);
+
+    // An unshared result keeps its memory, so only the first copy on a buffer allocates
+    result.resize(0);
+    result.reserve(m_source.size() + static_cast<qsizetype>(m_patches.size()) * number.size());
+
+    qsizetype cursor = 0;
+    for (auto const& patch : m_patches) {
+        result.append(m_source.constData() + cursor, patch.begin - cursor);
+        if (patch.entityId >= 0) {
+            result.append(instantiateEntityId(newId, patch.entityId));
+        } else if (patch.customData) {
+            result.append(instantiateCustomData(newId));
+        } else {
+            result.append(patch.prefix);
+            result.append(number);
+        }
+        cursor = patch.end;
+    }
+    result.append(m_source.constData() + cursor, m_source.size() - cursor);
+}
+
+std::vector<PatchTemplate::Slice> PatchTemplate::slices(QByteArray const& number, QByteArray& scratch) const {
+    // Everything generated goes into scratch first, slices can only point into it once it is complete
+    qsizetype const newId = number.toLongLong();
+    std::vector<qsizetype> offsets;
+    scratch.resize(0);
+    if (m_customData || m_entityIds) {
+        for (auto const& patch : m_patches) {
+            if (patch.entityId >= 0) {
+                offsets.push_back(scratch.size());
+                scratch.append(instantiateEntityId(newId, patch.entityId));
+            } else if (patch.customData) {
+                offsets.push_back(scratch.size());
+                scratch.append(instantiateCustomData(newId));
+            }
+        }
+        offsets.push_back(scratch.size());
+    }
+
+    std::vector<Slice> result;
+    result.reserve(3 * m_patches.size() + 1);
+
+    qsizetype cursor = 0;
+    std::size_t generated = 0;
+    for (auto const& patch : m_patches) {
+        if (patch.begin > cursor) {
+            result.push_back({ m_source.constData() + cursor, patch.begin - cursor });
+        }
+        if ((patch.entityId >= 0) || patch.customData) {
+            qsizetype const begin = offsets.at(generated);
+            qsizetype const end = offsets.at(generated + 1);
+            result.push_back({ scratch.constData() + begin, end - begin });
+            ++generated;
+            cursor = patch.end;
+            continue;
+        }
+        if (!patch.prefix.isEmpty()) {
+            result.push_back({ patch.prefix.constData(), patch.prefix.size() });
+        }
+        result.push_back({ number.constData(), number.size() });
+        cursor = patch.end;
+    }
+    if (m_source.size() > cursor) {
+        result.push_back({ m_source.constData() + cursor, m_source.size() - cursor });
+    }
+
+    return result;
+}
+
+qsizetype PatchTemplate::trailingDigitsBegin(QByteArray const& source, qsizetype begin, qsizetype end) {
+    qsizetype pos = end;
+    while (pos > begin) {
+        char const c = source.at(pos - 1);
+        if (('0' <= c) && (c <= '9')) {
+            --pos;
+        } else {
+            break;
+        }
+    }
+    return pos;
+}
+
+bool PatchTemplate::isNumber(QByteArray const& source, qsizetype begin, qsizetype end, int expected) {
+    if (end <= begin) {
+        return false;
+    }
+    bool ok = false;
+    int const value = QByteArray(source.constData() + begin, end - begin).toInt(&ok);
+    return ok && (value == expected);
+}
+
+std::optional<PatchTemplate> PatchTemplate::compile(QByteArray const& source, BlueprintData const& blueprintData, std::vector<CustomData::Override> const& overrides, std::ostream& error) {
+    // The blueprint data came from parsing the same source within the limits of the caller, which may be above the defaults
+    ParseBudget budget(ParseLimits::none());
+    auto const fields = BlueprintScanner::scan(source, budget, error);
+    if (!fields) {
+        return std::nullopt;
+    }
+    return compile(source, *fields, blueprintData, overrides, error);
+}
+
+std::optional<PatchTemplate> PatchTemplate::compile(QByteArray const& source, std::vector<BlueprintScanner::Field> const& fields, BlueprintData const& blueprintData, std::vector<CustomData::Override> const& overrides, std::ostream& error) {
+    int const id = blueprintData.getId();
+
+    // First pass: locate the group name (needed for the CustomName prefixes) and the last display name (the one fromXml kept)
+    BlueprintScanner::Field const* groupField = nullptr;
+    BlueprintScanner::Field const* displayNameField = nullptr;
+    qsizetype idCount = 0;
+    qsizetype customNameCount = 0;
+    qsizetype customDataCount = 0;
+    for (auto const& field : fields) {
+        switch (field.type) {
+            case BlueprintScanner::FieldType::IdSubtype: ++idCount; break;
+            case BlueprintScanner::FieldType::GridDisplayName: displayNameField = &field; break;
+            case BlueprintScanner::FieldType::GroupName:
+                if (groupField != nullptr) {
+                    error << "Template: More than one block group defined!" << std::endl;
+                    return std::nullopt;
+                }
+                groupField = &field;
+                break;
+            case BlueprintScanner::FieldType::BlockCustomName: ++customNameCount; break;
+            case BlueprintScanner::FieldType::CustomData: ++customDataCount; break;
+        }
+    }
+    if ((idCount != 1) || (displayNameField == nullptr) || (groupField == nullptr) || (customDataCount != 1) || (customNameCount != blueprintData.getItemCount())) {
+        error << "Template: Scanned structure does not match the parsed blueprint!" << std::endl;
+        return std::nullopt;
+    }
+
+    qsizetype const groupDigits = trailingDigitsBegin(source, groupField->begin, groupField->end);
+    if (!isNumber(source, groupDigits, groupField->end, id)) {
+        error << "Template: Group name does not end in the missile number!" << std::endl;
+        return std::nullopt;
+    }
+    qsizetype const groupLength = groupField->end - groupField->begin;
+    qsizetype const groupDigitsOffset = groupDigits - groupField->begin;
+
+    qsizetype const displayNameDigits = trailingDigitsBegin(source, displayNameField->begin, displayNameField->end);
+    if (!isNumber(source, displayNameDigits, displayNameField->end, id)) {
+        error << "Template: Display name does not end in the missile number!" << std::endl;
+        return std::nullopt;
+    }
+    // Like toXMLWithNewId, every grid gets the display name of the main grid
+    QByteArray const displayNameStem(source.constData() + displayNameField->begin, displayNameDigits - displayNameField->begin);
+
+    // Second pass: build the patches in document order
+    std::vector<Patch> patches;
+    patches.reserve(fields.size() + 1);
+    std::shared_ptr<CustomData const> customData;
+    for (auto const& field : fields) {
+        switch (field.type) {
+            case BlueprintScanner::FieldType::IdSubtype:
+            case BlueprintScanner::FieldType::GroupName: {
+                qsizetype const digits = trailingDigitsBegin(source, field.begin, field.end);
+                if (!isNumber(source, digits, field.end, id)) {
+                    error << "Template: Blueprint subtype or group name does not end in the missile number!" << std::endl;
+                    return std::nullopt;
+                }
+                patches.push_back({ digits, field.end, QByteArray(), false, -1 });
+                break;
+            }
+            case BlueprintScanner::FieldType::GridDisplayName:
+                patches.push_back({ field.begin, field.end, displayNameStem, false, -1 });
+                break;
+            case BlueprintScanner::FieldType::BlockCustomName: {
+                // The raw name has to start with "(" + raw group name + ")"
+                char const* const raw = source.constData() + field.begin;
+                if (((field.end - field.begin) < (groupLength + 2)) || (raw[0] != '(') || (raw[groupLength + 1] != ')') || (std::memcmp(raw + 1, source.constData() + groupField->begin, static_cast<std::size_t>(groupLength)) != 0)) {
+                    error << "Template: Item '" << QByteArray(raw, field.end - field.begin).toStdString() << "' does not carry the raw group name prefix!" << std::endl;
+                    return std::nullopt;
+                }
+                patches.push_back({ field.begin + 1 + groupDigitsOffset, field.begin + 1 + groupLength, QByteArray(), false, -1 });
+                break;
+            }
+            case BlueprintScanner::FieldType::CustomData: {
+                // Same as expressionCustomDataMissileNumber: "\nMissile number=(\d+)\n"
+                QByteArray const key("\nMissile number=");
+                qsizetype matches = 0;
+                qsizetype pos = source.indexOf(key, field.begin);
+                while ((pos >= 0) && (pos + key.size() <= field.end)) {
+                    qsizetype const digitsBegin = pos + key.size();
+                    qsizetype digitsEnd = digitsBegin;
+                    while ((digitsEnd < field.end) && ('0' <= source.at(digitsEnd)) && (source.at(digitsEnd) <= '9')) {
+                        ++digitsEnd;
+                    }
+                    if ((digitsEnd > digitsBegin) && (digitsEnd < field.end) && ((source.at(digitsEnd) == '\n') || (source.at(digitsEnd) == '\r'))) {
+                        if (!isNumber(source, digitsBegin, digitsEnd, id)) {
+                            error << "Template: Missile number in the WHAM custom data does not match!" << std::endl;
+                            return std::nullopt;
+                        }
+                        if (overrides.empty()) {
+                            patches.push_back({ digitsBegin, digitsEnd, QByteArray(), false, -1 });
+                        }
+                        ++matches;
+                    }
+                    pos = source.indexOf(key, digitsEnd);
+                }
+                if (matches == 0) {
+                    error << "Template: Failed to locate the missile number in the raw WHAM custom data!" << std::endl;
+                    return std::nullopt;
+                }
+                if (!overrides.empty()) {
+                    customData = std::make_shared<CustomData const>(QByteArray(source.constData() + field.begin, field.end - field.begin), true);
+                    patches.push_back({ field.begin, field.end, QByteArray(), true, -1 });
+                }
+                break;
+            }
+        }
+    }
+
+    return PatchTemplate(source, patches, customData, overrides, nullptr);
+}
@@ -0,0 +1,78 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_PATCHTEMPLATE_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_PATCHTEMPLATE_H_
+
+#include <QByteArray>
+
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "BlueprintScanner.h"
+#include "CustomData.h"
+#include "EntityIds.h"
+
+class BlueprintData;
+
+/*
+	A bp.sbc compiled once into unchanged byte segments and the locations that carry the missile number.
+	Every copy is produced by splicing the new number into those locations, so the output is
+	byte-identical to the source apart from the renumbered fields.
+*/
+class PatchTemplate {
+public:
+	struct Patch {
+		// Byte range in the source that is replaced
+		qsizetype begin;
+		qsizetype end;
+		// Raw bytes written in front of the new number
+		QByteArray prefix;
+		// The whole WHAM custom data, rebuilt from the model instead of getting the number
+		bool customData;
+		// With --newEntityIds, the index of the EntityId that replaces the range instead of the number, else -1
+		qsizetype entityId;
+	};
+
+	struct Slice {
+		char const* data;
+		qsizetype size;
+	};
+
+	PatchTemplate(QByteArray const& source, std::vector<Patch> const& patches);
+	PatchTemplate(QByteArray const& source, std::vector<Patch> const& patches, std::shared_ptr<CustomData const> const& customData, std::vector<CustomData::Override> const& overrides, std::shared_ptr<EntityIds const> const& entityIds);
+
+	QByteArray instantiate(qsizetype newId) const;
+	// Same into result, whose memory is reused as long as nobody else holds on to it
+	void instantiate(qsizetype newId, QByteArray& result) const;
+	// The copy as a list of slices into the source, the patch prefixes, number and scratch, valid while all are
+	// alive. scratch receives the rebuilt WHAM custom data and the new EntityIds, if the template has them.
+	std::vector<Slice> slices(QByteArray const& number, QByteArray& scratch) const;
+	// The rebuilt WHAM custom data of a copy, for the patch marked customData
+	QByteArray instantiateCustomData(qsizetype newId) const;
+	// The new EntityId of a copy, for a patch with an entityId
+	QByteArray instantiateEntityId(qsizetype newId, qsizetype index) const;
+	// The same template that also gives every copy its own EntityIds
+	PatchTemplate withEntityIds(std::shared_ptr<EntityIds const> const& entityIds) const;
+	qsizetype getPatchCount() const;
+	QByteArray const& getSource() const;
+	// In document order, the ranges do not overlap
+	std::vector<Patch> const& getPatches() const;
+
+	// Problems are written to error. With --customData overrides, the WHAM custom data becomes a single patch rebuilt
+	// for every copy.
+	static std::optional<PatchTemplate> compile(QByteArray const& source, BlueprintData const& blueprintData, std::vector<CustomData::Override> const& overrides, std::ostream& error);
+	// Same with fields already scanned from source
+	static std::optional<PatchTemplate> compile(QByteArray const& source, std::vector<BlueprintScanner::Field> const& fields, BlueprintData const& blueprintData, std::vector<CustomData::Override> const& overrides, std::ostream& error);
+private:
+	QByteArray const m_source;
+	std::vector<Patch> const m_patches;
+	// Only set with overrides, parsed once from the raw bytes of the custom data
+	std::shared_ptr<CustomData const> const m_customData;
+	std::vector<CustomData::Override> const m_overrides;
+	std::shared_ptr<EntityIds const> const m_entityIds;
+
+	static qsizetype trailingDigitsBegin(QByteArray const& source, qsizetype begin, qsizetype end);
+	static bool isNumber(QByteArray const& source, qsizetype begin, qsizetype end, int expected);
+};
+
+#endif
@@ -0,0 +1,165 @@
+#include "Salvo.h"
+
+#include <QLocale>
+#include <QStringList>
+
+#include <algorithm>
+#include <ostream>
+
+Salvo::Salvo(PatchTemplate const& patchTemplate, qsizetype gridsBegin, qsizetype gridsEnd, qsizetype separatorBegin, std::vector<Edit> const& edits, qsizetype gridCount) : m_patchTemplate(patchTemplate), m_gridsBegin(gridsBegin), m_gridsEnd(gridsEnd), m_separatorBegin(separatorBegin), m_edits(edits), m_gridCount(gridCount) {
+	//
+}
+
+qsizetype Salvo::getGridCount() const {
+    return m_gridCount;
+}
+
+std::optional<Salvo::Vector> Salvo::parseVector(QString const& text) {
+    QStringList const parts = text.split(QChar(','));
+    if (parts.size() != 3) {
+        return std::nullopt;
+    }
+    bool okX = false;
+    bool okY = false;
+    bool okZ = false;
+    Vector const result{ parts.at(0).trimmed().toDouble(&okX), parts.at(1).trimmed().toDouble(&okY), parts.at(2).trimmed().toDouble(&okZ) };
+    if (!okX || !okY || !okZ) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+std::optional<Salvo::Pattern> Salvo::parsePattern(QString const& text) {
+    QStringList const parts = text.split(QChar(':'));
+    if ((parts.size() != 1) && (parts.size() != 3)) {
+        return std::nullopt;
+    }
+    auto const step = parseVector(parts.at(0));
+    if (!step) {
+        return std::nullopt;
+    } else if (parts.size() == 1) {
+        return Pattern{ *step, 0, Vector{ 0.0, 0.0, 0.0 } };
+    }
+
+    bool ok = false;
+    qsizetype const columns = parts.at(1).trimmed().toLongLong(&ok);
+    auto const rowStep = parseVector(parts.at(2));
+    if (!ok || (columns < 1) || !rowStep) {
+        return std::nullopt;
+    }
+    return Pattern{ *step, columns, *rowStep };
+}
+
+Salvo::Vector Salvo::offset(Pattern const& pattern, qsizetype index) {
+    // Without columns, all copies are in one row
+    qsizetype const column = (pattern.columns > 0) ? (index % pattern.columns) : index;
+    qsizetype const row = (pattern.columns > 0) ? (index / pattern.columns) : 0;
+    double const c = static_cast<double>(column);
+    double const r = static_cast<double>(row);
+    return Vector{ c * pattern.step.x + r * pattern.rowStep.x, c * pattern.step.y + r * pattern.rowStep.y, c * pattern.step.z + r * pattern.rowStep.z };
+}
+
+std::optional<Salvo> Salvo::compile(PatchTemplate const& patchTemplate, std::ostream& error) {
+    QByteArray const& source = patchTemplate.getSource();
+    QByteArray const gridOpen("<CubeGrid>");
+    QByteArray const gridClose("</CubeGrid>");
+
+    // Markup characters in text are always escaped, so the tags can be searched for as bytes
+    qsizetype const gridsBegin = source.indexOf(gridOpen);
+    qsizetype const lastGridClose = source.lastIndexOf(gridClose);
+    if ((gridsBegin < 0) || (lastGridClose < gridsBegin)) {
+        error << "Salvo: The blueprint does not contain any grids!" << std::endl;
+        return std::nullopt;
+    }
+    qsizetype const gridsEnd = lastGridClose + gridClose.size();
+    qsizetype separatorBegin = gridsBegin;
+    while ((separatorBegin > 0) && QChar(source.at(separatorBegin - 1)).isSpace()) {
+        --separatorBegin;
+    }
+
+    std::vector<Edit> edits;
+    for (auto const& patch : patchTemplate.getPatches()) {
+        bool const inside = (patch.begin >= gridsBegin) && (patch.end <= gridsEnd);
+        bool const outside = (patch.end <= gridsBegin) || (patch.begin >= gridsEnd);
+        if (!inside && !outside) {
+            error << "Salvo: A numbered field at byte " << patch.begin << " crosses the boundary of the grids!" << std::endl;
+            return std::nullopt;
+        }
+        edits.push_back({ patch.begin, patch.end, patch.prefix, (patch.entityId >= 0) ? -3 : ((patch.customData) ? -2 : -1), 0.0, patch.entityId });
+    }
+
+    // The position of a grid is its first PositionAndOrientation, which comes before any of its blocks
+    QByteArray const axisKeys[3] = { QByteArray(" x=\""), QByteArray(" y=\""), QByteArray(" z=\"") };
+    qsizetype gridCount = 0;
+    for (qsizetype grid = gridsBegin; (grid >= 0) && (grid < gridsEnd); grid = source.indexOf(gridOpen, grid + gridOpen.size())) {
+        qsizetype const gridEnd = source.indexOf(gridClose, grid);
+        qsizetype const blocks = source.indexOf("<CubeBlocks", grid);
+        qsizetype const placement = source.indexOf("<PositionAndOrientation>", grid);
+        qsizetype const position = (placement < 0) ? -1 : source.indexOf("<Position ", placement);
+        qsizetype const tagEnd = (position < 0) ? -1 : source.indexOf('>', position);
+        if ((placement < 0) || (position < 0) || (tagEnd < 0) || (tagEnd > gridEnd) || ((blocks >= 0) && (blocks < placement))) {
+            error << "Salvo: The grid at byte " << grid << " has no position!" << std::endl;
+            return std::nullopt;
+        }
+        for (int axis = 0; axis < 3; ++axis) {
+            qsizetype const key = source.indexOf(axisKeys[axis], position);
+            qsizetype const valueBegin = key + axisKeys[axis].size();
+            qsizetype const valueEnd = (key < 0) ? -1 : source.indexOf('"', valueBegin);
+            bool ok = false;
+            double const value = (valueEnd < 0) ? 0.0 : QByteArray(source.constData() + valueBegin, valueEnd - valueBegin).toDouble(&ok);
+            if ((key < 0) || (valueEnd > tagEnd) || !ok) {
+                error << "Salvo: The position of the grid at byte " << grid << " could not be read!" << std::endl;
+                return std::nullopt;
+            }
+            edits.push_back({ valueBegin, valueEnd, QByteArray(), axis, value, -1 });
+        }
+        ++gridCount;
+    }
+
+    std::sort(edits.begin(), edits.end(), [](Edit const& a, Edit const& b) { return a.begin < b.begin; });
+    return Salvo(patchTemplate, gridsBegin, gridsEnd, separatorBegin, edits, gridCount);
+}
+
+void Salvo::append(QByteArray& out, qsizetype begin, qsizetype end, QByteArray const& number, Vector const& offset) const {
+    QByteArray const& source = m_patchTemplate.getSource();
+    auto it = std::lower_bound(m_edits.begin(), m_edits.end(), begin, [](Edit const& edit, qsizetype position) { return edit.begin < position; });
+    qsizetype cursor = begin;
+    for (; (it != m_edits.end()) && (it->end <= end); ++it) {
+        out.append(source.constData() + cursor, it->begin - cursor);
+        if (it->axis == -3) {
+            out.append(m_patchTemplate.instantiateEntityId(number.toLongLong(), it->entityId));
+        } else if (it->axis == -2) {
+            out.append(m_patchTemplate.instantiateCustomData(number.toLongLong()));
+        } else if (it->axis < 0) {
+            out.append(it->prefix);
+            out.append(number);
+        } else {
+            double const shift = (it->axis == 0) ? offset.x : ((it->axis == 1) ? offset.y : offset.z);
+            out.append(QByteArray::number(it->value + shift, 'g', QLocale::FloatingPointShortest));
+        }
+        cursor = it->end;
+    }
+    out.append(source.constData() + cursor, end - cursor);
+}
+
+bool Salvo::write(QIODevice& output, qsizetype firstIndex, qsizetype count, Pattern const& pattern, QByteArray const& label) const {
+    QByteArray const& source = m_patchTemplate.getSource();
+    Vector const origin{ 0.0, 0.0, 0.0 };
+
+    // One buffer for the whole run, every copy is written as soon as it is complete
+    QByteArray buffer;
+    buffer.reserve(m_gridsEnd - m_gridsBegin + 1024);
+    append(buffer, 0, m_gridsBegin, label, origin);
+    for (qsizetype i = 0; i < count; ++i) {
+        if (i > 0) {
+            buffer.append(source.constData() + m_separatorBegin, m_gridsBegin - m_separatorBegin);
+        }
+        append(buffer, m_gridsBegin, m_gridsEnd, QByteArray::number(firstIndex + i), offset(pattern, i));
+        if (output.write(buffer) != buffer.size()) {
+            return false;
+        }
+        buffer.resize(0);
+    }
+    append(buffer, m_gridsEnd, source.size(), label, origin);
+    return output.write(buffer) == buffer.size();
+}
@@ -0,0 +1,72 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_SALVO_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_SALVO_H_
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+#include "PatchTemplate.h"
+
+/*
+	A salvo is a single blueprint holding several renumbered copies of all grids of the source, used by --salvo.
+	Every copy gets its own numbers in the display name, group, CustomName prefixes and WHAM custom data, with
+	--newEntityIds also its own EntityIds, and all of its grids are moved by the offset of the copy. Everything around
+	the grids is written once, the numbers in it (the blueprint Id) get a label instead. The source is split into
+	these parts once, from its patch template.
+*/
+class Salvo {
+public:
+	struct Vector {
+		double x;
+		double y;
+		double z;
+	};
+
+	// Copy i is placed at (i % columns) * step + (i / columns) * rowStep from the source
+	struct Pattern {
+		Vector step;
+		qsizetype columns;
+		Vector rowStep;
+	};
+
+	// Either "x,y,z" for a single row or "x,y,z:columns:x,y,z" for rows of the given length, in meters
+	static std::optional<Pattern> parsePattern(QString const& text);
+	static Vector offset(Pattern const& pattern, qsizetype index);
+
+	static std::optional<Salvo> compile(PatchTemplate const& patchTemplate, std::ostream& error);
+
+	qsizetype getGridCount() const;
+	// Writes the copies [firstIndex, firstIndex + count) in one pass over the source
+	bool write(QIODevice& output, qsizetype firstIndex, qsizetype count, Pattern const& pattern, QByteArray const& label) const;
+private:
+	// A change to the source: a number patch (axis -1), the WHAM custom data (axis -2), an EntityId (axis -3) or one
+	// coordinate of a grid position if axis is not negative
+	struct Edit {
+		qsizetype begin;
+		qsizetype end;
+		QByteArray prefix;
+		int axis;
+		double value;
+		qsizetype entityId;
+	};
+
+	PatchTemplate const m_patchTemplate;
+	// The copied part runs from the first <CubeGrid> to the last </CubeGrid>, copies are separated like the source is
+	qsizetype const m_gridsBegin;
+	qsizetype const m_gridsEnd;
+	qsizetype const m_separatorBegin;
+	std::vector<Edit> const m_edits;
+	qsizetype const m_gridCount;
+
+	Salvo(PatchTemplate const& patchTemplate, qsizetype gridsBegin, qsizetype gridsEnd, qsizetype separatorBegin, std::vector<Edit> const& edits, qsizetype gridCount);
+
+	// Appends the source range [begin, end) with the edits in it, numbered number and moved by offset
+	void append(QByteArray& out, qsizetype begin, qsizetype end, QByteArray const& number, Vector const& offset) const;
+	static std::optional<Vector> parseVector(QString const& text);
+};
+
+#endif
@@ -0,0 +1,183 @@
+#include "Server.h"
+
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QPointer>
+
+#include <cmath>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include "Stats.h"
+
+namespace {
+    // JSON numbers are doubles, so the counts are accepted if they are whole and not negative
+    bool readCount(QJsonObject const& object, QString const& key, qsizetype& value) {
+        QJsonValue const field = object.value(key);
+        if (!field.isDouble()) {
+            return false;
+        }
+        double const number = field.toDouble();
+        if ((number < 0.0) || (number > 2147483647.0) || (std::floor(number) != number)) {
+            return false;
+        }
+        value = static_cast<qsizetype>(number);
+        return true;
+    }
+}
+
+Server::Server(qsizetype jobs, Handler const& handler) : m_jobs((jobs < 1) ? 1 : jobs), m_handler(handler), m_stopping(false) {
+    m_threads.reserve(static_cast<std::size_t>(m_jobs));
+    for (qsizetype i = 0; i < m_jobs; ++i) {
+        m_threads.emplace_back([this]() { worker(); });
+    }
+}
+
+Server::~Server() {
+    stop();
+}
+
+void Server::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+}
+
+void Server::worker() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [&]() { return m_stopping || !m_tasks.empty(); });
+            // Requests that are already queued are still answered when stopping
+            if (m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void Server::submit(QByteArray const& line, Reply const& reply) {
+    auto timer = std::make_shared<QElapsedTimer>();
+    timer->start();
+    auto task = [this, line, reply, timer]() {
+        qint64 const queueMs = timer->elapsed();
+        QJsonValue id;
+        QString error;
+        auto const request = parseRequest(line, id, error);
+        QJsonObject response;
+        if (request) {
+            Stats::Span const span("request");
+            response = m_handler(*request);
+        } else {
+            response.insert(QStringLiteral("ok"), false);
+            response.insert(QStringLiteral("error"), error);
+        }
+        response.insert(QStringLiteral("id"), id);
+        response.insert(QStringLiteral("queueMs"), static_cast<double>(queueMs));
+        response.insert(QStringLiteral("wallMs"), static_cast<double>(timer->elapsed()));
+        reply(QJsonDocument(response).toJson(QJsonDocument::Compact).append('\n'));
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+std::optional<Server::Request> Server::parseRequest(QByteArray const& line, QJsonValue& id, QString& error) {
+    QJsonParseError parseError;
+    QJsonDocument const document = QJsonDocument::fromJson(line, &parseError);
+    if ((parseError.error != QJsonParseError::NoError) || !document.isObject()) {
+        error = QStringLiteral("The request is not a JSON object.");
+        return std::nullopt;
+    }
+    QJsonObject const object = document.object();
+    id = object.value(QStringLiteral("id"));
+
+    Request result{ id, object.value(QStringLiteral("blueprint")).toString(), 0, 0 };
+    if (result.blueprint.isEmpty()) {
+        error = QStringLiteral("The request has no 'blueprint'.");
+        return std::nullopt;
+    } else if (!readCount(object, QStringLiteral("firstIndex"), result.firstIndex)) {
+        error = QStringLiteral("The request has no valid 'firstIndex'.");
+        return std::nullopt;
+    } else if (!readCount(object, QStringLiteral("numCopies"), result.numCopies) || (result.numCopies < 1)) {
+        error = QStringLiteral("The request has no valid 'numCopies'.");
+        return std::nullopt;
+    }
+    return result;
+}
+
+void Server::runStdio(std::istream& input, std::ostream& output) {
+    std::mutex outputMutex;
+    Reply const reply = [&](QByteArray const& response) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        output.write(response.constData(), response.size());
+        output.flush();
+    };
+
+    std::string line;
+    while (std::getline(input, line)) {
+        QByteArray const request = QByteArray::fromStdString(line).trimmed();
+        if (!request.isEmpty()) {
+            submit(request, reply);
+        }
+    }
+    // The reply refers to this frame, so every request has to be answered before returning
+    stop();
+}
+
+bool Server::listen(QString const& name, std::ostream& error) {
+    // A socket left behind by a previous run that did not shut down cleanly would block the name
+    QLocalServer::removeServer(name);
+    m_localServer = std::make_unique<QLocalServer>();
+    if (!m_localServer->listen(name)) {
+        error << "Error: Could not listen on '" << name.toStdString() << "': " << m_localServer->errorString().toStdString() << std::endl;
+        return false;
+    }
+
+    QLocalServer* const localServer = m_localServer.get();
+    QObject::connect(localServer, &QLocalServer::newConnection, [this, localServer]() {
+        while (localServer->hasPendingConnections()) {
+            QLocalSocket* const socket = localServer->nextPendingConnection();
+            QPointer<QLocalSocket> const guard(socket);
+            QObject::connect(socket, &QLocalSocket::disconnected, [socket]() { socket->deleteLater(); });
+            QObject::connect(socket, &QLocalSocket::readyRead, [this, localServer, socket, guard]() {
+                while (socket->canReadLine()) {
+                    QByteArray const request = socket->readLine().trimmed();
+                    if (request.isEmpty()) {
+                        continue;
+                    }
+                    // Sockets may only be written on their own thread, the client may be gone by then
+                    submit(request, [localServer, guard](QByteArray const& response) {
+                        QMetaObject::invokeMethod(localServer, [guard, response]() {
+                            if (guard) {
+                                guard->write(response);
+                            }
+                        }, Qt::QueuedConnection);
+                    });
+                }
+            });
+        }
+    });
+    return true;
+}
+
+QString Server::getServerName() const {
+    return (m_localServer) ? m_localServer->fullServerName() : QString();
+}
@@ -0,0 +1,74 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_SERVER_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_SERVER_H_
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QString>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+class QLocalServer;
+
+/*
+	Answers duplication requests for --serve, one JSON object per line in both directions.
+	Requests are read from stdin or from clients of a local socket (a Unix domain socket, a named pipe on Windows)
+	and run on a fixed pool of threads, so several of them are in flight at once. Every request gets exactly one
+	response as soon as it is done, which is not necessarily the order they came in; the "id" of the request is
+	echoed to match them up. The handler does the actual work, the server adds the id and the timings.
+*/
+class Server {
+public:
+	struct Request {
+		QJsonValue id;
+		QString blueprint;
+		qsizetype firstIndex;
+		qsizetype numCopies;
+	};
+
+	// Returns the response without id and timings, "ok" tells whether the request succeeded
+	using Handler = std::function<QJsonObject(Request const& request)>;
+	using Reply = std::function<void(QByteArray const& line)>;
+
+	Server(qsizetype jobs, Handler const& handler);
+	~Server();
+
+	Server(Server const&) = delete;
+	Server& operator=(Server const&) = delete;
+
+	// Answers requests from input on output until input is closed and every request is answered, used with stdin and stdout
+	void runStdio(std::istream& input, std::ostream& output);
+	// Accepts clients on the local socket with the given name, requires a running event loop. Why the name can not be
+	// used goes to error.
+	bool listen(QString const& name, std::ostream& error);
+	// The full name of the socket clients connect to, once listening
+	QString getServerName() const;
+private:
+	qsizetype const m_jobs;
+	Handler const m_handler;
+	std::unique_ptr<QLocalServer> m_localServer;
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<std::function<void()>> m_tasks;
+	bool m_stopping;
+	std::vector<std::thread> m_threads;
+
+	// Answers a line on a worker thread, reply is called from that thread
+	void submit(QByteArray const& line, Reply const& reply);
+	void worker();
+	void stop();
+
+	// The id is set as soon as the line is a JSON object, even if the rest of the request is invalid
+	static std::optional<Request> parseRequest(QByteArray const& line, QJsonValue& id, QString& error);
+};
+
+#endif
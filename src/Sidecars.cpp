@@ -0,0 +1,237 @@
+#include "Sidecars.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QtGlobal>
+
+#include <cstring>
+#include <ostream>
+
+#ifdef Q_OS_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+
+#ifdef Q_OS_MACOS
+#include <sys/clonefile.h>
+#endif
+
+Sidecars::Sidecars(QDir const& sourceFolder, Strategy strategy) : m_sourceFolder(sourceFolder), m_strategy(strategy), m_reflinkFailed(false), m_hardlinkFailed(false), m_copyRangeFailed(false) {
+    for (auto const& name : sourceFolder.entryList(QDir::Files | QDir::NoDotAndDotDot)) {
+        if ((name == QStringLiteral("bp.sbc")) || (name == QStringLiteral("bp.sbcB5"))) {
+            continue;
+        }
+        File file{ name, std::nullopt };
+        if (strategy == Strategy::Copy) {
+            QFile input(sourceFolder.absoluteFilePath(name));
+            if (input.open(QFile::ReadOnly)) {
+                file.contents = input.readAll();
+            }
+        }
+        m_files.push_back(file);
+    }
+}
+
+Sidecars::Sidecars(std::vector<File> const& files) : m_sourceFolder(), m_strategy(Strategy::Copy), m_files(files), m_reflinkFailed(false), m_hardlinkFailed(false), m_copyRangeFailed(false) {
+	//
+}
+
+std::optional<Sidecars::Strategy> Sidecars::parseStrategy(QString const& name) {
+    if (name == QStringLiteral("auto")) {
+        return Strategy::Auto;
+    } else if (name == QStringLiteral("reflink")) {
+        return Strategy::Reflink;
+    } else if (name == QStringLiteral("hardlink")) {
+        return Strategy::Hardlink;
+    } else if (name == QStringLiteral("copyRange")) {
+        return Strategy::CopyRange;
+    } else if (name == QStringLiteral("copy")) {
+        return Strategy::Copy;
+    }
+    return std::nullopt;
+}
+
+std::vector<Sidecars::File> const& Sidecars::getFiles() const {
+    return m_files;
+}
+
+QStringList Sidecars::getReplacedFileNames() const {
+    QStringList result;
+    result.append(QStringLiteral("thumb.png"));
+    for (auto const& file : m_files) {
+        if (!result.contains(file.name)) {
+            result.append(file.name);
+        }
+    }
+    return result;
+}
+
+Sidecars::Strategy Sidecars::getStrategy() const {
+    return m_strategy;
+}
+
+std::optional<QByteArray> Sidecars::read(File const& file) const {
+    if (file.contents) {
+        return file.contents;
+    }
+    QFile input(m_sourceFolder.absoluteFilePath(file.name));
+    if (!input.open(QFile::ReadOnly)) {
+        return std::nullopt;
+    }
+    return input.readAll();
+}
+
+qint64 Sidecars::propagate(QDir const& copyFolder, std::ostream& error) const {
+    qint64 result = 0;
+    for (auto const& file : m_files) {
+        qint64 const written = propagate(copyFolder, file, error);
+        if (written < 0) {
+            result = -1;
+        } else if (result >= 0) {
+            result += written;
+        }
+    }
+    return result;
+}
+
+qint64 Sidecars::propagate(QDir const& copyFolder, File const& file, std::ostream& error) const {
+    QString const sourceName = m_sourceFolder.absoluteFilePath(file.name);
+    QString const targetName = copyFolder.absoluteFilePath(file.name);
+    if (m_strategy == Strategy::Copy) {
+        return copyContents(sourceName, targetName, file);
+    }
+
+#ifdef Q_OS_UNIX
+    QByteArray const source = QFile::encodeName(sourceName);
+    QByteArray const target = QFile::encodeName(targetName);
+    bool const mayReflink = (m_strategy == Strategy::Auto) || (m_strategy == Strategy::Reflink);
+
+    if ((m_strategy == Strategy::Hardlink) && !m_hardlinkFailed) {
+        if ((::link(source.constData(), target.constData()) == 0) || (errno == EEXIST)) {
+            return 0;
+        }
+        fallBack(m_hardlinkFailed, Strategy::Hardlink, "hardlink", errno, error);
+    }
+
+#ifdef Q_OS_MACOS
+    if (mayReflink && !m_reflinkFailed) {
+        if ((::clonefile(source.constData(), target.constData(), 0) == 0) || (errno == EEXIST)) {
+            return 0;
+        }
+        fallBack(m_reflinkFailed, Strategy::Reflink, "reflink", errno, error);
+    }
+#endif
+
+#ifdef Q_OS_LINUX
+    int const input = ::open(source.constData(), O_RDONLY | O_CLOEXEC);
+    if (input < 0) {
+        return -1;
+    }
+    int const output = ::open(target.constData(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (output < 0) {
+        int const openError = errno;
+        ::close(input);
+        return (openError == EEXIST) ? 0 : -1;
+    }
+
+    qint64 result = -1;
+    bool done = false;
+#ifdef FICLONE
+    if (mayReflink && !m_reflinkFailed) {
+        if (::ioctl(output, FICLONE, input) == 0) {
+            result = 0;
+            done = true;
+        } else {
+            fallBack(m_reflinkFailed, Strategy::Reflink, "reflink", errno, error);
+        }
+    }
+#endif
+
+    // Falls back only if nothing was copied yet, otherwise the error is real
+    if (!done && !m_copyRangeFailed) {
+        qint64 copied = 0;
+        while (!done) {
+            ssize_t const count = ::copy_file_range(input, nullptr, output, nullptr, 1 << 30, 0);
+            if (count > 0) {
+                copied += count;
+            } else if (count == 0) {
+                result = copied;
+                done = true;
+            } else if (errno == EINTR) {
+                continue;
+            } else if ((copied == 0) && ((errno == ENOSYS) || (errno == EXDEV) || (errno == EINVAL) || (errno == EOPNOTSUPP))) {
+                fallBack(m_copyRangeFailed, Strategy::CopyRange, "copy_file_range", errno, error);
+                break;
+            } else {
+                done = true;
+            }
+        }
+    }
+
+    if (!done) {
+        char buffer[64 * 1024];
+        qint64 copied = 0;
+        while (!done) {
+            ssize_t const count = ::read(input, buffer, sizeof(buffer));
+            if ((count < 0) && (errno == EINTR)) {
+                continue;
+            } else if (count <= 0) {
+                result = (count == 0) ? copied : -1;
+                break;
+            }
+            for (ssize_t offset = 0; offset < count;) {
+                ssize_t const written = ::write(output, buffer + offset, static_cast<std::size_t>(count - offset));
+                if ((written < 0) && (errno == EINTR)) {
+                    continue;
+                } else if (written <= 0) {
+                    done = true;
+                    break;
+                }
+                offset += written;
+            }
+            copied += count;
+        }
+    }
+
+    ::close(input);
+    if (::close(output) != 0) {
+        result = -1;
+    }
+    if (result < 0) {
+        ::unlink(target.constData());
+    }
+    return result;
+#endif
+#endif
+
+    return copyContents(sourceName, targetName, file);
+}
+
+qint64 Sidecars::copyContents(QString const& sourceName, QString const& targetName, File const& file) const {
+    if (QFile::exists(targetName)) {
+        return 0;
+    }
+    if (!file.contents) {
+        return (QFile::copy(sourceName, targetName)) ? QFileInfo(targetName).size() : -1;
+    }
+
+    QFile output(targetName);
+    if (!output.open(QFile::WriteOnly | QFile::NewOnly) || (output.write(*file.contents) != file.contents->size())) {
+        output.remove();
+        return -1;
+    }
+    return file.contents->size();
+}
+
+void Sidecars::fallBack(std::atomic<bool>& failed, Strategy strategy, char const* strategyName, int errorNumber, std::ostream& error) const {
+    // Only worth a warning if the strategy was asked for explicitly
+    if (!failed.exchange(true) && (m_strategy == strategy)) {
+        error << "Warning: Sidecar files can not be propagated by " << strategyName << " here (" << std::strerror(errorNumber) << "), falling back to copying them." << std::endl;
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_SIDECARS_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_SIDECARS_H_
+
+#include <QByteArray>
+#include <QDir>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+/*
+	The files next to bp.sbc that every copy gets unchanged, like thumb.png. bp.sbc and bp.sbcB5 are not sidecars,
+	they are generated for every copy. A sidecar is propagated with the cheapest strategy the file system supports:
+	a reflink (FICLONE, or clonefile on macOS) shares the data on copy-on-write file systems, a hardlink shares the
+	file itself, copy_file_range copies inside the kernel and a plain copy writes the contents read once up front.
+	A strategy that fails is not tried again for later files, the next one in this order is used instead.
+	Like QFile::copy, a sidecar that already exists in the copy folder is kept.
+*/
+class Sidecars {
+public:
+	enum class Strategy { Auto, Reflink, Hardlink, CopyRange, Copy };
+
+	struct File {
+		QString name;
+		// Only read for the plain copy strategy
+		std::optional<QByteArray> contents;
+	};
+
+	Sidecars(QDir const& sourceFolder, Strategy strategy);
+	// Sidecars that only exist in memory, like the ones in an archive, are always written with the plain copy strategy
+	explicit Sidecars(std::vector<File> const& files);
+
+	static std::optional<Strategy> parseStrategy(QString const& name);
+
+	std::vector<File> const& getFiles() const;
+	// Files an earlier copy may have left that have to be removed when it is replaced
+	QStringList getReplacedFileNames() const;
+	Strategy getStrategy() const;
+	// The contents of a sidecar, read from the source folder if they were not read up front
+	std::optional<QByteArray> read(File const& file) const;
+
+	// Returns the number of bytes written, which is zero for shared data, or -1 if a sidecar could not be propagated.
+	// Safe to call from several threads at once, as long as each passes its own error stream. A strategy that was asked
+	// for and has to be given up is reported there once.
+	qint64 propagate(QDir const& copyFolder, std::ostream& error) const;
+	qint64 propagate(QDir const& copyFolder, File const& file, std::ostream& error) const;
+private:
+	QDir const m_sourceFolder;
+	Strategy const m_strategy;
+	std::vector<File> m_files;
+
+	mutable std::atomic<bool> m_reflinkFailed;
+	mutable std::atomic<bool> m_hardlinkFailed;
+	mutable std::atomic<bool> m_copyRangeFailed;
+
+	qint64 copyContents(QString const& sourceName, QString const& targetName, File const& file) const;
+	void fallBack(std::atomic<bool>& failed, Strategy strategy, char const* strategyName, int errorNumber, std::ostream& error) const;
+};
+
+#endif
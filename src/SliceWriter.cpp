@@ -0,0 +1,67 @@
+#include "SliceWriter.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+
+#ifdef Q_OS_UNIX
+#include <sys/uio.h>
+#include <cerrno>
+#include <climits>
+#endif
+
+bool SliceWriter::write(QFile& file, std::vector<PatchTemplate::Slice> const& slices) {
+#ifdef Q_OS_UNIX
+    int const fd = file.handle();
+    if (fd < 0) {
+        return false;
+    }
+
+#ifdef IOV_MAX
+    std::size_t const maxVectors = IOV_MAX;
+#else
+    std::size_t const maxVectors = 1024;
+#endif
+
+    std::vector<iovec> vectors;
+    vectors.reserve(slices.size());
+    for (auto const& slice : slices) {
+        vectors.push_back({ const_cast<char*>(slice.data), static_cast<std::size_t>(slice.size) });
+    }
+
+    std::size_t first = 0;
+    while (first < vectors.size()) {
+        std::size_t const count = std::min(maxVectors, vectors.size() - first);
+        ssize_t written = ::writev(fd, vectors.data() + first, static_cast<int>(count));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        // Skip everything that was written completely and trim a partially written slice
+        while ((written > 0) && (first < vectors.size())) {
+            if (static_cast<std::size_t>(written) >= vectors[first].iov_len) {
+                written -= static_cast<ssize_t>(vectors[first].iov_len);
+                ++first;
+            } else {
+                vectors[first].iov_base = static_cast<char*>(vectors[first].iov_base) + written;
+                vectors[first].iov_len -= static_cast<std::size_t>(written);
+                written = 0;
+            }
+        }
+        while ((first < vectors.size()) && (vectors[first].iov_len == 0)) {
+            ++first;
+        }
+    }
+    return true;
+#else
+    for (auto const& slice : slices) {
+        if (file.write(slice.data, slice.size) != slice.size) {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
@@ -0,0 +1,16 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_SLICEWRITER_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_SLICEWRITER_H_
+
+#include <QFile>
+
+#include <vector>
+
+#include "PatchTemplate.h"
+
+class SliceWriter {
+public:
+	// Writes all slices to the (unbuffered) file, using writev where available
+	static bool write(QFile& file, std::vector<PatchTemplate::Slice> const& slices);
+};
+
+#endif
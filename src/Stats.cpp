@@ -0,0 +1,302 @@
+#include "Stats.h"
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#include <time.h>
+#elif defined(Q_OS_WIN)
+#include <windows.h>
+#endif
+
+namespace {
+    struct PhaseTotals {
+        std::string name;
+        qint64 count;
+        qint64 wall;
+        qint64 cpu;
+    };
+
+    struct CopyTimes {
+        qint64 latency;
+        qint64 begin;
+        qint64 end;
+    };
+
+    struct TraceEvent {
+        char const* phase;
+        qsizetype copy;
+        int thread;
+        qint64 begin;
+        qint64 duration;
+    };
+
+    std::chrono::steady_clock::time_point const startTime = std::chrono::steady_clock::now();
+
+    std::atomic<bool> enabled(false);
+    std::atomic<bool> tracing(false);
+    std::atomic<qint64> bytesRead(0);
+    std::atomic<qint64> bytesWritten(0);
+
+    std::mutex mutex;
+    // In order of first appearance
+    std::vector<PhaseTotals> phases;
+    std::map<qsizetype, CopyTimes> copies;
+    std::vector<TraceEvent> events;
+    std::map<std::thread::id, int> threadIds;
+
+    thread_local qsizetype currentCopy = -1;
+
+    double toMilliseconds(qint64 nanoseconds) {
+        return static_cast<double>(nanoseconds) / 1e6;
+    }
+
+    // Nearest-rank percentile of a sorted list
+    qint64 percentile(std::vector<qint64> const& sorted, int percent) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        std::size_t const rank = (sorted.size() * static_cast<std::size_t>(percent) + 99) / 100;
+        return sorted.at((rank == 0) ? 0 : (rank - 1));
+    }
+
+    struct CopySummary {
+        qsizetype count;
+        qint64 duration;
+        std::vector<qint64> latencies;
+    };
+
+    // Expects the mutex to be held
+    CopySummary summarizeCopies() {
+        CopySummary result{ static_cast<qsizetype>(copies.size()), 0, {} };
+        qint64 begin = 0;
+        qint64 end = 0;
+        for (auto const& copy : copies) {
+            begin = (result.latencies.empty()) ? copy.second.begin : std::min(begin, copy.second.begin);
+            end = std::max(end, copy.second.end);
+            result.latencies.push_back(copy.second.latency);
+        }
+        result.duration = end - begin;
+        std::sort(result.latencies.begin(), result.latencies.end());
+        return result;
+    }
+}
+
+Stats::Span::Span(char const* phase, qsizetype copy) : m_phase(phase), m_copy(copy), m_previousCopy(-1), m_wallBegin(-1), m_cpuBegin(-1) {
+    if (!enabled.load(std::memory_order_relaxed)) {
+        return;
+    }
+    m_previousCopy = currentCopy;
+    if (m_copy >= 0) {
+        currentCopy = m_copy;
+    }
+    m_cpuBegin = threadCpuNanoseconds();
+    m_wallBegin = wallNanoseconds();
+}
+
+Stats::Span::~Span() {
+    if (m_wallBegin < 0) {
+        return;
+    }
+    qint64 const wallEnd = wallNanoseconds();
+    qint64 const cpuEnd = threadCpuNanoseconds();
+    qsizetype const copy = currentCopy;
+    currentCopy = m_previousCopy;
+
+    Stats::record(m_phase, copy, m_copy >= 0, m_wallBegin, wallEnd, ((m_cpuBegin < 0) || (cpuEnd < 0)) ? -1 : (cpuEnd - m_cpuBegin));
+}
+
+void Stats::enable(bool trace) {
+    tracing.store(trace);
+    enabled.store(true);
+}
+
+bool Stats::isEnabled() {
+    return enabled.load(std::memory_order_relaxed);
+}
+
+void Stats::addBytesRead(qint64 bytes) {
+    bytesRead.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void Stats::addBytesWritten(qint64 bytes) {
+    bytesWritten.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+qint64 Stats::wallNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+qint64 Stats::threadCpuNanoseconds() {
+#if defined(Q_OS_UNIX)
+    struct timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0) {
+        return -1;
+    }
+    return static_cast<qint64>(time.tv_sec) * 1000000000 + static_cast<qint64>(time.tv_nsec);
+#elif defined(Q_OS_WIN)
+    FILETIME creation, exit, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user)) {
+        return -1;
+    }
+    // In units of 100ns
+    auto const toNanoseconds = [](FILETIME const& time) { return ((static_cast<qint64>(time.dwHighDateTime) << 32) | static_cast<qint64>(time.dwLowDateTime)) * 100; };
+    return toNanoseconds(kernel) + toNanoseconds(user);
+#else
+    return -1;
+#endif
+}
+
+qint64 Stats::getPeakResidentKiB() {
+#if defined(Q_OS_UNIX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) {
+        return -1;
+    }
+#ifdef Q_OS_MACOS
+    // Reported in bytes on MacOS
+    return static_cast<qint64>(usage.ru_maxrss) / 1024;
+#else
+    return static_cast<qint64>(usage.ru_maxrss);
+#endif
+#else
+    return -1;
+#endif
+}
+
+void Stats::record(char const* phase, qsizetype copy, bool topLevel, qint64 wallBegin, qint64 wallEnd, qint64 cpu) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = std::find_if(phases.begin(), phases.end(), [&](PhaseTotals const& totals) { return totals.name == phase; });
+    if (it == phases.end()) {
+        phases.push_back({ phase, 0, 0, 0 });
+        it = phases.end() - 1;
+    }
+    it->count += 1;
+    it->wall += wallEnd - wallBegin;
+    // Stays negative once a measurement was unavailable
+    it->cpu = ((it->cpu < 0) || (cpu < 0)) ? -1 : (it->cpu + cpu);
+
+    if ((copy >= 0) && topLevel) {
+        auto const inserted = copies.emplace(copy, CopyTimes{ 0, wallBegin, wallEnd });
+        CopyTimes& times = inserted.first->second;
+        times.latency += wallEnd - wallBegin;
+        times.begin = std::min(times.begin, wallBegin);
+        times.end = std::max(times.end, wallEnd);
+    }
+
+    if (tracing.load(std::memory_order_relaxed)) {
+        auto const thread = threadIds.emplace(std::this_thread::get_id(), static_cast<int>(threadIds.size()) + 1).first->second;
+        events.push_back({ phase, copy, thread, wallBegin, wallEnd - wallBegin });
+    }
+}
+
+QString Stats::toText() {
+    std::lock_guard<std::mutex> lock(mutex);
+    CopySummary const summary = summarizeCopies();
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "Statistics:" << std::endl;
+    out << "  " << std::left << std::setw(16) << "Phase" << std::right << std::setw(10) << "Count" << std::setw(14) << "Wall ms" << std::setw(14) << "CPU ms" << std::endl;
+    for (auto const& totals : phases) {
+        out << "  " << std::left << std::setw(16) << totals.name << std::right << std::setw(10) << totals.count << std::setw(14) << toMilliseconds(totals.wall);
+        if (totals.cpu < 0) {
+            out << std::setw(14) << "n/a" << std::endl;
+        } else {
+            out << std::setw(14) << toMilliseconds(totals.cpu) << std::endl;
+        }
+    }
+    out << "  Read " << bytesRead.load() << " bytes, wrote " << bytesWritten.load() << " bytes in " << (toMilliseconds(wallNanoseconds()) / 1000.0) << " s." << std::endl;
+    if (summary.count > 0) {
+        double const copiesPerSecond = (summary.duration > 0) ? (static_cast<double>(summary.count) * 1e9 / static_cast<double>(summary.duration)) : 0.0;
+        out << "  " << summary.count << " copies at " << copiesPerSecond << " copies/s, latency p50 " << toMilliseconds(percentile(summary.latencies, 50)) << " ms, p90 " << toMilliseconds(percentile(summary.latencies, 90)) << " ms, p99 " << toMilliseconds(percentile(summary.latencies, 99)) << " ms, max " << toMilliseconds(summary.latencies.back()) << " ms." << std::endl;
+    }
+    qint64 const peakResidentKiB = getPeakResidentKiB();
+    if (peakResidentKiB >= 0) {
+        out << "  Peak RSS " << (static_cast<double>(peakResidentKiB) / 1024.0) << " MiB." << std::endl;
+    }
+    return QString::fromStdString(out.str());
+}
+
+QByteArray Stats::toJson() {
+    std::lock_guard<std::mutex> lock(mutex);
+    CopySummary const summary = summarizeCopies();
+
+    QJsonArray phaseArray;
+    for (auto const& totals : phases) {
+        QJsonObject object;
+        object.insert(QStringLiteral("name"), QString::fromStdString(totals.name));
+        object.insert(QStringLiteral("count"), static_cast<double>(totals.count));
+        object.insert(QStringLiteral("wallMs"), toMilliseconds(totals.wall));
+        object.insert(QStringLiteral("cpuMs"), (totals.cpu < 0) ? QJsonValue() : QJsonValue(toMilliseconds(totals.cpu)));
+        phaseArray.append(object);
+    }
+
+    QJsonObject latency;
+    latency.insert(QStringLiteral("p50"), toMilliseconds(percentile(summary.latencies, 50)));
+    latency.insert(QStringLiteral("p90"), toMilliseconds(percentile(summary.latencies, 90)));
+    latency.insert(QStringLiteral("p99"), toMilliseconds(percentile(summary.latencies, 99)));
+    latency.insert(QStringLiteral("max"), toMilliseconds(summary.latencies.empty() ? 0 : summary.latencies.back()));
+
+    qint64 const peakResidentKiB = getPeakResidentKiB();
+
+    QJsonObject root;
+    root.insert(QStringLiteral("wallMs"), toMilliseconds(wallNanoseconds()));
+    root.insert(QStringLiteral("phases"), phaseArray);
+    root.insert(QStringLiteral("bytesRead"), static_cast<double>(bytesRead.load()));
+    root.insert(QStringLiteral("bytesWritten"), static_cast<double>(bytesWritten.load()));
+    root.insert(QStringLiteral("copies"), static_cast<double>(summary.count));
+    root.insert(QStringLiteral("copiesPerSecond"), (summary.duration > 0) ? (static_cast<double>(summary.count) * 1e9 / static_cast<double>(summary.duration)) : 0.0);
+    root.insert(QStringLiteral("latencyMs"), latency);
+    root.insert(QStringLiteral("peakResidentKiB"), (peakResidentKiB < 0) ? QJsonValue() : QJsonValue(static_cast<double>(peakResidentKiB)));
+    return QJsonDocument(root).toJson(QJsonDocument::Compact);
+}
+
+bool Stats::writeTrace(QString const& fileName) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    QJsonArray traceEvents;
+    for (auto const& event : events) {
+        QJsonObject object;
+        object.insert(QStringLiteral("name"), QString::fromLatin1(event.phase));
+        object.insert(QStringLiteral("cat"), (event.copy < 0) ? QStringLiteral("setup") : QStringLiteral("copy"));
+        object.insert(QStringLiteral("ph"), QStringLiteral("X"));
+        // Trace events are in microseconds
+        object.insert(QStringLiteral("ts"), static_cast<double>(event.begin) / 1e3);
+        object.insert(QStringLiteral("dur"), static_cast<double>(event.duration) / 1e3);
+        object.insert(QStringLiteral("pid"), 1);
+        object.insert(QStringLiteral("tid"), event.thread);
+        if (event.copy >= 0) {
+            QJsonObject args;
+            args.insert(QStringLiteral("copy"), static_cast<double>(event.copy));
+            object.insert(QStringLiteral("args"), args);
+        }
+        traceEvents.append(object);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("traceEvents"), traceEvents);
+    root.insert(QStringLiteral("displayTimeUnit"), QStringLiteral("ms"));
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly)) {
+        return false;
+    }
+    QByteArray const data = QJsonDocument(root).toJson(QJsonDocument::Compact);
+    return file.write(data) == data.size();
+}
@@ -0,0 +1,50 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_STATS_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_STATS_H_
+
+#include <QByteArray>
+#include <QString>
+
+/*
+	Process-wide timing and resource statistics, enabled with --stats and --trace.
+	Work is recorded as named spans. A span given a copy index becomes the current copy of its thread,
+	nested spans are attributed to it, and the per-copy latency is the sum of its top-level spans.
+	While disabled, a span costs a single branch.
+*/
+class Stats {
+public:
+	class Span {
+	public:
+		explicit Span(char const* phase, qsizetype copy = -1);
+		~Span();
+
+		Span(Span const&) = delete;
+		Span& operator=(Span const&) = delete;
+	private:
+		char const* const m_phase;
+		qsizetype const m_copy;
+		qsizetype m_previousCopy;
+		qint64 m_wallBegin;
+		qint64 m_cpuBegin;
+	};
+
+	static void enable(bool trace);
+	static bool isEnabled();
+
+	static void addBytesRead(qint64 bytes);
+	static void addBytesWritten(qint64 bytes);
+
+	static QString toText();
+	static QByteArray toJson();
+	// Writes all spans in the Chrome trace event format, for chrome://tracing or Perfetto
+	static bool writeTrace(QString const& fileName);
+
+	// Peak resident set size of the process in KiB, or -1 if not available on this platform
+	static qint64 getPeakResidentKiB();
+private:
+	static qint64 wallNanoseconds();
+	// CPU time of the calling thread, or -1 if not available on this platform
+	static qint64 threadCpuNanoseconds();
+	static void record(char const* phase, qsizetype copy, bool topLevel, qint64 wallBegin, qint64 wallEnd, qint64 cpu);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "XmlFixupDevice.h"
+
+#include <cstring>
+
+namespace {
+    char const quotEntity[] = "&quot;";
+    qsizetype const quotEntityLength = 6;
+}
+
+XmlFixupDevice::XmlFixupDevice(QIODevice& output) : QIODevice(), m_output(output), m_healthy(true) {
+    m_buffer.reserve(bufferSize + 16);
+}
+
+XmlFixupDevice::~XmlFixupDevice() {
+    if (isOpen()) {
+        close();
+    }
+}
+
+void XmlFixupDevice::close() {
+    // A held back prefix did not turn into a pattern, pass it through unchanged
+    m_buffer.append(m_pending);
+    m_pending.clear();
+    flushBuffer();
+    QIODevice::close();
+}
+
+bool XmlFixupDevice::isHealthy() const {
+    return m_healthy;
+}
+
+qint64 XmlFixupDevice::readData(char* data, qint64 maxSize) {
+    Q_UNUSED(data);
+    Q_UNUSED(maxSize);
+    return -1;
+}
+
+bool XmlFixupDevice::flushBuffer() {
+    if (!m_buffer.isEmpty()) {
+        if (m_output.write(m_buffer) != m_buffer.size()) {
+            m_healthy = false;
+        }
+        m_buffer.clear();
+    }
+    return m_healthy;
+}
+
+qint64 XmlFixupDevice::writeData(char const* data, qint64 maxSize) {
+    QByteArray input;
+    char const* begin = data;
+    qsizetype size = static_cast<qsizetype>(maxSize);
+    if (!m_pending.isEmpty()) {
+        input = m_pending;
+        input.append(data, size);
+        m_pending.clear();
+        begin = input.constData();
+        size = input.size();
+    }
+
+    qsizetype runBegin = 0;
+    qsizetype i = 0;
+    while (i < size) {
+        char const c = begin[i];
+        if ((c != '/') && (c != '&')) {
+            ++i;
+            continue;
+        }
+
+        qsizetype const remaining = size - i;
+        if (c == '/') {
+            if (remaining < 2) {
+                m_buffer.append(begin + runBegin, i - runBegin);
+                m_pending = QByteArray(begin + i, remaining);
+                runBegin = size;
+                break;
+            } else if (begin[i + 1] == '>') {
+                m_buffer.append(begin + runBegin, i - runBegin);
+                m_buffer.append(" />", 3);
+                i += 2;
+                runBegin = i;
+                continue;
+            }
+        } else {
+            if ((remaining < quotEntityLength) && (std::memcmp(begin + i, quotEntity, static_cast<std::size_t>(remaining)) == 0)) {
+                m_buffer.append(begin + runBegin, i - runBegin);
+                m_pending = QByteArray(begin + i, remaining);
+                runBegin = size;
+                break;
+            } else if ((remaining >= quotEntityLength) && (std::memcmp(begin + i, quotEntity, quotEntityLength) == 0)) {
+                m_buffer.append(begin + runBegin, i - runBegin);
+                m_buffer.append('"');
+                i += quotEntityLength;
+                runBegin = i;
+                continue;
+            }
+        }
+        ++i;
+    }
+    if (runBegin < size) {
+        m_buffer.append(begin + runBegin, size - runBegin);
+    }
+
+    if ((m_buffer.size() >= bufferSize) && !flushBuffer()) {
+        return -1;
+    }
+    return maxSize;
+}
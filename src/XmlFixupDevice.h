@@ -0,0 +1,33 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_XMLFIXUPDEVICE_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_XMLFIXUPDEVICE_H_
+
+#include <QByteArray>
+#include <QIODevice>
+
+/*
+	Write-only device that applies the QXmlStreamWriter output fixes ("/>" to " />" and "&quot;" to '"')
+	on the fly and forwards the result to another device in large chunks.
+	Only a pattern prefix split across two writes is held back, so memory does not grow with the document.
+*/
+class XmlFixupDevice : public QIODevice {
+public:
+	explicit XmlFixupDevice(QIODevice& output);
+	virtual ~XmlFixupDevice();
+
+	virtual void close() override;
+	bool isHealthy() const;
+protected:
+	virtual qint64 readData(char* data, qint64 maxSize) override;
+	virtual qint64 writeData(char const* data, qint64 maxSize) override;
+private:
+	QIODevice& m_output;
+	QByteArray m_pending;
+	QByteArray m_buffer;
+	bool m_healthy;
+
+	bool flushBuffer();
+
+	static constexpr qsizetype bufferSize = 64 * 1024;
+};
+
+#endif
@@ -0,0 +1,463 @@
+#include "ZipArchive.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <ostream>
+
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+    quint32 const localHeaderSignature = 0x04034b50;
+    quint32 const centralHeaderSignature = 0x02014b50;
+    quint32 const endOfCentralDirectorySignature = 0x06054b50;
+    qsizetype const localHeaderSize = 30;
+    qsizetype const centralHeaderSize = 46;
+    qsizetype const endOfCentralDirectorySize = 22;
+    quint16 const methodStored = 0;
+    quint16 const methodDeflated = 8;
+    // Version 2.0, names are UTF-8
+    quint16 const versionNeeded = 20;
+    quint16 const flagUtf8 = 0x0800;
+    qint64 const inputChunkSize = 64 * 1024;
+
+    quint16 readLe16(char const* data) {
+        auto const bytes = reinterpret_cast<unsigned char const*>(data);
+        return static_cast<quint16>(bytes[0] | (bytes[1] << 8));
+    }
+
+    quint32 readLe32(char const* data) {
+        auto const bytes = reinterpret_cast<unsigned char const*>(data);
+        return static_cast<quint32>(bytes[0]) | (static_cast<quint32>(bytes[1]) << 8) | (static_cast<quint32>(bytes[2]) << 16) | (static_cast<quint32>(bytes[3]) << 24);
+    }
+
+    void appendLe16(QByteArray& out, quint16 value) {
+        out.append(static_cast<char>(value & 0xFF));
+        out.append(static_cast<char>(value >> 8));
+    }
+
+    void appendLe32(QByteArray& out, quint32 value) {
+        appendLe16(out, static_cast<quint16>(value & 0xFFFF));
+        appendLe16(out, static_cast<quint16>(value >> 16));
+    }
+
+    quint32 updateCrc(quint32 crc, char const* data, qint64 size) {
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+        while (size > 0) {
+            uInt const chunk = static_cast<uInt>(std::min<qint64>(size, 1 << 30));
+            crc = static_cast<quint32>(crc32(crc, reinterpret_cast<Bytef const*>(data), chunk));
+            data += chunk;
+            size -= chunk;
+        }
+        return crc;
+#else
+        static auto const table = []() {
+            std::array<quint32, 256> result{};
+            for (quint32 i = 0; i < 256; ++i) {
+                quint32 value = i;
+                for (int bit = 0; bit < 8; ++bit) {
+                    value = (value & 1) ? (0xEDB88320u ^ (value >> 1)) : (value >> 1);
+                }
+                result[i] = value;
+            }
+            return result;
+        }();
+        crc = ~crc;
+        for (qint64 i = 0; i < size; ++i) {
+            crc = table[(crc ^ static_cast<unsigned char>(data[i])) & 0xFF] ^ (crc >> 8);
+        }
+        return ~crc;
+#endif
+    }
+
+    std::optional<QByteArray> deflateRaw(QByteArray const& data) {
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+            return std::nullopt;
+        }
+        QByteArray result;
+        result.resize(static_cast<qsizetype>(deflateBound(&stream, static_cast<uLong>(data.size()))) + 32);
+        stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.constData()));
+        stream.avail_in = static_cast<uInt>(data.size());
+        stream.next_out = reinterpret_cast<Bytef*>(result.data());
+        stream.avail_out = static_cast<uInt>(result.size());
+        int const status = deflate(&stream, Z_FINISH);
+        result.resize(static_cast<qsizetype>(stream.total_out));
+        deflateEnd(&stream);
+        if (status != Z_STREAM_END) {
+            return std::nullopt;
+        }
+        return result;
+#else
+        Q_UNUSED(data);
+        return std::nullopt;
+#endif
+    }
+
+    quint32 currentDosDateTime() {
+        QDateTime const now = QDateTime::currentDateTime();
+        int const year = std::max(now.date().year(), 1980);
+        quint32 const date = static_cast<quint32>(((year - 1980) << 9) | (now.date().month() << 5) | now.date().day());
+        quint32 const time = static_cast<quint32>((now.time().hour() << 11) | (now.time().minute() << 5) | (now.time().second() / 2));
+        return (date << 16) | time;
+    }
+
+    /*
+        Reads the data of one entry from the archive file and decompresses it in chunks as large as asked for.
+        Once the last byte was produced, size and checksum are compared to the central directory. No more than one
+        byte beyond the size given there is ever decompressed, so a deflate bomb fails before it can fill memory.
+    */
+    class ZipEntryDevice : public QIODevice {
+    public:
+        ZipEntryDevice(std::unique_ptr<QFile> file, ZipArchive::Entry const& entry) : QIODevice(), m_file(std::move(file)), m_entry(entry), m_remaining(entry.compressedSize), m_produced(0), m_crc(0), m_finished(false) {
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+            std::memset(&m_stream, 0, sizeof(m_stream));
+            m_inflating = (entry.method == methodDeflated) && (inflateInit2(&m_stream, -MAX_WBITS) == Z_OK);
+#endif
+        }
+
+        virtual ~ZipEntryDevice() {
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+            if (m_inflating) {
+                inflateEnd(&m_stream);
+            }
+#endif
+        }
+
+        virtual bool isSequential() const override {
+            return true;
+        }
+
+        virtual qint64 size() const override {
+            return m_entry.size;
+        }
+    protected:
+        virtual qint64 readData(char* data, qint64 maxSize) override {
+            if (m_finished) {
+                return 0;
+            }
+            // One byte more than is left is enough to tell that the entry is larger than it claims
+            qint64 const limit = std::min(maxSize, m_entry.size - m_produced + 1);
+            qint64 const produced = (m_entry.method == methodStored) ? readStored(data, limit) : readDeflated(data, limit);
+            if (produced < 0) {
+                return -1;
+            } else if (m_produced + produced > m_entry.size) {
+                setErrorString(QStringLiteral("'%1' is larger than the archive says").arg(m_entry.name));
+                m_finished = true;
+                return -1;
+            }
+            m_crc = updateCrc(m_crc, data, produced);
+            m_produced += produced;
+            if (m_finished && ((m_produced != m_entry.size) || (m_crc != m_entry.crc))) {
+                setErrorString(QStringLiteral("Checksum mismatch in '%1'").arg(m_entry.name));
+                return -1;
+            }
+            return produced;
+        }
+
+        virtual qint64 writeData(char const* data, qint64 maxSize) override {
+            Q_UNUSED(data);
+            Q_UNUSED(maxSize);
+            return -1;
+        }
+    private:
+        std::unique_ptr<QFile> m_file;
+        ZipArchive::Entry const m_entry;
+        qint64 m_remaining;
+        qint64 m_produced;
+        quint32 m_crc;
+        bool m_finished;
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+        z_stream m_stream;
+        bool m_inflating;
+        QByteArray m_input;
+#endif
+
+        qint64 readStored(char* data, qint64 maxSize) {
+            qint64 const count = (m_remaining > 0) ? m_file->read(data, std::min(maxSize, m_remaining)) : 0;
+            if ((count <= 0) && (m_remaining > 0)) {
+                setErrorString(QStringLiteral("Unexpected end of '%1'").arg(m_entry.name));
+                return -1;
+            }
+            m_remaining -= count;
+            m_finished = (m_remaining == 0);
+            return count;
+        }
+
+        qint64 readDeflated(char* data, qint64 maxSize) {
+#ifdef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+            if (!m_inflating) {
+                setErrorString(QStringLiteral("Could not start decompressing '%1'").arg(m_entry.name));
+                return -1;
+            }
+            uInt const outputSize = static_cast<uInt>(std::min<qint64>(maxSize, 1 << 30));
+            m_stream.next_out = reinterpret_cast<Bytef*>(data);
+            m_stream.avail_out = outputSize;
+            // Loops until at least one byte came out, a deflate block may need more input than one chunk
+            while (m_stream.avail_out == outputSize) {
+                if ((m_stream.avail_in == 0) && (m_remaining > 0)) {
+                    m_input = m_file->read(std::min(m_remaining, inputChunkSize));
+                    if (m_input.isEmpty()) {
+                        break;
+                    }
+                    m_remaining -= m_input.size();
+                    m_stream.next_in = reinterpret_cast<Bytef*>(m_input.data());
+                    m_stream.avail_in = static_cast<uInt>(m_input.size());
+                }
+                int const status = inflate(&m_stream, Z_NO_FLUSH);
+                if (status == Z_STREAM_END) {
+                    m_finished = true;
+                    break;
+                } else if ((status != Z_OK) && !((status == Z_BUF_ERROR) && (m_stream.avail_in == 0) && (m_remaining > 0))) {
+                    setErrorString(QStringLiteral("Corrupt data in '%1'").arg(m_entry.name));
+                    return -1;
+                }
+            }
+            if (!m_finished && (m_stream.avail_out == outputSize)) {
+                setErrorString(QStringLiteral("Unexpected end of '%1'").arg(m_entry.name));
+                return -1;
+            }
+            return static_cast<qint64>(outputSize - m_stream.avail_out);
+#else
+            Q_UNUSED(data);
+            Q_UNUSED(maxSize);
+            return -1;
+#endif
+        }
+    };
+}
+
+ZipArchive::ZipArchive(QString const& path) : m_path(path) {
+	//
+}
+
+
+std::optional<ZipArchive> ZipArchive::open(QString const& path, std::ostream& error) {
+    ZipArchive result(path);
+    if (!result.readCentralDirectory(error)) {
+        return std::nullopt;
+    }
+    return result;
+}
+
+bool ZipArchive::isArchive(QString const& path) {
+    QFileInfo const info(path);
+    QString const suffix = info.suffix().toLower();
+    return ((suffix == QStringLiteral("sbb")) || (suffix == QStringLiteral("zip"))) && info.isFile();
+}
+
+QString const& ZipArchive::getPath() const {
+    return m_path;
+}
+
+std::vector<ZipArchive::Entry> const& ZipArchive::getEntries() const {
+    return m_entries;
+}
+
+ZipArchive::Entry const* ZipArchive::find(QString const& name) const {
+    for (auto const& entry : m_entries) {
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+bool ZipArchive::readCentralDirectory(std::ostream& error) {
+    QFile file(m_path);
+    if (!file.open(QFile::ReadOnly)) {
+        error << "Error: Could not open the archive '" << m_path.toStdString() << "' for reading!" << std::endl;
+        return false;
+    }
+
+    // The end record is at most a maximal comment away from the end of the file
+    qint64 const fileSize = file.size();
+    qint64 const tailSize = std::min<qint64>(fileSize, endOfCentralDirectorySize + 0xFFFF);
+    QByteArray tail;
+    if (file.seek(fileSize - tailSize)) {
+        tail = file.read(tailSize);
+    }
+    qsizetype end = tail.size() - endOfCentralDirectorySize;
+    while ((end >= 0) && (readLe32(tail.constData() + end) != endOfCentralDirectorySignature)) {
+        --end;
+    }
+    if (end < 0) {
+        error << "Error: '" << m_path.toStdString() << "' is not a zip archive!" << std::endl;
+        return false;
+    }
+
+    char const* const record = tail.constData() + end;
+    quint16 const entryCount = readLe16(record + 10);
+    quint32 const directorySize = readLe32(record + 12);
+    quint32 const directoryOffset = readLe32(record + 16);
+    if ((readLe16(record + 4) != 0) || (readLe16(record + 6) != 0) || (entryCount == 0xFFFF) || (directoryOffset == 0xFFFFFFFF)) {
+        error << "Error: The archive '" << m_path.toStdString() << "' spans several files or uses Zip64, which is not supported." << std::endl;
+        return false;
+    }
+    QByteArray directory;
+    if ((static_cast<qint64>(directoryOffset) + directorySize <= fileSize) && file.seek(directoryOffset)) {
+        directory = file.read(directorySize);
+    }
+    if (directory.size() != static_cast<qsizetype>(directorySize)) {
+        error << "Error: The central directory of the archive '" << m_path.toStdString() << "' is truncated." << std::endl;
+        return false;
+    }
+
+    qsizetype pos = 0;
+    for (quint16 i = 0; i < entryCount; ++i) {
+        char const* const header = directory.constData() + pos;
+        if ((pos + centralHeaderSize > directory.size()) || (readLe32(header) != centralHeaderSignature)) {
+            error << "Error: The central directory of the archive '" << m_path.toStdString() << "' is corrupt." << std::endl;
+            return false;
+        }
+        quint16 const flags = readLe16(header + 8);
+        qsizetype const nameLength = readLe16(header + 28);
+        qsizetype const recordSize = centralHeaderSize + nameLength + readLe16(header + 30) + readLe16(header + 32);
+        if (pos + recordSize > directory.size()) {
+            error << "Error: The central directory of the archive '" << m_path.toStdString() << "' is corrupt." << std::endl;
+            return false;
+        }
+        pos += recordSize;
+
+        Entry entry;
+        entry.name = QString::fromUtf8(header + centralHeaderSize, nameLength);
+        entry.method = readLe16(header + 10);
+        entry.modified = (static_cast<quint32>(readLe16(header + 14)) << 16) | readLe16(header + 12);
+        entry.crc = readLe32(header + 16);
+        entry.compressedSize = readLe32(header + 20);
+        entry.size = readLe32(header + 24);
+        entry.localHeaderOffset = readLe32(header + 42);
+        // Encrypted entries can not be read and directories have no contents
+        if (((flags & 0x0001) != 0) || entry.name.endsWith(QChar('/'))) {
+            continue;
+        }
+        m_entries.push_back(entry);
+    }
+    return true;
+}
+
+
+std::unique_ptr<QIODevice> ZipArchive::openEntry(Entry const& entry, std::ostream& error) const {
+    if ((entry.method != methodStored) && (entry.method != methodDeflated)) {
+        error << "Error: '" << entry.name.toStdString() << "' in the archive '" << m_path.toStdString() << "' uses the unsupported compression method " << entry.method << "." << std::endl;
+        return nullptr;
+    }
+#ifndef BLUEPRINTDUPLICATOR_HAVE_ZLIB
+    if (entry.method == methodDeflated) {
+        error << "Error: '" << entry.name.toStdString() << "' in the archive '" << m_path.toStdString() << "' is compressed, but this build has no zlib support." << std::endl;
+        return nullptr;
+    }
+#endif
+
+    auto file = std::make_unique<QFile>(m_path);
+    QByteArray header;
+    if (file->open(QFile::ReadOnly) && file->seek(entry.localHeaderOffset)) {
+        header = file->read(localHeaderSize);
+    }
+    if ((header.size() != localHeaderSize) || (readLe32(header.constData()) != localHeaderSignature)) {
+        error << "Error: Could not find '" << entry.name.toStdString() << "' in the archive '" << m_path.toStdString() << "'." << std::endl;
+        return nullptr;
+    }
+    // Name and extra field may differ from the central directory
+    qint64 const dataOffset = entry.localHeaderOffset + localHeaderSize + readLe16(header.constData() + 26) + readLe16(header.constData() + 28);
+    if (!file->seek(dataOffset)) {
+        return nullptr;
+    }
+
+    auto device = std::make_unique<ZipEntryDevice>(std::move(file), entry);
+    device->open(QIODevice::ReadOnly);
+    return device;
+}
+
+
+std::optional<QByteArray> ZipArchive::read(Entry const& entry, std::ostream& error) const {
+    auto const device = openEntry(entry, error);
+    if (!device) {
+        return std::nullopt;
+    }
+    QByteArray const result = device->readAll();
+    if (result.size() != entry.size) {
+        error << "Error: Could not read '" << entry.name.toStdString() << "' from the archive '" << m_path.toStdString() << "': " << device->errorString().toStdString() << std::endl;
+        return std::nullopt;
+    }
+    return result;
+}
+
+
+bool ZipArchive::write(QIODevice& output, std::vector<std::pair<QString, QByteArray>> const& files, std::ostream& error) {
+    quint32 const modified = currentDosDateTime();
+    QByteArray directory;
+    qint64 offset = 0;
+    for (auto const& file : files) {
+        QByteArray const name = file.first.toUtf8();
+        QByteArray const& contents = file.second;
+        quint32 const crc = updateCrc(0, contents.constData(), contents.size());
+        // Thumbnails and bp.sbcB5 are usually compressed already
+        auto const deflated = deflateRaw(contents);
+        bool const useDeflated = deflated && (deflated->size() < contents.size());
+        QByteArray const& data = (useDeflated) ? *deflated : contents;
+        quint16 const method = (useDeflated) ? methodDeflated : methodStored;
+        if ((offset > 0xFFFFFFFE) || (contents.size() > 0xFFFFFFFE)) {
+            error << "Error: The archive would need Zip64, which is not supported." << std::endl;
+            return false;
+        }
+
+        QByteArray header;
+        appendLe32(header, localHeaderSignature);
+        appendLe16(header, versionNeeded);
+        appendLe16(header, flagUtf8);
+        appendLe16(header, method);
+        appendLe16(header, static_cast<quint16>(modified & 0xFFFF));
+        appendLe16(header, static_cast<quint16>(modified >> 16));
+        appendLe32(header, crc);
+        appendLe32(header, static_cast<quint32>(data.size()));
+        appendLe32(header, static_cast<quint32>(contents.size()));
+        appendLe16(header, static_cast<quint16>(name.size()));
+        appendLe16(header, 0);
+        header.append(name);
+        if ((output.write(header) != header.size()) || (output.write(data) != data.size())) {
+            return false;
+        }
+
+        appendLe32(directory, centralHeaderSignature);
+        appendLe16(directory, versionNeeded);
+        appendLe16(directory, versionNeeded);
+        appendLe16(directory, flagUtf8);
+        appendLe16(directory, method);
+        appendLe16(directory, static_cast<quint16>(modified & 0xFFFF));
+        appendLe16(directory, static_cast<quint16>(modified >> 16));
+        appendLe32(directory, crc);
+        appendLe32(directory, static_cast<quint32>(data.size()));
+        appendLe32(directory, static_cast<quint32>(contents.size()));
+        appendLe16(directory, static_cast<quint16>(name.size()));
+        // Extra field, comment, disk, internal and external attributes
+        appendLe16(directory, 0);
+        appendLe16(directory, 0);
+        appendLe16(directory, 0);
+        appendLe16(directory, 0);
+        appendLe32(directory, 0);
+        appendLe32(directory, static_cast<quint32>(offset));
+        directory.append(name);
+        offset += header.size() + data.size();
+    }
+
+    QByteArray end;
+    appendLe32(end, endOfCentralDirectorySignature);
+    appendLe16(end, 0);
+    appendLe16(end, 0);
+    appendLe16(end, static_cast<quint16>(files.size()));
+    appendLe16(end, static_cast<quint16>(files.size()));
+    appendLe32(end, static_cast<quint32>(directory.size()));
+    appendLe32(end, static_cast<quint32>(offset));
+    appendLe16(end, 0);
+    directory.append(end);
+    return output.write(directory) == directory.size();
+}
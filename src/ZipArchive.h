@@ -0,0 +1,57 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_ZIPARCHIVE_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_ZIPARCHIVE_H_
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+
+#include <iosfwd>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+/*
+	Zip archives as Workshop blueprints come in (*.sbb), with bp.sbc, thumb.png and maybe bp.sbcB5 in the root.
+	Only the central directory is read when opening, entries are decompressed on the fly while they are read,
+	so nothing is ever extracted to disk. Stored entries are always supported, deflated ones require zlib.
+	Zip64, encryption and archives spanning several files are not supported.
+*/
+class ZipArchive {
+public:
+	struct Entry {
+		QString name;
+		quint16 method;
+		quint32 crc;
+		qint64 compressedSize;
+		qint64 size;
+		qint64 localHeaderOffset;
+		// MS-DOS date and time, (date << 16) | time, so later means larger
+		quint32 modified;
+	};
+
+	// Reports why the archive could not be opened to error
+	static std::optional<ZipArchive> open(QString const& path, std::ostream& error);
+	// Whether path names an archive file, judged by its suffix
+	static bool isArchive(QString const& path);
+
+	QString const& getPath() const;
+	std::vector<Entry> const& getEntries() const;
+	// Files in the root of the archive only, returns nullptr if there is no such entry
+	Entry const* find(QString const& name) const;
+
+	// Sequential read-only device decompressing the entry while it is read, fails on a wrong checksum
+	std::unique_ptr<QIODevice> openEntry(Entry const& entry, std::ostream& error) const;
+	std::optional<QByteArray> read(Entry const& entry, std::ostream& error) const;
+
+	// Writes a complete archive in one pass, deflating files that get smaller by it if zlib is available
+	static bool write(QIODevice& output, std::vector<std::pair<QString, QByteArray>> const& files, std::ostream& error);
+private:
+	QString m_path;
+	std::vector<Entry> m_entries;
+
+	explicit ZipArchive(QString const& path);
+	bool readCentralDirectory(std::ostream& error);
+};
+
+#endif
@@ -1,16 +1,49 @@
 #include <QCommandLineParser>
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QJsonObject>
 #include <QStandardPaths>
 #include <QString>
+#include <QTimer>
 
+#include <functional>
+#include <future>
 #include <iostream>
 #include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <sstream>
 #include <string>
+#include <thread>
 
+#include "AsyncWriter.h"
+#include "BinaryBlueprint.h"
 #include "BlueprintData.h"
+#include "BlueprintIndex.h"
+#include "BlueprintLint.h"
+#include "BlueprintScanner.h"
+#include "CopyManifest.h"
+#include "CopyPipeline.h"
+#include "CopyPlan.h"
+#include "EntityIds.h"
+#include "LruCache.h"
+#include "Manifest.h"
 #include "Options.h"
+#include "PatchTemplate.h"
+#include "Salvo.h"
+#include "Server.h"
+#include "Sidecars.h"
+#include "SliceWriter.h"
+#include "Stats.h"
+#include "ZipArchive.h"
 
 QString readInputFromConsoleWithDefault(std::string const& text, QString const& defaultValue) {
     std::cout << text << " [" << defaultValue.toStdString() << "]: ";
@@ -89,7 +122,986 @@ QStringList scanBlueprints(QString const& path) {
         throw;
     }
 
-    return dir.entryList();
+    // Workshop blueprints are zip archives next to the folders
+    QStringList result = dir.entryList();
+    for (auto const& name : dir.entryList(QDir::Files)) {
+        if (ZipArchive::isArchive(dir.absoluteFilePath(name))) {
+            result.append(name);
+        }
+    }
+    return result;
+}
+
+// The bp.sbc of a blueprint folder or archive opened for reading, nullptr if that failed
+std::unique_ptr<QIODevice> openBlueprint(QDir const& folder, ZipArchive const* archive, std::ostream& error) {
+    if (archive != nullptr) {
+        auto const entry = archive->find(QStringLiteral("bp.sbc"));
+        if (entry == nullptr) {
+            error << "Error: The archive '" << archive->getPath().toStdString() << "' does not contain a bp.sbc!" << std::endl;
+            return nullptr;
+        }
+        return archive->openEntry(*entry, error);
+    }
+    auto file = std::make_unique<QFile>(folder.absoluteFilePath(QStringLiteral("bp.sbc")));
+    if (!file->open(QFile::ReadOnly)) {
+        return nullptr;
+    }
+    return file;
+}
+
+std::unique_ptr<QIODevice> openBlueprint(QDir const& folder, ZipArchive const* archive) {
+    return openBlueprint(folder, archive, std::cerr);
+}
+
+// Like BinaryBlueprint::isFresh, the bp.sbcB5 of an archive is only used if it is not older than its bp.sbc
+QByteArray readArchivedBinary(ZipArchive const& archive, std::ostream& error) {
+    auto const xmlEntry = archive.find(QStringLiteral("bp.sbc"));
+    auto const binaryEntry = archive.find(QStringLiteral("bp.sbcB5"));
+    if ((xmlEntry == nullptr) || (binaryEntry == nullptr) || (binaryEntry->modified < xmlEntry->modified)) {
+        return QByteArray();
+    }
+    return archive.read(*binaryEntry, error).value_or(QByteArray());
+}
+
+// All other files in the root of an archive, read into memory once
+std::vector<Sidecars::File> readArchivedSidecars(ZipArchive const& archive, std::ostream& error) {
+    std::vector<Sidecars::File> result;
+    for (auto const& entry : archive.getEntries()) {
+        if ((entry.name == QStringLiteral("bp.sbc")) || (entry.name == QStringLiteral("bp.sbcB5")) || entry.name.contains(QChar('/'))) {
+            continue;
+        } else if (entry.name.isEmpty() || entry.name.contains(QChar('\\')) || entry.name.contains(QChar(':')) || entry.name.contains(QStringLiteral(".."))) {
+            // Written next to bp.sbc of every copy, so a name must never lead out of the copy or into a drive
+            error << "Warning: Ignoring '" << entry.name.toStdString() << "' in the archive, it is not a plain file name." << std::endl;
+            continue;
+        }
+        auto contents = archive.read(entry, error);
+        if (!contents) {
+            error << "Warning: Could not read '" << entry.name.toStdString() << "' from the archive, the copies will not have it." << std::endl;
+            continue;
+        }
+        result.push_back(Sidecars::File{ entry.name, std::move(contents) });
+    }
+    return result;
+}
+
+void printBlueprintList(QStringList const& list, BlueprintIndex const* index) {
+    for (qsizetype i = 0; i < list.size(); ++i) {
+        std::cout << std::setw(3) << (i + 1) << ": " << list.at(i).toStdString();
+        auto const entry = (index == nullptr) ? nullptr : index->find(list.at(i));
+        if (entry == nullptr) {
+            std::cout << std::endl;
+        } else if (entry->valid) {
+            std::cout << " [group '" << entry->groupName.toStdString() << "', missile " << entry->missileNumber << ", " << entry->blockCount << " named blocks]" << std::endl;
+        } else {
+            std::cout << " [invalid]" << std::endl;
+        }
+    }
+}
+
+void printFound(BlueprintData const& blueprintData) {
+    std::cout << "Info: Found GridName='" << blueprintData.getGridName().toStdString() << "', DisplayName='" << blueprintData.getDisplayName().toStdString() << "', GroupName='" << blueprintData.getGroupName().toStdString() << "' and " << blueprintData.getItemCount() << " items, which all have the group name prefix." << std::endl;
+}
+
+// Prints the plan and asks once whether the existing copies it lists may be replaced, nothing is asked with --force
+bool confirmPlan(CopyPlan const& plan, Options const& options) {
+    std::cout << plan.toText(false).toStdString();
+    qsizetype const overwriteCount = plan.count(CopyPlan::Action::Overwrite);
+    bool mayOverride = options.force || (overwriteCount == 0);
+    if (!mayOverride) {
+        QString const removeReply = readInputFromConsoleWithDefault("Are you sure you want to replace all contents of the " + std::to_string(overwriteCount) + " existing Blueprint" + ((overwriteCount == 1) ? "" : "s") + "? (y or yes to confirm)", QStringLiteral("no"));
+        mayOverride = ((removeReply == QStringLiteral("y")) || (removeReply == QStringLiteral("yes")));
+    }
+    if (!mayOverride) {
+        std::cout << "Will not override, quitting..." << std::endl;
+    }
+    return mayOverride;
+}
+
+// With --dryRun, the plan is the only output
+void printDryRun(CopyPlan const& plan, Options const& options) {
+    if (options.dryRunAsJson) {
+        std::cout << plan.toJson().toStdString() << std::endl;
+    } else {
+        std::cout << plan.toText(true).toStdString();
+    }
+}
+
+bool writeCopy(QString const& blueprintLocation, Sidecars const& sidecars, QString const& copyName, std::function<bool(QFile&)> const& writeContents, QByteArray const& binaryCopy, Options const& options, std::ostream& error) {
+    QDir copyDir(blueprintLocation);
+    {
+        Stats::Span const span("mkdir");
+        if (!copyDir.cd(copyName)) {
+            copyDir.mkdir(copyName);
+            copyDir.cd(copyName);
+        }
+    }
+
+    // Replacing existing copies was confirmed with the plan of the run
+    QString const copyBpName = copyDir.absoluteFilePath(QStringLiteral("bp.sbc"));
+    if (QFile::exists(copyBpName)) {
+        QFile::remove(copyBpName);
+        QFile::remove(copyDir.absoluteFilePath(QStringLiteral("bp.sbcB5")));
+        for (auto const& name : sidecars.getReplacedFileNames()) {
+            QFile::remove(copyDir.absoluteFilePath(name));
+        }
+    }
+
+    {
+        Stats::Span const span("write");
+        QFile fileBlueprint(copyBpName);
+        if (!fileBlueprint.open(QFile::WriteOnly | QFile::Unbuffered)) {
+            error << "Error: Failed to write file '" << copyBpName.toStdString() << "', not writable!" << std::endl;
+            return false;
+        }
+        if (!writeContents(fileBlueprint)) {
+            error << "Error: Failed to write file '" << copyBpName.toStdString() << "'!" << std::endl;
+            return false;
+        }
+        Stats::addBytesWritten(fileBlueprint.size());
+        fileBlueprint.close();
+    }
+
+    // Written after bp.sbc, so the game considers it up to date
+    if (!binaryCopy.isEmpty()) {
+        Stats::Span const span("binary");
+        QFile fileBinary(copyDir.absoluteFilePath(QStringLiteral("bp.sbcB5")));
+        if (!fileBinary.open(QFile::WriteOnly) || (fileBinary.write(binaryCopy) != binaryCopy.size())) {
+            error << "Warning: Failed to write the binary blueprint cache of '" << copyName.toStdString() << "'." << std::endl;
+            fileBinary.remove();
+        } else {
+            Stats::addBytesWritten(binaryCopy.size());
+        }
+    }
+
+    // Thumbnail and any other files next to bp.sbc
+    {
+        Stats::Span const span("sidecars");
+        qint64 const written = sidecars.propagate(copyDir, error);
+        if (written < 0) {
+            error << "Warning: Failed to copy some of the other files of the Blueprint to '" << copyName.toStdString() << "'." << std::endl;
+        } else {
+            Stats::addBytesWritten(written);
+        }
+    }
+
+    return true;
+}
+
+// With --archive, the copy is written as <copyName>.sbb in one pass, sidecars included
+bool writeArchiveCopy(QString const& blueprintLocation, Sidecars const& sidecars, QString const& copyName, QByteArray const& copyData, QByteArray const& binaryCopy, Options const& options, std::ostream& error) {
+    QString const archiveName = QDir(blueprintLocation).absoluteFilePath(QString(copyName).append(QStringLiteral(".sbb")));
+
+    std::vector<std::pair<QString, QByteArray>> files;
+    files.emplace_back(QStringLiteral("bp.sbc"), copyData);
+    if (!binaryCopy.isEmpty()) {
+        files.emplace_back(QStringLiteral("bp.sbcB5"), binaryCopy);
+    }
+    {
+        Stats::Span const span("sidecars");
+        for (auto const& file : sidecars.getFiles()) {
+            auto const contents = sidecars.read(file);
+            if (!contents) {
+                error << "Warning: Failed to read '" << file.name.toStdString() << "' of the Blueprint, it is missing from '" << copyName.toStdString() << ".sbb'." << std::endl;
+                continue;
+            }
+            files.emplace_back(file.name, *contents);
+        }
+    }
+
+    Stats::Span const span("write");
+    QFile output(archiveName);
+    if (!output.open(QFile::WriteOnly | QFile::Truncate) || !ZipArchive::write(output, files, error)) {
+        error << "Error: Failed to write the archive '" << archiveName.toStdString() << "'!" << std::endl;
+        output.remove();
+        return false;
+    }
+    Stats::addBytesWritten(output.size());
+    return true;
+}
+
+bool writeCopy(QString const& blueprintLocation, Sidecars const& sidecars, QString const& copyName, QByteArray const& copyData, QByteArray const& binaryCopy, Options const& options, std::ostream& error) {
+    if (copyData.isNull() || copyData.isEmpty()) {
+        error << "Failed to produce a viable copy, quitting..." << std::endl;
+        return false;
+    } else if (options.archive) {
+        return writeArchiveCopy(blueprintLocation, sidecars, copyName, copyData, binaryCopy, options, error);
+    }
+    return writeCopy(blueprintLocation, sidecars, copyName, [&](QFile& file) { return file.write(copyData) == copyData.size(); }, binaryCopy, options, error);
+}
+
+// Queues the copy on the asynchronous writer, replace comes from the plan and removing the old files is part of the batch
+bool submitCopy(AsyncWriter& writer, QString const& blueprintLocation, QString const& copyName, qsizetype index, QByteArray const& copyData, QByteArray const& binaryCopy, Sidecars const& sidecars, bool replace) {
+    if (copyData.isNull() || copyData.isEmpty()) {
+        std::cerr << "Failed to produce a viable copy, quitting..." << std::endl;
+        return false;
+    }
+
+    QString const copyFolder = QDir(blueprintLocation).absoluteFilePath(copyName);
+    writer.submit(AsyncWriter::Copy{ index, copyFolder, copyData, binaryCopy, &sidecars, replace });
+    return true;
+}
+
+// The generation mode for the source hash of --incremental, copies have to be regenerated if the overrides change
+QByteArray hashMode(QByteArray const& mode, Options const& options) {
+    QByteArray result(mode);
+    if (options.newEntityIds) {
+        result.append("\nentityIds");
+    }
+    for (auto const& entry : options.customDataOverrides) {
+        result.append('\n').append(entry.text.toUtf8());
+    }
+    return result;
+}
+
+struct LoadedSource {
+    QDir folder;
+    QByteArray data;
+    QByteArray binaryData;
+    std::optional<BlueprintData> blueprintData;
+    std::optional<PatchTemplate> patchTemplate;
+    QByteArray sourceHash;
+    std::unique_ptr<Sidecars> sidecars;
+    QByteArray sidecarHash;
+};
+
+// Gives the copies of a compiled template new EntityIds, which avoid those of the source and of the other blueprints in
+// the library. The numbered copies of the same missile are left out: they are the ones being replaced, and reserving
+// their ids would move every copy to other ids on each run. A silent call only reports to error.
+std::optional<PatchTemplate> withNewEntityIds(PatchTemplate const& patchTemplate, QByteArray const& data, BlueprintData const& blueprintData, QString const& blueprintLocation, std::ostream& error, bool silent) {
+    auto entityIds = EntityIds::collect(data);
+    if (!entityIds) {
+        error << "Warning: The blueprint has no EntityIds, the copies are written without them." << std::endl;
+        return patchTemplate;
+    }
+
+    Stats::Span const span("entityIds");
+    QDir const location(blueprintLocation);
+    QString const baseName = BlueprintData::cutDigitsFromEnd(blueprintData.getDisplayName());
+    for (auto const& name : scanBlueprints(blueprintLocation)) {
+        QString const path = location.absoluteFilePath(name);
+        QString const copyName = (ZipArchive::isArchive(path)) ? QFileInfo(name).completeBaseName() : name;
+        if ((copyName.size() > baseName.size()) && (BlueprintData::cutDigitsFromEnd(copyName) == baseName)) {
+            continue;
+        }
+        auto const archive = (ZipArchive::isArchive(path)) ? ZipArchive::open(path, error) : std::nullopt;
+        auto const file = openBlueprint(QDir(path), (archive) ? &*archive : nullptr, error);
+        if (file) {
+            entityIds->reserve(file->readAll());
+        }
+    }
+    if (!silent) {
+        std::cout << "Info: Every copy gets " << entityIds->getCount() << " new EntityId" << ((entityIds->getCount() == 1) ? "" : "s") << "." << std::endl;
+    }
+    return patchTemplate.withEntityIds(std::make_shared<EntityIds const>(*entityIds));
+}
+
+// Compiles the patch template of a source, with new EntityIds if --newEntityIds is given
+std::optional<PatchTemplate> compileTemplate(QByteArray const& data, BlueprintData const& blueprintData, QString const& blueprintLocation, Options const& options, std::ostream& error) {
+    auto const patchTemplate = PatchTemplate::compile(data, blueprintData, options.customDataOverrides, error);
+    if (!patchTemplate || !options.newEntityIds) {
+        return patchTemplate;
+    }
+    return withNewEntityIds(*patchTemplate, data, blueprintData, blueprintLocation, error, false);
+}
+
+// Scans, checks and compiles a source without printing anything, problems only go to error. Documents the fast
+// scanner can not handle are read by the XML parser instead and get no patch template.
+std::optional<BlueprintData> parseSilently(QByteArray const& data, QString const& blueprintLocation, Options const& options, std::ostream& error, std::optional<PatchTemplate>& patchTemplate) {
+    ParseBudget budget(options.parseLimits);
+    auto const fields = BlueprintScanner::scan(data, budget, error);
+    if (!fields && budget.isExceeded()) {
+        return std::nullopt;
+    } else if (!fields) {
+        return BlueprintData::fromXml(data, options, error);
+    }
+    BlueprintData::Problem problem;
+    auto blueprintData = BlueprintData::lint(data, *fields, problem);
+    if (!blueprintData) {
+        error << problem.message.toStdString() << std::endl;
+        return std::nullopt;
+    }
+    auto const compiled = PatchTemplate::compile(data, *fields, *blueprintData, options.customDataOverrides, error);
+    auto withIds = (compiled && options.newEntityIds) ? withNewEntityIds(*compiled, data, *blueprintData, blueprintLocation, error, true) : compiled;
+    if (withIds) {
+        patchTemplate.emplace(std::move(*withIds));
+    }
+    return blueprintData;
+}
+
+// A blueprint read, checked and compiled on a background thread while the user is still answering a prompt
+struct Speculation {
+    QByteArray data;
+    BlueprintData blueprintData;
+    std::optional<PatchTemplate> patchTemplate;
+    // Of bp.sbc before it was read, the game may save it again before the blueprint is chosen
+    qint64 size;
+    QDateTime modified;
+};
+
+// These read the source in their own way, so nothing can be loaded before the blueprint is chosen
+bool canSpeculate(Options const& options) {
+    return !options.stream && !options.mmap && !options.binaryCache && !options.verifyParse;
+}
+
+// The blueprint in the list most likely to be chosen: the one saved last, as copies are usually made right after saving
+// the original in the game. -1 if nothing should be loaded before it is chosen.
+qsizetype likelyChoice(QString const& blueprintLocation, QStringList const& list, Options const& options) {
+    // Archives are only opened once chosen as opening one may print errors
+    if (!canSpeculate(options)) {
+        return -1;
+    }
+    QDir const dir(blueprintLocation);
+    qsizetype result = -1;
+    QDateTime newest;
+    for (qsizetype i = 0; i < list.size(); ++i) {
+        QString const path = dir.absoluteFilePath(list.at(i));
+        if (ZipArchive::isArchive(path)) {
+            continue;
+        }
+        QDateTime const modified = QFileInfo(QDir(path).absoluteFilePath(QStringLiteral("bp.sbc"))).lastModified();
+        if (modified.isValid() && ((result < 0) || (modified > newest))) {
+            result = i;
+            newest = modified;
+        }
+    }
+    return result;
+}
+
+// Reads, scans, checks and compiles a blueprint folder without printing anything, so it can run while a prompt is open.
+// Nothing if any step failed, the blueprint is then loaded again once chosen and the problem reported there.
+std::optional<Speculation> speculate(QDir const& folder, Options const& options) {
+    Stats::Span const span("speculate");
+    QFileInfo const info(folder.absoluteFilePath(QStringLiteral("bp.sbc")));
+    QFile file(info.absoluteFilePath());
+    if (!file.open(QFile::ReadOnly)) {
+        return std::nullopt;
+    }
+    QByteArray const data = file.readAll();
+    if ((data.size() != file.size()) || (data.size() != info.size())) {
+        return std::nullopt;
+    }
+    Stats::addBytesRead(data.size());
+
+    ParseBudget budget(options.parseLimits);
+    std::ostringstream error;
+    auto const fields = BlueprintScanner::scan(data, budget, error);
+    if (!fields) {
+        return std::nullopt;
+    }
+    BlueprintData::Problem problem;
+    auto const blueprintData = BlueprintData::lint(data, *fields, problem);
+    if (!blueprintData) {
+        return std::nullopt;
+    }
+    // New EntityIds are added once chosen, reserving those of the library reads every other blueprint
+    auto patchTemplate = PatchTemplate::compile(data, *fields, *blueprintData, options.customDataOverrides, error);
+    return Speculation{ data, *blueprintData, std::move(patchTemplate), info.size(), info.lastModified() };
+}
+
+// Whether bp.sbc is still the one the speculation read
+bool isCurrent(Speculation const& speculation, QDir const& folder) {
+    QFileInfo const info(folder.absoluteFilePath(QStringLiteral("bp.sbc")));
+    return info.exists() && (info.size() == speculation.size) && (info.lastModified() == speculation.modified);
+}
+
+// The blueprints to choose from and, with --index, the index they were taken from. Built on a background thread, so
+// its messages are kept until the listing is used.
+struct BlueprintListing {
+    QStringList list;
+    std::unique_ptr<BlueprintIndex> index;
+    std::string info;
+    std::string warnings;
+};
+
+BlueprintListing listBlueprints(QString const& blueprintLocation, Options const& options) {
+    Stats::Span const span("scan");
+    BlueprintListing result;
+    if (!options.index && !options.list && !options.haveFamily) {
+        result.list = scanBlueprints(blueprintLocation);
+        return result;
+    }
+
+    std::ostringstream warnings;
+    result.index = std::make_unique<BlueprintIndex>(blueprintLocation);
+    result.index->load(warnings);
+    qsizetype const parsed = result.index->update(options, warnings);
+    result.index->save(warnings);
+    result.info = "Info: Updated the blueprint index, " + std::to_string(parsed) + " of " + std::to_string(result.index->getEntries().size()) + " blueprints had to be parsed.";
+    result.warnings = warnings.str();
+
+    if (options.haveFamily) {
+        for (auto const entry : result.index->family(options.userFamily)) {
+            result.list.append(entry->name);
+        }
+    } else {
+        for (auto const& entry : result.index->getEntries()) {
+            result.list.append(entry.name);
+        }
+    }
+    return result;
+}
+
+// Reads, parses and compiles a source from its folder or, if archive is given, from the archive.
+// If bp.sbc and bp.sbcB5 did not change since previous was loaded, its results are reused. Problems go to error, a
+// silent load prints nothing else, which --serve needs as it answers on stdout.
+std::unique_ptr<LoadedSource> loadSource(QDir const& folder, QString const& name, Options const& options, LoadedSource const* previous, ZipArchive const* archive, std::ostream& error, bool silent) {
+    auto const file = openBlueprint(folder, archive, error);
+    if (!file) {
+        error << "Could not open blueprint '" << name.toStdString() << "' for reading!" << std::endl;
+        return nullptr;
+    }
+    QByteArray binaryData;
+    QByteArray const data = [&]() {
+        Stats::Span const span("read");
+        QByteArray result = file->readAll();
+        file->close();
+        if (options.binaryCache && (archive != nullptr)) {
+            binaryData = readArchivedBinary(*archive, error);
+        } else if (options.binaryCache && BinaryBlueprint::isFresh(folder)) {
+            QFile fileBinary(folder.absoluteFilePath(QStringLiteral("bp.sbcB5")));
+            if (fileBinary.open(QFile::ReadOnly)) {
+                binaryData = fileBinary.readAll();
+            }
+        }
+        Stats::addBytesRead(result.size() + binaryData.size());
+        return result;
+    }();
+    if ((archive != nullptr) && (data.size() != file->size())) {
+        error << "Could not read blueprint '" << name.toStdString() << "': " << file->errorString().toStdString() << std::endl;
+        return nullptr;
+    }
+    bool const unchanged = (previous != nullptr) && (previous->data == data) && (previous->binaryData == binaryData);
+    // Archives are in the blueprint folder itself, other sources are a folder in it
+    QString const blueprintLocation = (archive != nullptr) ? folder.absolutePath() : QFileInfo(folder.absolutePath()).absolutePath();
+
+    std::optional<PatchTemplate> silentTemplate;
+    auto blueprintData = [&]() {
+        Stats::Span const span("parse");
+        if (unchanged) {
+            return previous->blueprintData;
+        } else if (!binaryData.isEmpty()) {
+            auto result = BinaryBlueprint::extract(binaryData, (archive != nullptr) ? QFileInfo(name).completeBaseName() : name, error);
+            if (result) {
+                // A silent load compiles the patch template while parsing, from bp.sbc either way
+                if (silent) {
+                    parseSilently(data, blueprintLocation, options, error, silentTemplate);
+                }
+                return result;
+            }
+            error << "Warning: Could not use bp.sbcB5 of '" << name.toStdString() << "', parsing bp.sbc instead." << std::endl;
+            binaryData.clear();
+        }
+        return (silent) ? parseSilently(data, blueprintLocation, options, error, silentTemplate) : BlueprintData::fromXml(data, options, error);
+    }();
+    if (!blueprintData) {
+        return nullptr;
+    } else if (!silent && !unchanged) {
+        printFound(*blueprintData);
+    }
+
+    auto patchTemplate = [&]() {
+        Stats::Span const span("compile");
+        if (unchanged) {
+            return previous->patchTemplate;
+        } else if (silent) {
+            return std::move(silentTemplate);
+        }
+        return compileTemplate(data, *blueprintData, blueprintLocation, options, error);
+    }();
+    if (!patchTemplate && options.newEntityIds) {
+        error << "Error: New EntityIds require a patch template, which could not be built for '" << name.toStdString() << "'." << std::endl;
+        return nullptr;
+    } else if (!patchTemplate && !unchanged) {
+        error << "Warning: Could not build a patch template for '" << name.toStdString() << "', falling back to rewriting the XML for every copy." << std::endl;
+    }
+    // Archives are written with the contents of the sidecars, so they are read once up front
+    auto sidecars = (archive != nullptr) ? std::make_unique<Sidecars>(readArchivedSidecars(*archive, error)) : std::make_unique<Sidecars>(folder, (options.archive) ? Sidecars::Strategy::Copy : options.sidecarStrategy);
+    QByteArray sourceHash;
+    QByteArray sidecarHash;
+    if (options.incremental && (archive != nullptr)) {
+        Stats::Span const span("incremental");
+        sourceHash = CopyManifest::hashArchive(archive->getPath(), hashMode((patchTemplate) ? "template" : "xml", options));
+        sidecarHash = CopyManifest::hashArchive(archive->getPath(), QByteArray());
+    } else if (options.incremental) {
+        Stats::Span const span("incremental");
+        QStringList const sidecarNames = sidecars->getReplacedFileNames();
+        sourceHash = CopyManifest::hashSource(folder, sidecarNames, !binaryData.isEmpty(), hashMode((patchTemplate) ? "template" : "xml", options));
+        sidecarHash = CopyManifest::hashSidecars(folder, sidecarNames);
+    }
+    return std::make_unique<LoadedSource>(LoadedSource{ folder, data, binaryData, std::move(blueprintData), std::move(patchTemplate), sourceHash, std::move(sidecars), sidecarHash });
+}
+
+// Prints the statistics and writes the trace however main() is left
+class StatsReport {
+public:
+    explicit StatsReport(Options const& options) : m_options(options) {
+        //
+    }
+
+    ~StatsReport() {
+        // --serve may answer on stdout
+        std::ostream& out = (m_options.haveServe) ? std::cerr : std::cout;
+        if (m_options.haveStats) {
+            if (m_options.statsAsJson) {
+                out << Stats::toJson().toStdString() << std::endl;
+            } else {
+                out << Stats::toText().toStdString();
+            }
+        }
+        if (m_options.haveTrace && !Stats::writeTrace(m_options.userTrace)) {
+            std::cerr << "Warning: Could not write the trace to '" << m_options.userTrace.toStdString() << "'." << std::endl;
+        }
+    }
+private:
+    Options const& m_options;
+};
+
+// Copies the asynchronous writer keeps in flight at once
+qsizetype const asyncInFlight = 64;
+
+int runManifest(QString const& blueprintLocation, QStringList const& list, Options const& options) {
+    auto const jobs = Manifest::fromFile(options.userManifest, std::cerr);
+    if (!jobs) {
+        return -1;
+    }
+
+    // Every source is loaded and compiled once, no matter how many jobs use it
+    std::map<QString, std::unique_ptr<LoadedSource>> sources;
+    for (auto const& job : *jobs) {
+        if (sources.count(job.blueprintName) > 0) {
+            continue;
+        } else if (!list.contains(job.blueprintName)) {
+            std::cerr << "Error: The Blueprint '" << job.blueprintName.toStdString() << "' from line " << job.line << " of the manifest does not exist in the selected folder." << std::endl;
+            return -1;
+        }
+
+        QDir folder(blueprintLocation);
+        std::unique_ptr<LoadedSource> source;
+        if (ZipArchive::isArchive(folder.absoluteFilePath(job.blueprintName))) {
+            auto const archive = ZipArchive::open(folder.absoluteFilePath(job.blueprintName), std::cerr);
+            source = (archive) ? loadSource(folder, job.blueprintName, options, nullptr, &*archive, std::cerr, false) : nullptr;
+        } else {
+            folder.cd(job.blueprintName);
+            source = loadSource(folder, job.blueprintName, options, nullptr, nullptr, std::cerr, false);
+        }
+        if (!source) {
+            std::cerr << "Error: Could not load the Blueprint '" << job.blueprintName.toStdString() << "' from line " << job.line << " of the manifest." << std::endl;
+            return -1;
+        }
+        sources.emplace(job.blueprintName, std::move(source));
+    }
+
+    // Plan all copies up front, so jobs writing the same copy are caught before anything is written
+    struct PlannedCopy {
+        std::size_t job;
+        LoadedSource const* source;
+        qsizetype newId;
+        QString name;
+        bool replace;
+    };
+    CopyManifest copyManifest(blueprintLocation, options.archive);
+    if (options.incremental) {
+        copyManifest.load(std::cerr);
+    }
+    std::vector<PlannedCopy> copies;
+    CopyPlan plan(blueprintLocation, options.archive);
+    std::set<QString> copyNames;
+    std::vector<qsizetype> done(jobs->size(), 0);
+    std::vector<qsizetype> skipped(jobs->size(), 0);
+    for (std::size_t j = 0; j < jobs->size(); ++j) {
+        auto const& job = jobs->at(j);
+        LoadedSource const* const source = sources.at(job.blueprintName).get();
+        for (qsizetype i = 0; i < job.numCopies; ++i) {
+            qsizetype const newId = job.firstIndex + i;
+            QString const name = BlueprintData::cutDigitsFromEnd(source->blueprintData->getDisplayName()).append(QString::number(newId));
+            if (!copyNames.insert(name).second) {
+                std::cerr << "Error: The copy '" << name.toStdString() << "' from line " << job.line << " of the manifest is also created by another job." << std::endl;
+                return -1;
+            }
+            bool const upToDate = options.incremental && copyManifest.isUpToDate(name, source->sourceHash, newId);
+            plan.add(name, newId, upToDate);
+            if (upToDate) {
+                ++done.at(j);
+                ++skipped.at(j);
+                continue;
+            }
+            copies.push_back({ j, source, newId, name, options.force || (plan.getEntries().back().action == CopyPlan::Action::Overwrite) });
+        }
+    }
+    if (options.haveDryRun) {
+        printDryRun(plan, options);
+        return 0;
+    }
+    std::cout << "We will create " << copies.size() << " cop" << ((copies.size() == 1) ? "y" : "ies") << " from " << sources.size() << " blueprint" << ((sources.size() == 1) ? "" : "s") << " in " << jobs->size() << " job" << ((jobs->size() == 1) ? "" : "s") << "." << std::endl;
+    if (!confirmPlan(plan, options)) {
+        return -1;
+    }
+
+    // With --async, copies count as done once the writer reports them complete
+    std::map<qsizetype, QByteArray> asyncHashes;
+    std::optional<AsyncWriter> asyncWriter;
+    if (options.async) {
+        asyncWriter.emplace(asyncInFlight, [&](qsizetype i, bool success) {
+            auto const& copy = copies.at(static_cast<std::size_t>(i));
+            if (success) {
+                ++done.at(copy.job);
+                if (options.incremental) {
+                    copyManifest.record(copy.name, copy.source->sourceHash, copy.newId, asyncHashes.at(i));
+                }
+            }
+            asyncHashes.erase(i);
+        }, std::cerr);
+        std::cout << "Info: Writing copies asynchronously using " << asyncWriter->getBackendName() << "." << std::endl;
+    }
+
+    // A failing copy does not stop the other jobs, it shows up in the summary instead
+    CopyPipeline const pipeline(options.jobs, 2 * options.jobs);
+    pipeline.run(static_cast<qsizetype>(copies.size()), [&](qsizetype i, QByteArray& copyData) {
+        Stats::Span const span("generate", i);
+        auto const& copy = copies.at(static_cast<std::size_t>(i));
+        if (copy.source->patchTemplate) {
+            copy.source->patchTemplate->instantiate(copy.newId, copyData);
+        } else {
+            BlueprintData::toXMLWithNewId(copy.source->data, *copy.source->blueprintData, copy.newId, options, copyData, std::cerr);
+        }
+    }, [&](qsizetype i, QByteArray const& copyData) {
+        Stats::Span const span("store", i);
+        auto const& copy = copies.at(static_cast<std::size_t>(i));
+        QByteArray const binaryCopy = (copy.source->binaryData.isEmpty()) ? QByteArray() : BinaryBlueprint::withNewId(copy.source->binaryData, *copy.source->blueprintData, copy.newId, options.customDataOverrides, std::cerr);
+        QByteArray const copyHash = (options.incremental) ? CopyManifest::hashCopy(copyData, binaryCopy, copy.source->sidecarHash) : QByteArray();
+        if (options.incremental && copyManifest.hasContents(copy.name, copyHash)) {
+            ++skipped.at(copy.job);
+        } else if (asyncWriter) {
+            asyncHashes[i] = copyHash;
+            if (!submitCopy(*asyncWriter, blueprintLocation, copy.name, i, copyData, binaryCopy, *copy.source->sidecars, copy.replace)) {
+                asyncHashes.erase(i);
+            }
+            return true;
+        } else if (!writeCopy(blueprintLocation, *copy.source->sidecars, copy.name, copyData, binaryCopy, options, std::cerr)) {
+            return true;
+        }
+        ++done.at(copy.job);
+        if (options.incremental) {
+            copyManifest.record(copy.name, copy.source->sourceHash, copy.newId, copyHash);
+        }
+        return true;
+    });
+    if (asyncWriter) {
+        asyncWriter->finish();
+    }
+    if (options.incremental) {
+        copyManifest.save(std::cerr);
+    }
+
+    bool success = true;
+    std::cout << "Summary:" << std::endl;
+    for (std::size_t j = 0; j < jobs->size(); ++j) {
+        auto const& job = jobs->at(j);
+        std::cout << "  Line " << job.line << ": '" << job.blueprintName.toStdString() << "', " << done.at(j) << " of " << job.numCopies << " cop" << ((job.numCopies == 1) ? "y" : "ies") << " starting at " << job.firstIndex;
+        if (skipped.at(j) > 0) {
+            std::cout << " (" << skipped.at(j) << " unchanged and skipped)";
+        }
+        std::cout << ((done.at(j) == job.numCopies) ? "" : " - FAILED") << std::endl;
+        success = success && (done.at(j) == job.numCopies);
+    }
+    if (!success) {
+        return -1;
+    }
+
+    std::cout << "Done! Happy Engineering!" << std::endl;
+    return 0;
+}
+
+// Saves of the game come as a burst of writes to bp.sbc, bp.sbcB5 and thumb.png
+int const watchDebounceMilliseconds = 500;
+
+// Replaces the copies [firstIndex, firstIndex + copyCount) of a loaded source without asking. With more than one job,
+// error is written to from the worker threads.
+bool regenerateCopies(LoadedSource const& source, QString const& blueprintLocation, qsizetype firstIndex, qsizetype copyCount, qsizetype jobs, Options const& options, std::ostream& error) {
+    QString const baseName = BlueprintData::cutDigitsFromEnd(source.blueprintData->getDisplayName());
+    CopyPipeline const pipeline(jobs, 2 * jobs);
+    return pipeline.run(copyCount, [&](qsizetype i, QByteArray& copyData) {
+        Stats::Span const span("generate", i);
+        qsizetype const newId = firstIndex + i;
+        if (source.patchTemplate) {
+            source.patchTemplate->instantiate(newId, copyData);
+        } else {
+            BlueprintData::toXMLWithNewId(source.data, *source.blueprintData, newId, options, copyData, error);
+        }
+    }, [&](qsizetype i, QByteArray const& copyData) {
+        Stats::Span const span("store", i);
+        qsizetype const newId = firstIndex + i;
+        QByteArray const binaryCopy = (source.binaryData.isEmpty()) ? QByteArray() : BinaryBlueprint::withNewId(source.binaryData, *source.blueprintData, newId, options.customDataOverrides, error);
+        return writeCopy(blueprintLocation, *source.sidecars, QString(baseName).append(QString::number(newId)), copyData, binaryCopy, options, error);
+    });
+}
+
+/*
+    Keeps the source loaded and regenerates the copies on a worker thread after every save.
+    Saves arriving while the copies are regenerated are collected and handled once it finished.
+*/
+int runWatch(QCoreApplication& app, QString const& blueprintLocation, QDir const& blueprintFolder, QString const& name, qsizetype firstIndex, qsizetype copyCount, Options const& options) {
+    std::unique_ptr<LoadedSource> resident = loadSource(blueprintFolder, name, options, nullptr, nullptr, std::cerr, false);
+    if (!resident) {
+        return -1;
+    }
+    // Otherwise every regeneration would trigger the next one
+    QString const baseName = BlueprintData::cutDigitsFromEnd(resident->blueprintData->getDisplayName());
+    for (qsizetype i = 0; i < copyCount; ++i) {
+        if (QString(baseName).append(QString::number(firstIndex + i)) == name) {
+            std::cerr << "Error: The copies include the watched Blueprint '" << name.toStdString() << "' itself, can not watch it." << std::endl;
+            return -1;
+        }
+    }
+
+    QString const sourcePath = blueprintFolder.absoluteFilePath(QStringLiteral("bp.sbc"));
+    QFileSystemWatcher watcher;
+    watcher.addPath(sourcePath);
+    watcher.addPath(blueprintFolder.absolutePath());
+
+    QTimer debounce;
+    debounce.setSingleShot(true);
+    debounce.setInterval(watchDebounceMilliseconds);
+
+    std::thread worker;
+    bool running = false;
+    bool changedWhileRunning = false;
+    QObject::connect(&debounce, &QTimer::timeout, [&]() {
+        if (running) {
+            changedWhileRunning = true;
+            return;
+        }
+        if (worker.joinable()) {
+            worker.join();
+        }
+        running = true;
+        worker = std::thread([&]() {
+            QElapsedTimer timer;
+            timer.start();
+            {
+                Stats::Span const span("regenerate");
+                auto source = loadSource(blueprintFolder, name, options, resident.get(), nullptr, std::cerr, false);
+                if (!source) {
+                    std::cerr << "Warning: The saved Blueprint could not be loaded, keeping the copies of the last good save." << std::endl;
+                } else if (!regenerateCopies(*source, blueprintLocation, firstIndex, copyCount, options.jobs, options, std::cerr)) {
+                    std::cerr << "Warning: Not all copies could be regenerated." << std::endl;
+                } else {
+                    std::cout << "Regenerated " << copyCount << " cop" << ((copyCount == 1) ? "y" : "ies") << " in " << timer.elapsed() << " ms." << std::endl;
+                }
+                if (source) {
+                    resident = std::move(source);
+                }
+            }
+            QMetaObject::invokeMethod(&debounce, [&]() {
+                running = false;
+                if (changedWhileRunning) {
+                    changedWhileRunning = false;
+                    debounce.start();
+                }
+            }, Qt::QueuedConnection);
+        });
+    });
+
+    // Saving by replacing bp.sbc drops it from the watcher, so it is added again once it is back
+    auto const onChange = [&]() {
+        if (!watcher.files().contains(sourcePath) && QFile::exists(sourcePath)) {
+            watcher.addPath(sourcePath);
+        }
+        debounce.start();
+    };
+    QObject::connect(&watcher, &QFileSystemWatcher::fileChanged, onChange);
+    QObject::connect(&watcher, &QFileSystemWatcher::directoryChanged, onChange);
+
+    std::cout << "Watching '" << name.toStdString() << "' for changes, press Ctrl+C to stop." << std::endl;
+    int const result = app.exec();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    return result;
+}
+
+// Sources --serve keeps loaded, the least recently used one is dropped beyond that
+std::size_t const serveCacheSize = 32;
+
+struct CachedSource {
+    QByteArray stamp;
+    std::unique_ptr<LoadedSource> source;
+};
+
+// Changes whenever a file the source is loaded from is written to or replaced, bp.sbcB5 and the sidecars included
+QByteArray sourceStamp(QString const& path, bool archive) {
+    QFileInfoList files;
+    if (archive) {
+        files.append(QFileInfo(path));
+    } else {
+        files = QDir(path).entryInfoList(QDir::Files, QDir::Name);
+    }
+    QByteArray result;
+    for (auto const& file : files) {
+        result.append(file.fileName().toUtf8()).append('\0');
+        result.append(QByteArray::number(file.lastModified().toMSecsSinceEpoch())).append(':').append(QByteArray::number(file.size())).append('\0');
+    }
+    return result;
+}
+
+/*
+    The Blueprints the requests of --serve are reading from and writing to right now. A source may be read by many
+    requests at once, but a copy is only ever touched by the one request writing it, so overlapping requests are
+    refused instead of writing the same folder or reading a half-written one.
+*/
+class InFlight {
+public:
+    // Holds the names until it goes out of scope, empty if they could not be claimed
+    class Claim {
+    public:
+        Claim(InFlight& inFlight, QStringList const& sources, QStringList const& copies) : m_inFlight(inFlight), m_sources(sources), m_copies(copies), m_claimed(inFlight.claim(sources, copies)) {
+            //
+        }
+        ~Claim() {
+            if (m_claimed) {
+                m_inFlight.release(m_sources, m_copies);
+            }
+        }
+        Claim(Claim const&) = delete;
+        Claim& operator=(Claim const&) = delete;
+
+        explicit operator bool() const {
+            return m_claimed;
+        }
+    private:
+        InFlight& m_inFlight;
+        QStringList const m_sources;
+        QStringList const m_copies;
+        bool const m_claimed;
+    };
+private:
+    std::mutex m_mutex;
+    std::multiset<QString> m_sources;
+    std::set<QString> m_copies;
+
+    // A source must not be written by another request, a copy must neither be written nor read by one
+    bool claim(QStringList const& sources, QStringList const& copies) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto const& name : sources) {
+            if (m_copies.count(name) > 0) {
+                return false;
+            }
+        }
+        for (auto const& name : copies) {
+            if ((m_copies.count(name) > 0) || (m_sources.count(name) > 0)) {
+                return false;
+            }
+        }
+        m_sources.insert(sources.cbegin(), sources.cend());
+        m_copies.insert(copies.cbegin(), copies.cend());
+        return true;
+    }
+
+    void release(QStringList const& sources, QStringList const& copies) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto const& name : sources) {
+            m_sources.erase(m_sources.find(name));
+        }
+        for (auto const& name : copies) {
+            m_copies.erase(name);
+        }
+    }
+};
+
+// Answers one request of --serve, called on many threads at once
+QJsonObject serveRequest(Server::Request const& request, QString const& blueprintLocation, LruCache<QString, CachedSource>& cache, InFlight& inFlight, Options const& options) {
+    QJsonObject response;
+    auto const fail = [&](QString const& error) {
+        response.insert(QStringLiteral("ok"), false);
+        response.insert(QStringLiteral("error"), error);
+        return response;
+    };
+
+    // Only Blueprints directly in the selected folder can be requested
+    QDir folder(blueprintLocation);
+    QString const path = folder.absoluteFilePath(request.blueprint);
+    bool const isArchive = ZipArchive::isArchive(path);
+    if (request.blueprint.contains(QChar('/')) || request.blueprint.contains(QChar('\\')) || (request.blueprint == QStringLiteral(".")) || (request.blueprint == QStringLiteral(".."))
+        || (!isArchive && !QFileInfo(QDir(path).absoluteFilePath(QStringLiteral("bp.sbc"))).isFile())) {
+        return fail(QStringLiteral("The Blueprint '%1' does not exist in the selected folder.").arg(request.blueprint));
+    }
+
+    // Claimed before loading, so the source can not be loaded while another request writes it
+    QString const sourceName = (isArchive) ? QFileInfo(request.blueprint).completeBaseName() : request.blueprint;
+    InFlight::Claim const sourceClaim(inFlight, { sourceName }, {});
+    if (!sourceClaim) {
+        return fail(QStringLiteral("The Blueprint '%1' is being written by another request.").arg(request.blueprint));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray const stamp = sourceStamp(path, isArchive);
+    std::shared_ptr<CachedSource const> cached = cache.find(path);
+    bool const hit = (cached != nullptr) && (cached->stamp == stamp);
+    // Nothing may be printed while serving, the problems of loading a source are answered instead
+    std::ostringstream error;
+    if (!hit) {
+        // A source that changed on disk still saves parsing and compiling if bp.sbc itself is unchanged
+        LoadedSource const* const previous = (cached != nullptr) ? cached->source.get() : nullptr;
+        std::unique_ptr<LoadedSource> source;
+        if (isArchive) {
+            auto const archive = ZipArchive::open(path, error);
+            source = (archive) ? loadSource(folder, request.blueprint, options, previous, &*archive, error, true) : nullptr;
+        } else {
+            folder.cd(request.blueprint);
+            source = loadSource(folder, request.blueprint, options, previous, nullptr, error, true);
+        }
+        if (!source) {
+            return fail(QStringLiteral("Could not load the Blueprint '%1': %2").arg(request.blueprint, QString::fromStdString(error.str()).trimmed()));
+        }
+        cached = std::make_shared<CachedSource const>(CachedSource{ stamp, std::move(source) });
+        cache.insert(path, cached);
+    }
+    qint64 const loadMs = timer.restart();
+
+    LoadedSource const& source = *cached->source;
+    QString const baseName = BlueprintData::cutDigitsFromEnd(source.blueprintData->getDisplayName());
+    QStringList copyNames;
+    for (qsizetype i = 0; i < request.numCopies; ++i) {
+        copyNames.append(QString(baseName).append(QString::number(request.firstIndex + i)));
+        if (copyNames.back() == sourceName) {
+            return fail(QStringLiteral("The copies include the Blueprint '%1' itself.").arg(request.blueprint));
+        }
+    }
+    InFlight::Claim const copiesClaim(inFlight, {}, copyNames);
+    if (!copiesClaim) {
+        return fail(QStringLiteral("Some copies of '%1' are being written or read by another request.").arg(request.blueprint));
+    }
+
+    // Requests already run concurrently, so the copies of one request are written one after the other
+    if (!regenerateCopies(source, blueprintLocation, request.firstIndex, request.numCopies, 1, options, error)) {
+        return fail(QStringLiteral("Not all copies of '%1' could be written: %2").arg(request.blueprint, QString::fromStdString(error.str()).trimmed()));
+    }
+    response.insert(QStringLiteral("ok"), true);
+    response.insert(QStringLiteral("copies"), static_cast<double>(request.numCopies));
+    response.insert(QStringLiteral("cached"), hit);
+    response.insert(QStringLiteral("loadMs"), static_cast<double>(loadMs));
+    response.insert(QStringLiteral("writeMs"), static_cast<double>(timer.elapsed()));
+    if (!error.str().empty()) {
+        response.insert(QStringLiteral("warning"), QString::fromStdString(error.str()).trimmed());
+    }
+    return response;
+}
+
+int runServe(QCoreApplication& app, QString const& blueprintLocation, Options const& options) {
+    LruCache<QString, CachedSource> cache(serveCacheSize);
+    InFlight inFlight;
+    Server server(options.jobs, [&](Server::Request const& request) {
+        return serveRequest(request, blueprintLocation, cache, inFlight, options);
+    });
+    if (options.userServe == QStringLiteral("-")) {
+        server.runStdio(std::cin, std::cout);
+        return 0;
+    } else if (!server.listen(options.userServe, std::cerr)) {
+        return -1;
+    }
+    std::cout << "Info: Listening for requests on '" << server.getServerName().toStdString() << "'." << std::endl;
+    return app.exec();
 }
 
 int main(int argc, char* argv[]) {
@@ -100,7 +1112,15 @@ int main(int argc, char* argv[]) {
     
 
     // Process the actual command line arguments given by the user
-    Options const options = Options::parseOptions(app);
+    std::optional<Options> const parsedOptions = Options::parseOptions(app, std::cerr);
+    if (!parsedOptions) {
+        return -1;
+    }
+    Options const& options = *parsedOptions;
+    if (options.haveStats || options.haveTrace) {
+        Stats::enable(options.haveTrace);
+    }
+    StatsReport const statsReport(options);
 
     // 1. Select location for blueprints
     QString blueprintLocation = options.userBlueprintLocation;
@@ -119,21 +1139,66 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    // 2. Present a list of Blueprints
-    auto const list = scanBlueprints(blueprintLocation);
+    if (options.haveServe) {
+        return runServe(app, blueprintLocation, options);
+    }
+
+    // 2. Present a list of Blueprints. It is built in the background, meanwhile a blueprint chosen on the command line
+    // is already being loaded.
+    auto listing = std::async(std::launch::async, [&]() {
+        return listBlueprints(blueprintLocation, options);
+    });
+    QString speculatedName;
+    std::future<std::optional<Speculation>> speculation;
+    auto const startSpeculation = [&](QString const& name) {
+        speculatedName = name;
+        speculation = std::async(std::launch::async, [&blueprintLocation, &options, name]() {
+            return speculate(QDir(blueprintLocation).absoluteFilePath(name), options);
+        });
+    };
+    bool const duplicating = !options.list && !options.haveLint && !options.haveManifest;
+    if (duplicating && options.haveBlueprintName && canSpeculate(options) && !ZipArchive::isArchive(QDir(blueprintLocation).absoluteFilePath(options.userBlueprintName))) {
+        startSpeculation(options.userBlueprintName);
+    }
+
+    BlueprintListing const listed = listing.get();
+    if (!listed.info.empty()) {
+        std::cout << listed.info << std::endl;
+    }
+    std::cerr << listed.warnings;
+    QStringList const& list = listed.list;
+    bool const useIndex = (listed.index != nullptr);
     if (list.size() < 1) {
-        std::cerr << "The selected location '" << blueprintLocation.toStdString() << "' does not contain any Blueprints! It should contain a set of folders, each containing a file called 'bp.spc'." << std::endl;
+        std::cerr << "The selected location '" << blueprintLocation.toStdString() << "' does not contain any (matching) Blueprints! It should contain a set of folders, each containing a file called 'bp.spc'." << std::endl;
         return -1;
     }
 
+    if (options.list) {
+        printBlueprintList(list, listed.index.get());
+        return 0;
+    } else if (options.haveLint) {
+        BlueprintLint lint(blueprintLocation, options.parseLimits);
+        lint.run(list, options.jobs);
+        if (options.lintAsJson) {
+            std::cout << lint.toJson().toStdString() << std::endl;
+        } else {
+            std::cout << lint.toText().toStdString();
+        }
+        return (lint.getProblemCount() == 0) ? 0 : -1;
+    } else if (options.haveManifest) {
+        return runManifest(blueprintLocation, list, options);
+    }
+
+    // While the list is on screen, the likely choice is already loaded in the background
     qsizetype choiceIndex = -1;
+    qsizetype const likelyIndex = (options.haveBlueprintName) ? -1 : likelyChoice(blueprintLocation, list, options);
+    if (likelyIndex >= 0) {
+        startSpeculation(list.at(likelyIndex));
+    }
     if (!options.haveBlueprintName) {
         std::cout << "Available Blueprints:" << std::endl;
-        for (qsizetype i = 0; i < list.size(); ++i) {
-            std::cout << std::setw(3) << (i + 1) << ": " << list.at(i).toStdString() << std::endl;
-        }
+        printBlueprintList(list, listed.index.get());
 
-        
         if (!readNumericInputOrQuit("", choiceIndex, 1, list.size())) {
             std::cout << "Quitting as requested..." << std::endl;
             return -1;
@@ -151,28 +1216,151 @@ int main(int argc, char* argv[]) {
 
     QString const choice = list.at(choiceIndex);
     std::cout << "You selected: " << choice.toStdString() << std::endl;
+    if (useIndex) {
+        auto const entry = listed.index->find(choice);
+        if ((entry != nullptr) && !entry->valid) {
+            std::cerr << "Warning: The blueprint index lists '" << choice.toStdString() << "' as invalid." << std::endl;
+        }
+    }
 
-    // 3. Load Blueprint
+    // A speculation on another blueprint is left to finish on its own, one on a bp.sbc saved again since is dropped
+    std::optional<Speculation> const speculated = [&]() {
+        auto result = (speculation.valid() && (speculatedName == choice)) ? speculation.get() : std::nullopt;
+        if (result && !isCurrent(*result, QDir(blueprintLocation).absoluteFilePath(choice))) {
+            result.reset();
+        }
+        return result;
+    }();
+
+    // 3. Load Blueprint, Workshop archives are read in place
     QDir blueprintFolder(blueprintLocation);
-    if (!blueprintFolder.cd(choice)) {
+    std::optional<ZipArchive> archive;
+    if (ZipArchive::isArchive(blueprintFolder.absoluteFilePath(choice))) {
+        archive = ZipArchive::open(blueprintFolder.absoluteFilePath(choice), std::cerr);
+        if (!archive) {
+            return -1;
+        } else if (options.watch) {
+            std::cerr << "Error: Blueprints in an archive can not be watched." << std::endl;
+            return -1;
+        }
+    } else if (!blueprintFolder.cd(choice)) {
         std::cerr << "Error: Failed to open your chosen blueprint?!" << std::endl;
         return -1;
     }
-    QFile file(blueprintFolder.absoluteFilePath(QStringLiteral("bp.sbc")));
-    if (!file.open(QFile::ReadOnly)) {
+    ZipArchive const* const archivePointer = (archive) ? &*archive : nullptr;
+    auto const file = openBlueprint(blueprintFolder, archivePointer);
+    if (!file) {
         std::cerr << "Could not open selected blueprint for reading!" << std::endl;
         return -1;
     }
-    QByteArray const data = file.readAll();
-    file.close();
-    auto const blueprintData = BlueprintData::fromXml(data, options);
+    QByteArray binaryData;
+    if (options.binaryCache && archive) {
+        Stats::Span const span("read");
+        binaryData = readArchivedBinary(*archive, std::cerr);
+        Stats::addBytesRead(binaryData.size());
+    } else if (options.binaryCache && BinaryBlueprint::isFresh(blueprintFolder)) {
+        Stats::Span const span("read");
+        QFile fileBinary(blueprintFolder.absoluteFilePath(QStringLiteral("bp.sbcB5")));
+        if (fileBinary.open(QFile::ReadOnly)) {
+            binaryData = fileBinary.readAll();
+            Stats::addBytesRead(binaryData.size());
+        }
+    }
+
+    QByteArray data;
+    auto const blueprintData = [&]() {
+        if (speculated) {
+            data = speculated->data;
+            return std::optional<BlueprintData>(speculated->blueprintData);
+        }
+        {
+            Stats::Span const span("read");
+            if (options.mmap && !options.stream && !archive) {
+                QFile& mappedFile = static_cast<QFile&>(*file);
+                uchar const* const mapped = mappedFile.map(0, mappedFile.size());
+                if (mapped == nullptr) {
+                    std::cerr << "Could not map selected blueprint into memory!" << std::endl;
+                    return std::optional<BlueprintData>();
+                }
+                // Does not copy, the mapping stays valid as long as file is open
+                data = QByteArray::fromRawData(reinterpret_cast<char const*>(mapped), mappedFile.size());
+            } else if (!options.stream) {
+                data = file->readAll();
+                file->close();
+                if (data.size() != file->size()) {
+                    std::cerr << "Could not read selected blueprint: " << file->errorString().toStdString() << std::endl;
+                    return std::optional<BlueprintData>();
+                }
+            }
+            Stats::addBytesRead(file->size());
+        }
+
+        Stats::Span const span("parse");
+        if (!binaryData.isEmpty()) {
+            auto result = BinaryBlueprint::extract(binaryData, (archive) ? QFileInfo(choice).completeBaseName() : choice, std::cerr);
+            if (result) {
+                std::cout << "Info: Read the blueprint data from bp.sbcB5." << std::endl;
+                return result;
+            }
+            std::cerr << "Warning: Could not use bp.sbcB5, parsing bp.sbc instead." << std::endl;
+            binaryData.clear();
+        }
+
+        if (options.stream) {
+            // The document is never held in memory, copies are streamed from the source file as well
+            auto result = BlueprintData::fromXml(*file, options, std::cerr);
+            file->close();
+            return result;
+        }
+        return BlueprintData::fromXml(data, options, std::cerr);
+    }();
     if (!blueprintData) {
         return -1;
-    } else if (choice != blueprintData->getDisplayName()) {
+    }
+    printFound(*blueprintData);
+    if (!archive && (choice != blueprintData->getDisplayName())) {
         std::cerr << "The selected blueprint should be in a folder called '" << blueprintData->getDisplayName().toStdString() << "', not in '" << choice.toStdString() << "'..." << std::endl;
     }
 
-    // 4. Ask how many copies and duplicate them
+    // Compile the source once, every copy is then spliced together from it
+    auto const patchTemplate = [&]() {
+        Stats::Span const span("compile");
+        if (speculated && speculated->patchTemplate) {
+            return (options.newEntityIds) ? withNewEntityIds(*speculated->patchTemplate, data, *blueprintData, blueprintLocation, std::cerr, false) : speculated->patchTemplate;
+        }
+        return (options.stream) ? std::optional<PatchTemplate>() : compileTemplate(data, *blueprintData, blueprintLocation, options, std::cerr);
+    }();
+    if (!patchTemplate && options.newEntityIds) {
+        std::cerr << "Error: New EntityIds require a patch template, which could not be built for this blueprint." << std::endl;
+        return -1;
+    } else if (!options.stream && !patchTemplate) {
+        std::cerr << "Warning: Could not build a patch template for this blueprint, falling back to rewriting the XML for every copy." << std::endl;
+    }
+
+    // 4. Ask how many copies and duplicate them. Neither the sidecars nor the hashes for --incremental depend on the
+    // answers, so they are prepared in the background while the questions are open.
+    std::unique_ptr<Sidecars> folderSidecars;
+    QByteArray sourceHash;
+    QByteArray sidecarHash;
+    auto preparation = std::async(std::launch::async, [&]() {
+        if (!archive) {
+            folderSidecars = std::make_unique<Sidecars>(blueprintFolder, (options.archive) ? Sidecars::Strategy::Copy : options.sidecarStrategy);
+        }
+        if (!options.incremental) {
+            return;
+        }
+        Stats::Span const span("incremental");
+        QByteArray const mode = hashMode((options.stream) ? "stream" : ((patchTemplate) ? "template" : "xml"), options);
+        if (archive) {
+            sourceHash = CopyManifest::hashArchive(archive->getPath(), mode);
+            sidecarHash = CopyManifest::hashArchive(archive->getPath(), QByteArray());
+        } else {
+            QStringList const sidecarNames = folderSidecars->getReplacedFileNames();
+            sourceHash = CopyManifest::hashSource(blueprintFolder, sidecarNames, !binaryData.isEmpty(), mode);
+            sidecarHash = CopyManifest::hashSidecars(blueprintFolder, sidecarNames);
+        }
+    });
+
     qsizetype firstIndex = options.userFirstIndex;
     if (!options.haveFirstIndex) {
         if (!readNumericInputOrQuit("Choose the starting ID of your copies. ", firstIndex, 1, 9999)) {
@@ -189,54 +1377,194 @@ int main(int argc, char* argv[]) {
     }    
     std::cout << "We will create " << copyCount << " cop" << ((copyCount == 1) ? "y" : "ies") << ", starting at " << firstIndex << "." << std::endl;
 
-    for (qsizetype i = 0; i < copyCount; ++i) {
-        QByteArray const copyData = BlueprintData::toXMLWithNewId(data, *blueprintData, firstIndex, options);
-        if (copyData.isNull() || copyData.isEmpty()) {
-            std::cerr << "Failed to produce a viable copy, quitting..." << std::endl;
+    auto const copyNameFor = [&](qsizetype i) {
+        return BlueprintData::cutDigitsFromEnd(blueprintData->getDisplayName()).append(QString::number(firstIndex + i));
+    };
+    auto const binaryCopyFor = [&](qsizetype i) {
+        Stats::Span const span("binary");
+        return (binaryData.isEmpty()) ? QByteArray() : BinaryBlueprint::withNewId(binaryData, *blueprintData, firstIndex + i, options.customDataOverrides, std::cerr);
+    };
+
+    // Archives are written with the contents of the sidecars, so they are read once up front. That may print a warning,
+    // so unlike the sidecars of a folder it is not done in the background.
+    preparation.get();
+    std::unique_ptr<Sidecars const> const sidecarsStorage = (archive) ? std::make_unique<Sidecars const>(readArchivedSidecars(*archive, std::cerr)) : std::move(folderSidecars);
+    Sidecars const& sidecars = *sidecarsStorage;
+
+    // With --salvo, all copies go into one Blueprint named after the range of numbers
+    if (options.haveSalvo) {
+        if (!patchTemplate) {
+            std::cerr << "Error: A salvo can only be built from a Blueprint with a patch template." << std::endl;
             return -1;
         }
-        
-        QString const copyName = BlueprintData::cutDigitsFromEnd(blueprintData->getDisplayName()).append(QString::number(firstIndex));
-
-        QDir copyDir(blueprintLocation);
-        if (!copyDir.cd(copyName)) {
-            copyDir.mkdir(copyName);
-            copyDir.cd(copyName);
+        auto const salvo = [&]() {
+            Stats::Span const span("compile");
+            return Salvo::compile(*patchTemplate, std::cerr);
+        }();
+        if (!salvo) {
+            return -1;
+        }
+        QByteArray const label = QByteArray::number(firstIndex).append('-').append(QByteArray::number(firstIndex + copyCount - 1));
+        QString const salvoName = BlueprintData::cutDigitsFromEnd(blueprintData->getDisplayName()).append(QString::fromUtf8(label));
+        if (salvoName == choice) {
+            std::cerr << "Error: The salvo would replace the selected Blueprint itself." << std::endl;
+            return -1;
+        }
+        CopyPlan plan(blueprintLocation, false);
+        plan.add(salvoName, firstIndex, false);
+        if (options.haveDryRun) {
+            printDryRun(plan, options);
+            return 0;
+        } else if (!confirmPlan(plan, options)) {
+            return -1;
         }
+        std::cout << "Info: Writing the copies with " << salvo->getGridCount() << " grid" << ((salvo->getGridCount() == 1) ? "" : "s") << " each as the salvo '" << salvoName.toStdString() << "'." << std::endl;
+        Stats::Span const span("store");
+        // bp.sbcB5 is not written, the game builds it from the new bp.sbc
+        if (!writeCopy(blueprintLocation, sidecars, salvoName, [&](QFile& file) { return salvo->write(file, firstIndex, copyCount, options.salvoPattern, label); }, QByteArray(), options, std::cerr)) {
+            return -1;
+        }
+        std::cout << "Done! Happy Engineering!" << std::endl;
+        return 0;
+    }
 
-        QString const copyBpName = copyDir.absoluteFilePath(QStringLiteral("bp.sbc"));
-        if (QFile::exists(copyBpName)) {
-            bool mayOverride = options.force;
-            if (!mayOverride) {
-                QString const removeReply = readInputFromConsoleWithDefault("Are you sure you want to replace all contents of the existing Blueprint '" + copyName.toStdString() + "'? (y or yes to confirm)", QStringLiteral("no"));
-                mayOverride = ((removeReply == QStringLiteral("y")) || (removeReply == QStringLiteral("yes")));
-            }
-            
-            if (mayOverride) {
-                QFile::remove(copyBpName);
-                QFile::remove(copyDir.absoluteFilePath(QStringLiteral("bp.sbcB5")));
-                QFile::remove(copyDir.absoluteFilePath(QStringLiteral("thumb.png")));
-            } else {
-                std::cout << "Will not override, quitting..." << std::endl;
-                return -1;
-            }
+    // With --incremental, copies generated from the same source and id are not even generated again
+    CopyManifest copyManifest(blueprintLocation, options.archive);
+    if (options.incremental) {
+        Stats::Span const span("incremental");
+        copyManifest.load(std::cerr);
+    }
+    std::vector<qsizetype> pending;
+    for (qsizetype i = 0; i < copyCount; ++i) {
+        if (!options.incremental || !copyManifest.isUpToDate(copyNameFor(i), sourceHash, firstIndex + i)) {
+            pending.push_back(i);
         }
+    }
+    qsizetype const pendingCount = static_cast<qsizetype>(pending.size());
 
-        QFile fileBlueprint(copyBpName);
-        if (!fileBlueprint.open(QFile::WriteOnly)) {
-            std::cerr << "Error: Failed to write file '" << copyBpName.toStdString() << "', not writable!" << std::endl;
-            return -1;
+    // Every target is looked at before the first copy is written, so the run either stops here or goes through
+    CopyPlan plan(blueprintLocation, options.archive);
+    {
+        std::size_t k = 0;
+        for (qsizetype i = 0; i < copyCount; ++i) {
+            bool const isPending = (k < pending.size()) && (pending.at(k) == i);
+            plan.add(copyNameFor(i), firstIndex + i, !isPending);
+            k += (isPending) ? 1 : 0;
         }
-        fileBlueprint.write(copyData);
-        fileBlueprint.close();
+    }
+    if (options.haveDryRun) {
+        printDryRun(plan, options);
+        return 0;
+    } else if (!confirmPlan(plan, options)) {
+        return -1;
+    }
 
-        // Copy the Thumbnail
-        QFile::copy(blueprintFolder.absoluteFilePath(QStringLiteral("thumb.png")), copyDir.absoluteFilePath(QStringLiteral("thumb.png")));
+    // With --async, the writer only queues a copy and it is recorded once it completed
+    bool asyncSuccess = true;
+    std::map<qsizetype, QByteArray> asyncHashes;
+    std::optional<AsyncWriter> asyncWriter;
+    if (options.async && !options.stream) {
+        asyncWriter.emplace(asyncInFlight, [&](qsizetype i, bool success) {
+            asyncSuccess = asyncSuccess && success;
+            if (success && options.incremental) {
+                copyManifest.record(copyNameFor(i), sourceHash, firstIndex + i, asyncHashes.at(i));
+            }
+            asyncHashes.erase(i);
+        }, std::cerr);
+        std::cout << "Info: Writing copies asynchronously using " << asyncWriter->getBackendName() << "." << std::endl;
+    }
+
+    // Skips copies that are already on disk with exactly these contents, and records every copy for the next run
+    qsizetype identicalCount = 0;
+    auto const storeCopy = [&](qsizetype i, QByteArray const& copyHash, std::function<bool()> const& write) {
+        QString const copyName = copyNameFor(i);
+        if (options.incremental && copyManifest.hasContents(copyName, copyHash)) {
+            ++identicalCount;
+        } else if (asyncWriter) {
+            asyncHashes[i] = copyHash;
+            return write() && asyncSuccess;
+        } else if (!write()) {
+            return false;
+        }
+        if (options.incremental) {
+            copyManifest.record(copyName, sourceHash, firstIndex + i, copyHash);
+        }
+        return true;
+    };
 
-        ++firstIndex;
+    bool success = true;
+    if (options.stream) {
+        // The contents are only known after streaming them, so only unchanged sources are skipped
+        for (qsizetype k = 0; (k < pendingCount) && success; ++k) {
+            qsizetype const i = pending.at(static_cast<std::size_t>(k));
+            Stats::Span const span("store", i);
+            success = storeCopy(i, QByteArray(), [&]() {
+                return writeCopy(blueprintLocation, sidecars, copyNameFor(i), [&](QFile& output) {
+                    auto const input = openBlueprint(blueprintFolder, archivePointer);
+                    if (!input) {
+                        std::cerr << "Could not open selected blueprint for reading!" << std::endl;
+                        return false;
+                    }
+                    return BlueprintData::toXMLWithNewId(*input, output, *blueprintData, firstIndex + i, options, std::cerr);
+                }, binaryCopyFor(i), options, std::cerr);
+            });
+        }
+    } else if (options.mmap && patchTemplate && !asyncWriter && !options.archive) {
+        // Scatter-gather straight from the mapping, only the new number is allocated per copy
+        for (qsizetype k = 0; (k < pendingCount) && success; ++k) {
+            qsizetype const i = pending.at(static_cast<std::size_t>(k));
+            Stats::Span const span("store", i);
+            QByteArray const number = QByteArray::number(firstIndex + i);
+            QByteArray scratch;
+            auto const slices = patchTemplate->slices(number, scratch);
+            QByteArray const binaryCopy = binaryCopyFor(i);
+            QByteArray const copyHash = (options.incremental) ? CopyManifest::hashCopy(slices, binaryCopy, sidecarHash) : QByteArray();
+            success = storeCopy(i, copyHash, [&]() {
+                return writeCopy(blueprintLocation, sidecars, copyNameFor(i), [&](QFile& file) { return SliceWriter::write(file, slices); }, binaryCopy, options, std::cerr);
+            });
+        }
+    } else {
+        CopyPipeline const pipeline(options.jobs, 2 * options.jobs);
+        // Every worker writes into a buffer the writer is done with, so the copies do not allocate one each
+        success = pipeline.run(pendingCount, [&](qsizetype k, QByteArray& copyData) {
+            qsizetype const i = pending.at(static_cast<std::size_t>(k));
+            Stats::Span const span("generate", i);
+            qsizetype const newId = firstIndex + i;
+            if (patchTemplate) {
+                patchTemplate->instantiate(newId, copyData);
+            } else {
+                BlueprintData::toXMLWithNewId(data, *blueprintData, newId, options, copyData, std::cerr);
+            }
+        }, [&](qsizetype k, QByteArray const& copyData) {
+            qsizetype const i = pending.at(static_cast<std::size_t>(k));
+            Stats::Span const span("store", i);
+            QByteArray const binaryCopy = binaryCopyFor(i);
+            QByteArray const copyHash = (options.incremental) ? CopyManifest::hashCopy(copyData, binaryCopy, sidecarHash) : QByteArray();
+            return storeCopy(i, copyHash, [&]() {
+                if (asyncWriter) {
+                    bool const replace = options.force || (plan.getEntries().at(static_cast<std::size_t>(i)).action == CopyPlan::Action::Overwrite);
+                    return submitCopy(*asyncWriter, blueprintLocation, copyNameFor(i), i, copyData, binaryCopy, sidecars, replace);
+                }
+                return writeCopy(blueprintLocation, sidecars, copyNameFor(i), copyData, binaryCopy, options, std::cerr);
+            });
+        });
+        if (asyncWriter) {
+            asyncWriter->finish();
+            success = success && asyncSuccess;
+        }
+    }
+    if (options.incremental) {
+        copyManifest.save(std::cerr);
+        std::cout << "Info: Skipped " << (copyCount - pendingCount) << " cop" << ((copyCount - pendingCount == 1) ? "y" : "ies") << " with an unchanged source and " << identicalCount << " that " << ((identicalCount == 1) ? "was" : "were") << " already identical on disk." << std::endl;
+    }
+    if (!success) {
+        return -1;
     }
 
     std::cout << "Done! Happy Engineering!" << std::endl;
+    if (options.watch) {
+        return runWatch(app, blueprintLocation, blueprintFolder, choice, firstIndex, copyCount, options);
+    }
     return 0;
 }
 
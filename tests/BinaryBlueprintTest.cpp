@@ -0,0 +1,177 @@
+#include <QByteArray>
+#include <QString>
+
+#include <iostream>
+#include <optional>
+
+#include "BlueprintGenerator.h"
+#include "TestCheck.h"
+
+#include "BinaryBlueprint.h"
+#include "BlueprintData.h"
+#include "Options.h"
+
+namespace {
+    void appendVarint(QByteArray& out, quint64 value) {
+        while (value >= 0x80) {
+            out.append(static_cast<char>((value & 0x7F) | 0x80));
+            value >>= 7;
+        }
+        out.append(static_cast<char>(value));
+    }
+
+    void appendNumber(QByteArray& out, quint64 field, quint64 value) {
+        appendVarint(out, field << 3);
+        appendVarint(out, value);
+    }
+
+    // Strings and nested messages alike
+    void appendBytes(QByteArray& out, quint64 field, QByteArray const& payload) {
+        appendVarint(out, (field << 3) | 2);
+        appendVarint(out, static_cast<quint64>(payload.size()));
+        out.append(payload);
+    }
+
+    QByteArray customDataOf(BlueprintGenerator::Parameters const& parameters, QByteArray const& lineBreak) {
+        QByteArray result("[Missile - Configuration]");
+        result.append(lineBreak).append("Missile name tag=").append(parameters.name.toUtf8());
+        result.append(lineBreak).append("Missile number=").append(QByteArray::number(parameters.number));
+        result.append(lineBreak).append("Fire individual missiles=true");
+        result.append(lineBreak).append("[Missile - Done]");
+        return result;
+    }
+
+    // A bp.sbcB5 of the blueprint BlueprintGenerator::generate writes, reduced to the blocks with their ids, subtypes,
+    // names and custom data, the grid with its display name and the block group. The thrusters are named
+    // thrusterName followed by their index.
+    QByteArray binaryOf(BlueprintGenerator::Parameters const& parameters, QByteArray const& lineBreak, QByteArray const& thrusterName = "Thruster ") {
+        QByteArray const displayName = BlueprintGenerator::displayNameOf(parameters).toUtf8();
+        QByteArray grid;
+        for (qsizetype i = 0; i < parameters.blocks; ++i) {
+            QByteArray block;
+            appendNumber(block, 1, 0x7000000000000000ull + static_cast<quint64>(i));
+            if (i == 0) {
+                appendBytes(block, 2, "SmallProgrammableBlock");
+                appendBytes(block, 3, "(" + displayName + ") Programmable Block");
+                appendBytes(block, 4, customDataOf(parameters, lineBreak));
+            } else if ((i % 2) == 0) {
+                appendBytes(block, 2, "SmallBlockSmallThrust");
+                appendBytes(block, 3, "(" + displayName + ") " + thrusterName + QByteArray::number(i));
+            } else {
+                appendBytes(block, 2, "SmallBlockArmorBlock");
+            }
+            appendBytes(grid, 2, block);
+        }
+        appendBytes(grid, 3, displayName);
+        QByteArray group;
+        appendBytes(group, 1, displayName);
+        appendBytes(grid, 4, group);
+
+        QByteArray definition;
+        appendBytes(definition, 1, displayName);
+        appendBytes(definition, 2, grid);
+        QByteArray result;
+        appendBytes(result, 1, definition);
+        return result;
+    }
+
+    BlueprintGenerator::Parameters parametersOf(qsizetype blocks, int number) {
+        BlueprintGenerator::Parameters result = BlueprintGenerator::defaultParameters();
+        result.blocks = blocks;
+        result.number = number;
+        result.customDataSize = 0;
+        return result;
+    }
+
+    // bp.sbcB5 has to give the same data as bp.sbc, for the source and for every copy made from both
+    void testRoundTrip(TestCheck& checks, qsizetype blocks) {
+        Options const options;
+        BlueprintGenerator::Parameters const parameters = parametersOf(blocks, 1);
+        QByteArray const xml = BlueprintGenerator::generate(parameters);
+        QByteArray const binary = binaryOf(parameters, "\n");
+
+        auto const fromXml = BlueprintData::fromXml(xml, options, std::cerr);
+        auto const fromBinary = BinaryBlueprint::extract(binary, BlueprintGenerator::displayNameOf(parameters), std::cerr);
+        if (!CHECK(fromXml.has_value()) || !CHECK(fromBinary.has_value())) {
+            return;
+        }
+        CHECK(*fromXml == *fromBinary);
+
+        for (int const newId : { 2, 17, 1234 }) {
+            QByteArray const xmlCopy = BlueprintData::toXMLWithNewId(xml, *fromXml, newId, options, std::cerr);
+            QByteArray const binaryCopy = BinaryBlueprint::withNewId(binary, *fromBinary, newId, {}, std::cerr);
+            // Every string is renumbered in place, so the copy is exactly what the game would write for that number
+            CHECK(binaryCopy == binaryOf(parametersOf(blocks, newId), "\n"));
+
+            auto const xmlCopyData = BlueprintData::fromXml(xmlCopy, options, std::cerr);
+            if (!CHECK(xmlCopyData.has_value())) {
+                continue;
+            }
+            auto const binaryCopyData = BinaryBlueprint::extract(binaryCopy, xmlCopyData->getGridName(), std::cerr);
+            if (CHECK(binaryCopyData.has_value())) {
+                CHECK(*binaryCopyData == *xmlCopyData);
+                CHECK(binaryCopyData->getId() == newId);
+            }
+        }
+    }
+
+    // A custom data whose missile number can not be renumbered drops bp.sbcB5 instead of keeping the old number
+    void testCrLfCustomData(TestCheck& checks) {
+        Options const options;
+        BlueprintGenerator::Parameters const parameters = parametersOf(10, 1);
+        auto const blueprintData = BlueprintData::fromXml(BlueprintGenerator::generate(parameters), options, std::cerr);
+        if (!CHECK(blueprintData.has_value())) {
+            return;
+        }
+        CHECK(BinaryBlueprint::withNewId(binaryOf(parameters, "\r\n"), *blueprintData, 2, {}, std::cerr).isEmpty());
+        CHECK(!BinaryBlueprint::withNewId(binaryOf(parameters, "\n"), *blueprintData, 2, {}, std::cerr).isEmpty());
+    }
+
+    // "(PA12345678 1) Block 2" is a valid message as well: '(' a varint field with the value 'P', 'A' a fixed64 field
+    // with "12345678", ' ' a varint field with '1' and ')' a fixed64 field with " Block 2"
+    void testNameLikeMessage(TestCheck& checks) {
+        Options const options;
+        BlueprintGenerator::Parameters parameters = parametersOf(4, 1);
+        parameters.name = QStringLiteral("PA12345678");
+        QByteArray const binary = binaryOf(parameters, "\n", "Block ");
+
+        auto const fromXml = BlueprintData::fromXml(BlueprintGenerator::generate(parameters), options, std::cerr);
+        auto const fromBinary = BinaryBlueprint::extract(binary, BlueprintGenerator::displayNameOf(parameters), std::cerr);
+        if (!CHECK(fromXml.has_value()) || !CHECK(fromBinary.has_value())) {
+            return;
+        }
+        CHECK(*fromXml == *fromBinary);
+
+        parameters.number = 2;
+        CHECK(BinaryBlueprint::withNewId(binary, *fromXml, 2, {}, std::cerr) == binaryOf(parameters, "\n", "Block "));
+    }
+
+    // A bp.sbcB5 that does not have exactly the named blocks of bp.sbc is dropped instead of being half renamed
+    void testMismatch(TestCheck& checks) {
+        Options const options;
+        auto const blueprintData = BlueprintData::fromXml(BlueprintGenerator::generate(parametersOf(10, 1)), options, std::cerr);
+        if (!CHECK(blueprintData.has_value())) {
+            return;
+        }
+        CHECK(BinaryBlueprint::withNewId(binaryOf(parametersOf(12, 1), "\n"), *blueprintData, 2, {}, std::cerr).isEmpty());
+        CHECK(BinaryBlueprint::withNewId(binaryOf(parametersOf(8, 1), "\n"), *blueprintData, 2, {}, std::cerr).isEmpty());
+    }
+
+    void testInvalid(TestCheck& checks) {
+        BlueprintGenerator::Parameters const parameters = parametersOf(10, 1);
+        QByteArray const binary = binaryOf(parameters, "\n");
+        CHECK(!BinaryBlueprint::extract(binary.left(binary.size() - 3), BlueprintGenerator::displayNameOf(parameters), std::cerr).has_value());
+        CHECK(!BinaryBlueprint::extract(binary, QStringLiteral("Some other name 1"), std::cerr).has_value());
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testRoundTrip(checks, 2);
+    testRoundTrip(checks, 100);
+    testCrLfCustomData(checks);
+    testNameLikeMessage(checks);
+    testMismatch(checks);
+    testInvalid(checks);
+    return checks.getResult();
+}
@@ -0,0 +1,117 @@
+#include <QBuffer>
+#include <QByteArray>
+#include <QIODevice>
+
+#include <iostream>
+#include <optional>
+
+#include "BlueprintGenerator.h"
+#include "TestCheck.h"
+
+#include "BlueprintData.h"
+#include "Options.h"
+
+namespace {
+    QByteArray source() {
+        BlueprintGenerator::Parameters parameters = BlueprintGenerator::defaultParameters();
+        parameters.blocks = 20;
+        parameters.subgrids = 1;
+        return BlueprintGenerator::generate(parameters);
+    }
+
+    QByteArray replaced(QByteArray const& data, QByteArray const& before, QByteArray const& after) {
+        QByteArray result(data);
+        return result.replace(before, after);
+    }
+
+    // The reference, QXmlStreamReader only
+    std::optional<BlueprintData> fromXmlReader(QByteArray const& data) {
+        QBuffer buffer;
+        buffer.setData(data);
+        if (!buffer.open(QIODevice::ReadOnly)) {
+            return std::nullopt;
+        }
+        return BlueprintData::fromXml(buffer, Options(), std::cerr);
+    }
+
+    // The scanner, and the XML parser for the documents it hands over, must read the same data as the reference
+    void checkAgree(TestCheck& checks, QByteArray const& data, std::optional<BlueprintData> const& expected) {
+        auto const scanned = BlueprintData::fromXml(data, Options(), std::cerr);
+        auto const reference = fromXmlReader(data);
+        CHECK(scanned.has_value() == expected.has_value());
+        CHECK(reference.has_value() == expected.has_value());
+        if (scanned && reference && expected) {
+            CHECK(*scanned == *expected);
+            CHECK(*reference == *expected);
+        }
+    }
+
+    void testWellFormed(TestCheck& checks) {
+        QByteArray const plain = source();
+        auto const expected = fromXmlReader(plain);
+        if (!CHECK(expected.has_value())) {
+            return;
+        }
+        checkAgree(checks, plain, expected);
+
+        // Entities and character references, in the attribute, the names and the custom data
+        QByteArray const entities = replaced(replaced(plain, "Wasp", "W&#97;sp"), "Thruster", "Thruster &amp; &lt;Co&gt;");
+        checkAgree(checks, replaced(entities, "MK_1", "MK&#x5F;1"), expected);
+
+        checkAgree(checks, replaced(plain, "\n", "\r\n"), expected);
+
+        // CDATA where the scanner skips it, and around the custom data where it hands over to the XML parser
+        checkAgree(checks, replaced(plain, "// Script omitted", "<![CDATA[// <Script> & omitted]]>"), expected);
+        checkAgree(checks, replaced(replaced(plain, "<CustomData>", "<CustomData><![CDATA["), "</CustomData>", "]]></CustomData>"), expected);
+
+        // Comments between elements, with markup and the WHAM key in them, and inside a name
+        checkAgree(checks, replaced(plain, "<CubeGrids>", "<CubeGrids><!-- <CubeGrid> Missile number=3 -->"), expected);
+        checkAgree(checks, replaced(plain, "<DisplayName>Synthetic Wasp", "<DisplayName>Synthetic<!-- x --> Wasp"), expected);
+
+        // Attributes on the elements whose text is read, including quotes and markup characters
+        QByteArray attributes = replaced(plain, "<DisplayName>Synthetic Wasp", "<DisplayName Note=\"a > b\" xml:space='preserve'>Synthetic Wasp");
+        attributes = replaced(attributes, "<Name>", "<Name Index=\"1\">");
+        attributes = replaced(attributes, "<CustomName>", "<CustomName\n\tKind='x/y'>");
+        attributes = replaced(attributes, "Subtype=\"Synthetic Wasp MK_1 1\"", "Subtype = 'Synthetic Wasp MK_1 1'");
+        checkAgree(checks, attributes, expected);
+    }
+
+    void testMalformed(TestCheck& checks) {
+        QByteArray const plain = source();
+        checkAgree(checks, plain.left(plain.size() - 20), std::nullopt);
+        checkAgree(checks, replaced(plain, "</GridSizeEnum>", "</GridSize>"), std::nullopt);
+        checkAgree(checks, replaced(plain, "<DestructibleBlocks>", "<DestructibleBlocks attribute>"), std::nullopt);
+        checkAgree(checks, replaced(plain, "<CubeGrids>", "<CubeGrids><!-- unterminated"), std::nullopt);
+        // In the fields the scanner reads, every entity is resolved and checked
+        checkAgree(checks, replaced(plain, "<DisplayName>Synthetic Wasp", "<DisplayName>Synthetic&nbsp;Wasp"), std::nullopt);
+        checkAgree(checks, replaced(plain, "<DisplayName>Synthetic Wasp", "<DisplayName>Synthetic&#xD800;Wasp"), std::nullopt);
+        // Everywhere else they are only checked, in text and in attribute values
+        checkAgree(checks, replaced(plain, "CastShadows InScene", "CastShadows&nbsp;InScene"), std::nullopt);
+        checkAgree(checks, replaced(plain, "\"MyObjectBuilder_Thrust\"", "\"MyObjectBuilder&nbsp;Thrust\""), std::nullopt);
+        checkAgree(checks, replaced(plain, "CastShadows InScene", "CastShadows & InScene"), std::nullopt);
+        checkAgree(checks, replaced(plain, "\"MyObjectBuilder_Thrust\"", "\"MyObjectBuilder<Thrust\""), std::nullopt);
+        // One root element and nothing else outside of it
+        checkAgree(checks, plain + "<Definitions />", std::nullopt);
+        checkAgree(checks, plain + "trailing text", std::nullopt);
+        checkAgree(checks, "<?xml version=\"1.0\"?>\n", std::nullopt);
+    }
+
+    // The scanner does not check everything QXmlStreamReader does, --verifyParse is what catches such documents
+    void testNotValidated(TestCheck& checks) {
+        QByteArray const data = replaced(source(), "<ShowOnHUD>", "<ShowOnHUD Note=\"1\" Note=\"2\">");
+        CHECK(BlueprintData::fromXml(data, Options(), std::cerr).has_value());
+        CHECK(!fromXmlReader(data).has_value());
+
+        Options verify;
+        verify.verifyParse = true;
+        CHECK(!BlueprintData::fromXml(data, verify, std::cerr).has_value());
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testWellFormed(checks);
+    testMalformed(checks);
+    testNotValidated(checks);
+    return checks.getResult();
+}
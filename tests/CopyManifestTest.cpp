@@ -0,0 +1,124 @@
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+#include <QStringList>
+#include <QTemporaryDir>
+
+#include <iostream>
+#include <vector>
+
+#include "TestCheck.h"
+
+#include "CopyManifest.h"
+#include "PatchTemplate.h"
+
+namespace {
+    QString const copyName = QStringLiteral("Wasp 2");
+
+    bool writeFile(QString const& path, QByteArray const& contents) {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly) && (file.write(contents) == contents.size());
+    }
+
+    // A copy in its folder, or as <copy>.sbb with archive
+    bool writeCopy(QTemporaryDir const& folder, bool archive, QByteArray const& contents) {
+        if (archive) {
+            return writeFile(folder.filePath(QString(copyName).append(QStringLiteral(".sbb"))), contents);
+        }
+        QDir const root(folder.path());
+        return root.mkpath(copyName) && writeFile(QDir(root.absoluteFilePath(copyName)).absoluteFilePath(QStringLiteral("bp.sbc")), contents);
+    }
+
+    // A recorded copy is skipped while it is untouched and the same source and id would generate it
+    void checkSkipAndRegenerate(TestCheck& checks, bool archive) {
+        QTemporaryDir const folder;
+        if (!CHECK(folder.isValid()) || !CHECK(writeCopy(folder, archive, "<Definitions>2</Definitions>"))) {
+            return;
+        }
+        QByteArray const sourceHash("source");
+        QByteArray const copyHash("copy");
+        {
+            CopyManifest manifest(folder.path(), archive);
+            CHECK(!manifest.load(std::cerr));
+            CHECK(!manifest.isUpToDate(copyName, sourceHash, 2));
+            manifest.record(copyName, sourceHash, 2, copyHash);
+            CHECK(manifest.save(std::cerr));
+        }
+
+        CopyManifest manifest(folder.path(), archive);
+        if (!CHECK(manifest.load(std::cerr))) {
+            return;
+        }
+        CHECK(manifest.isUpToDate(copyName, sourceHash, 2));
+        CHECK(manifest.hasContents(copyName, copyHash));
+        CHECK(!manifest.isUpToDate(copyName, "changed source", 2));
+        CHECK(!manifest.isUpToDate(copyName, sourceHash, 3));
+        CHECK(!manifest.isUpToDate(QStringLiteral("Wasp 3"), sourceHash, 2));
+        CHECK(!manifest.hasContents(copyName, "other copy"));
+        CHECK(!manifest.hasContents(copyName, QByteArray()));
+
+        // Changed by someone else, so it has to be written again whatever the hashes say
+        CHECK(writeCopy(folder, archive, "<Definitions>2 edited</Definitions>"));
+        CHECK(!manifest.isUpToDate(copyName, sourceHash, 2));
+        CHECK(!manifest.hasContents(copyName, copyHash));
+
+        manifest.record(copyName, sourceHash, 2, copyHash);
+        CHECK(manifest.isUpToDate(copyName, sourceHash, 2));
+        if (!archive) {
+            // A file added to the copy counts as a change as well
+            CHECK(writeFile(QDir(folder.filePath(copyName)).absoluteFilePath(QStringLiteral("bp.sbcB5")), "binary"));
+            CHECK(!manifest.isUpToDate(copyName, sourceHash, 2));
+        }
+    }
+
+    void testSkipAndRegenerate(TestCheck& checks) {
+        checkSkipAndRegenerate(checks, false);
+        checkSkipAndRegenerate(checks, true);
+    }
+
+    void testDamaged(TestCheck& checks) {
+        QTemporaryDir const folder;
+        if (!CHECK(folder.isValid()) || !CHECK(writeCopy(folder, false, "<Definitions />"))) {
+            return;
+        }
+        CHECK(writeFile(folder.filePath(CopyManifest::fileName), "{ not json"));
+        CopyManifest manifest(folder.path(), false);
+        CHECK(!manifest.load(std::cerr));
+        CHECK(!manifest.isUpToDate(copyName, "source", 2));
+    }
+
+    // The source hash covers the mode, bp.sbc and the sidecars, and the copy hash is the same whether the copy is
+    // whole or in slices
+    void testHashes(TestCheck& checks) {
+        QTemporaryDir const folder;
+        if (!CHECK(folder.isValid()) || !CHECK(writeFile(folder.filePath(QStringLiteral("bp.sbc")), "<Definitions>1</Definitions>"))) {
+            return;
+        }
+        QDir const blueprintFolder(folder.path());
+        QStringList const sidecars{ QStringLiteral("thumb.png") };
+        QByteArray const missing = CopyManifest::hashSource(blueprintFolder, sidecars, false, "xml");
+        CHECK(missing == CopyManifest::hashSource(blueprintFolder, sidecars, false, "xml"));
+        CHECK(missing != CopyManifest::hashSource(blueprintFolder, sidecars, false, "template"));
+        CHECK(writeFile(folder.filePath(QStringLiteral("thumb.png")), QByteArray()));
+        QByteArray const empty = CopyManifest::hashSource(blueprintFolder, sidecars, false, "xml");
+        CHECK(empty != missing);
+        CHECK(writeFile(folder.filePath(QStringLiteral("bp.sbc")), "<Definitions>7</Definitions>"));
+        CHECK(CopyManifest::hashSource(blueprintFolder, sidecars, false, "xml") != empty);
+
+        QByteArray const copy("<Definitions>2</Definitions>");
+        QByteArray const sidecarHash = CopyManifest::hashSidecars(blueprintFolder, sidecars);
+        std::vector<PatchTemplate::Slice> const slices{ { copy.constData(), 13 }, { copy.constData() + 13, copy.size() - 13 } };
+        CHECK(CopyManifest::hashCopy(slices, "binary", sidecarHash) == CopyManifest::hashCopy(copy, "binary", sidecarHash));
+        CHECK(CopyManifest::hashCopy(copy, QByteArray(), sidecarHash) != CopyManifest::hashCopy(copy, "binary", sidecarHash));
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testSkipAndRegenerate(checks);
+    testDamaged(checks);
+    testHashes(checks);
+    return checks.getResult();
+}
@@ -0,0 +1,87 @@
+#include <QByteArray>
+
+#include <iostream>
+#include <optional>
+#include <vector>
+
+#include "BlueprintGenerator.h"
+#include "TestCheck.h"
+
+#include "BlueprintData.h"
+#include "CopyPipeline.h"
+#include "Options.h"
+#include "PatchTemplate.h"
+
+namespace {
+    struct Written {
+        std::vector<qsizetype> indices;
+        std::vector<QByteArray> copies;
+    };
+
+    Written runPipeline(CopyPipeline const& pipeline, qsizetype count, CopyPipeline::Filler const& filler) {
+        Written result;
+        pipeline.run(count, filler, [&](qsizetype index, QByteArray const& data) {
+            result.indices.push_back(index);
+            result.copies.push_back(data);
+            return true;
+        });
+        return result;
+    }
+
+    // However many workers generate them, the writer sees the same copies in the same order as the serial loop
+    void testOrder(TestCheck& checks) {
+        BlueprintGenerator::Parameters parameters = BlueprintGenerator::defaultParameters();
+        parameters.blocks = 20;
+        QByteArray const source = BlueprintGenerator::generate(parameters);
+        auto const blueprintData = BlueprintData::fromXml(source, Options(), std::cerr);
+        auto const patchTemplate = (blueprintData) ? PatchTemplate::compile(source, *blueprintData, {}, std::cerr) : std::nullopt;
+        if (!CHECK(patchTemplate.has_value())) {
+            return;
+        }
+        qsizetype const count = 50;
+        CopyPipeline::Filler const filler = [&](qsizetype index, QByteArray& data) {
+            patchTemplate->instantiate(2 + index, data);
+        };
+
+        Written const serial = runPipeline(CopyPipeline(1, 4), count, filler);
+        if (!CHECK(serial.copies.size() == static_cast<std::size_t>(count))) {
+            return;
+        }
+        for (qsizetype i = 0; i < count; ++i) {
+            CHECK(serial.indices.at(static_cast<std::size_t>(i)) == i);
+            CHECK(serial.copies.at(static_cast<std::size_t>(i)) == patchTemplate->instantiate(2 + i));
+        }
+
+        for (qsizetype const jobs : { 2, 4, 8 }) {
+            for (qsizetype const queueCapacity : { 1, 3, 16 }) {
+                Written const parallel = runPipeline(CopyPipeline(jobs, queueCapacity), count, filler);
+                CHECK(parallel.indices == serial.indices);
+                CHECK(parallel.copies == serial.copies);
+            }
+        }
+    }
+
+    // A rejected copy stops the run, nothing after it reaches the writer
+    void testRejected(TestCheck& checks) {
+        for (qsizetype const jobs : { 1, 4 }) {
+            std::vector<qsizetype> indices;
+            bool const result = CopyPipeline(jobs, 2).run(20, CopyPipeline::Generator([](qsizetype index) {
+                return QByteArray::number(index);
+            }), [&](qsizetype index, QByteArray const& data) {
+                indices.push_back(index);
+                return (data != QByteArray("5"));
+            });
+            CHECK(!result);
+            CHECK(indices == std::vector<qsizetype>({ 0, 1, 2, 3, 4, 5 }));
+        }
+        CHECK(CopyPipeline(0, 0).getJobs() == 1);
+        CHECK(CopyPipeline(4, 1).run(0, CopyPipeline::Generator([](qsizetype) { return QByteArray(); }), [](qsizetype, QByteArray const&) { return false; }));
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testOrder(checks);
+    testRejected(checks);
+    return checks.getResult();
+}
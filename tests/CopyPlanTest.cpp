@@ -0,0 +1,99 @@
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QIODevice>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QString>
+#include <QTemporaryDir>
+
+#include <vector>
+
+#include "TestCheck.h"
+
+#include "CopyPlan.h"
+
+namespace {
+    bool writeFile(QString const& path, QByteArray const& contents) {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly) && (file.write(contents) == contents.size());
+    }
+
+    // Wasp 2 is a complete copy, Wasp 3 an empty folder, Wasp 4.sbb an archived copy and Wasp 5 is missing
+    bool prepareFolder(QTemporaryDir const& folder) {
+        QDir const root(folder.path());
+        return root.mkpath(QStringLiteral("Wasp 2")) && writeFile(folder.filePath(QStringLiteral("Wasp 2/bp.sbc")), "<Definitions />") && root.mkpath(QStringLiteral("Wasp 3")) && writeFile(folder.filePath(QStringLiteral("Wasp 4.sbb")), "PK");
+    }
+
+    CopyPlan planFor(QTemporaryDir const& folder, bool archive) {
+        CopyPlan result(folder.path(), archive);
+        result.add(QStringLiteral("Wasp 1"), 1, true);
+        for (qsizetype newId = 2; newId <= 5; ++newId) {
+            result.add(QString("Wasp %1").arg(newId), newId, false);
+        }
+        return result;
+    }
+
+    bool hasActions(CopyPlan const& plan, std::vector<CopyPlan::Action> const& actions) {
+        std::vector<CopyPlan::Entry> const& entries = plan.getEntries();
+        if (entries.size() != actions.size()) {
+            return false;
+        }
+        for (std::size_t i = 0; i < entries.size(); ++i) {
+            if ((entries.at(i).action != actions.at(i)) || (entries.at(i).newId != static_cast<qsizetype>(i) + 1)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Only a folder with bp.sbc is replaced, an empty one is just filled in
+    void testFolders(TestCheck& checks, QTemporaryDir const& folder) {
+        CopyPlan const plan = planFor(folder, false);
+        CHECK(hasActions(plan, { CopyPlan::Action::Skip, CopyPlan::Action::Overwrite, CopyPlan::Action::Create, CopyPlan::Action::Create, CopyPlan::Action::Create }));
+        CHECK((plan.count(CopyPlan::Action::Create) == 3) && (plan.count(CopyPlan::Action::Overwrite) == 1) && (plan.count(CopyPlan::Action::Skip) == 1));
+        CHECK(plan.toText(false).startsWith(QStringLiteral("Plan: 5 copies, 3 to create, 1 to overwrite, 1 unchanged and skipped.")));
+        CHECK(plan.toText(false).contains(QStringLiteral("overwrite: Wasp 2")));
+        CHECK(!plan.toText(false).contains(QStringLiteral("create: Wasp 3")));
+        CHECK(plan.toText(true).contains(QStringLiteral("create: Wasp 3")));
+
+        QJsonObject const root = QJsonDocument::fromJson(plan.toJson()).object();
+        CHECK((root.value(QStringLiteral("create")).toInt() == 3) && (root.value(QStringLiteral("overwrite")).toInt() == 1) && (root.value(QStringLiteral("skip")).toInt() == 1));
+        QJsonArray const copies = root.value(QStringLiteral("copies")).toArray();
+        if (CHECK(copies.size() == 5)) {
+            QJsonObject const copy = copies.at(1).toObject();
+            CHECK(copy.value(QStringLiteral("name")).toString() == QStringLiteral("Wasp 2"));
+            CHECK(copy.value(QStringLiteral("missileNumber")).toInt() == 2);
+            CHECK(copy.value(QStringLiteral("action")).toString() == QStringLiteral("overwrite"));
+        }
+    }
+
+    // With archive only <name>.sbb counts, folders of the same name do not
+    void testArchives(TestCheck& checks, QTemporaryDir const& folder) {
+        CopyPlan const plan = planFor(folder, true);
+        CHECK(hasActions(plan, { CopyPlan::Action::Skip, CopyPlan::Action::Create, CopyPlan::Action::Create, CopyPlan::Action::Overwrite, CopyPlan::Action::Create }));
+    }
+
+    // The folder is listed once, a copy showing up afterwards is not looked at
+    void testListedOnce(TestCheck& checks, QTemporaryDir const& folder) {
+        CopyPlan plan(folder.path(), false);
+        plan.add(QStringLiteral("Wasp 5"), 5, false);
+        QDir const root(folder.path());
+        CHECK(root.mkpath(QStringLiteral("Wasp 6")) && writeFile(folder.filePath(QStringLiteral("Wasp 6/bp.sbc")), "<Definitions />"));
+        plan.add(QStringLiteral("Wasp 6"), 6, false);
+        CHECK(plan.count(CopyPlan::Action::Create) == 2);
+    }
+}
+
+int main() {
+    TestCheck checks;
+    QTemporaryDir const folder;
+    if (!CHECK(folder.isValid()) || !CHECK(prepareFolder(folder))) {
+        return checks.getResult();
+    }
+    testFolders(checks, folder);
+    testArchives(checks, folder);
+    testListedOnce(checks, folder);
+    return checks.getResult();
+}
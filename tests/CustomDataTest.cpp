@@ -0,0 +1,112 @@
+#include <QByteArray>
+#include <QString>
+
+#include <optional>
+#include <vector>
+
+#include "TestCheck.h"
+
+#include "CustomData.h"
+
+namespace {
+    QByteArray evaluate(QByteArray const& text, qsizetype index) {
+        QString error;
+        auto const parsed = CustomData::Template::parse(text, error);
+        return (parsed) ? parsed->evaluate(index) : QByteArray("<invalid>");
+    }
+
+    bool isValid(QByteArray const& text) {
+        QString error;
+        return CustomData::Template::parse(text, error).has_value();
+    }
+
+    std::vector<CustomData::Override> overridesOf(std::vector<QString> const& texts) {
+        std::vector<CustomData::Override> result;
+        for (auto const& text : texts) {
+            QString error;
+            auto parsed = CustomData::parseOverride(text, error);
+            if (parsed) {
+                result.push_back(std::move(*parsed));
+            }
+        }
+        return result;
+    }
+
+    void testFormulas(TestCheck& checks) {
+        CHECK(evaluate("{(i % 4) * 0.5}", 0) == "0");
+        CHECK(evaluate("{(i % 4) * 0.5}", 3) == "1.5");
+        CHECK(evaluate("{(i % 4) * 0.5}", 5) == "0.5");
+        CHECK(evaluate("Delay {i * 2}s", 4) == "Delay 8s");
+        CHECK(evaluate("{1 + 2 * 3}", 0) == "7");
+        CHECK(evaluate("{-i + 1}", 3) == "-2");
+        CHECK(evaluate("{--i}", 3) == "3");
+        CHECK(evaluate("{i / 0}", 3) == "0");
+        CHECK(evaluate("{i % 0}", 3) == "0");
+        CHECK(evaluate("{i / 4}", 2) == "0.5");
+        CHECK(evaluate("no formula", 3) == "no formula");
+        CHECK(evaluate("{i}-{i + 1}", 7) == "7-8");
+    }
+
+    void testInvalidFormulas(TestCheck& checks) {
+        CHECK(!isValid("{i +}"));
+        CHECK(!isValid("{(i}"));
+        CHECK(!isValid("{i"));
+        CHECK(!isValid("i}"));
+        CHECK(!isValid("{}"));
+        CHECK(!isValid("{x}"));
+        CHECK(!isValid("{1.2.3}"));
+        // Too deep to evaluate with the fixed stack
+        CHECK(!isValid("{" + QByteArray(40, '(') + "i" + QByteArray(40, ')') + "}"));
+        CHECK(isValid("{" + QByteArray(8, '(') + "i" + QByteArray(8, ')') + "}"));
+    }
+
+    void testOverrides(TestCheck& checks) {
+        QString error;
+        CHECK(!CustomData::parseOverride(QStringLiteral("Missile number=3"), error).has_value());
+        CHECK(!CustomData::parseOverride(QStringLiteral(" Missile name tag =x"), error).has_value());
+        CHECK(!CustomData::parseOverride(QStringLiteral("no value"), error).has_value());
+        CHECK(!CustomData::parseOverride(QStringLiteral("=value"), error).has_value());
+        CHECK(!CustomData::parseOverride(QStringLiteral("Launch delay={i +}"), error).has_value());
+        CHECK(CustomData::parseOverride(QStringLiteral("Launch delay={i}"), error).has_value());
+    }
+
+    void testInstantiate(TestCheck& checks) {
+        CustomData const customData("[Missile - Configuration]\nMissile name tag=Wasp\nMissile number=1\nLaunch delay=0\n[Other]\nFoo = 1\n", false);
+        CHECK(customData.getEntries().size() == 4);
+        auto const* const foo = customData.find("Foo");
+        if (CHECK(foo != nullptr)) {
+            CHECK(customData.getValue(*foo) == "1");
+        }
+
+        // Existing keys are replaced where they are, new ones go to the end of the section with the missile number
+        auto const overrides = overridesOf({ QStringLiteral("Launch delay={i}"), QStringLiteral("New key=x"), QStringLiteral("Foo=2") });
+        CHECK(overrides.size() == 3);
+        CHECK(customData.instantiate(7, overrides) == "[Missile - Configuration]\nMissile name tag=Wasp\nMissile number=7\nLaunch delay=7\nNew key=x\n[Other]\nFoo = 2\n");
+        CHECK(customData.instantiate(12, {}) == "[Missile - Configuration]\nMissile name tag=Wasp\nMissile number=12\nLaunch delay=0\n[Other]\nFoo = 1\n");
+    }
+
+    void testLineBreaks(TestCheck& checks) {
+        auto const overrides = overridesOf({ QStringLiteral("Added=1") });
+        CustomData const crLf("[Missile]\r\nMissile number=1\r\n", false);
+        CHECK(crLf.instantiate(2, overrides) == "[Missile]\r\nMissile number=2\r\nAdded=1\r\n");
+        CustomData const unterminated("Missile number=1", false);
+        CHECK(unterminated.instantiate(4, overrides) == "Missile number=4\nAdded=1");
+    }
+
+    void testEscaped(TestCheck& checks) {
+        // Raw from bp.sbc, so the new values need XML entities
+        CustomData const customData("[M]\nMissile number=1\n", true);
+        CHECK(customData.instantiate(5, overridesOf({ QStringLiteral("Note=a<b & c") })) == "[M]\nMissile number=5\nNote=a&lt;b &amp; c\n");
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testFormulas(checks);
+    testInvalidFormulas(checks);
+    testOverrides(checks);
+    testInstantiate(checks);
+    testLineBreaks(checks);
+    testEscaped(checks);
+    return checks.getResult();
+}
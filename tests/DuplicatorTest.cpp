@@ -0,0 +1,128 @@
+#include <QByteArray>
+#include <QString>
+
+#include <iostream>
+#include <optional>
+
+#include "BlueprintGenerator.h"
+#include "TestCheck.h"
+
+#include "BlueprintData.h"
+#include "Duplicator.h"
+#include "Options.h"
+
+namespace {
+    BlueprintGenerator::Parameters parameters() {
+        BlueprintGenerator::Parameters result = BlueprintGenerator::defaultParameters();
+        result.blocks = 20;
+        result.subgrids = 1;
+        return result;
+    }
+
+    QByteArray replaced(QByteArray const& data, QByteArray const& before, QByteArray const& after) {
+        QByteArray result(data);
+        return result.replace(before, after);
+    }
+
+    Duplicator::ByteSpan spanOf(QByteArray const& data) {
+        return Duplicator::ByteSpan{ data.constData(), data.size() };
+    }
+
+    // Preset to a code none of the calls below may leave behind by accident
+    Duplicator::Error freshError() {
+        return Duplicator::Error{ Duplicator::ErrorCode::InvalidId, QStringLiteral("untouched"), QString() };
+    }
+
+    // The copies read back like the source with the new number
+    void testGenerate(TestCheck& checks) {
+        QByteArray const source = BlueprintGenerator::generate(parameters());
+        Duplicator::Error error = freshError();
+        auto const duplicator = Duplicator::load(spanOf(source), { nullptr, 0 }, error);
+        if (!CHECK(duplicator.has_value())) {
+            return;
+        }
+        auto const expected = BlueprintData::fromXml(source, Options(), std::cerr);
+        if (!CHECK(expected.has_value())) {
+            return;
+        }
+        CHECK(duplicator->getBlueprintData() == *expected);
+
+        for (qsizetype const newId : { 1, 2, 17, 1000 }) {
+            auto const copy = duplicator->generate(newId, error);
+            if (!CHECK(copy.has_value())) {
+                continue;
+            }
+            CHECK(copy->name == duplicator->getCopyName(newId));
+            CHECK(copy->name == BlueprintData::cutDigitsFromEnd(BlueprintGenerator::displayNameOf(parameters())).append(QString::number(newId)));
+            CHECK(copy->binary.isEmpty());
+
+            auto const copyData = BlueprintData::fromXml(copy->blueprint, Options(), std::cerr);
+            if (CHECK(copyData.has_value())) {
+                CHECK((copyData->getId() == newId) && (copyData->getDisplayName() == copy->name));
+                CHECK(copyData->getItemCount() == expected->getItemCount());
+            }
+            auto const checked = Duplicator::check(spanOf(copy->blueprint), error);
+            CHECK(checked.has_value() && copyData.has_value() && (*checked == *copyData));
+        }
+    }
+
+    void testErrorCodes(TestCheck& checks) {
+        QByteArray const source = BlueprintGenerator::generate(parameters());
+
+        // WHAM custom data in a CDATA section is left to the XML parser, which the library does not fall back to
+        QByteArray const cdata = replaced(replaced(source, "<CustomData>", "<CustomData><![CDATA["), "</CustomData>", "]]></CustomData>");
+        Duplicator::Error error = freshError();
+        CHECK(!Duplicator::check(spanOf(cdata), error).has_value());
+        CHECK((error.code == Duplicator::ErrorCode::Unsupported) && (error.check == QStringLiteral("scan")) && !error.message.isEmpty());
+        error = freshError();
+        CHECK(!Duplicator::load(spanOf(cdata), { nullptr, 0 }, error).has_value());
+        CHECK(error.code == Duplicator::ErrorCode::Unsupported);
+
+        error = freshError();
+        ParseLimits const defaults = ParseLimits::defaults();
+        ParseLimits const fewBlocks(defaults.maxDepth, defaults.maxBytes, 5, defaults.maxCustomData, defaults.timeBudget);
+        CHECK(!Duplicator::load(spanOf(source), { nullptr, 0 }, fewBlocks, error).has_value());
+        CHECK((error.code == Duplicator::ErrorCode::LimitExceeded) && (error.check == QStringLiteral("limits")));
+
+        // The custom data disagrees with the names about the missile number
+        QByteArray const renumbered = replaced(source, "Missile number=1\n", "Missile number=2\n");
+        error = freshError();
+        CHECK(!Duplicator::check(spanOf(renumbered), error).has_value());
+        CHECK((error.code == Duplicator::ErrorCode::Inconsistent) && (error.check == QStringLiteral("numbering")));
+        error = freshError();
+        CHECK(!Duplicator::load(spanOf(renumbered), { nullptr, 0 }, error).has_value());
+        CHECK((error.code == Duplicator::ErrorCode::Inconsistent) && (error.check == QStringLiteral("numbering")));
+
+        // Decoded, the block names carry the group prefix, raw they do not, so only the template can not be built
+        QByteArray const displayName = BlueprintGenerator::displayNameOf(parameters()).toUtf8();
+        QByteArray const escaped = replaced(source, ">(" + displayName + ")", ">(" + replaced(displayName, "W", "&#87;") + ")");
+        error = freshError();
+        CHECK(Duplicator::check(spanOf(escaped), error).has_value());
+        CHECK(!Duplicator::load(spanOf(escaped), { nullptr, 0 }, error).has_value());
+        CHECK((error.code == Duplicator::ErrorCode::NoTemplate) && !error.message.isEmpty());
+
+        // A bp.sbcB5 that is no protocol buffer is only noticed once a copy renumbers it
+        QByteArray const binary("not a binary blueprint");
+        error = freshError();
+        auto const withBinary = Duplicator::load(spanOf(source), spanOf(binary), error);
+        if (CHECK(withBinary.has_value())) {
+            error = freshError();
+            CHECK(!withBinary->generate(2, error).has_value());
+            CHECK(error.code == Duplicator::ErrorCode::BinaryFailed);
+        }
+
+        auto const duplicator = Duplicator::load(spanOf(source), { nullptr, 0 }, error);
+        if (CHECK(duplicator.has_value())) {
+            error = Duplicator::Error{ Duplicator::ErrorCode::Unsupported, QString(), QString() };
+            CHECK(!duplicator->generate(-1, error).has_value());
+            CHECK((error.code == Duplicator::ErrorCode::InvalidId) && !error.message.isEmpty());
+        }
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testGenerate(checks);
+    testErrorCodes(checks);
+    return checks.getResult();
+}
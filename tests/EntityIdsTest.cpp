@@ -0,0 +1,81 @@
+#include <QByteArray>
+
+#include <optional>
+#include <unordered_set>
+
+#include "TestCheck.h"
+
+#include "EntityIds.h"
+
+namespace {
+    QByteArray const source("<Grid><EntityId>100</EntityId><Block><EntityId>200</EntityId><TopBlockId>100</TopBlockId><Other>300</Other></Block><Block><EntityId>0</EntityId><EntityId>12a</EntityId></Block></Grid>");
+
+    void testCollect(TestCheck& checks) {
+        CHECK(!EntityIds::collect("<Grid><Name>100</Name></Grid>").has_value());
+        CHECK(!EntityIds::collect("<Grid><EntityId>0</EntityId></Grid>").has_value());
+
+        auto const entityIds = EntityIds::collect(source);
+        if (!CHECK(entityIds.has_value())) {
+            return;
+        }
+        // 0 and text that is not a number are no ids, 300 is no id of the source
+        CHECK(entityIds->getCount() == 2);
+        auto const& locations = entityIds->getLocations();
+        if (CHECK(locations.size() == 3)) {
+            CHECK(source.mid(locations.at(0).begin, locations.at(0).end - locations.at(0).begin) == "100");
+            CHECK(locations.at(0).index == 0);
+            CHECK(locations.at(1).index == 1);
+            CHECK(source.mid(locations.at(2).begin, locations.at(2).end - locations.at(2).begin) == "100");
+            CHECK(locations.at(2).index == 0);
+            CHECK(locations.at(0).end <= locations.at(1).begin);
+            CHECK(locations.at(1).end <= locations.at(2).begin);
+        }
+    }
+
+    // The same copy gets the same ids in every run, and no two ids of any copies or of the source are the same
+    void testGenerate(TestCheck& checks) {
+        auto const entityIds = EntityIds::collect(source);
+        auto const again = EntityIds::collect(source);
+        if (!CHECK(entityIds.has_value()) || !CHECK(again.has_value())) {
+            return;
+        }
+        std::unordered_set<quint64> seen{ 0, 100, 200 };
+        bool distinct = true;
+        bool stable = true;
+        bool positive = true;
+        for (qsizetype copy = 1; copy <= 1000; ++copy) {
+            for (qsizetype index = 0; index < entityIds->getCount(); ++index) {
+                quint64 const id = entityIds->generate(copy, index);
+                distinct = seen.insert(id).second && distinct;
+                stable = (again->generate(copy, index) == id) && stable;
+                positive = (id <= 0x7FFFFFFFFFFFFFFFull) && positive;
+            }
+        }
+        CHECK(distinct);
+        CHECK(stable);
+        CHECK(positive);
+    }
+
+    void testReserve(TestCheck& checks) {
+        auto entityIds = EntityIds::collect(source);
+        if (!CHECK(entityIds.has_value())) {
+            return;
+        }
+        quint64 const taken = entityIds->generate(5, 0);
+        entityIds->reserve("<EntityId>" + QByteArray::number(taken) + "</EntityId>");
+        quint64 const replacement = entityIds->generate(5, 0);
+        CHECK(replacement != taken);
+        CHECK(replacement != 100);
+        CHECK(replacement != 200);
+        // Other copies are not affected
+        CHECK(entityIds->generate(6, 0) == EntityIds::collect(source)->generate(6, 0));
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testCollect(checks);
+    testGenerate(checks);
+    testReserve(checks);
+    return checks.getResult();
+}
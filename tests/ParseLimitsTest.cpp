@@ -0,0 +1,106 @@
+#include <QBuffer>
+#include <QByteArray>
+#include <QIODevice>
+
+#include <iostream>
+#include <optional>
+
+#include "BlueprintGenerator.h"
+#include "TestCheck.h"
+
+#include "BlueprintData.h"
+#include "Duplicator.h"
+#include "Options.h"
+#include "ParseLimits.h"
+
+namespace {
+    QByteArray source() {
+        BlueprintGenerator::Parameters parameters = BlueprintGenerator::defaultParameters();
+        parameters.blocks = 20;
+        return BlueprintGenerator::generate(parameters);
+    }
+
+    // Only the limit under test is tight
+    ParseLimits tight(qsizetype maxDepth, qint64 maxBytes, qsizetype maxBlocks, qsizetype maxCustomData) {
+        ParseLimits const defaults = ParseLimits::defaults();
+        return ParseLimits((maxDepth > 0) ? maxDepth : defaults.maxDepth, (maxBytes > 0) ? maxBytes : defaults.maxBytes, (maxBlocks > 0) ? maxBlocks : defaults.maxBlocks, (maxCustomData > 0) ? maxCustomData : defaults.maxCustomData, defaults.timeBudget);
+    }
+
+    Options withLimits(ParseLimits const& limits) {
+        Options result;
+        result.parseLimits = limits;
+        return result;
+    }
+
+    // Through the scanner and through QXmlStreamReader alone
+    void checkRejected(TestCheck& checks, QByteArray const& data, ParseLimits const& limits) {
+        CHECK(!BlueprintData::fromXml(data, withLimits(limits), std::cerr).has_value());
+
+        QBuffer buffer;
+        buffer.setData(data);
+        if (CHECK(buffer.open(QIODevice::ReadOnly))) {
+            CHECK(!BlueprintData::fromXml(buffer, withLimits(limits), std::cerr).has_value());
+        }
+    }
+
+    // The first exceeded limit is kept, and nothing passes once one was exceeded
+    void testBudget(TestCheck& checks) {
+        ParseBudget budget(tight(4, 1000, 10, 100));
+        CHECK(budget.checkBytes(1000) && budget.checkDepth(4, 0) && budget.checkBlocks(10, 0) && budget.checkCustomData(100, 0));
+        CHECK(!budget.isExceeded() && budget.getError().isEmpty());
+
+        CHECK(!budget.checkDepth(5, 123));
+        CHECK(budget.isExceeded() && budget.getError().contains(QStringLiteral("--maxDepth")));
+        CHECK(!budget.checkBlocks(11, 456));
+        CHECK(budget.getError().contains(QStringLiteral("--maxDepth")) && !budget.getError().contains(QStringLiteral("--maxBlocks")));
+        CHECK(!budget.checkBytes(1));
+
+        // Without a time budget the clock is never looked at
+        ParseBudget unlimited(ParseLimits::none());
+        for (int i = 0; i < 10000; ++i) {
+            CHECK(unlimited.checkTime(i));
+        }
+        CHECK(!unlimited.isExceeded());
+    }
+
+    void testDefaultsAccept(TestCheck& checks) {
+        QByteArray const data = source();
+        CHECK(BlueprintData::fromXml(data, Options(), std::cerr).has_value());
+
+        Duplicator::Error error;
+        CHECK(Duplicator::load({ data.constData(), data.size() }, { nullptr, 0 }, error).has_value());
+        CHECK(Duplicator::check({ data.constData(), data.size() }, ParseLimits::defaults(), error).has_value());
+    }
+
+    void testPathological(TestCheck& checks) {
+        checkRejected(checks, BlueprintGenerator::generatePathological(BlueprintGenerator::Pathology::DeepNesting, 64), tight(32, 0, 0, 0));
+        checkRejected(checks, BlueprintGenerator::generatePathological(BlueprintGenerator::Pathology::ManyNames, 64), tight(0, 0, 32, 0));
+        checkRejected(checks, BlueprintGenerator::generatePathological(BlueprintGenerator::Pathology::LongCustomData, 4096), tight(0, 0, 0, 1024));
+
+        QByteArray const data = source();
+        checkRejected(checks, data, tight(0, data.size() - 1, 0, 0));
+    }
+
+    // The library entry points stop at the limits they are given and say so
+    void testDuplicator(TestCheck& checks) {
+        QByteArray const nested = BlueprintGenerator::generatePathological(BlueprintGenerator::Pathology::DeepNesting, 64);
+        Duplicator::Error error{ Duplicator::ErrorCode::InvalidId, QString(), QString() };
+        CHECK(!Duplicator::load({ nested.constData(), nested.size() }, { nullptr, 0 }, tight(32, 0, 0, 0), error).has_value());
+        CHECK((error.code == Duplicator::ErrorCode::LimitExceeded) && (error.check == QStringLiteral("limits")));
+        CHECK(error.message.contains(QStringLiteral("--maxDepth")));
+
+        QByteArray const data = source();
+        error = Duplicator::Error{ Duplicator::ErrorCode::InvalidId, QString(), QString() };
+        CHECK(!Duplicator::check({ data.constData(), data.size() }, tight(0, 0, 5, 0), error).has_value());
+        CHECK((error.code == Duplicator::ErrorCode::LimitExceeded) && error.message.contains(QStringLiteral("--maxBlocks")));
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testBudget(checks);
+    testDefaultsAccept(checks);
+    testPathological(checks);
+    testDuplicator(checks);
+    return checks.getResult();
+}
@@ -0,0 +1,130 @@
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QXmlStreamReader>
+
+#include <iostream>
+#include <optional>
+
+#include "BlueprintGenerator.h"
+#include "TestCheck.h"
+
+#include "BlueprintData.h"
+#include "Options.h"
+#include "PatchTemplate.h"
+
+namespace {
+    BlueprintGenerator::Parameters parameters() {
+        BlueprintGenerator::Parameters result = BlueprintGenerator::defaultParameters();
+        result.blocks = 20;
+        result.subgrids = 1;
+        return result;
+    }
+
+    QByteArray replaced(QByteArray const& data, QByteArray const& before, QByteArray const& after) {
+        QByteArray result(data);
+        return result.replace(before, after);
+    }
+
+    // The document as QXmlStreamReader sees it, without the indentation, the XML declaration and the line breaks the
+    // reader normalizes anyway
+    std::optional<QStringList> tokensOf(QByteArray const& data) {
+        QStringList result;
+        QXmlStreamReader reader(data);
+        while (!reader.atEnd()) {
+            switch (reader.readNext()) {
+                case QXmlStreamReader::StartElement: {
+                    QString element = QStringLiteral("<").append(reader.qualifiedName());
+                    for (auto const& attribute : reader.attributes()) {
+                        element.append(QChar(' ')).append(attribute.qualifiedName()).append(QStringLiteral("=")).append(attribute.value());
+                    }
+                    result.append(element);
+                    break;
+                }
+                case QXmlStreamReader::EndElement:
+                    result.append(QStringLiteral("</").append(reader.qualifiedName()));
+                    break;
+                case QXmlStreamReader::Characters:
+                    if (!reader.isWhitespace()) {
+                        result.append(reader.text().toString());
+                    }
+                    break;
+                case QXmlStreamReader::Comment:
+                    result.append(QStringLiteral("<!--").append(reader.text()));
+                    break;
+                default:
+                    break;
+            }
+        }
+        if (reader.hasError()) {
+            return std::nullopt;
+        }
+        return result;
+    }
+
+    // Outside the patched ranges the copy is the source byte for byte, and the ranges are the numbered fields
+    void checkOnlyPatched(TestCheck& checks, PatchTemplate const& patchTemplate, BlueprintData const& blueprintData, qsizetype newId) {
+        QByteArray const& source = patchTemplate.getSource();
+        QByteArray const copy = patchTemplate.instantiate(newId);
+        QByteArray const oldNumber = QByteArray::number(blueprintData.getId());
+        QByteArray const newNumber = QByteArray::number(newId);
+
+        qsizetype cursor = 0;
+        qsizetype at = 0;
+        for (auto const& patch : patchTemplate.getPatches()) {
+            if (!CHECK((cursor <= patch.begin) && (patch.begin < patch.end)) || !CHECK(source.mid(patch.begin, patch.end - patch.begin).endsWith(oldNumber))) {
+                return;
+            }
+            qsizetype const unchanged = patch.begin - cursor;
+            if (!CHECK(copy.mid(at, unchanged) == source.mid(cursor, unchanged)) || !CHECK(copy.mid(at + unchanged, patch.prefix.size() + newNumber.size()) == patch.prefix + newNumber)) {
+                return;
+            }
+            at += unchanged + patch.prefix.size() + newNumber.size();
+            cursor = patch.end;
+        }
+        CHECK(copy.mid(at) == source.mid(cursor));
+    }
+
+    // The template and the XML rewrite of the fallback rename the same fields the same way
+    void checkAgree(TestCheck& checks, QByteArray const& source, qsizetype grids) {
+        Options const options;
+        auto const blueprintData = BlueprintData::fromXml(source, options, std::cerr);
+        auto const patchTemplate = (blueprintData) ? PatchTemplate::compile(source, *blueprintData, {}, std::cerr) : std::nullopt;
+        if (!CHECK(patchTemplate.has_value())) {
+            return;
+        }
+        // Subtype, group name, missile number, a display name per grid and every named block
+        CHECK(patchTemplate->getPatchCount() == 3 + grids + blueprintData->getItemCount());
+
+        for (qsizetype const newId : { 2, 17, 1000 }) {
+            checkOnlyPatched(checks, *patchTemplate, *blueprintData, newId);
+
+            QByteArray const patched = patchTemplate->instantiate(newId);
+            QByteArray const rewritten = BlueprintData::toXMLWithNewId(source, *blueprintData, newId, options, std::cerr);
+            auto const patchedTokens = tokensOf(patched);
+            auto const rewrittenTokens = tokensOf(rewritten);
+            if (CHECK(patchedTokens.has_value()) && CHECK(rewrittenTokens.has_value())) {
+                CHECK(*patchedTokens == *rewrittenTokens);
+            }
+            CHECK(patched != source);
+        }
+    }
+
+    void testAgree(TestCheck& checks) {
+        QByteArray const plain = BlueprintGenerator::generate(parameters());
+        qsizetype const grids = 1 + parameters().subgrids;
+        checkAgree(checks, plain, grids);
+        checkAgree(checks, replaced(plain, "\n", "\r\n"), grids);
+
+        // Only the leading group prefix of a block name is renamed, not the same text further in
+        QByteArray const displayName = BlueprintGenerator::displayNameOf(parameters()).toUtf8();
+        QByteArray const prefix = "(" + displayName + ")";
+        checkAgree(checks, replaced(plain, prefix + " Thruster 2<", prefix + " Thruster 2 " + prefix + "<"), grids);
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testAgree(checks);
+    return checks.getResult();
+}
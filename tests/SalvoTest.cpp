@@ -0,0 +1,125 @@
+#include <QBuffer>
+#include <QByteArray>
+#include <QString>
+
+#include <iostream>
+#include <optional>
+
+#include "BlueprintGenerator.h"
+#include "TestCheck.h"
+
+#include "BlueprintData.h"
+#include "Options.h"
+#include "PatchTemplate.h"
+#include "Salvo.h"
+
+namespace {
+    QByteArray const gridOpen("<CubeGrid>");
+    QByteArray const gridClose("</CubeGrid>");
+
+    // All grids of a blueprint, from the first <CubeGrid> to the last </CubeGrid>
+    QByteArray gridsOf(QByteArray const& blueprint) {
+        qsizetype const begin = blueprint.indexOf(gridOpen);
+        qsizetype const end = blueprint.lastIndexOf(gridClose) + gridClose.size();
+        return blueprint.mid(begin, end - begin);
+    }
+
+    std::optional<QByteArray> writeSalvo(Salvo const& salvo, qsizetype firstIndex, qsizetype count, QString const& pattern, QByteArray const& label) {
+        auto const parsed = Salvo::parsePattern(pattern);
+        QBuffer buffer;
+        if (!parsed || !buffer.open(QIODevice::WriteOnly) || !salvo.write(buffer, firstIndex, count, *parsed, label)) {
+            return std::nullopt;
+        }
+        return buffer.data();
+    }
+
+    void testPatterns(TestCheck& checks) {
+        CHECK(!Salvo::parsePattern(QStringLiteral("1,2")).has_value());
+        CHECK(!Salvo::parsePattern(QStringLiteral("1,2,x")).has_value());
+        CHECK(!Salvo::parsePattern(QStringLiteral("1,2,3:0:0,5,0")).has_value());
+        CHECK(!Salvo::parsePattern(QStringLiteral("1,2,3:2")).has_value());
+
+        auto const row = Salvo::parsePattern(QStringLiteral("10, 0, 0"));
+        if (CHECK(row.has_value())) {
+            Salvo::Vector const offset = Salvo::offset(*row, 3);
+            CHECK((offset.x == 30.0) && (offset.y == 0.0) && (offset.z == 0.0));
+        }
+        auto const rows = Salvo::parsePattern(QStringLiteral("10,0,0:4:0,-5,2.5"));
+        if (CHECK(rows.has_value())) {
+            Salvo::Vector const offset = Salvo::offset(*rows, 9);
+            CHECK((offset.x == 10.0) && (offset.y == -10.0) && (offset.z == 5.0));
+        }
+    }
+
+    // Without an offset, every copy in the salvo holds exactly the grids of a single copy with that number
+    void testSplicing(TestCheck& checks) {
+        BlueprintGenerator::Parameters parameters = BlueprintGenerator::defaultParameters();
+        parameters.blocks = 20;
+        parameters.subgrids = 1;
+        QByteArray const source = BlueprintGenerator::generate(parameters);
+        auto const blueprintData = BlueprintData::fromXml(source, Options(), std::cerr);
+        auto const patchTemplate = (blueprintData) ? PatchTemplate::compile(source, *blueprintData, {}, std::cerr) : std::nullopt;
+        auto const salvo = (patchTemplate) ? Salvo::compile(*patchTemplate, std::cerr) : std::nullopt;
+        if (!CHECK(salvo.has_value())) {
+            return;
+        }
+        CHECK(salvo->getGridCount() == 2);
+
+        auto const written = writeSalvo(*salvo, 2, 3, QStringLiteral("0,0,0"), "2-4");
+        if (!CHECK(written.has_value())) {
+            return;
+        }
+        qsizetype const gridsBegin = source.indexOf(gridOpen);
+        qsizetype const gridsEnd = source.lastIndexOf(gridClose) + gridClose.size();
+        qsizetype separatorBegin = gridsBegin;
+        while (QChar(source.at(separatorBegin - 1)).isSpace()) {
+            --separatorBegin;
+        }
+        QByteArray const separator = source.mid(separatorBegin, gridsBegin - separatorBegin);
+        QByteArray header = source.left(gridsBegin);
+        header.replace("Subtype=\"" + BlueprintGenerator::displayNameOf(parameters).toUtf8() + "\"", "Subtype=\"" + parameters.name.toUtf8() + " 2-4\"");
+
+        QByteArray expected = header;
+        expected.append(gridsOf(patchTemplate->instantiate(2))).append(separator);
+        expected.append(gridsOf(patchTemplate->instantiate(3))).append(separator);
+        expected.append(gridsOf(patchTemplate->instantiate(4)));
+        expected.append(source.mid(gridsEnd));
+        CHECK(*written == expected);
+    }
+
+    void testOffsets(TestCheck& checks) {
+        BlueprintGenerator::Parameters parameters = BlueprintGenerator::defaultParameters();
+        parameters.blocks = 4;
+        parameters.subgrids = 1;
+        QByteArray const source = BlueprintGenerator::generate(parameters);
+        auto const blueprintData = BlueprintData::fromXml(source, Options(), std::cerr);
+        auto const patchTemplate = (blueprintData) ? PatchTemplate::compile(source, *blueprintData, {}, std::cerr) : std::nullopt;
+        auto const salvo = (patchTemplate) ? Salvo::compile(*patchTemplate, std::cerr) : std::nullopt;
+        auto const written = (salvo) ? writeSalvo(*salvo, 1, 3, QStringLiteral("10,0,0:2:0,20,0"), "1-3") : std::nullopt;
+        if (!CHECK(written.has_value())) {
+            return;
+        }
+        // The generator places the main grid at the origin and the subgrid 5 m above it
+        CHECK(written->count(gridOpen) == 6);
+        CHECK(written->count("<Position x=\"0\" y=\"0\" z=\"0\" />") == 1);
+        CHECK(written->count("<Position x=\"0\" y=\"0\" z=\"5\" />") == 1);
+        CHECK(written->count("<Position x=\"10\" y=\"0\" z=\"0\" />") == 1);
+        CHECK(written->count("<Position x=\"10\" y=\"0\" z=\"5\" />") == 1);
+        CHECK(written->count("<Position x=\"0\" y=\"20\" z=\"0\" />") == 1);
+        CHECK(written->count("<Position x=\"0\" y=\"20\" z=\"5\" />") == 1);
+    }
+
+    void testNoGrids(TestCheck& checks) {
+        QByteArray const source("<Definitions><ShipBlueprints /></Definitions>");
+        CHECK(!Salvo::compile(PatchTemplate(source, {}), std::cerr).has_value());
+    }
+}
+
+int main() {
+    TestCheck checks;
+    testPatterns(checks);
+    testSplicing(checks);
+    testOffsets(checks);
+    testNoGrids(checks);
+    return checks.getResult();
+}
@@ -0,0 +1,132 @@
+#include <QByteArray>
+#include <QDir>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+#include <QTemporaryDir>
+
+#include <optional>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "TestCheck.h"
+
+#include "Sidecars.h"
+
+namespace {
+    bool writeFile(QString const& path, QByteArray const& contents) {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly) && (file.write(contents) == contents.size());
+    }
+
+    std::optional<QByteArray> readFile(QString const& path) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return std::nullopt;
+        }
+        return file.readAll();
+    }
+
+    QByteArray contentsOf(int index) {
+        return QByteArray("sidecar ").append(QByteArray::number(index)).repeated(100 * (index + 1));
+    }
+
+    qsizetype countOf(std::string const& text, std::string const& part) {
+        qsizetype result = 0;
+        for (std::size_t at = text.find(part); at != std::string::npos; at = text.find(part, at + part.size())) {
+            ++result;
+        }
+        return result;
+    }
+
+    void testParseStrategy(TestCheck& checks) {
+        CHECK(Sidecars::parseStrategy(QStringLiteral("auto")) == Sidecars::Strategy::Auto);
+        CHECK(Sidecars::parseStrategy(QStringLiteral("reflink")) == Sidecars::Strategy::Reflink);
+        CHECK(Sidecars::parseStrategy(QStringLiteral("hardlink")) == Sidecars::Strategy::Hardlink);
+        CHECK(Sidecars::parseStrategy(QStringLiteral("copyRange")) == Sidecars::Strategy::CopyRange);
+        CHECK(Sidecars::parseStrategy(QStringLiteral("copy")) == Sidecars::Strategy::Copy);
+        CHECK(!Sidecars::parseStrategy(QStringLiteral("symlink")).has_value());
+    }
+
+    // Whichever strategy the file system supports, every copy ends up with the same files. A strategy that fails is
+    // given up for good, so it is reported at most once however many files follow.
+    void testFallbackChain(TestCheck& checks, QTemporaryDir const& folder) {
+        QDir const root(folder.path());
+        QString const sourcePath = folder.filePath(QStringLiteral("Wasp 1"));
+        if (!CHECK(root.mkpath(QStringLiteral("Wasp 1")))) {
+            return;
+        }
+        int const fileCount = 5;
+        bool written = writeFile(QDir(sourcePath).absoluteFilePath(QStringLiteral("bp.sbc")), "<Definitions />") && writeFile(QDir(sourcePath).absoluteFilePath(QStringLiteral("bp.sbcB5")), "binary");
+        for (int i = 0; i < fileCount; ++i) {
+            written = written && writeFile(QDir(sourcePath).absoluteFilePath(QString("side%1.txt").arg(i)), contentsOf(i));
+        }
+        if (!CHECK(written)) {
+            return;
+        }
+
+        int copy = 2;
+        for (auto const strategy : { Sidecars::Strategy::Auto, Sidecars::Strategy::Reflink, Sidecars::Strategy::Hardlink, Sidecars::Strategy::CopyRange, Sidecars::Strategy::Copy }) {
+            Sidecars const sidecars(QDir(sourcePath), strategy);
+            CHECK(sidecars.getFiles().size() == static_cast<std::size_t>(fileCount));
+            for (auto const& file : sidecars.getFiles()) {
+                CHECK(file.contents.has_value() == (strategy == Sidecars::Strategy::Copy));
+                CHECK(sidecars.read(file) == contentsOf(file.name.mid(4, 1).toInt()));
+            }
+
+            QString const copyName = QString("Wasp %1").arg(copy++);
+            if (!CHECK(root.mkpath(copyName))) {
+                continue;
+            }
+            QDir const copyFolder(root.absoluteFilePath(copyName));
+            std::ostringstream error;
+            CHECK(sidecars.propagate(copyFolder, error) >= 0);
+            CHECK(countOf(error.str(), "Warning:") <= 1);
+            for (int i = 0; i < fileCount; ++i) {
+                CHECK(readFile(copyFolder.absoluteFilePath(QString("side%1.txt").arg(i))) == contentsOf(i));
+            }
+            CHECK(!copyFolder.exists(QStringLiteral("bp.sbc")) && !copyFolder.exists(QStringLiteral("bp.sbcB5")));
+
+            // Propagated again, the files that are already there are kept
+            std::ostringstream again;
+            CHECK(sidecars.propagate(copyFolder, again) == 0);
+            CHECK(countOf(error.str() + again.str(), "Warning:") <= 1);
+        }
+    }
+
+    // An existing sidecar is kept, a missing source fails
+    void testExistingAndMissing(TestCheck& checks, QTemporaryDir const& folder) {
+        QDir const root(folder.path());
+        if (!CHECK(root.mkpath(QStringLiteral("Memory 1")) && root.mkpath(QStringLiteral("Memory 2")))) {
+            return;
+        }
+        QDir const copyFolder(root.absoluteFilePath(QStringLiteral("Memory 2")));
+        CHECK(writeFile(copyFolder.absoluteFilePath(QStringLiteral("kept.txt")), "edited"));
+
+        Sidecars const inMemory(std::vector<Sidecars::File>{ { QStringLiteral("kept.txt"), QByteArray("original") }, { QStringLiteral("thumb.png"), QByteArray("png") } });
+        std::ostringstream error;
+        CHECK(inMemory.getStrategy() == Sidecars::Strategy::Copy);
+        CHECK(inMemory.propagate(copyFolder, error) == 3);
+        CHECK(readFile(copyFolder.absoluteFilePath(QStringLiteral("kept.txt"))) == QByteArray("edited"));
+        CHECK(readFile(copyFolder.absoluteFilePath(QStringLiteral("thumb.png"))) == QByteArray("png"));
+        CHECK(inMemory.getReplacedFileNames() == QStringList({ QStringLiteral("thumb.png"), QStringLiteral("kept.txt") }));
+
+        Sidecars const fromFolder(QDir(root.absoluteFilePath(QStringLiteral("Memory 1"))), Sidecars::Strategy::Auto);
+        CHECK(fromFolder.getFiles().empty());
+        CHECK(fromFolder.propagate(copyFolder, Sidecars::File{ QStringLiteral("missing.txt"), std::nullopt }, error) < 0);
+        CHECK(!copyFolder.exists(QStringLiteral("missing.txt")));
+    }
+}
+
+int main() {
+    TestCheck checks;
+    QTemporaryDir const folder;
+    if (!CHECK(folder.isValid())) {
+        return checks.getResult();
+    }
+    testParseStrategy(checks);
+    testFallbackChain(checks, folder);
+    testExistingAndMissing(checks, folder);
+    return checks.getResult();
+}
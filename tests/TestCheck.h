@@ -0,0 +1,39 @@
+#ifndef SPACEENGINEERS_BLUEPRINTDUPLICATOR_TESTCHECK_H_
+#define SPACEENGINEERS_BLUEPRINTDUPLICATOR_TESTCHECK_H_
+
+#include <iostream>
+
+/*
+	The little the test executables need instead of a test framework. Every failed check is printed with its
+	location, and the exit code of the test tells ctest whether all of them held.
+*/
+class TestCheck {
+public:
+	TestCheck() : m_failures(0) {
+		//
+	}
+
+	bool check(bool condition, char const* what, char const* file, int line) {
+		if (!condition) {
+			std::cerr << file << ":" << line << ": Check failed: " << what << std::endl;
+			++m_failures;
+		}
+		return condition;
+	}
+
+	// For main() to return
+	int getResult() const {
+		if (m_failures > 0) {
+			std::cerr << m_failures << " check" << ((m_failures == 1) ? "" : "s") << " failed." << std::endl;
+			return -1;
+		}
+		return 0;
+	}
+private:
+	int m_failures;
+};
+
+// Checks a condition with the TestCheck called checks in the calling scope
+#define CHECK(condition) checks.check((condition), #condition, __FILE__, __LINE__)
+
+#endif
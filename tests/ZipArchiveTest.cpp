@@ -0,0 +1,171 @@
+#include <QBuffer>
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QString>
+#include <QTemporaryDir>
+
+#include <memory>
+#include <iostream>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "TestCheck.h"
+
+#include "ZipArchive.h"
+
+namespace {
+    // Does not get smaller when deflated, so the archive stores it as it is
+    QByteArray incompressible(qsizetype size) {
+        QByteArray result;
+        quint32 state = 12345;
+        for (qsizetype i = 0; i < size; ++i) {
+            state = state * 1664525u + 1013904223u;
+            result.append(static_cast<char>(state >> 24));
+        }
+        return result;
+    }
+
+    QByteArray compressible() {
+        QByteArray result("<?xml version=\"1.0\"?>\n");
+        for (int i = 0; i < 200; ++i) {
+            result.append("<MyObjectBuilder_CubeBlock><SubtypeName>SmallBlockArmorBlock</SubtypeName></MyObjectBuilder_CubeBlock>\n");
+        }
+        return result;
+    }
+
+    bool writeFile(QString const& path, QByteArray const& contents) {
+        QFile file(path);
+        return file.open(QIODevice::WriteOnly) && (file.write(contents) == contents.size());
+    }
+
+    std::optional<QByteArray> writeArchive(std::vector<std::pair<QString, QByteArray>> const& files) {
+        QBuffer buffer;
+        if (!buffer.open(QIODevice::WriteOnly) || !ZipArchive::write(buffer, files, std::cerr)) {
+            return std::nullopt;
+        }
+        return buffer.data();
+    }
+
+    // Judged by the suffix, but only for files
+    void testIsArchive(TestCheck& checks, QTemporaryDir const& folder) {
+        QString const upperCase = folder.filePath(QStringLiteral("Wasp.SBB"));
+        QString const blueprint = folder.filePath(QStringLiteral("bp.sbc"));
+        CHECK(writeFile(upperCase, QByteArray()) && writeFile(blueprint, QByteArray()));
+        CHECK(ZipArchive::isArchive(upperCase));
+        CHECK(!ZipArchive::isArchive(blueprint));
+        CHECK(!ZipArchive::isArchive(folder.filePath(QStringLiteral("Missing.sbb"))));
+    }
+
+    // Whatever is written is read back the same, deflated or stored, whole or as a device
+    void testRoundTrip(TestCheck& checks, QTemporaryDir const& folder) {
+        std::vector<std::pair<QString, QByteArray>> const files{ { QStringLiteral("bp.sbc"), compressible() }, { QStringLiteral("thumb.png"), incompressible(4096) }, { QStringLiteral("empty.txt"), QByteArray() } };
+        auto const written = writeArchive(files);
+        QString const path = folder.filePath(QStringLiteral("RoundTrip.sbb"));
+        if (!CHECK(written.has_value()) || !CHECK(writeFile(path, *written))) {
+            return;
+        }
+        auto const archive = ZipArchive::open(path, std::cerr);
+        if (!CHECK(archive.has_value())) {
+            return;
+        }
+        CHECK(archive->getEntries().size() == files.size());
+        CHECK(archive->find(QStringLiteral("missing.txt")) == nullptr);
+        for (auto const& file : files) {
+            auto const* const entry = archive->find(file.first);
+            if (!CHECK(entry != nullptr)) {
+                continue;
+            }
+            CHECK(entry->size == file.second.size());
+            auto const contents = archive->read(*entry, std::cerr);
+            CHECK(contents.has_value() && (*contents == file.second));
+
+            std::unique_ptr<QIODevice> const device = archive->openEntry(*entry, std::cerr);
+            if (CHECK(device != nullptr)) {
+                // The device is sequential, so it only knows it is done once nothing more comes
+                QByteArray streamed;
+                for (QByteArray chunk = device->read(1000); !chunk.isEmpty(); chunk = device->read(1000)) {
+                    streamed.append(chunk);
+                }
+                CHECK(streamed == file.second);
+            }
+        }
+    }
+
+    // A changed byte in a stored entry is caught by its checksum
+    void testCorruptEntry(TestCheck& checks, QTemporaryDir const& folder) {
+        QByteArray const thumbnail = incompressible(2048);
+        auto written = writeArchive({ { QStringLiteral("thumb.png"), thumbnail } });
+        qsizetype const at = (written) ? written->indexOf(thumbnail) : -1;
+        if (!CHECK(at >= 0)) {
+            return;
+        }
+        (*written)[at + 100] = static_cast<char>(~written->at(at + 100));
+        QString const path = folder.filePath(QStringLiteral("Corrupt.sbb"));
+        auto const archive = (writeFile(path, *written)) ? ZipArchive::open(path, std::cerr) : std::nullopt;
+        if (CHECK(archive.has_value())) {
+            auto const* const entry = archive->find(QStringLiteral("thumb.png"));
+            CHECK((entry != nullptr) && !archive->read(*entry, std::cerr).has_value());
+        }
+    }
+
+    // An entry larger than its size in the central directory fails right after that size, like a deflate bomb would
+    void testOversizedEntry(TestCheck& checks, QTemporaryDir const& folder) {
+        QByteArray const contents = compressible();
+        auto written = writeArchive({ { QStringLiteral("bp.sbc"), contents } });
+        qsizetype const central = (written) ? written->indexOf(QByteArray("PK\x01\x02", 4)) : -1;
+        if (!CHECK(central >= 0)) {
+            return;
+        }
+        // The uncompressed size, little endian at offset 24 of the central directory header
+        qint64 const claimed = 100;
+        for (int i = 0; i < 4; ++i) {
+            (*written)[central + 24 + i] = static_cast<char>((claimed >> (8 * i)) & 0xFF);
+        }
+        QString const path = folder.filePath(QStringLiteral("Oversized.sbb"));
+        auto const archive = (writeFile(path, *written)) ? ZipArchive::open(path, std::cerr) : std::nullopt;
+        auto const* const entry = (archive) ? archive->find(QStringLiteral("bp.sbc")) : nullptr;
+        if (!CHECK(entry != nullptr) || !CHECK(entry->size == claimed)) {
+            return;
+        }
+        CHECK(!archive->read(*entry, std::cerr).has_value());
+
+        std::unique_ptr<QIODevice> const device = archive->openEntry(*entry, std::cerr);
+        if (CHECK(device != nullptr)) {
+            QByteArray streamed;
+            for (QByteArray chunk = device->read(4096); !chunk.isEmpty(); chunk = device->read(4096)) {
+                streamed.append(chunk);
+            }
+            CHECK(streamed.size() <= claimed);
+            CHECK(contents.startsWith(streamed));
+        }
+    }
+
+    void testNotAnArchive(TestCheck& checks, QTemporaryDir const& folder) {
+        QString const text = folder.filePath(QStringLiteral("Text.sbb"));
+        CHECK(writeFile(text, "This is not a zip archive at all, just some text that is long enough."));
+        CHECK(!ZipArchive::open(text, std::cerr).has_value());
+
+        auto const written = writeArchive({ { QStringLiteral("bp.sbc"), compressible() } });
+        QString const truncated = folder.filePath(QStringLiteral("Truncated.sbb"));
+        CHECK(written.has_value() && writeFile(truncated, written->left(written->size() - 10)));
+        CHECK(!ZipArchive::open(truncated, std::cerr).has_value());
+
+        CHECK(!ZipArchive::open(folder.filePath(QStringLiteral("Missing.sbb")), std::cerr).has_value());
+    }
+}
+
+int main() {
+    TestCheck checks;
+    QTemporaryDir const folder;
+    if (!CHECK(folder.isValid())) {
+        return checks.getResult();
+    }
+    testIsArchive(checks, folder);
+    testRoundTrip(checks, folder);
+    testCorruptEntry(checks, folder);
+    testOversizedEntry(checks, folder);
+    testNotAnArchive(checks, folder);
+    return checks.getResult();
+}